@@ -5,6 +5,8 @@
 #include <netdb.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
 #include <xtables.h>
 
 #include <linux/netfilter/xt_dnp3.h>
@@ -12,23 +14,51 @@
 
 enum {
     O_CHECKSUM = 0,
+    O_CRC,
     O_DADDR,
     O_SADDR,
     O_FC,
+    O_OBJECT,
+    O_POLICY,
+    O_RATE,
+    O_BURST,
+    O_PER,
+    O_EVENT,
+    O_CTMARK,
+    O_LEARN,
 };
 
+/*
+    The --fc-burst and --per options qualify the --fc-rate option and are tracked 
+    within the option flags of the parser only, above the flags of the rule.
+*/
+
+#define DNP3_FLAG_BURST                 (0x00010000)
+#define DNP3_FLAG_PER                   (0x00020000)
+
 static const struct option dnp3_opts[] = {
         { .name = "chksum", .has_arg = false, .val = O_CHECKSUM },
+        { .name = "crc", .has_arg = true, .val = O_CRC },
+        { .name = "ct-mark", .has_arg = true, .val = O_CTMARK },
         { .name = "daddr", .has_arg = true, .val = O_DADDR },
         { .name = "destination-addr", .has_arg = true, .val = O_DADDR },
+        { .name = "event", .has_arg = true, .val = O_EVENT },
         { .name = "fc", .has_arg = true, .val = O_FC },
+        { .name = "fc-burst", .has_arg = true, .val = O_BURST },
+        { .name = "fc-rate", .has_arg = true, .val = O_RATE },
         { .name = "function-code", .has_arg = true, .val = O_FC },
+        { .name = "learn", .has_arg = false, .val = O_LEARN },
+        { .name = "object", .has_arg = true, .val = O_OBJECT },
+        { .name = "per", .has_arg = true, .val = O_PER },
+        { .name = "policy", .has_arg = true, .val = O_POLICY },
         { .name = "saddr", .has_arg = true, .val = O_SADDR },
         { .name = "source-addr", .has_arg = true, .val = O_SADDR },
         XT_GETOPT_TABLEEND,
 };
 
 
+static void dnp3_check( unsigned int flags );
+
 static void dnp3_help( void );
 
 static void dnp3_init( struct xt_entry_match *m );
@@ -37,19 +67,59 @@ static int dnp3_parse( int c, char **argv, int invert, unsigned int *flags, cons
 
 static void dnp3_parse_address( const char *arg, uint16_t *addr );
 
+static void dnp3_parse_crc( const char *arg, struct xt_dnp3 *dnp3info );
+
 static void dnp3_parse_function( const char *arg, uint8_t *func );
 
 static int dnp3_parse_isnumber( const char *arg );
 
+static void dnp3_parse_mark( const char *arg, struct xt_dnp3 *dnp3info );
+
+static uint32_t dnp3_parse_number( const char *arg, uint32_t max );
+
+static void dnp3_parse_object( const char *arg, struct xt_dnp3_object *object );
+
+static void dnp3_parse_rate( const char *arg, struct xt_dnp3 *dnp3info );
+
 static void dnp3_print( const void *ip, const struct xt_entry_match *match, int numeric );
 
 static void dnp3_output_address( const char *name, uint16_t min, uint16_t max, int invert, int flag );
 
+static void dnp3_output_crc( const char *name, const struct xt_dnp3 *dnp3info );
+
+static void dnp3_output_event( const char *name, const struct xt_dnp3 *dnp3info );
+
 static void dnp3_output_function( const char *name, uint8_t *func, int invert, int flag );
 
+static void dnp3_output_learn( const char *name, const struct xt_dnp3 *dnp3info );
+
+static void dnp3_output_mark( const char *name, const struct xt_dnp3 *dnp3info );
+
+static void dnp3_output_object( const char *name, const struct xt_dnp3 *dnp3info );
+
+static void dnp3_output_policy( const char *name, const struct xt_dnp3 *dnp3info );
+
+static void dnp3_output_rate( const char *prefix, const struct xt_dnp3 *dnp3info );
+
 static void dnp3_save( const void *ip, const struct xt_entry_match *match ); 
 
 
+static void
+dnp3_check( unsigned int flags )
+{
+    if( ( flags & ( DNP3_FLAG_BURST | DNP3_FLAG_PER ) ) &&
+            ( ! ( flags & XT_DNP3_FLAG_RATE ) ) ) {
+        xtables_error( PARAMETER_PROBLEM, 
+                "`--fc-burst` and `--per` require `--fc-rate`" );
+    }
+    if( ( flags & XT_DNP3_FLAG_LEARN ) &&
+            ( flags & ~( XT_DNP3_FLAG_LEARN | XT_DNP3_FLAG_CHECKSUM ) ) ) {
+        xtables_error( PARAMETER_PROBLEM, 
+                "`--learn` may only be combined with `--crc`" );
+    }
+}
+
+
 static void 
 dnp3_help( void ) 
 {
@@ -63,7 +133,27 @@ dnp3_help( void )
 "\t\t\t\tsource address(es)\n" 
 "[!] --function-code code[,code]\n"
 " --fc ...\n"
-"\t\t\t\tfunction code(s)\n");
+"\t\t\t\tfunction code(s)\n"
+"[!] --object group[:variation][,qualifier=code][,index=min[:max]][,count=max]\n"
+"\t\t\t\tobject header constraint (up to %u)\n"
+"[!] --policy name\n"
+"\t\t\t\tfunction codes permitted by policy table\n"
+"[!] --fc-rate rate[/second|/minute|/hour]\n"
+"\t\t\t\tmessage rate limit\n"
+" --fc-burst number\n"
+"\t\t\t\tmessage rate limit burst (default %u)\n"
+" --per daddr|saddr|pair\n"
+"\t\t\t\tmessage rate limit key (default daddr)\n"
+" --crc none|header|full|sample:N\n"
+"\t\t\t\tCRC validation (default full)\n"
+" --event tag\n"
+"\t\t\t\texport event records of matched frames\n"
+" --ct-mark value[/mask]\n"
+"\t\t\t\tset connection mark of matched packets\n"
+" --learn\n"
+"\t\t\t\trecord observed tuples and match all packets\n",
+            XT_DNP3_OBJECTS,
+            XT_DNP3_RATE_BURST );
 }
 
 
@@ -76,6 +166,7 @@ dnp3_init( struct xt_entry_match *m )
     dnp3info->daddr[1] = dnp3info->saddr[1]
             = (uint16_t) ~0U;
     dnp3info->set = dnp3info->invert = 0;
+    dnp3info->burst = XT_DNP3_RATE_BURST;
 }
 
 
@@ -83,11 +174,23 @@ static int
 dnp3_parse( int c, char **argv, int invert, unsigned int *flags, const void *entry, struct xt_entry_match **match )
 {
     struct xt_dnp3 *dnp3info = ( struct xt_dnp3 * ) (*match)->data;
-    uint8_t flag;
+    uint32_t flag;
 
     flag = 0;
     switch( c ) {
         case O_CHECKSUM:
+        case O_CRC:
+            if( *flags & XT_DNP3_FLAG_CHECKSUM ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Only single `--crc` definition allowed" );
+            }
+            if( invert ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Inversion not supported for `--crc`" );
+            }
+            if( c == O_CRC ) {
+                dnp3_parse_crc( optarg, dnp3info );
+            }
             flag = XT_DNP3_FLAG_CHECKSUM;
             break;
         case O_DADDR:
@@ -116,6 +219,102 @@ dnp3_parse( int c, char **argv, int invert, unsigned int *flags, const void *ent
             dnp3_parse_function( optarg, dnp3info->fc );
             flag = XT_DNP3_FLAG_FC;
             break;
+        case O_OBJECT:
+            if( dnp3info->objects >= XT_DNP3_OBJECTS ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Only %u `--object` definitions allowed", XT_DNP3_OBJECTS );
+            }
+            if( ( *flags & XT_DNP3_FLAG_OBJECT ) &&
+                    ( ( ! ( dnp3info->invert & XT_DNP3_FLAG_OBJECT ) ) != ( ! invert ) ) ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Inversion must be specified for all or no `--object` definitions" );
+            }
+            dnp3_parse_object( optarg, &dnp3info->object[ dnp3info->objects++ ] );
+            flag = XT_DNP3_FLAG_OBJECT;
+            break;
+        case O_POLICY:
+            if( *flags & XT_DNP3_FLAG_POLICY ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Only single `--policy` definition allowed" );
+            }
+            if( ( optarg[0] == '\0' ) ||
+                    ( strlen( optarg ) >= XT_DNP3_POLICY_NAME ) ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Invalid DNP3 policy table name `%s'", optarg );
+            }
+            ( void ) strcpy( dnp3info->policy, optarg );
+            flag = XT_DNP3_FLAG_POLICY;
+            break;
+        case O_RATE:
+            if( *flags & XT_DNP3_FLAG_RATE ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Only single `--fc-rate` definition allowed" );
+            }
+            dnp3_parse_rate( optarg, dnp3info );
+            flag = XT_DNP3_FLAG_RATE;
+            break;
+        case O_EVENT:
+            if( *flags & XT_DNP3_FLAG_EVENT ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Only single `--event` definition allowed" );
+            }
+            if( invert ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Inversion not supported for `--event`" );
+            }
+            dnp3info->event = ( uint8_t ) dnp3_parse_number( optarg, 255 );
+            flag = XT_DNP3_FLAG_EVENT;
+            break;
+        case O_CTMARK:
+            if( *flags & XT_DNP3_FLAG_CTMARK ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Only single `--ct-mark` definition allowed" );
+            }
+            if( invert ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Inversion not supported for `--ct-mark`" );
+            }
+            dnp3_parse_mark( optarg, dnp3info );
+            flag = XT_DNP3_FLAG_CTMARK;
+            break;
+        case O_LEARN:
+            if( invert ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Inversion not supported for `--learn`" );
+            }
+            flag = XT_DNP3_FLAG_LEARN;
+            break;
+        case O_BURST:
+        case O_PER:
+            if( invert ) {
+                xtables_error( PARAMETER_PROBLEM, 
+                        "Inversion not supported for `--fc-burst` or `--per`" );
+            }
+            if( c == O_BURST ) {
+                dnp3info->burst = dnp3_parse_number( optarg, XT_DNP3_RATE_BURST_MAX );
+                if( dnp3info->burst == 0 ) {
+                    xtables_error( PARAMETER_PROBLEM, 
+                            "Invalid DNP3 rate limit burst `%s'", optarg );
+                }
+                *flags |= DNP3_FLAG_BURST;
+            }
+            else {
+                if( strcmp( optarg, "daddr" ) == 0 ) {
+                    dnp3info->per = XT_DNP3_RATE_DADDR;
+                }
+                else if( strcmp( optarg, "saddr" ) == 0 ) {
+                    dnp3info->per = XT_DNP3_RATE_SADDR;
+                }
+                else if( strcmp( optarg, "pair" ) == 0 ) {
+                    dnp3info->per = XT_DNP3_RATE_PAIR;
+                }
+                else {
+                    xtables_error( PARAMETER_PROBLEM, 
+                            "Unknown DNP3 rate limit key `%s'", optarg );
+                }
+                *flags |= DNP3_FLAG_PER;
+            }
+            return 1;
     }
     if( invert ) {
         dnp3info->invert |= flag;
@@ -150,6 +349,51 @@ dnp3_parse_address( const char *arg, uint16_t *addr )
 }
 
 
+/*
+    The sample interval of the sample:N validation mode must be a power of two, 
+    such that the frames validated for each interval are a subset of those 
+    validated for any shorter interval, and is rejected otherwise rather than 
+    rounded, such that the rule saved is that specified.
+*/
+
+static void
+dnp3_parse_crc( const char *arg, struct xt_dnp3 *dnp3info )
+{
+    unsigned long val;
+
+    if( strcmp( arg, "full" ) == 0 ) {
+        dnp3info->crc = XT_DNP3_CRC_FULL;
+    }
+    else if( strcmp( arg, "header" ) == 0 ) {
+        dnp3info->crc = XT_DNP3_CRC_HEADER;
+    }
+    else if( strcmp( arg, "none" ) == 0 ) {
+        dnp3info->crc = XT_DNP3_CRC_NONE;
+    }
+    else if( strncmp( arg, "sample:", 7 ) == 0 ) {
+        if( dnp3_parse_isnumber( &arg[7] ) == 0 ) {
+            xtables_error( PARAMETER_PROBLEM,
+                    "Invalid CRC sample interval `%s'", &arg[7] );
+        }
+        val = strtoul( &arg[7], NULL, 10 );
+        if( ( val == 0 ) ||
+                ( val > ( 1UL << XT_DNP3_CRC_SAMPLE_MAX ) ) ||
+                ( ( val & ( val - 1 ) ) != 0 ) ) {
+            xtables_error( PARAMETER_PROBLEM,
+                    "CRC sample interval must be a power of two between 1 and %lu", ( 1UL << XT_DNP3_CRC_SAMPLE_MAX ) );
+        }
+        dnp3info->crc = XT_DNP3_CRC_SAMPLE;
+        for( dnp3info->sample = 0; ( val >>= 1 ) != 0; ++dnp3info->sample ) {
+            ;
+        }
+    }
+    else {
+        xtables_error( PARAMETER_PROBLEM,
+                "Unknown CRC validation mode `%s'", arg );
+    }
+}
+
+
 static void
 dnp3_parse_function( const char *arg, uint8_t *func )
 {
@@ -187,6 +431,160 @@ dnp3_parse_isnumber( const char *arg )
 }
 
 
+/*
+    A connection mark is specified as a value, optionally followed by the mask of 
+    the bits of the connection mark which are replaced by this value - for 
+    example, `0x100/0x100'. Where no mask is specified, the connection mark is 
+    replaced in whole.
+*/
+
+static void
+dnp3_parse_mark( const char *arg, struct xt_dnp3 *dnp3info )
+{
+    char buffer[ 32 ], *mask;
+
+    if( strlen( arg ) >= sizeof( buffer ) ) {
+        xtables_error( PARAMETER_PROBLEM,
+                "Invalid connection mark `%s'", arg );
+    }
+    ( void ) strcpy( buffer, arg );
+    dnp3info->ctmask = UINT32_MAX;
+    if( ( mask = strchr( buffer, '/' ) ) != NULL ) {
+        *mask++ = '\0';
+        dnp3info->ctmask = dnp3_parse_number( mask, UINT32_MAX );
+    }
+    dnp3info->ctmark = dnp3_parse_number( buffer, UINT32_MAX );
+    if( dnp3info->ctmark & ~dnp3info->ctmask ) {
+        xtables_error( PARAMETER_PROBLEM,
+                "Connection mark `%s' has bits outside of mask", arg );
+    }
+}
+
+
+static uint32_t
+dnp3_parse_number( const char *arg, uint32_t max )
+{
+    unsigned long val;
+    char *end;
+
+    errno = 0;
+    val = strtoul( arg, &end, 0 );
+    if( ( ! isdigit( ( unsigned char ) arg[0] ) ) ||
+            ( *end != '\0' ) ||
+            ( errno != 0 ) ||
+            ( val > max ) ) {
+        xtables_error( PARAMETER_PROBLEM,
+                "Invalid value `%s'", arg );
+    }
+    return ( uint32_t ) val;
+}
+
+
+/*
+    An object header constraint is specified as the object group, optionally 
+    followed by the variation, and a comma-separated list of the qualifier code, 
+    point index range and maximum number of objects of the object header - for 
+    example, `12:1,qualifier=0x17,index=0:15,count=1'. Fields which are not 
+    specified are not constrained.
+*/
+
+static void
+dnp3_parse_object( const char *arg, struct xt_dnp3_object *object )
+{
+    char *buffer, *ptr, *save, *value;
+
+    buffer = strdup( arg );
+    ptr = strtok_r( buffer, ",", &save );
+    if( ptr == NULL ) {
+        xtables_error( PARAMETER_PROBLEM,
+                "Invalid DNP3 object header `%s'", arg );
+    }
+    if( ( value = strchr( ptr, ':' ) ) != NULL ) {
+        *value++ = '\0';
+        object->variation = ( uint8_t ) dnp3_parse_number( value, 255 );
+        object->flags |= XT_DNP3_OBJECT_VARIATION;
+    }
+    object->group = ( uint8_t ) dnp3_parse_number( ptr, 255 );
+
+    while( ( ptr = strtok_r( NULL, ",", &save ) ) != NULL ) {
+        if( strncmp( ptr, "qualifier=", 10 ) == 0 ) {
+            object->qualifier = ( uint8_t ) dnp3_parse_number( &ptr[10], 255 );
+            object->flags |= XT_DNP3_OBJECT_QUALIFIER;
+        }
+        else if( strncmp( ptr, "index=", 6 ) == 0 ) {
+            ptr += 6;
+            if( ( value = strchr( ptr, ':' ) ) == NULL ) {
+                object->index[0] = object->index[1] = dnp3_parse_number( ptr, UINT32_MAX );
+            }
+            else {
+                *value++ = '\0';
+                object->index[0] = ptr[0] ? dnp3_parse_number( ptr, UINT32_MAX ) : 0;
+                object->index[1] = value[0] ? dnp3_parse_number( value, UINT32_MAX ) : UINT32_MAX;
+                if( object->index[0] > object->index[1] ) {
+                    xtables_error( PARAMETER_PROBLEM,
+                            "Invalid DNP3 point index range (min > max)" );
+                }
+            }
+            object->flags |= XT_DNP3_OBJECT_INDEX;
+        }
+        else if( strncmp( ptr, "count=", 6 ) == 0 ) {
+            object->count = dnp3_parse_number( &ptr[6], UINT32_MAX );
+            object->flags |= XT_DNP3_OBJECT_COUNT;
+        }
+        else {
+            xtables_error( PARAMETER_PROBLEM,
+                    "Unknown DNP3 object header field `%s'", ptr );
+        }
+    }
+    free( buffer );
+}
+
+
+/*
+    A rate limit is specified as the number of messages admitted per second, 
+    minute or hour, and is held as the interval between messages in microseconds.
+*/
+
+static void
+dnp3_parse_rate( const char *arg, struct xt_dnp3 *dnp3info )
+{
+    static const struct {
+        const char *name;
+        uint32_t period;
+    } units[] = {
+        { "second", 1000000U },
+        { "minute", 60000000U },
+        { "hour", 3600000000U },
+    };
+    char *buffer, *ptr;
+    unsigned int index;
+    uint32_t period, rate;
+
+    buffer = strdup( arg );
+    period = units[0].period;
+    if( ( ptr = strchr( buffer, '/' ) ) != NULL ) {
+        *ptr++ = '\0';
+        for( index = 0; index < ARRAY_SIZE( units ); ++index ) {
+            if( ( ptr[0] != '\0' ) &&
+                    ( strncmp( units[ index ].name, ptr, strlen( ptr ) ) == 0 ) ) {
+                break;
+            }
+        }
+        if( index == ARRAY_SIZE( units ) ) {
+            xtables_error( PARAMETER_PROBLEM,
+                    "Unknown DNP3 rate limit unit `%s'", ptr );
+        }
+        period = units[ index ].period;
+    }
+    if( ( rate = dnp3_parse_number( buffer, period ) ) == 0 ) {
+        xtables_error( PARAMETER_PROBLEM,
+                "Invalid DNP3 rate limit `%s'", arg );
+    }
+    dnp3info->interval = period / rate;
+    free( buffer );
+}
+
+
 static void
 dnp3_print( const void *ip, const struct xt_entry_match *match, int numeric )
 {
@@ -194,9 +592,7 @@ dnp3_print( const void *ip, const struct xt_entry_match *match, int numeric )
 
     printf( " dnp3" );
 
-    printf( "%s%s",
-            ( dnp3info->invert & XT_DNP3_FLAG_CHECKSUM ) ? " !" : "",
-            ( dnp3info->set & XT_DNP3_FLAG_CHECKSUM ) ? " chksum" : "" );
+    dnp3_output_crc( "crc", dnp3info );
 
     dnp3_output_address( "daddr",
             dnp3info->daddr[0],
@@ -212,6 +608,12 @@ dnp3_print( const void *ip, const struct xt_entry_match *match, int numeric )
             dnp3info->fc,
             dnp3info->invert & XT_DNP3_FLAG_FC,
             dnp3info->set & XT_DNP3_FLAG_FC );
+    dnp3_output_object( "object", dnp3info );
+    dnp3_output_policy( "policy", dnp3info );
+    dnp3_output_rate( "", dnp3info );
+    dnp3_output_event( "event", dnp3info );
+    dnp3_output_mark( "ct-mark", dnp3info );
+    dnp3_output_learn( "learn", dnp3info );
 }
 
 
@@ -233,6 +635,43 @@ dnp3_output_address( const char *name, uint16_t min, uint16_t max, int invert, i
     }
 }
 
+static void
+dnp3_output_crc( const char *name, const struct xt_dnp3 *dnp3info )
+{
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_CHECKSUM ) ) {
+        return;
+    }
+
+    printf( " %s ", name );
+    switch( dnp3info->crc ) {
+        case XT_DNP3_CRC_HEADER:
+            printf( "header" );
+            break;
+        case XT_DNP3_CRC_NONE:
+            printf( "none" );
+            break;
+        case XT_DNP3_CRC_SAMPLE:
+            printf( "sample:%u", ( 1U << dnp3info->sample ) );
+            break;
+        case XT_DNP3_CRC_FULL:
+        default:
+            printf( "full" );
+            break;
+    }
+}
+
+
+static void
+dnp3_output_event( const char *name, const struct xt_dnp3 *dnp3info )
+{
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_EVENT ) ) {
+        return;
+    }
+
+    printf( " %s %u", name, dnp3info->event );
+}
+
+
 static void
 dnp3_output_function( const char *name, uint8_t *func, int invert, int flag ) 
 {
@@ -258,14 +697,122 @@ dnp3_output_function( const char *name, uint8_t *func, int invert, int flag )
 }
 
 
+static void
+dnp3_output_learn( const char *name, const struct xt_dnp3 *dnp3info )
+{
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_LEARN ) ) {
+        return;
+    }
+
+    printf( " %s", name );
+}
+
+
+static void
+dnp3_output_mark( const char *name, const struct xt_dnp3 *dnp3info )
+{
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_CTMARK ) ) {
+        return;
+    }
+
+    printf( " %s 0x%x", name, dnp3info->ctmark );
+    if( dnp3info->ctmask != UINT32_MAX ) {
+        printf( "/0x%x", dnp3info->ctmask );
+    }
+}
+
+
+static void
+dnp3_output_object( const char *name, const struct xt_dnp3 *dnp3info )
+{
+    const struct xt_dnp3_object *object;
+    uint8_t index;
+
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_OBJECT ) ) {
+        return;
+    }
+
+    for( index = 0; index < dnp3info->objects; ++index ) {
+        object = &dnp3info->object[ index ];
+        printf( " %s%s %u", 
+                ( dnp3info->invert & XT_DNP3_FLAG_OBJECT ) ? "! " : "", 
+                name, 
+                object->group );
+        if( object->flags & XT_DNP3_OBJECT_VARIATION ) {
+            printf( ":%u", object->variation );
+        }
+        if( object->flags & XT_DNP3_OBJECT_QUALIFIER ) {
+            printf( ",qualifier=0x%02x", object->qualifier );
+        }
+        if( object->flags & XT_DNP3_OBJECT_INDEX ) {
+            if( object->index[0] != object->index[1] ) {
+                printf( ",index=%u:%u", object->index[0], object->index[1] );
+            }
+            else {
+                printf( ",index=%u", object->index[0] );
+            }
+        }
+        if( object->flags & XT_DNP3_OBJECT_COUNT ) {
+            printf( ",count=%u", object->count );
+        }
+    }
+}
+
+
+static void
+dnp3_output_policy( const char *name, const struct xt_dnp3 *dnp3info )
+{
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_POLICY ) ) {
+        return;
+    }
+
+    printf( " %s%s %s", 
+            ( dnp3info->invert & XT_DNP3_FLAG_POLICY ) ? "! " : "", 
+            name, 
+            dnp3info->policy );
+}
+
+
+/*
+    The interval of a rate limit is output as a rate in the largest unit of which 
+    the interval is a whole fraction.
+*/
+
+static void
+dnp3_output_rate( const char *prefix, const struct xt_dnp3 *dnp3info )
+{
+    static const char *per[] = { "daddr", "saddr", "pair" };
+
+    if( ! ( dnp3info->set & XT_DNP3_FLAG_RATE ) ) {
+        return;
+    }
+
+    printf( " %s%sfc-rate ", 
+            ( dnp3info->invert & XT_DNP3_FLAG_RATE ) ? "! " : "", 
+            prefix );
+    if( ( 1000000U % dnp3info->interval ) == 0 ) {
+        printf( "%u/second", 1000000U / dnp3info->interval );
+    }
+    else if( ( 60000000U % dnp3info->interval ) == 0 ) {
+        printf( "%u/minute", 60000000U / dnp3info->interval );
+    }
+    else {
+        printf( "%u/hour", 3600000000U / dnp3info->interval );
+    }
+    printf( " %sfc-burst %u %sper %s", 
+            prefix, 
+            dnp3info->burst, 
+            prefix, 
+            ( dnp3info->per < XT_DNP3_RATE_MAX ) ? per[ dnp3info->per ] : "daddr" );
+}
+
+
 static void 
 dnp3_save( const void *ip, const struct xt_entry_match *match )
 {
     struct xt_dnp3 *dnp3info = (struct xt_dnp3 *) match->data;
 
-    printf( "%s%s", 
-            ( dnp3info->invert & XT_DNP3_FLAG_CHECKSUM ) ? "! " : "",
-            ( dnp3info->set & XT_DNP3_FLAG_CHECKSUM ) ? "--chksum" : "" );
+    dnp3_output_crc( "--crc", dnp3info );
 
     dnp3_output_address( "--daddr",
             dnp3info->daddr[0],
@@ -281,6 +828,12 @@ dnp3_save( const void *ip, const struct xt_entry_match *match )
             dnp3info->fc,
             dnp3info->invert & XT_DNP3_FLAG_FC,
             dnp3info->set & XT_DNP3_FLAG_FC );
+    dnp3_output_object( "--object", dnp3info );
+    dnp3_output_policy( "--policy", dnp3info );
+    dnp3_output_rate( "--", dnp3info );
+    dnp3_output_event( "--event", dnp3info );
+    dnp3_output_mark( "--ct-mark", dnp3info );
+    dnp3_output_learn( "--learn", dnp3info );
 }
 
 
@@ -289,10 +842,11 @@ static struct xtables_match dnp3_match = {
     .name               = "dnp3",
     .version            = XTABLES_VERSION,
     .size               = XT_ALIGN( sizeof( struct xt_dnp3 ) ),
-    .userspacesize      = XT_ALIGN( sizeof( struct xt_dnp3 ) ),
+    .userspacesize      = offsetof( struct xt_dnp3, program ),
     .help               = dnp3_help,
     .init               = dnp3_init,
     .parse              = dnp3_parse,
+    .final_check        = dnp3_check,
     .print              = dnp3_print,
     .save               = dnp3_save,
     .extra_opts         = dnp3_opts,
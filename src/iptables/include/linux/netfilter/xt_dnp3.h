@@ -5,19 +5,81 @@
 #include <linux/types.h>
 
 
+#define XT_DNP3_OBJECTS                 (4)
+
+#define XT_DNP3_POLICY_NAME             (16)
+
+struct xt_dnp3_object {
+    __u8 group;                         /* Object group */
+    __u8 variation;                     /* Object variation */
+    __u8 qualifier;                     /* Qualifier code */
+    __u8 flags;                         /* Constrained fields */
+    __u32 index[2];                     /* Point index range */
+    __u32 count;                        /* Maximum number of objects */
+};
+
 struct xt_dnp3 {
     __u16 daddr[2];                     /* Destination address */
     __u16 saddr[2];                     /* Source address */
     __u8 fc[32];                        /* Function code */
     __u32 set;                          /* Set flags */
     __u32 invert;                       /* Invert flags */
+    __u8 crc;                           /* CRC validation */
+    __u8 sample;                        /* CRC sample interval (log2) */
+    __u8 objects;                       /* Object header constraints */
+    struct xt_dnp3_object object[XT_DNP3_OBJECTS];
+    char policy[XT_DNP3_POLICY_NAME];   /* Policy table */
+    __u32 interval;                     /* Rate limit interval (us) */
+    __u32 burst;                        /* Rate limit burst */
+    __u8 per;                           /* Rate limit key */
+    __u8 event;                         /* Event tag */
+    __u32 ctmark;                       /* Connection mark */
+    __u32 ctmask;                       /* Connection mark mask */
+
+    /* Used internally by the kernel */
+    struct xt_dnp3_program *program __attribute__((aligned(8)));
+    struct xt_dnp3_table *table;
+    struct xt_dnp3_rate *rate;
+    __u8 matcher;                       /* Specialised matcher */
 };
 
 #define XT_DNP3_FLAG_CHECKSUM           (0x00000001)
 #define XT_DNP3_FLAG_DADDR              (0x00000002)
 #define XT_DNP3_FLAG_SADDR              (0x00000004)
 #define XT_DNP3_FLAG_FC                 (0x00000008)
-#define XT_DNP3_FLAG_MASK               (0x0000000f)
+#define XT_DNP3_FLAG_OBJECT             (0x00000010)
+#define XT_DNP3_FLAG_POLICY             (0x00000020)
+#define XT_DNP3_FLAG_RATE               (0x00000040)
+#define XT_DNP3_FLAG_EVENT              (0x00000080)
+#define XT_DNP3_FLAG_CTMARK             (0x00000100)
+#define XT_DNP3_FLAG_LEARN              (0x00000200)
+#define XT_DNP3_FLAG_MASK               (0x000003ff)
+
+#define XT_DNP3_OBJECT_VARIATION        (0x01)
+#define XT_DNP3_OBJECT_QUALIFIER        (0x02)
+#define XT_DNP3_OBJECT_INDEX            (0x04)
+#define XT_DNP3_OBJECT_COUNT            (0x08)
+#define XT_DNP3_OBJECT_MASK             (0x0f)
+
+enum {
+    XT_DNP3_CRC_FULL = 0,
+    XT_DNP3_CRC_HEADER,
+    XT_DNP3_CRC_NONE,
+    XT_DNP3_CRC_SAMPLE,
+    XT_DNP3_CRC_MAX
+};
+
+#define XT_DNP3_CRC_SAMPLE_MAX          (15)
+
+enum {
+    XT_DNP3_RATE_DADDR = 0,
+    XT_DNP3_RATE_SADDR,
+    XT_DNP3_RATE_PAIR,
+    XT_DNP3_RATE_MAX
+};
+
+#define XT_DNP3_RATE_BURST              (5)
+#define XT_DNP3_RATE_BURST_MAX          (10000)
 
 
 #endif
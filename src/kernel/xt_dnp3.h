@@ -3,6 +3,20 @@
 
 
 #include <linux/types.h>
+#ifdef __KERNEL__
+#include <linux/atomic.h>
+#include <linux/jump_label.h>
+#include <linux/list.h>
+#include <linux/mempool.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/skbuff.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/netfilter/nf_conntrack_common.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
+#endif
 
 
 struct pkt_dnp3_header {
@@ -15,25 +29,67 @@ struct pkt_dnp3_header {
     __u16 checksum;                     /* Checksum */
 };
 
+/*
+    The XT_DNP3_OBJECTS definition specifies the maximum number of object header 
+    constraints of a rule, specified with the --object option, against which the 
+    object headers of the application fragment of each frame are matched.
+*/
+
+#define XT_DNP3_OBJECTS                 (4)
+
+struct xt_dnp3_object {
+    __u8 group;                         /* Object group */
+    __u8 variation;                     /* Object variation */
+    __u8 qualifier;                     /* Qualifier code */
+    __u8 flags;                         /* Constrained fields */
+    __u32 index[2];                     /* Point index range */
+    __u32 count;                        /* Maximum number of objects */
+};
+
+/*
+    The XT_DNP3_POLICY_NAME definition specifies the maximum length, including 
+    the terminating NUL, of the name of a policy table referenced by the --policy 
+    option.
+*/
+
+#define XT_DNP3_POLICY_NAME             (16)
+
+struct xt_dnp3_program;
+
+struct xt_dnp3_rate;
+
+struct xt_dnp3_table;
+
 struct xt_dnp3_rule {
     __u16 daddr[2];                     /* Destination address */
     __u16 saddr[2];                     /* Source address */
     __u8 fc[32];                        /* Function code */
     __u32 set;                          /* Set flags */
     __u32 invert;                       /* Invert flags */
-};
+    __u8 crc;                           /* CRC validation */
+    __u8 sample;                        /* CRC sample interval (log2) */
+    __u8 objects;                       /* Object header constraints */
+    struct xt_dnp3_object object[XT_DNP3_OBJECTS];
+    char policy[XT_DNP3_POLICY_NAME];   /* Policy table */
+    __u32 interval;                     /* Rate limit interval (us) */
+    __u32 burst;                        /* Rate limit burst */
+    __u8 per;                           /* Rate limit key */
+    __u8 event;                         /* Event tag */
+    __u32 ctmark;                       /* Connection mark */
+    __u32 ctmask;                       /* Connection mark mask */
 
-struct xt_dnp3_session {
-    __u32 src;                          /* Source IP */
-    __u32 dest;                         /* Destination IP */
-    __u8 saddr;                         /* Source address */
-    __u8 daddr;                         /* Destination address */
-    __u16 seq;                          /* Transport sequence */
-    __u8 active;
+    /* Used internally by the kernel */
+    struct xt_dnp3_program *program __attribute__((aligned(8)));
+    struct xt_dnp3_table *table;
+    struct xt_dnp3_rate *rate;
+    __u8 matcher;                       /* Specialised matcher */
 };
 
 
 #define DNP3_LINK_HDR_LENGTH            (10)
+#define DNP3_LINK_BLOCK_LENGTH          (16)
+#define DNP3_LINK_CRC_LENGTH            (2)
+#define DNP3_LINK_FRAME_MAX             (292)
 
 #define DNP3_TSPT_HDR_LENGTH            (1)
 #define DNP3_TSPT_HDR_FIRST_MASK        (0x40)
@@ -42,20 +98,715 @@ struct xt_dnp3_session {
 
 #define DNP3_APPL_CTRL_OFFSET           (0)
 #define DNP3_APPL_FC_OFFSET             (1)
+#define DNP3_APPL_FC_RESPONSE           (0x81)
+#define DNP3_APPL_IIN_LENGTH            (2)
+#define DNP3_APPL_OBJHDR_LENGTH         (3)
+
+#define DNP3_FRAME_SUMMARY              (DNP3_LINK_HDR_LENGTH + DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET + 1)
+
+#define DNP3_PORT                       (20000)
+
+
+/*
+    The XT_DNP3_SESSIONS definition specifies the default number of multi-frame 
+    messages to track concurrently within each network namespace. This value may 
+    be overridden at module load time with the sessions module parameter, which 
+    also determines the number of hash buckets in the session table of each 
+    namespace, and for each namespace with the net.netfilter.dnp3_sessions sysctl.
+
+    XT_DNP3_SESSION_TIMEOUT specifies the default time in milliseconds after the 
+    most recent frame of a message for which its session is held, such that the 
+    sessions of messages abandoned mid-message are reclaimed, and may be changed 
+    with the session_timeout module parameter and the 
+    net.netfilter.dnp3_session_timeout sysctl. XT_DNP3_SESSION_SCAN specifies the 
+    number of hash buckets examined for a session to evict where the session 
+    table is full.
+*/
+
+#define XT_DNP3_SESSIONS                (4096)
+#define XT_DNP3_SESSION_TIMEOUT         (10000)
+#define XT_DNP3_SESSION_SCAN            (64)
+
+
+/*
+    The XT_DNP3_LINKS definition specifies the number of multi-frame messages, 
+    each between a distinct pair of DNP3 link layer addresses, tracked within the 
+    connection tracking entry of each direction of a connection to which the dnp3 
+    connection tracking helper is assigned. Further concurrent messages on such a 
+    connection, and messages on other connections, are tracked within the global 
+    session table.
+*/
+
+#define XT_DNP3_LINKS                   (4)
+
+
+/*
+    The XT_DNP3_DIGESTS definition specifies the number of the most recent frames 
+    of a multi-frame message for which a digest is held by its session, such that 
+    a retransmission of any of these frames is recognised as a duplicate rather 
+    than as a frame out of transport sequence. This value must be a power of two 
+    no greater than the transport sequence space of 64.
+*/
+
+#define XT_DNP3_DIGESTS                 (8)
+
+
+/*
+    The XT_DNP3_SAMPLES definition specifies the number of frame counts, indexed 
+    by a hash of source and destination IP address, by which frames are selected 
+    for sampled CRC validation. This value must be a power of two.
+*/
+
+#define XT_DNP3_SAMPLES                 (1024)
+
+
+/*
+    The XT_DNP3_STREAMS definition specifies the default maximum number of partial 
+    DNP3 frames, split across TCP segments, held for reassembly at any one time in 
+    each network namespace, and XT_DNP3_STREAM_TIMEOUT the default time in 
+    milliseconds for which these are held. These values may be overridden with the 
+    streams and stream_timeout module parameters. XT_DNP3_STREAM_RESERVE specifies 
+    the number of frame buffers preallocated for reassembly in each namespace.
+*/
+
+#define XT_DNP3_STREAMS                 (1024)
+#define XT_DNP3_STREAM_TIMEOUT          (2000)
+#define XT_DNP3_STREAM_RESERVE          (64)
 
 
 /*
-    The XT_DNP3_SESSION definition specifies the number of multi-frame messages
-    to track concurrently within the xt_dnp3 kernel module.
+    The XT_DNP3_OBJHDRS definition specifies the number of object headers decoded 
+    from the frames of a packet for matching against the object header constraints 
+    of rules. Frames beyond this bound are summarised without object headers and 
+    as such, do not match any rule with object header constraints.
 */
 
-#define XT_DNP3_SESSIONS                (16)
+#define XT_DNP3_OBJHDRS                 (64)
+
+
+/*
+    The XT_DNP3_APDU_MAX definition specifies the maximum length of an application 
+    fragment reassembled from the frames of a multi-frame message, and 
+    XT_DNP3_APDU_TIMEOUT the default time in milliseconds within which the final 
+    frame of such a message must be received for the fragment to be inspected. The 
+    number of fragments reassembled concurrently, which is zero and as such, 
+    disables reassembly by default, is specified with the apdus module parameter 
+    and the timeout with the apdu_timeout module parameter.
+*/
+
+#define XT_DNP3_APDU_MAX                (4096)
+#define XT_DNP3_APDU_TIMEOUT            (5000)
+
+
+/*
+    The XT_DNP3_FRAMES definition specifies the number of frame summaries held in 
+    each per-CPU parse cache entry before additional storage is allocated, with 
+    consecutive frames sharing the same addresses and function code summarised 
+    by a single entry.
+*/
+
+#define XT_DNP3_FRAMES                  (16)
+
+#define XT_DNP3_FRAME_FC                (0x01)
+#define XT_DNP3_FRAME_PARTIAL           (0x02)
+#define XT_DNP3_FRAME_NODATA            (0x04)
+#define XT_DNP3_FRAME_NOSESSION         (0x08)
+#define XT_DNP3_FRAME_TSPT              (0x10)
+#define XT_DNP3_FRAME_OBJECTS           (0x20)
+#define XT_DNP3_FRAME_FIRST             (DNP3_TSPT_HDR_FIRST_MASK)
+#define XT_DNP3_FRAME_FINAL             (DNP3_TSPT_HDR_FINAL_MASK)
+#define XT_DNP3_FRAME_DEFERRED          (0x0100)
+
+#define XT_DNP3_FRAME_HEADER_CRC        (0x01)
+#define XT_DNP3_FRAME_HEADER_BAD        (0x02)
+#define XT_DNP3_FRAME_BLOCK_CRC         (0x04)
+#define XT_DNP3_FRAME_BLOCK_BAD         (0x08)
+#define XT_DNP3_FRAME_RANK_SHIFT        (4)
 
 #define XT_DNP3_FLAG_CHECKSUM           (0x00000001)
 #define XT_DNP3_FLAG_DADDR              (0x00000002)
 #define XT_DNP3_FLAG_SADDR              (0x00000004)
 #define XT_DNP3_FLAG_FC                 (0x00000008)
-#define XT_DNP3_FLAG_MASK               (0x0000000f)
+#define XT_DNP3_FLAG_OBJECT             (0x00000010)
+#define XT_DNP3_FLAG_POLICY             (0x00000020)
+#define XT_DNP3_FLAG_RATE               (0x00000040)
+#define XT_DNP3_FLAG_EVENT              (0x00000080)
+#define XT_DNP3_FLAG_CTMARK             (0x00000100)
+#define XT_DNP3_FLAG_LEARN              (0x00000200)
+#define XT_DNP3_FLAG_MASK               (0x000003ff)
+
+#define XT_DNP3_OBJECT_VARIATION        (0x01)
+#define XT_DNP3_OBJECT_QUALIFIER        (0x02)
+#define XT_DNP3_OBJECT_INDEX            (0x04)
+#define XT_DNP3_OBJECT_COUNT            (0x08)
+#define XT_DNP3_OBJECT_MASK             (0x0f)
+
+
+/*
+    The depth of CRC validation is selected for each rule with the --crc option, 
+    which sets XT_DNP3_FLAG_CHECKSUM, with all CRCs of every frame validated where 
+    this option is not specified. With the sample mode, the CRCs of the data blocks 
+    are validated for one in every 2^sample frames between each pair of IP 
+    addresses and the link header CRC of every frame. The link layer addresses and 
+    function code of every frame are matched irrespective of this mode.
+*/
+
+enum {
+    XT_DNP3_CRC_FULL = 0,
+    XT_DNP3_CRC_HEADER,
+    XT_DNP3_CRC_NONE,
+    XT_DNP3_CRC_SAMPLE,
+    XT_DNP3_CRC_MAX
+};
+
+#define XT_DNP3_CRC_SAMPLE_MAX          (15)
+
+
+/*
+    Rate limits are applied with the --fc-rate option to the messages carried by 
+    frames which match the other criteria of a rule, with a token bucket for each 
+    function code and destination address, source address or pair of addresses, 
+    as selected by the --per option. A message is admitted where it arrives no 
+    earlier than the interval of the rule after the previous message admitted, 
+    less the tolerance afforded by the burst of the rule, such that each bucket 
+    is held as a single theoretical arrival time updated without locks. Keys are 
+    hashed into a table of XT_DNP3_RATE_BUCKETS buckets for each rule, with keys 
+    which collide sharing a bucket - a collision may therefore limit, but never 
+    exempt, the messages of a key. Tokens are taken for each evaluation of a rule, 
+    and none where any message of the packet is not admitted.
+*/
+
+enum {
+    XT_DNP3_RATE_DADDR = 0,
+    XT_DNP3_RATE_SADDR,
+    XT_DNP3_RATE_PAIR,
+    XT_DNP3_RATE_MAX
+};
+
+#define XT_DNP3_RATE_BUCKETS            (1024)
+#define XT_DNP3_RATE_BURST              (5)
+#define XT_DNP3_RATE_BURST_MAX          (10000)
+
+
+/*
+    The following counters record the outcome of the parsing of DNP3 frames and 
+    the tracking of multi-frame message sessions, in order that the reason for 
+    which a packet is not matched, or is dropped, can be determined. The evicted 
+    counter records sessions released before the final frame of a message, and the 
+    abandoned counter the reassembly of application fragments which could not be 
+    commenced or completed.
+*/
+
+enum {
+    XT_DNP3_STAT_PACKETS = 0,           /* Packets parsed */
+    XT_DNP3_STAT_TRUSTED,               /* Packets of trusted flows */
+    XT_DNP3_STAT_FRAMES,                /* Complete frames parsed */
+    XT_DNP3_STAT_SYNC,                  /* Invalid start or length field */
+    XT_DNP3_STAT_HEADER_CRC,            /* Link header CRC failure */
+    XT_DNP3_STAT_BLOCK_CRC,             /* Data block CRC failure */
+    XT_DNP3_STAT_TRUNCATED,             /* Frame truncated by end of packet */
+    XT_DNP3_STAT_HELD,                  /* Partial frame held for reassembly */
+    XT_DNP3_STAT_SEQUENCE,              /* Transport sequence mismatch */
+    XT_DNP3_STAT_DUPLICATE,             /* Retransmitted frame of message */
+    XT_DNP3_STAT_NOSESSION,             /* Frame without message session */
+    XT_DNP3_STAT_EXHAUSTED,             /* Session table full */
+    XT_DNP3_STAT_NOMEM,                 /* Memory allocation failure */
+    XT_DNP3_STAT_OPENED,                /* Sessions opened */
+    XT_DNP3_STAT_CLOSED,                /* Sessions closed by final frame */
+    XT_DNP3_STAT_EVICTED,               /* Sessions evicted */
+    XT_DNP3_STAT_EXPIRED,               /* Sessions expired */
+    XT_DNP3_STAT_ASSEMBLED,             /* Application fragments reassembled */
+    XT_DNP3_STAT_ABANDONED,             /* Reassemblies abandoned */
+    XT_DNP3_STAT_LEARNED,               /* Tuples added to learning table */
+    XT_DNP3_STAT_UNLEARNED,             /* Tuples not added as table full */
+    XT_DNP3_STAT_MAX
+};
+
+
+/*
+    Rules with the --event option write a record of each frame of a matched packet, 
+    or of a packet dropped for a frame without a message session, to a per-CPU ring 
+    of fixed-size records. The rings are allocated for each network namespace, with 
+    the number of records of each ring specified by the events module parameter, 
+    which is zero and as such, disables event export by default. The rings are 
+    mapped into userspace from /proc/net/xt_dnp3_events of the namespace, with the 
+    ring of each CPU commencing with a page holding the ring header, followed by 
+    the records of the ring, and with the rings of successive CPUs stride bytes 
+    apart.
+
+    Each ring has a single producer, the CPU which owns it, and a single consumer. 
+    The producer writes records at head and the consumer reads records from tail, 
+    with each publishing its index with release semantics. Records which would 
+    overwrite unread records are counted as lost.
+*/
+
+enum {
+    XT_DNP3_EVENT_MATCH = 0,            /* Packet matched rule */
+    XT_DNP3_EVENT_HOTDROP,              /* Packet dropped by rule */
+    XT_DNP3_EVENT_MAX
+};
+
+struct xt_dnp3_event {
+    __u64 time;                         /* Time (ns since the epoch) */
+    __be32 src;                         /* Source IP */
+    __be32 dest;                        /* Destination IP */
+    __be16 sport;                       /* Source port */
+    __be16 dport;                       /* Destination port */
+    __u16 saddr;                        /* Source address */
+    __u16 daddr;                        /* Destination address */
+    __u16 count;                        /* Consecutive frames */
+    __u8 control;                       /* Link control */
+    __u8 tspt;                          /* Transport header */
+    __u8 func;                          /* Function code */
+    __u8 flags;                         /* Frame flags */
+    __u8 reason;                        /* Event reason */
+    __u8 tag;                           /* Rule event tag */
+};
+
+struct xt_dnp3_ring {
+    __u64 head;                         /* Records written */
+    __u64 lost;                         /* Records lost */
+    __u32 size;                         /* Records (power of two) */
+    __u32 rings;                        /* Rings */
+    __u32 stride;                       /* Bytes between rings */
+    __u32 offset;                       /* Offset of records */
+    __u64 tail __attribute__((aligned(64)));
+};
+
+
+/*
+    The nf_tables dnp3 expression loads a field of the DNP3 frames of a packet 
+    into a register, specified by the NFTA_DNP3_KEY and NFTA_DNP3_DREG 
+    attributes. The link layer addresses are loaded as 16-bit values and the 
+    function code and the first and final bits of the transport header (0x40 and 
+    0x80) as 8-bit values, in host byte order. As no nft or libnftnl support for 
+    this expression exists, it is only built into the module with NFT=y.
+*/
+
+enum nft_dnp3_keys {
+    NFT_DNP3_DADDR = 0,
+    NFT_DNP3_SADDR,
+    NFT_DNP3_FC,
+    NFT_DNP3_TSPT,
+    __NFT_DNP3_MAX
+};
+
+enum nft_dnp3_attributes {
+    NFTA_DNP3_UNSPEC,
+    NFTA_DNP3_DREG,
+    NFTA_DNP3_KEY,
+    __NFTA_DNP3_MAX
+};
+
+#define NFTA_DNP3_MAX                   (__NFTA_DNP3_MAX - 1)
+
+
+/*
+    Policy tables map the source and destination link layer addresses of a frame 
+    to the function codes permitted between these addresses, and are loaded and 
+    replaced as a whole through the xt_dnp3 generic netlink family. Each table 
+    is held as an open-addressed hash table of at least twice the number of 
+    entries, with an entry for any source or any destination address consulted 
+    where no entry for the pair of addresses exists. Each entry of a policy is 
+    carried by a separate XT_DNP3_ATTR_ENTRY attribute, as the length of a nested 
+    attribute would otherwise limit the size of a table, and the 
+    XT_DNP3_POLICY_ENTRIES definition specifies the maximum number of entries.
+*/
+
+#define XT_DNP3_GENL_NAME               "xt_dnp3"
+#define XT_DNP3_GENL_VERSION            (1)
+
+#define XT_DNP3_POLICY_ENTRIES          (65536)
+
+#define XT_DNP3_POLICY_USED             (0x01)
+#define XT_DNP3_POLICY_ANY_SADDR        (0x02)
+#define XT_DNP3_POLICY_ANY_DADDR        (0x04)
+
+enum xt_dnp3_commands {
+    XT_DNP3_CMD_UNSPEC,
+    XT_DNP3_CMD_POLICY_SET,
+    XT_DNP3_CMD_POLICY_DEL,
+    __XT_DNP3_CMD_MAX
+};
+
+enum xt_dnp3_attributes {
+    XT_DNP3_ATTR_UNSPEC,
+    XT_DNP3_ATTR_NAME,
+    XT_DNP3_ATTR_ENTRY,
+    __XT_DNP3_ATTR_MAX
+};
+
+#define XT_DNP3_ATTR_MAX                (__XT_DNP3_ATTR_MAX - 1)
+
+enum xt_dnp3_entry_attributes {
+    XT_DNP3_ENTRY_UNSPEC,
+    XT_DNP3_ENTRY_SADDR,
+    XT_DNP3_ENTRY_DADDR,
+    XT_DNP3_ENTRY_FC,
+    __XT_DNP3_ENTRY_MAX
+};
+
+#define XT_DNP3_ENTRY_MAX               (__XT_DNP3_ENTRY_MAX - 1)
+
+struct xt_dnp3_entry {
+    __u16 saddr;                        /* Source address */
+    __u16 daddr;                        /* Destination address */
+    __u8 flags;                         /* Entry flags */
+    __u8 fc[32];                        /* Permitted function codes */
+};
+
+struct xt_dnp3_policy {
+    __u32 bits;                         /* Hash table size (log2) */
+    __u32 count;                        /* Entries */
+    struct xt_dnp3_entry entry[];
+};
+
+
+struct xt_dnp3_frame {
+    __u16 daddr;                        /* Destination address */
+    __u16 saddr;                        /* Source address */
+    __u16 flags;                        /* Frame flags */
+    __u16 count;                        /* Consecutive frames */
+    __u8 func;                          /* Function code */
+    __u8 crc;                           /* CRC validation outcome */
+    __u8 object;                        /* First object header */
+    __u8 objects;                       /* Object headers */
+    __u8 control;                       /* Link control */
+    __u8 tspt;                          /* Transport header */
+};
+
+struct xt_dnp3_fragment {
+    __u32 len;                          /* Fragment length */
+    __u8 data[XT_DNP3_APDU_MAX];        /* Application fragment */
+};
+
+struct xt_dnp3_objhdr {
+    __u8 group;                         /* Object group */
+    __u8 variation;                     /* Object variation */
+    __u8 qualifier;                     /* Qualifier code */
+    __u32 count;                        /* Number of objects */
+    __u32 min;                          /* Lowest point index */
+    __u32 max;                          /* Highest point index */
+};
+
+
+/*
+    The object header constraints of a rule are compiled when the rule is loaded 
+    into a table indexed by object group, which yields the set of constraints which 
+    may admit an object header of that group, together with the variations and 
+    qualifier codes admitted by each constraint as bitmaps. The point index range 
+    and object count of each constraint are unbounded where not specified, such 
+    that each object header is matched with a fixed sequence of comparisons.
+*/
+
+struct xt_dnp3_clause {
+    __u8 variation[32];                 /* Admitted variations */
+    __u8 qualifier[32];                 /* Admitted qualifier codes */
+    __u32 min;                          /* Lowest point index */
+    __u32 max;                          /* Highest point index */
+    __u32 count;                        /* Maximum number of objects */
+};
+
+struct xt_dnp3_program {
+    __u8 group[256];                    /* Constraints by object group */
+    struct xt_dnp3_clause clause[XT_DNP3_OBJECTS];
+};
+
+struct xt_dnp3_crc_stats {
+    __u64 frames;                       /* Frames evaluated */
+    __u64 headers;                      /* Link header CRCs validated */
+    __u64 blocks;                       /* Data block CRCs validated */
+    __u64 skipped;                      /* Frames not fully validated */
+    __u64 failed;                       /* Frames failing validation */
+};
+
+struct xt_dnp3_packet {
+    const struct sk_buff *skb;          /* Socket buffer */
+    unsigned int recseq;                /* x_tables traversal sequence */
+    unsigned int len;                   /* Socket buffer length */
+    __u32 seq;                          /* Transport sequence or checksum */
+    __u8 valid;                         /* All frames valid */
+    __u8 hotdrop;                       /* Drop packet */
+    __u8 depth;                         /* CRC validation depth */
+    __u8 sample;                        /* CRC sample interval (log2) */
+    __u8 inspect;                       /* Decode object headers */
+    __u8 sessions;                      /* Track multi-frame messages */
+    const __u8 *safe;                   /* Function codes not validated */
+    void *session;                      /* Connection session state */
+    __u32 count;                        /* Frame summaries */
+    __u32 size;                         /* Frame summary capacity */
+    struct xt_dnp3_frame *frame;        /* Frame summaries */
+    struct xt_dnp3_frame frames[XT_DNP3_FRAMES];
+    __u32 objects;                      /* Object headers */
+    struct xt_dnp3_objhdr objhdr[XT_DNP3_OBJHDRS];
+};
+
+
+#ifdef __KERNEL__
+
+struct xt_dnp3_apdu {
+    struct list_head list;              /* Free or reassembling fragments */
+    spinlock_t lock;                    /* Ownership lock */
+    const void *owner;                  /* Owning session */
+    unsigned long expires;              /* Reassembly expiry */
+    struct xt_dnp3_fragment fragment;   /* Application fragment */
+};
+
+/*
+    The tuples of the frames observed by rules with the --learn option are held in 
+    an open-addressed hash table for each CPU, with entries added but never removed 
+    from within the packet path. An entry is published by the release of its used 
+    field once written, such that it may be read from other CPUs as the tables 
+    are merged.
+*/
+
+struct xt_dnp3_learn {
+    __be32 src;                         /* Source IP */
+    __be32 dest;                        /* Destination IP */
+    __u16 saddr;                        /* Source address */
+    __u16 daddr;                        /* Destination address */
+    __u8 protocol;                      /* IP protocol */
+    __u8 func;                          /* Function code */
+    __u8 used;                          /* Entry held */
+};
+
+struct xt_dnp3_session {
+    struct hlist_node node;             /* Hash bucket linkage */
+    struct rcu_head rcu;                /* Deferred release */
+    spinlock_t lock;                    /* Transport sequence lock */
+    struct xt_dnp3_apdu *apdu;          /* Fragment under reassembly */
+    unsigned long expires;              /* Session expiry (jiffies) */
+    __u32 src;                          /* Source IP */
+    __u32 dest;                         /* Destination IP */
+    __u16 saddr;                        /* Source address */
+    __u16 daddr;                        /* Destination address */
+    __u16 seq;                          /* Transport sequence */
+    __u8 func;                          /* Function code of first frame */
+    __u8 active;                        /* Session held */
+    __u8 frames;                        /* Frames with digests held */
+    __u8 referenced;                    /* Frame since eviction scan */
+    __u32 digest[XT_DNP3_DIGESTS];      /* Digests of recent frames */
+};
+
+struct xt_dnp3_bucket {
+    struct hlist_head head;             /* Sessions */
+    spinlock_t lock;                    /* Insertion and removal lock */
+};
+
+struct xt_dnp3_link {
+    struct xt_dnp3_apdu *apdu;          /* Fragment under reassembly */
+    unsigned long expires;              /* Session expiry (jiffies) */
+    __u16 saddr;                        /* Source address */
+    __u16 daddr;                        /* Destination address */
+    __u8 seq;                           /* Transport sequence */
+    __u8 func;                          /* Function code of first frame */
+    __u8 active;                        /* Session held */
+    __u8 frames;                        /* Frames with digests held */
+    __u32 digest[XT_DNP3_DIGESTS];      /* Digests of recent frames */
+};
+
+struct xt_dnp3_stream {
+    spinlock_t lock;                    /* Stream and link session lock */
+    struct list_head list;              /* Held partial frames */
+    __u8 *buffer;                       /* Partial frame */
+    unsigned long expires;              /* Partial frame expiry */
+    __u32 seq;                          /* TCP sequence of partial frame */
+    __u16 len;                          /* Partial frame length */
+    __u16 consumed;                     /* Bytes consumed from continuation */
+    __u32 next;                         /* TCP sequence of continuation */
+    struct xt_dnp3_frame frame;         /* Summary of continued frame */
+    struct xt_dnp3_link link[XT_DNP3_LINKS];
+};
+
+struct xt_dnp3_flow {
+    struct list_head list;              /* Flows */
+    possible_net_t net;                 /* Network namespace */
+    struct xt_dnp3_stream stream[IP_CT_DIR_MAX];
+};
+
+struct xt_dnp3_rate {
+    __u64 interval;                     /* Interval between messages (ns) */
+    __u64 tolerance;                    /* Burst tolerance (ns) */
+    atomic64_t tat[XT_DNP3_RATE_BUCKETS];
+};
+
+struct xt_dnp3_table {
+    struct list_head list;              /* Policy tables */
+    possible_net_t net;                 /* Network namespace */
+    struct xt_dnp3_policy __rcu *policy;
+    unsigned int refs;                  /* Referencing rules */
+    char name[XT_DNP3_POLICY_NAME];     /* Table name */
+};
+
+struct xt_dnp3_stats {
+    __u64 count[XT_DNP3_STAT_MAX];
+    struct xt_dnp3_crc_stats crc[XT_DNP3_CRC_MAX];
+};
+
+/*
+    The session table, reassembly buffers, counters and tunables of the module are 
+    held for each network namespace, such that the DNP3 gateways of different 
+    namespaces neither share nor contend for session or reassembly capacity. The state of the namespace 
+    of the packet under evaluation is held per-CPU in dnp3_net_current, set with 
+    bottom halves disabled by dnp3_net_enter() upon entry to the packet path, 
+    and used by the session functions and counters of the frame parsing source 
+    shared with the userspace tools, which hold this state per-thread.
+*/
+
+struct xt_dnp3_net {
+    struct xt_dnp3_stats __percpu *stats;
+    struct xt_dnp3_bucket *bucket;      /* Session table */
+    unsigned int buckets;               /* Session table buckets */
+    atomic_t count;                     /* Sessions held in table */
+    atomic_t hand;                      /* Eviction clock hand */
+    atomic_t links;                     /* Sessions held by connections */
+    unsigned int sessions;              /* Maximum sessions in table */
+    unsigned int session_timeout;       /* Session timeout (ms) */
+    unsigned int ct_trust;              /* Trusted connection mark bits */
+    struct ctl_table_header *sysctl;    /* Tunables */
+    struct xt_dnp3_learn *learn;        /* Learning tables */
+    void *ring;                         /* Event rings */
+    struct xt_dnp3_apdu *apdu;          /* Fragment buffers */
+    struct list_head apdu_free;         /* Free fragment buffers */
+    struct list_head apdu_used;         /* Fragment buffers in use */
+    spinlock_t apdu_lock;               /* Fragment buffer list lock */
+    mempool_t *frame_pool;              /* Partial frame buffers */
+    atomic_t frames;                    /* Partial frames held */
+    unsigned int streams;               /* Maximum partial frames held */
+    struct list_head held;              /* Held partial frames */
+    spinlock_t held_lock;               /* Held partial frame lock */
+    struct delayed_work gc;             /* Partial frame expiry */
+    __u32 sample[XT_DNP3_SAMPLES];      /* Sampled validation counts */
+};
+
+
+extern unsigned int dnp3_net_id;
+
+DECLARE_PER_CPU(struct xt_dnp3_net *, dnp3_net_current);
+
+DECLARE_STATIC_KEY_FALSE(dnp3_histogram);
+
+
+int dnp3_apdu_add(struct xt_dnp3_apdu **slot, const void *owner, const u8 *payload, bool final, struct xt_dnp3_fragment **fragment);
+
+struct xt_dnp3_apdu * dnp3_apdu_get(const void *owner, const u8 *payload);
+
+void dnp3_apdu_net_exit(struct xt_dnp3_net *dnet);
+
+int dnp3_apdu_net_init(struct xt_dnp3_net *dnet);
+
+void dnp3_apdu_put(struct xt_dnp3_apdu *apdu, const void *owner);
+
+void dnp3_flow_exit(void);
+
+void dnp3_flow_expire(struct xt_dnp3_stream *stream);
+
+int dnp3_flow_hold(struct xt_dnp3_stream *stream, u32 seq, const u8 *data, u32 len);
+
+int dnp3_flow_init(void);
+
+void dnp3_flow_net_exit(const struct net *net);
+
+int dnp3_flow_net_init(struct xt_dnp3_net *dnet);
+
+void dnp3_flow_release(struct xt_dnp3_stream *stream);
+
+struct xt_dnp3_stream * dnp3_flow_stream(const struct sk_buff *skb);
+
+void dnp3_event_init(void);
+
+void dnp3_event_net_exit(struct net *net);
+
+int dnp3_event_net_init(struct net *net);
+
+void dnp3_event_write(struct xt_dnp3_net *dnet, const struct sk_buff *skb, u32 thoff, const struct xt_dnp3_packet *packet, u8 tag, u8 reason);
+
+void dnp3_genl_exit(void);
+
+int dnp3_genl_init(void);
+
+void dnp3_genl_net_exit(const struct net *net);
+
+struct xt_dnp3_table * dnp3_genl_table_get(struct net *net, const char *name);
+
+void dnp3_genl_table_put(struct xt_dnp3_table *table);
+
+bool dnp3_learn_enabled(void);
+
+void dnp3_learn_init(void);
+
+void dnp3_learn_net_exit(struct net *net);
+
+int dnp3_learn_net_init(struct net *net);
+
+void dnp3_learn_record(struct xt_dnp3_net *dnet, const struct sk_buff *skb, const struct xt_dnp3_packet *packet);
+
+void dnp3_mt_parse_packet(const struct sk_buff *skb, u32 thoff, struct xt_dnp3_packet *packet);
+
+#if IS_ENABLED(CONFIG_KUNIT)
+struct xt_action_param;
+struct xt_mtchk_param;
+struct xt_mtdtor_param;
+
+int dnp3_mt_check_rule(const struct xt_mtchk_param *par);
+
+u32 dnp3_mt_depth(void);
+
+void dnp3_mt_destroy_rule(const struct xt_mtdtor_param *par);
+
+bool dnp3_mt_match_rule(const struct sk_buff *skb, struct xt_action_param *par);
+#endif
+
+static inline struct xt_dnp3_net *
+dnp3_net(const struct net *net) {
+    return net_generic(net, dnp3_net_id);
+}
+
+static inline struct xt_dnp3_net *
+dnp3_net_enter(const struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+
+    __this_cpu_write(dnp3_net_current, dnet);
+    return dnet;
+}
+
+void dnp3_net_exit(void);
+
+int dnp3_net_init(void);
+
+#if defined(XT_DNP3_NFT) && IS_ENABLED(CONFIG_NF_TABLES)
+void dnp3_nft_exit(void);
+
+int dnp3_nft_init(void);
+#else
+static inline void dnp3_nft_exit(void) {}
+
+static inline int dnp3_nft_init(void) { return 0; }
+#endif
+
+unsigned int dnp3_session_count(struct xt_dnp3_net *dnet);
+
+void dnp3_session_exit(void);
+
+void dnp3_session_release(struct xt_dnp3_stream *stream);
+
+int dnp3_session_init(void);
+
+void dnp3_session_net_exit(struct xt_dnp3_net *dnet);
+
+int dnp3_session_net_init(struct xt_dnp3_net *dnet);
+
+void dnp3_stats_exit(void);
+
+int dnp3_stats_init(void);
+
+void dnp3_stats_net_exit(struct net *net);
+
+int dnp3_stats_net_init(struct net *net);
+
+void dnp3_stats_latency(u64 ns, const struct xt_dnp3_packet *packet);
+
+#endif
 
 
 #endif
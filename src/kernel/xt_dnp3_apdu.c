@@ -0,0 +1,236 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_packet.h"
+
+
+static void dnp3_apdu_release(struct xt_dnp3_apdu *apdu);
+
+
+static unsigned int apdus __read_mostly = 0;
+module_param(apdus, uint, 0400);
+MODULE_PARM_DESC(apdus, "Maximum number of multi-frame application fragments reassembled concurrently in each network namespace (0 disables)");
+
+static unsigned int apdu_timeout __read_mostly = XT_DNP3_APDU_TIMEOUT;
+module_param(apdu_timeout, uint, 0600);
+MODULE_PARM_DESC(apdu_timeout, "Timeout for the reassembly of multi-frame application fragments (ms)");
+
+
+/*
+    The application fragments of multi-frame messages are reassembled, while rules
+    with object header constraints are loaded, into buffers drawn from a pool
+    allocated for each network namespace as the namespace is created, such that no
+    memory is allocated in the packet path, the memory consumed by reassembly is
+    bounded irrespective of the number of messages in progress, and the messages
+    of one namespace cannot exhaust the buffers of another. Each buffer is held by the session of a
+    message from its first frame, with the contents of the buffer accessed under
+    the lock of the buffer by the session which owns it.
+
+    Buffers in use are held in order of allocation, and therefore of expiry. Where
+    no buffer is free, the buffer of the oldest message which has exceeded the
+    reassembly timeout is taken from its session - which may have been abandoned
+    mid-message - in the same manner as partial frames are reclaimed by the
+    periodic work of the connection tracking helper. A session discovers that its
+    buffer has been taken by the owner recorded with the buffer.
+*/
+
+/*
+    This function adds the user data of a complete frame of a multi-frame message,
+    pointed to by payload, to the application fragment under reassembly held by a
+    session in slot. Where the fragment can no longer be completed - the frame is
+    not passed, the fragment exceeds XT_DNP3_APDU_MAX bytes, the reassembly timeout
+    has elapsed or the buffer has been taken by another session - the buffer is
+    released and zero returned. Otherwise, one is returned and where final is set,
+    the completed fragment is detached from the session and returned in fragment,
+    to be released with dnp3_apdu_free() once inspected.
+*/
+
+int
+dnp3_apdu_add(struct xt_dnp3_apdu **slot,
+        const void *owner,
+        const u8 *payload,
+        bool final,
+        struct xt_dnp3_fragment **fragment) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    struct xt_dnp3_apdu *apdu;
+
+    if (!(apdu = *slot)) {
+        return 0;
+    }
+    *slot = NULL;
+
+    spin_lock(&apdu->lock);
+    if (apdu->owner != owner) {
+        spin_unlock(&apdu->lock);
+        return 0;
+    }
+    if ((!payload) ||
+            (time_after(jiffies, apdu->expires)) ||
+            (dnp3_packet_append(&apdu->fragment, payload) != 0)) {
+        dnp3_apdu_release(apdu);
+        spin_unlock(&apdu->lock);
+        dnp3_stats_inc(XT_DNP3_STAT_ABANDONED);
+        return 0;
+    }
+
+    if (final) {
+        apdu->owner = NULL;
+        spin_lock(&dnet->apdu_lock);
+        list_del_init(&apdu->list);
+        spin_unlock(&dnet->apdu_lock);
+        *fragment = &apdu->fragment;
+    }
+    else {
+        *slot = apdu;
+    }
+    spin_unlock(&apdu->lock);
+    return 1;
+}
+
+
+void
+dnp3_apdu_free(struct xt_dnp3_fragment *fragment) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    struct xt_dnp3_apdu *apdu;
+
+    apdu = container_of(fragment, struct xt_dnp3_apdu, fragment);
+    spin_lock_bh(&dnet->apdu_lock);
+    list_add(&apdu->list, &dnet->apdu_free);
+    spin_unlock_bh(&dnet->apdu_lock);
+}
+
+
+/*
+    This function returns a buffer for the reassembly of the application fragment
+    of a multi-frame message by the session owner, commencing with the user data of
+    the first frame of the message pointed to by payload, or NULL where reassembly
+    is disabled, payload is NULL or no buffer of the current namespace is available.
+*/
+
+struct xt_dnp3_apdu *
+dnp3_apdu_get(const void *owner, const u8 *payload) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    struct xt_dnp3_apdu *apdu, *entry;
+
+    if ((!payload) ||
+            (!dnet->apdu)) {
+        return NULL;
+    }
+
+    apdu = NULL;
+    spin_lock_bh(&dnet->apdu_lock);
+    if (!list_empty(&dnet->apdu_free)) {
+        apdu = list_first_entry(&dnet->apdu_free, struct xt_dnp3_apdu, list);
+        list_del_init(&apdu->list);
+    }
+    else {
+        list_for_each_entry(entry, &dnet->apdu_used, list) {
+            if (!time_after(jiffies, entry->expires)) {
+                break;
+            }
+            if (!spin_trylock(&entry->lock)) {
+                continue;
+            }
+            entry->owner = NULL;
+            list_del_init(&entry->list);
+            spin_unlock(&entry->lock);
+            dnp3_stats_inc(XT_DNP3_STAT_ABANDONED);
+            apdu = entry;
+            break;
+        }
+    }
+    spin_unlock_bh(&dnet->apdu_lock);
+
+    if (!apdu) {
+        dnp3_stats_inc(XT_DNP3_STAT_ABANDONED);
+        return NULL;
+    }
+
+    spin_lock_bh(&apdu->lock);
+    apdu->fragment.len = 0;
+    if (dnp3_packet_append(&apdu->fragment, payload) != 0) {
+        spin_unlock_bh(&apdu->lock);
+        dnp3_apdu_free(&apdu->fragment);
+        dnp3_stats_inc(XT_DNP3_STAT_ABANDONED);
+        return NULL;
+    }
+    apdu->owner = owner;
+    apdu->expires = jiffies + msecs_to_jiffies(apdu_timeout);
+    spin_lock(&dnet->apdu_lock);
+    list_add_tail(&apdu->list, &dnet->apdu_used);
+    spin_unlock(&dnet->apdu_lock);
+    spin_unlock_bh(&apdu->lock);
+
+    return apdu;
+}
+
+
+/*
+    The buffers of a namespace are released once the sessions of the namespace, 
+    and with these the ownership of every buffer, have been released.
+*/
+
+void
+dnp3_apdu_net_exit(struct xt_dnp3_net *dnet) {
+    kvfree(dnet->apdu);
+}
+
+
+int
+dnp3_apdu_net_init(struct xt_dnp3_net *dnet) {
+    unsigned int index;
+
+    INIT_LIST_HEAD(&dnet->apdu_free);
+    INIT_LIST_HEAD(&dnet->apdu_used);
+    spin_lock_init(&dnet->apdu_lock);
+    dnet->apdu = NULL;
+    if (apdus == 0) {
+        return 0;
+    }
+    if (!(dnet->apdu = kvcalloc(apdus, sizeof(*dnet->apdu), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+    for (index = 0; index < apdus; ++index) {
+        spin_lock_init(&dnet->apdu[index].lock);
+        list_add_tail(&dnet->apdu[index].list, &dnet->apdu_free);
+    }
+    return 0;
+}
+
+
+/*
+    This function releases the buffer of the application fragment under reassembly
+    by the session owner, where the buffer has not since been taken by another
+    session - for example, where a message is restarted by the first frame of a
+    new message or its session is released.
+*/
+
+void
+dnp3_apdu_put(struct xt_dnp3_apdu *apdu, const void *owner) {
+    if (!apdu) {
+        return;
+    }
+    spin_lock_bh(&apdu->lock);
+    if (apdu->owner == owner) {
+        dnp3_apdu_release(apdu);
+        dnp3_stats_inc(XT_DNP3_STAT_ABANDONED);
+    }
+    spin_unlock_bh(&apdu->lock);
+}
+
+
+static void
+dnp3_apdu_release(struct xt_dnp3_apdu *apdu) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+
+    apdu->owner = NULL;
+    spin_lock(&dnet->apdu_lock);
+    list_move(&apdu->list, &dnet->apdu_free);
+    spin_unlock(&dnet->apdu_lock);
+}
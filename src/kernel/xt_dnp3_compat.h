@@ -0,0 +1,80 @@
+#ifndef _XT_DNP3_COMPAT_H
+#define _XT_DNP3_COMPAT_H
+
+
+/*
+    Portions of the xt_dnp3 kernel module - such as CRC calculation and DNP3 frame 
+    validation - are independent of the kernel environment and are also compiled 
+    into the userspace tools under src/tools. This header provides the minimal set 
+    of kernel type and helper definitions required by these portions of source when 
+    compiled outside of the kernel. Counters incremented with dnp3_stats_inc() are 
+    held per-CPU for each network namespace within the kernel and per-thread 
+    within the userspace tools, while the tracepoints of the kernel module are 
+    compiled out of the tools.
+*/
+
+#ifdef __KERNEL__
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <asm/byteorder.h>
+
+#include "xt_dnp3_trace.h"
+
+#define dnp3_stats_inc(stat)            this_cpu_inc(__this_cpu_read(dnp3_net_current)->stats->count[(stat)])
+
+#else
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <errno.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define __read_mostly
+#define __init
+
+#ifndef __always_inline
+#define __always_inline                 inline __attribute__((__always_inline__))
+#endif
+
+#define likely(x)                       __builtin_expect(!!(x), 1)
+#define unlikely(x)                     __builtin_expect(!!(x), 0)
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x)                   (sizeof(x) / sizeof((x)[0]))
+#endif
+
+#define DIV_ROUND_UP(n, d)              (((n) + (d) - 1) / (d))
+#define U16_MAX                         UINT16_MAX
+#define U32_MAX                         UINT32_MAX
+
+#define le16_to_cpu(x)                  le16toh(x)
+
+#define GFP_ATOMIC                      (0)
+#define kmalloc_array(n, size, flags)   calloc((n), (size))
+#define krealloc_array(ptr, n, size, flags) \
+                                        reallocarray((ptr), (n), (size))
+#define kfree(ptr)                      free(ptr)
+
+extern __thread unsigned long long dnp3_stats[];
+
+#define dnp3_stats_inc(stat)            (++dnp3_stats[(stat)])
+
+#define trace_dnp3_frame(...)           do { } while (0)
+#define trace_dnp3_frame_enabled()      (false)
+
+#endif
+
+
+#endif
@@ -0,0 +1,169 @@
+#include "xt_dnp3.h"
+#include "xt_dnp3_crc.h"
+
+
+static __always_inline int dnp3_crc_check_blocks(const u8 *buff, u32 len, u16 (*calculate)(const u8 *, u32));
+
+
+static const u16 _crc[256] = {
+        0x0000, 0x365e, 0x6cbc, 0x5ae2, 0xd978, 0xef26, 0xb5c4, 0x839a,
+        0xff89, 0xc9d7, 0x9335, 0xa56b, 0x26f1, 0x10af, 0x4a4d, 0x7c13,
+        0xb26b, 0x8435, 0xded7, 0xe889, 0x6b13, 0x5d4d, 0x07af, 0x31f1,
+        0x4de2, 0x7bbc, 0x215e, 0x1700, 0x949a, 0xa2c4, 0xf826, 0xce78,
+        0x29af, 0x1ff1, 0x4513, 0x734d, 0xf0d7, 0xc689, 0x9c6b, 0xaa35,
+        0xd626, 0xe078, 0xba9a, 0x8cc4, 0x0f5e, 0x3900, 0x63e2, 0x55bc,
+        0x9bc4, 0xad9a, 0xf778, 0xc126, 0x42bc, 0x74e2, 0x2e00, 0x185e,
+        0x644d, 0x5213, 0x08f1, 0x3eaf, 0xbd35, 0x8b6b, 0xd189, 0xe7d7,
+        0x535e, 0x6500, 0x3fe2, 0x09bc, 0x8a26, 0xbc78, 0xe69a, 0xd0c4,
+        0xacd7, 0x9a89, 0xc06b, 0xf635, 0x75af, 0x43f1, 0x1913, 0x2f4d,
+        0xe135, 0xd76b, 0x8d89, 0xbbd7, 0x384d, 0x0e13, 0x54f1, 0x62af,
+        0x1ebc, 0x28e2, 0x7200, 0x445e, 0xc7c4, 0xf19a, 0xab78, 0x9d26,
+        0x7af1, 0x4caf, 0x164d, 0x2013, 0xa389, 0x95d7, 0xcf35, 0xf96b,
+        0x8578, 0xb326, 0xe9c4, 0xdf9a, 0x5c00, 0x6a5e, 0x30bc, 0x06e2,
+        0xc89a, 0xfec4, 0xa426, 0x9278, 0x11e2, 0x27bc, 0x7d5e, 0x4b00,
+        0x3713, 0x014d, 0x5baf, 0x6df1, 0xee6b, 0xd835, 0x82d7, 0xb489,
+        0xa6bc, 0x90e2, 0xca00, 0xfc5e, 0x7fc4, 0x499a, 0x1378, 0x2526,
+        0x5935, 0x6f6b, 0x3589, 0x03d7, 0x804d, 0xb613, 0xecf1, 0xdaaf,
+        0x14d7, 0x2289, 0x786b, 0x4e35, 0xcdaf, 0xfbf1, 0xa113, 0x974d,
+        0xeb5e, 0xdd00, 0x87e2, 0xb1bc, 0x3226, 0x0478, 0x5e9a, 0x68c4,
+        0x8f13, 0xb94d, 0xe3af, 0xd5f1, 0x566b, 0x6035, 0x3ad7, 0x0c89,
+        0x709a, 0x46c4, 0x1c26, 0x2a78, 0xa9e2, 0x9fbc, 0xc55e, 0xf300,
+        0x3d78, 0x0b26, 0x51c4, 0x679a, 0xe400, 0xd25e, 0x88bc, 0xbee2,
+        0xc2f1, 0xf4af, 0xae4d, 0x9813, 0x1b89, 0x2dd7, 0x7735, 0x416b,
+        0xf5e2, 0xc3bc, 0x995e, 0xaf00, 0x2c9a, 0x1ac4, 0x4026, 0x7678,
+        0x0a6b, 0x3c35, 0x66d7, 0x5089, 0xd313, 0xe54d, 0xbfaf, 0x89f1,
+        0x4789, 0x71d7, 0x2b35, 0x1d6b, 0x9ef1, 0xa8af, 0xf24d, 0xc413,
+        0xb800, 0x8e5e, 0xd4bc, 0xe2e2, 0x6178, 0x5726, 0x0dc4, 0x3b9a,
+        0xdc4d, 0xea13, 0xb0f1, 0x86af, 0x0535, 0x336b, 0x6989, 0x5fd7,
+        0x23c4, 0x159a, 0x4f78, 0x7926, 0xfabc, 0xcce2, 0x9600, 0xa05e,
+        0x6e26, 0x5878, 0x029a, 0x34c4, 0xb75e, 0x8100, 0xdbe2, 0xedbc,
+        0x91af, 0xa7f1, 0xfd13, 0xcb4d, 0x48d7, 0x7e89, 0x246b, 0x1235
+};
+
+
+/*
+    The _slice table holds sixteen 256-entry tables where _slice[n][b] is the CRC 
+    register value that results from processing byte b followed by n zero bytes. As 
+    DNP3 computes an independent CRC for each block of at most sixteen data bytes, 
+    with the CRC register initialised to zero, the CRC of an entire block can be 
+    computed as the exclusive-or of one lookup per byte, with no dependency between 
+    lookups. This table is populated from _crc by dnp3_crc_init().
+*/
+
+static u16 _slice[DNP3_LINK_BLOCK_LENGTH][256] __read_mostly;
+
+
+static __always_inline int
+dnp3_crc_check_blocks(const u8 *buff, 
+        u32 len, 
+        u16 (*calculate)(const u8 *, u32)) {
+    u32 index, segment;
+    u16 crc;
+
+    for (index = DNP3_LINK_HDR_LENGTH; index < len; index += (DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH)) {
+        segment = len - index;
+        if (segment > (DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH)) {
+            segment = (DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH);
+        }
+        if (segment <= DNP3_LINK_CRC_LENGTH) {
+            return -EINVAL;
+        }
+        segment -= DNP3_LINK_CRC_LENGTH;
+
+        crc = calculate(&buff[index], segment);
+        if (crc != (buff[index + segment] | (buff[index + segment + 1] << 8))) {
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+
+/*
+    This function validates the CRC of each data block of the DNP3 frame of length 
+    len bytes pointed to by buff, in a single pass over the frame. Validation of the 
+    CRC of the DNP3 link layer header is performed separately.
+*/
+
+int
+dnp3_crc_check_frame(const u8 *buff, u32 len, int engine) {
+    switch (engine) {
+        case DNP3_CRC_TABLE:
+            return dnp3_crc_check_blocks(buff, len, dnp3_crc_table);
+        case DNP3_CRC_SLICE16:
+        default:
+            return dnp3_crc_check_blocks(buff, len, dnp3_crc_slice16);
+    }
+}
+
+
+void __init
+dnp3_crc_init(void) {
+    unsigned int index, slice;
+    u16 crc;
+
+    for (index = 0; index < 256; ++index) {
+        _slice[0][index] = _crc[index];
+    }
+    for (slice = 1; slice < DNP3_LINK_BLOCK_LENGTH; ++slice) {
+        for (index = 0; index < 256; ++index) {
+            crc = _slice[slice - 1][index];
+            _slice[slice][index] = (crc >> 8) ^ _crc[crc & 0x00ff];
+        }
+    }
+}
+
+
+u16
+dnp3_crc_slice16(const u8 *buff, u32 len) {
+    u32 index;
+    u16 crc, value;
+
+    crc = 0;
+    for (; len >= DNP3_LINK_BLOCK_LENGTH; len -= DNP3_LINK_BLOCK_LENGTH) {
+        crc = _slice[15][(buff[0] ^ crc) & 0x00ff] ^
+                _slice[14][(buff[1] ^ (crc >> 8)) & 0x00ff] ^
+                _slice[13][buff[2]] ^
+                _slice[12][buff[3]] ^
+                _slice[11][buff[4]] ^
+                _slice[10][buff[5]] ^
+                _slice[9][buff[6]] ^
+                _slice[8][buff[7]] ^
+                _slice[7][buff[8]] ^
+                _slice[6][buff[9]] ^
+                _slice[5][buff[10]] ^
+                _slice[4][buff[11]] ^
+                _slice[3][buff[12]] ^
+                _slice[2][buff[13]] ^
+                _slice[1][buff[14]] ^
+                _slice[0][buff[15]];
+        buff += DNP3_LINK_BLOCK_LENGTH;
+    }
+
+    if (len == 1) {
+        crc = (crc >> 8) ^ _slice[0][(buff[0] ^ crc) & 0x00ff];
+    }
+    else if (len > 1) {
+        value = _slice[len - 1][(buff[0] ^ crc) & 0x00ff] ^
+                _slice[len - 2][(buff[1] ^ (crc >> 8)) & 0x00ff];
+        for (index = 2; index < len; ++index) {
+            value ^= _slice[len - 1 - index][buff[index]];
+        }
+        crc = value;
+    }
+    else {};
+
+    return (~crc & 0xffff);
+}
+
+
+u16
+dnp3_crc_table(const u8 *buff, u32 len) {
+    u16 crc;
+
+    crc = 0;
+    while (len--) {
+        crc = (u16) ((crc >> 8) ^ (_crc[((crc ^ *buff++) & 0x00ff)]));
+    }
+    return (~crc & 0xffff);
+}
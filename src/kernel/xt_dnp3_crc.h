@@ -0,0 +1,31 @@
+#ifndef _XT_DNP3_CRC_H
+#define _XT_DNP3_CRC_H
+
+
+#include "xt_dnp3_compat.h"
+
+
+/*
+    The following CRC engines are available for the calculation of the DNP3 CRC-16 
+    (polynomial 0x3d65, reflected). The table engine is the byte-at-a-time lookup 
+    employed in earlier versions of this module and has a 512 byte table footprint, 
+    while the slice16 engine processes up to sixteen bytes per step with independent 
+    table lookups and has an 8 KiB table footprint.
+*/
+
+enum {
+    DNP3_CRC_TABLE = 0,
+    DNP3_CRC_SLICE16,
+};
+
+
+void dnp3_crc_init(void);
+
+u16 dnp3_crc_table(const u8 *buff, u32 len);
+
+u16 dnp3_crc_slice16(const u8 *buff, u32 len);
+
+int dnp3_crc_check_frame(const u8 *buff, u32 len, int engine);
+
+
+#endif
@@ -0,0 +1,170 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/proc_fs.h>
+#include <linux/smp.h>
+#include <linux/timekeeping.h>
+#include <linux/vmalloc.h>
+#include <net/ip.h>
+#include <net/net_namespace.h>
+
+#include "xt_dnp3.h"
+
+
+static int dnp3_event_mmap(struct file *file, struct vm_area_struct *vma);
+
+
+static unsigned int events __read_mostly = 0;
+module_param(events, uint, 0400);
+MODULE_PARM_DESC(events, "Number of event records in the ring of each CPU (0 disables)");
+
+
+/*
+    The rings of all CPUs are held in a single allocation for each network 
+    namespace, such that these may be mapped into userspace from 
+    /proc/net/xt_dnp3_events of the namespace with a single call to mmap(), and a 
+    consumer is presented with the events of its own namespace only. The size, 
+    mask and stride of the rings are held within the module and not read from the 
+    ring headers, which are writable by the consumer. A consumer may map the 
+    header page of the first ring alone to read the number and stride of the rings 
+    before mapping the rings of all CPUs.
+*/
+
+static u32 _size __read_mostly;
+
+static u32 _mask __read_mostly;
+
+static u32 _stride __read_mostly;
+
+static const struct proc_ops _event_ops = {
+    .proc_mmap = dnp3_event_mmap,
+};
+
+
+static int
+dnp3_event_mmap(struct file *file, struct vm_area_struct *vma) {
+    const struct xt_dnp3_net *dnet = pde_data(file_inode(file));
+
+    if ((vma->vm_pgoff != 0) ||
+            ((vma->vm_end - vma->vm_start) > ((unsigned long) _stride * nr_cpu_ids))) {
+        return -EINVAL;
+    }
+    return remap_vmalloc_range(vma, dnet->ring, 0);
+}
+
+
+void __init
+dnp3_event_init(void) {
+    if (events == 0) {
+        return;
+    }
+    _size = roundup_pow_of_two(min_t(u32, events, 1U << 20));
+    _mask = _size - 1;
+    _stride = PAGE_SIZE + PAGE_ALIGN(_size * sizeof(struct xt_dnp3_event));
+}
+
+
+void
+dnp3_event_net_exit(struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+
+    if (!dnet->ring) {
+        return;
+    }
+    remove_proc_entry("xt_dnp3_events", net->proc_net);
+    vfree(dnet->ring);
+}
+
+
+int
+dnp3_event_net_init(struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+    struct xt_dnp3_ring *ring;
+    unsigned int cpu;
+
+    dnet->ring = NULL;
+    if (events == 0) {
+        return 0;
+    }
+    if (!(dnet->ring = vmalloc_user((unsigned long) _stride * nr_cpu_ids))) {
+        return -ENOMEM;
+    }
+    for (cpu = 0; cpu < nr_cpu_ids; ++cpu) {
+        ring = dnet->ring + ((unsigned long) _stride * cpu);
+        ring->size = _size;
+        ring->rings = nr_cpu_ids;
+        ring->stride = _stride;
+        ring->offset = PAGE_SIZE;
+    }
+    if (!proc_create_data("xt_dnp3_events", 0600, net->proc_net, &_event_ops, dnet)) {
+        vfree(dnet->ring);
+        dnet->ring = NULL;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+
+/*
+    This function writes a record of each frame summary of a parsed packet to the
+    ring of the current CPU in the namespace passed, and must be called with 
+    bottom halves disabled. Where
+    consecutive frames are summarised together, a single record is written with
+    the number of frames, and the link control and transport header of the first
+    of these frames.
+*/
+
+void
+dnp3_event_write(struct xt_dnp3_net *dnet, 
+        const struct sk_buff *skb,
+        u32 thoff,
+        const struct xt_dnp3_packet *packet,
+        u8 tag,
+        u8 reason) {
+    const struct xt_dnp3_frame *frame;
+    const struct iphdr *iph;
+    struct xt_dnp3_event *event, *record;
+    struct xt_dnp3_ring *ring;
+    __be16 _ports[2];
+    const __be16 *ports;
+    u64 head, tail, time;
+    u32 index;
+
+    if ((!dnet->ring) ||
+            (packet->count == 0)) {
+        return;
+    }
+    ring = dnet->ring + ((unsigned long) _stride * smp_processor_id());
+    record = (struct xt_dnp3_event *) ((u8 *) ring + PAGE_SIZE);
+    iph = ip_hdr(skb);
+    ports = skb_header_pointer(skb, thoff, sizeof(_ports), _ports);
+    time = ktime_get_real_ns();
+
+    head = ring->head;
+    tail = smp_load_acquire(&ring->tail);
+    for (index = 0; index < packet->count; ++index) {
+        if ((head - tail) > _mask) {
+            ring->lost += packet->count - index;
+            break;
+        }
+        frame = &packet->frame[index];
+        event = &record[head & _mask];
+        event->time = time;
+        event->src = iph->saddr;
+        event->dest = iph->daddr;
+        event->sport = ports ? ports[0] : 0;
+        event->dport = ports ? ports[1] : 0;
+        event->saddr = frame->saddr;
+        event->daddr = frame->daddr;
+        event->count = frame->count;
+        event->control = frame->control;
+        event->tspt = frame->tspt;
+        event->func = frame->func;
+        event->flags = frame->flags & 0xff;
+        event->reason = reason;
+        event->tag = tag;
+        ++head;
+    }
+    smp_store_release(&ring->head, head);
+}
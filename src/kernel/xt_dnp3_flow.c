@@ -0,0 +1,375 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/jiffies.h>
+#include <linux/mempool.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+
+#include "xt_dnp3.h"
+
+
+static void dnp3_flow_destroy(struct nf_conn *ct);
+static void dnp3_flow_gc(struct work_struct *work);
+static int dnp3_flow_help(struct sk_buff *skb, unsigned int protoff, struct nf_conn *ct, enum ip_conntrack_info ctinfo);
+
+
+static unsigned int streams __read_mostly = XT_DNP3_STREAMS;
+module_param(streams, uint, 0400);
+MODULE_PARM_DESC(streams, "Initial maximum number of partial DNP3 frames held for reassembly in each network namespace");
+
+static unsigned int stream_timeout __read_mostly = XT_DNP3_STREAM_TIMEOUT;
+module_param(stream_timeout, uint, 0600);
+MODULE_PARM_DESC(stream_timeout, "Timeout for partial DNP3 frames held for reassembly (ms)");
+
+
+/*
+    TCP stream reassembly of DNP3 frames is performed for connections which have 
+    been assigned the dnp3 connection tracking helper - for example, with the CT 
+    target in the raw table. This helper performs no processing of packets itself, 
+    but provides per-connection storage for the reassembly state of the connection 
+    and of the multi-frame sessions carried upon it, which are released with the 
+    connection tracking entry.
+*/
+
+static const struct nf_conntrack_expect_policy _policy = {
+    .max_expected   = 0,
+    .timeout        = 0,
+};
+
+static struct nf_conntrack_helper _helper[1] __read_mostly;
+
+static struct kmem_cache *_flow_cache __read_mostly;
+
+static LIST_HEAD(_flows);
+
+static DEFINE_SPINLOCK(_flows_lock);
+
+
+static void
+dnp3_flow_destroy(struct nf_conn *ct) {
+    struct xt_dnp3_flow *flow;
+    unsigned int dir;
+
+    if (!(flow = *(struct xt_dnp3_flow **) nfct_help_data(ct))) {
+        return;
+    }
+    local_bh_disable();
+    dnp3_net_enter(nf_ct_net(ct));
+    for (dir = 0; dir < IP_CT_DIR_MAX; ++dir) {
+        spin_lock(&flow->stream[dir].lock);
+        dnp3_flow_release(&flow->stream[dir]);
+        dnp3_session_release(&flow->stream[dir]);
+        spin_unlock(&flow->stream[dir].lock);
+    }
+    local_bh_enable();
+
+    spin_lock_bh(&_flows_lock);
+    list_del(&flow->list);
+    spin_unlock_bh(&_flows_lock);
+
+    kmem_cache_free(_flow_cache, flow);
+}
+
+
+void
+dnp3_flow_exit(void) {
+    struct xt_dnp3_flow *flow, *next;
+    unsigned int dir;
+    LIST_HEAD(flows);
+
+    nf_conntrack_helpers_unregister(_helper, ARRAY_SIZE(_helper));
+    synchronize_rcu();
+
+    /*
+        Following the unregistration of the connection tracking helper, the destroy 
+        callback will no longer be called for connections to which this helper had 
+        been assigned and as such, all remaining reassembly state is released here, 
+        with the partial frames of each connection returned to the namespace of the 
+        connection. The sessions held with this state are not released, as the 
+        state of every network namespace, including its buffers of application 
+        fragments, is released in turn as the module is unloaded.
+    */
+
+    spin_lock_bh(&_flows_lock);
+    list_splice_init(&_flows, &flows);
+    spin_unlock_bh(&_flows_lock);
+
+    list_for_each_entry_safe(flow, next, &flows, list) {
+        local_bh_disable();
+        dnp3_net_enter(read_pnet(&flow->net));
+        for (dir = 0; dir < IP_CT_DIR_MAX; ++dir) {
+            dnp3_flow_release(&flow->stream[dir]);
+        }
+        local_bh_enable();
+        list_del(&flow->list);
+        kmem_cache_free(_flow_cache, flow);
+    }
+
+    kmem_cache_destroy(_flow_cache);
+}
+
+
+void
+dnp3_flow_expire(struct xt_dnp3_stream *stream) {
+    if ((stream->buffer) &&
+            (time_after(jiffies, stream->expires))) {
+        dnp3_flow_release(stream);
+    }
+}
+
+
+/*
+    Partial frames which are not completed within the reassembly timeout are 
+    reclaimed lazily upon receipt of the next segment of the connection and, for 
+    connections which fall silent, by this periodic work of each namespace. As 
+    partial frames are held in order of expiry, this work stops at the first 
+    unexpired frame.
+*/
+
+static void
+dnp3_flow_gc(struct work_struct *work) {
+    struct xt_dnp3_net *dnet = container_of(to_delayed_work(work), struct xt_dnp3_net, gc);
+    struct xt_dnp3_stream *stream, *next;
+
+    spin_lock_bh(&dnet->held_lock);
+    list_for_each_entry_safe(stream, next, &dnet->held, list) {
+        if (!time_after(jiffies, stream->expires)) {
+            break;
+        }
+        if (!spin_trylock(&stream->lock)) {
+            continue;
+        }
+        list_del_init(&stream->list);
+        mempool_free(stream->buffer, dnet->frame_pool);
+        atomic_dec(&dnet->frames);
+        stream->buffer = NULL;
+        stream->len = 0;
+        spin_unlock(&stream->lock);
+    }
+    spin_unlock_bh(&dnet->held_lock);
+
+    schedule_delayed_work(&dnet->gc, HZ);
+}
+
+
+static int
+dnp3_flow_help(struct sk_buff *skb, 
+        unsigned int protoff, 
+        struct nf_conn *ct, 
+        enum ip_conntrack_info ctinfo) {
+    return NF_ACCEPT;
+}
+
+
+int
+dnp3_flow_hold(struct xt_dnp3_stream *stream, 
+        u32 seq, 
+        const u8 *data, 
+        u32 len) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+
+    if (len > DNP3_LINK_FRAME_MAX) {
+        return -EINVAL;
+    }
+
+    /*
+        A cap is placed on the number of partial frames held in each namespace 
+        such that the memory consumed by reassembly is bounded, irrespective of 
+        the number of connections on which partial frames are received, and the 
+        connections of one namespace cannot exhaust the reassembly capacity of 
+        another.
+    */
+
+    if (!stream->buffer) {
+        if (atomic_inc_return(&dnet->frames) > READ_ONCE(dnet->streams)) {
+            atomic_dec(&dnet->frames);
+            return -ENOSPC;
+        }
+        if (!(stream->buffer = mempool_alloc(dnet->frame_pool, GFP_ATOMIC))) {
+            atomic_dec(&dnet->frames);
+            return -ENOMEM;
+        }
+    }
+    else {
+        spin_lock(&dnet->held_lock);
+        list_del_init(&stream->list);
+        spin_unlock(&dnet->held_lock);
+    }
+
+    memcpy(stream->buffer, data, len);
+    stream->seq = seq;
+    stream->len = len;
+    stream->expires = jiffies + msecs_to_jiffies(stream_timeout);
+
+    spin_lock(&dnet->held_lock);
+    list_add_tail(&stream->list, &dnet->held);
+    spin_unlock(&dnet->held_lock);
+
+    return 0;
+}
+
+
+int __init
+dnp3_flow_init(void) {
+    int ret;
+
+    NF_CT_HELPER_BUILD_BUG_ON(sizeof(struct xt_dnp3_flow *));
+
+    _flow_cache = kmem_cache_create("xt_dnp3_flow", 
+            sizeof(struct xt_dnp3_flow), 
+            0, 
+            SLAB_HWCACHE_ALIGN, 
+            NULL);
+    if (!_flow_cache) {
+        return -ENOMEM;
+    }
+
+    nf_ct_helper_init(&_helper[0], 
+            AF_INET, 
+            IPPROTO_TCP, 
+            "dnp3", 
+            DNP3_PORT, 
+            DNP3_PORT, 
+            0, 
+            &_policy, 
+            0, 
+            dnp3_flow_help, 
+            NULL, 
+            THIS_MODULE);
+    _helper[0].destroy = dnp3_flow_destroy;
+    if ((ret = nf_conntrack_helpers_register(_helper, ARRAY_SIZE(_helper))) != 0) {
+        goto error_helper;
+    }
+    return 0;
+
+error_helper:
+    kmem_cache_destroy(_flow_cache);
+    return ret;
+}
+
+
+/*
+    This function releases the partial frames and sessions held with the 
+    reassembly state of the connections of a network namespace as the namespace 
+    is destroyed, before the frame buffers of the namespace are released. The 
+    reassembly state itself is released with the connection tracking entry.
+*/
+
+void
+dnp3_flow_net_exit(const struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+    struct xt_dnp3_flow *flow;
+    unsigned int dir;
+
+    local_bh_disable();
+    dnp3_net_enter(net);
+    spin_lock(&_flows_lock);
+    list_for_each_entry(flow, &_flows, list) {
+        if (!net_eq(read_pnet(&flow->net), net)) {
+            continue;
+        }
+        for (dir = 0; dir < IP_CT_DIR_MAX; ++dir) {
+            spin_lock(&flow->stream[dir].lock);
+            dnp3_flow_release(&flow->stream[dir]);
+            dnp3_session_release(&flow->stream[dir]);
+            spin_unlock(&flow->stream[dir].lock);
+        }
+    }
+    spin_unlock(&_flows_lock);
+    local_bh_enable();
+
+    cancel_delayed_work_sync(&dnet->gc);
+    mempool_destroy(dnet->frame_pool);
+}
+
+
+/*
+    The partial frames of each namespace are allocated from a reserve of frame 
+    buffers held for the namespace, with the dnp3_streams sysctl of the namespace 
+    bounding the partial frames held.
+*/
+
+int
+dnp3_flow_net_init(struct xt_dnp3_net *dnet) {
+    dnet->streams = streams;
+    atomic_set(&dnet->frames, 0);
+    INIT_LIST_HEAD(&dnet->held);
+    spin_lock_init(&dnet->held_lock);
+    INIT_DELAYED_WORK(&dnet->gc, dnp3_flow_gc);
+
+    dnet->frame_pool = mempool_create_kmalloc_pool(min_t(unsigned int, streams, XT_DNP3_STREAM_RESERVE), 
+            DNP3_LINK_FRAME_MAX);
+    if (!dnet->frame_pool) {
+        return -ENOMEM;
+    }
+    schedule_delayed_work(&dnet->gc, HZ);
+    return 0;
+}
+
+
+void
+dnp3_flow_release(struct xt_dnp3_stream *stream) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+
+    if (!stream->buffer) {
+        return;
+    }
+
+    spin_lock(&dnet->held_lock);
+    list_del_init(&stream->list);
+    spin_unlock(&dnet->held_lock);
+
+    mempool_free(stream->buffer, dnet->frame_pool);
+    atomic_dec(&dnet->frames);
+    stream->buffer = NULL;
+    stream->len = 0;
+}
+
+
+/*
+    This function returns the reassembly state for the direction of the connection 
+    of the packet passed, where the dnp3 connection tracking helper has been 
+    assigned to this connection. The reassembly state of a connection is allocated 
+    upon the first packet of this connection processed by the DNP3 match.
+*/
+
+struct xt_dnp3_stream *
+dnp3_flow_stream(const struct sk_buff *skb) {
+    enum ip_conntrack_info ctinfo;
+    struct nf_conn_help *help;
+    struct nf_conn *ct;
+    struct xt_dnp3_flow **slot, *flow;
+    unsigned int dir;
+
+    if (!(ct = nf_ct_get(skb, &ctinfo))) {
+        return NULL;
+    }
+    if ((!(help = nfct_help(ct))) ||
+            (rcu_dereference(help->helper) != &_helper[0])) {
+        return NULL;
+    }
+
+    slot = (struct xt_dnp3_flow **) nfct_help_data(ct);
+    if (!(flow = READ_ONCE(*slot))) {
+        if (!(flow = kmem_cache_zalloc(_flow_cache, GFP_ATOMIC))) {
+            return NULL;
+        }
+        for (dir = 0; dir < IP_CT_DIR_MAX; ++dir) {
+            spin_lock_init(&flow->stream[dir].lock);
+            INIT_LIST_HEAD(&flow->stream[dir].list);
+        }
+        write_pnet(&flow->net, nf_ct_net(ct));
+        if (cmpxchg(slot, NULL, flow) != NULL) {
+            kmem_cache_free(_flow_cache, flow);
+            flow = READ_ONCE(*slot);
+        }
+        else {
+            spin_lock_bh(&_flows_lock);
+            list_add(&flow->list, &_flows);
+            spin_unlock_bh(&_flows_lock);
+        }
+    }
+    return &flow->stream[CTINFO2DIR(ctinfo)];
+}
@@ -0,0 +1,313 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/overflow.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <net/genetlink.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_packet.h"
+
+
+static int dnp3_genl_policy_del(struct sk_buff *skb, struct genl_info *info);
+static int dnp3_genl_policy_set(struct sk_buff *skb, struct genl_info *info);
+static struct xt_dnp3_table * dnp3_genl_table_find(const struct net *net, const char *name);
+
+
+/*
+    Policy tables are named within each network namespace, and are created either 
+    by the loading of a policy through the xt_dnp3 generic netlink family from 
+    within the namespace or by the loading of a rule of the namespace which 
+    references the table, such that rules may be loaded before the policy of the 
+    table and the tables of one namespace are neither visible to nor replaced from 
+    another. A table is released once it is referenced by no rule and holds no 
+    policy. The policy of a table is replaced as a whole, with the new policy 
+    published with RCU and the previous policy released once no packet may be 
+    evaluated against it - a packet is therefore evaluated against either the 
+    previous or the new policy, but never a mixture of the two.
+*/
+
+static const struct nla_policy _entry_policy[XT_DNP3_ENTRY_MAX + 1] = {
+    [XT_DNP3_ENTRY_SADDR]   = { .type = NLA_U16 },
+    [XT_DNP3_ENTRY_DADDR]   = { .type = NLA_U16 },
+    [XT_DNP3_ENTRY_FC]      = NLA_POLICY_EXACT_LEN(32),
+};
+
+static const struct nla_policy _policy[XT_DNP3_ATTR_MAX + 1] = {
+    [XT_DNP3_ATTR_NAME]     = { .type = NLA_NUL_STRING, .len = XT_DNP3_POLICY_NAME - 1 },
+    [XT_DNP3_ATTR_ENTRY]    = NLA_POLICY_NESTED(_entry_policy),
+};
+
+static const struct genl_small_ops _ops[] = {
+    {
+        .cmd        = XT_DNP3_CMD_POLICY_SET,
+        .doit       = dnp3_genl_policy_set,
+        .flags      = GENL_ADMIN_PERM,
+    },
+    {
+        .cmd        = XT_DNP3_CMD_POLICY_DEL,
+        .doit       = dnp3_genl_policy_del,
+        .flags      = GENL_ADMIN_PERM,
+    },
+};
+
+static struct genl_family _family __ro_after_init = {
+    .name           = XT_DNP3_GENL_NAME,
+    .version        = XT_DNP3_GENL_VERSION,
+    .maxattr        = XT_DNP3_ATTR_MAX,
+    .policy         = _policy,
+    .module         = THIS_MODULE,
+    .netnsok        = true,
+    .small_ops      = _ops,
+    .n_small_ops    = ARRAY_SIZE(_ops),
+    .resv_start_op  = __XT_DNP3_CMD_MAX,
+};
+
+static LIST_HEAD(_tables);
+
+static DEFINE_MUTEX(_tables_lock);
+
+
+void
+dnp3_genl_exit(void) {
+    struct xt_dnp3_table *table, *next;
+
+    genl_unregister_family(&_family);
+
+    list_for_each_entry_safe(table, next, &_tables, list) {
+        list_del(&table->list);
+        kvfree(rcu_dereference_protected(table->policy, true));
+        kfree(table);
+    }
+}
+
+
+int __init
+dnp3_genl_init(void) {
+    return genl_register_family(&_family);
+}
+
+
+/*
+    This function releases the policies of the tables of a network namespace as 
+    the namespace is destroyed, once no packet of the namespace is evaluated. The 
+    tables are removed from the table list such that they cannot be found by a 
+    later namespace, and those still referenced by rules of the namespace are 
+    released as these rules are destroyed.
+*/
+
+void
+dnp3_genl_net_exit(const struct net *net) {
+    struct xt_dnp3_policy *policy;
+    struct xt_dnp3_table *table, *next;
+
+    mutex_lock(&_tables_lock);
+    list_for_each_entry_safe(table, next, &_tables, list) {
+        if (!net_eq(read_pnet(&table->net), net)) {
+            continue;
+        }
+        list_del_init(&table->list);
+        policy = rcu_dereference_protected(table->policy, lockdep_is_held(&_tables_lock));
+        RCU_INIT_POINTER(table->policy, NULL);
+        kvfree(policy);
+        if (table->refs == 0) {
+            kfree(table);
+        }
+    }
+    mutex_unlock(&_tables_lock);
+}
+
+
+static int
+dnp3_genl_policy_del(struct sk_buff *skb, struct genl_info *info) {
+    struct xt_dnp3_policy *policy;
+    struct xt_dnp3_table *table;
+
+    if (GENL_REQ_ATTR_CHECK(info, XT_DNP3_ATTR_NAME)) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&_tables_lock);
+    if (!(table = dnp3_genl_table_find(genl_info_net(info), nla_data(info->attrs[XT_DNP3_ATTR_NAME])))) {
+        mutex_unlock(&_tables_lock);
+        NL_SET_ERR_MSG_ATTR(info->extack, info->attrs[XT_DNP3_ATTR_NAME], "Unknown policy table");
+        return -ENOENT;
+    }
+    policy = rcu_dereference_protected(table->policy, lockdep_is_held(&_tables_lock));
+    RCU_INIT_POINTER(table->policy, NULL);
+    if (table->refs == 0) {
+        list_del(&table->list);
+        kfree(table);
+    }
+    mutex_unlock(&_tables_lock);
+
+    if (policy) {
+        synchronize_rcu();
+        kvfree(policy);
+    }
+    return 0;
+}
+
+
+static int
+dnp3_genl_policy_set(struct sk_buff *skb, struct genl_info *info) {
+    struct nlattr *tb[XT_DNP3_ENTRY_MAX + 1];
+    struct xt_dnp3_policy *old, *policy;
+    struct xt_dnp3_table *table;
+    struct xt_dnp3_entry entry;
+    struct nlattr *attr;
+    const char *name;
+    u32 bits, count;
+    int rem, ret;
+
+    if (GENL_REQ_ATTR_CHECK(info, XT_DNP3_ATTR_NAME)) {
+        return -EINVAL;
+    }
+    name = nla_data(info->attrs[XT_DNP3_ATTR_NAME]);
+    if (name[0] == '\0') {
+        NL_SET_ERR_MSG_ATTR(info->extack, info->attrs[XT_DNP3_ATTR_NAME], "Empty policy table name");
+        return -EINVAL;
+    }
+
+    count = 0;
+    nla_for_each_attr(attr, genlmsg_data(info->genlhdr), genlmsg_len(info->genlhdr), rem) {
+        if (nla_type(attr) == XT_DNP3_ATTR_ENTRY) {
+            ++count;
+        }
+    }
+    if (count > XT_DNP3_POLICY_ENTRIES) {
+        NL_SET_ERR_MSG(info->extack, "Too many policy table entries");
+        return -E2BIG;
+    }
+
+    /*
+        The new policy is built in full before it is published, with an entry 
+        which omits the source or destination address applying to any source or 
+        destination address respectively.
+    */
+
+    bits = dnp3_policy_bits(count);
+    if (!(policy = kvzalloc(struct_size(policy, entry, 1U << bits), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+    policy->bits = bits;
+
+    nla_for_each_attr(attr, genlmsg_data(info->genlhdr), genlmsg_len(info->genlhdr), rem) {
+        if (nla_type(attr) != XT_DNP3_ATTR_ENTRY) {
+            continue;
+        }
+        if ((ret = nla_parse_nested(tb, XT_DNP3_ENTRY_MAX, attr, _entry_policy, info->extack)) != 0) {
+            goto error;
+        }
+        if (!tb[XT_DNP3_ENTRY_FC]) {
+            NL_SET_ERR_MSG_ATTR(info->extack, attr, "Missing function codes");
+            ret = -EINVAL;
+            goto error;
+        }
+        memset(&entry, 0, sizeof(entry));
+        if (tb[XT_DNP3_ENTRY_SADDR]) {
+            entry.saddr = nla_get_u16(tb[XT_DNP3_ENTRY_SADDR]);
+        }
+        else {
+            entry.flags |= XT_DNP3_POLICY_ANY_SADDR;
+        }
+        if (tb[XT_DNP3_ENTRY_DADDR]) {
+            entry.daddr = nla_get_u16(tb[XT_DNP3_ENTRY_DADDR]);
+        }
+        else {
+            entry.flags |= XT_DNP3_POLICY_ANY_DADDR;
+        }
+        nla_memcpy(entry.fc, tb[XT_DNP3_ENTRY_FC], sizeof(entry.fc));
+        if ((ret = dnp3_policy_insert(policy, &entry)) != 0) {
+            goto error;
+        }
+    }
+
+    mutex_lock(&_tables_lock);
+    if (!(table = dnp3_genl_table_find(genl_info_net(info), name))) {
+        if (!(table = kzalloc(sizeof(*table), GFP_KERNEL))) {
+            mutex_unlock(&_tables_lock);
+            ret = -ENOMEM;
+            goto error;
+        }
+        write_pnet(&table->net, genl_info_net(info));
+        strscpy(table->name, name, sizeof(table->name));
+        list_add(&table->list, &_tables);
+    }
+    old = rcu_dereference_protected(table->policy, lockdep_is_held(&_tables_lock));
+    rcu_assign_pointer(table->policy, policy);
+    mutex_unlock(&_tables_lock);
+
+    if (old) {
+        synchronize_rcu();
+        kvfree(old);
+    }
+    return 0;
+
+error:
+    kvfree(policy);
+    return ret;
+}
+
+
+const struct xt_dnp3_policy *
+dnp3_policy_get(const struct xt_dnp3_table *table) {
+    return rcu_dereference(table->policy);
+}
+
+
+static struct xt_dnp3_table *
+dnp3_genl_table_find(const struct net *net, const char *name) {
+    struct xt_dnp3_table *table;
+
+    list_for_each_entry(table, &_tables, list) {
+        if ((net_eq(read_pnet(&table->net), net)) &&
+                (strcmp(table->name, name) == 0)) {
+            return table;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+    This function returns the policy table of the name specified within the 
+    network namespace passed, creating this table where it does not exist, with a 
+    reference held by the calling rule. Until a policy is loaded into a table, no 
+    function code is permitted by the table.
+*/
+
+struct xt_dnp3_table *
+dnp3_genl_table_get(struct net *net, const char *name) {
+    struct xt_dnp3_table *table;
+
+    mutex_lock(&_tables_lock);
+    if (!(table = dnp3_genl_table_find(net, name))) {
+        if ((table = kzalloc(sizeof(*table), GFP_KERNEL)) != NULL) {
+            write_pnet(&table->net, net);
+            strscpy(table->name, name, sizeof(table->name));
+            list_add(&table->list, &_tables);
+        }
+    }
+    if (table) {
+        ++table->refs;
+    }
+    mutex_unlock(&_tables_lock);
+    return table;
+}
+
+
+void
+dnp3_genl_table_put(struct xt_dnp3_table *table) {
+    mutex_lock(&_tables_lock);
+    if ((--table->refs == 0) &&
+            (!rcu_access_pointer(table->policy))) {
+        list_del(&table->list);
+        kfree(table);
+    }
+    mutex_unlock(&_tables_lock);
+}
@@ -0,0 +1,555 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/math64.h>
+#include <linux/skbuff.h>
+#include <linux/version.h>
+#include <net/ip.h>
+#include <net/udp.h>
+#include <linux/netfilter/x_tables.h>
+#include <kunit/test.h>
+
+#include "xt_dnp3.h"
+
+
+/*
+    This KUnit suite is built as the xt_dnp3_kunit module, with the match 
+    functions of the xt_dnp3 module exported to it where the kernel is built with 
+    KUnit. A rule is loaded with checkentry for each case and removed with 
+    destroy, and synthetic UDP packets, with payloads held either within the 
+    linear data of the socket buffer or across page fragments with frames 
+    straddling fragments, are evaluated through dnp3_mt_match_rule() as within an 
+    x_tables traversal of the initial network namespace. The number of packets 
+    parsed, as counted for the namespace, distinguishes evaluations served from 
+    the per-CPU parse cache. The time per packet of each case is reported in the 
+    log of the suite.
+*/
+
+#define DNP3_KUNIT_FRAG                 (64)
+
+#define DNP3_KUNIT_ITERATIONS           (10000)
+
+#define DNP3_KUNIT_PAYLOAD              (10 * DNP3_LINK_FRAME_MAX)
+
+#define DNP3_KUNIT_SADDR                (1)
+
+#define DNP3_KUNIT_DADDR                (10)
+
+
+struct dnp3_kunit_case {
+    const char *name;                   /* Case name */
+    u8 func;                            /* Function code */
+    u32 bytes;                          /* User data octets of each frame */
+    u32 frames;                         /* Frames */
+    s32 corrupt;                        /* Payload octet corrupted, or -1 */
+    u32 truncate;                       /* Payload octets removed */
+    bool match;                         /* Expected rule match */
+};
+
+
+static int dnp3_kunit_check(struct xt_dnp3_rule *rule);
+static u16 dnp3_kunit_crc(const u8 *data, u32 len);
+static void dnp3_kunit_destroy(struct xt_dnp3_rule *rule);
+static void dnp3_kunit_evaluate(struct kunit *test, bool paged);
+static void dnp3_kunit_exit(struct kunit *test);
+static u32 dnp3_kunit_frame(u8 *frame, u8 tspt, u8 func, u32 bytes);
+static int dnp3_kunit_init(struct kunit *test);
+static bool dnp3_kunit_match(const struct sk_buff *skb, const struct xt_dnp3_rule *rule, bool *hotdrop);
+static u64 dnp3_kunit_parsed(void);
+static u32 dnp3_kunit_payload(u8 *payload, const struct dnp3_kunit_case *entry);
+static void dnp3_kunit_rule(struct xt_dnp3_rule *rule, u8 func);
+static struct sk_buff * dnp3_kunit_skb(const u8 *payload, u32 len, bool paged);
+static void dnp3_kunit_test_cache(struct kunit *test);
+static void dnp3_kunit_test_check(struct kunit *test);
+static void dnp3_kunit_test_linear(struct kunit *test);
+static void dnp3_kunit_test_paged(struct kunit *test);
+static void dnp3_kunit_test_time(struct kunit *test);
+
+
+static const struct dnp3_kunit_case _cases[] = {
+    { "read",               1,   9,   1,  -1,   0, true },
+    { "read x10",           1,   9,  10,  -1,   0, true },
+    { "write",              2,   9,   1,  -1,   0, false },
+    { "read 250",           1, 250,   1,  -1,   0, true },
+    { "header_crc",         1, 250,   1,   8,   0, false },
+    { "block_crc first",    1, 250,   1, DNP3_LINK_HDR_LENGTH + DNP3_LINK_BLOCK_LENGTH, 0, false },
+    { "block_crc last",     1, 250,   1, DNP3_LINK_FRAME_MAX - 1, 0, false },
+    { "truncated",          1, 250,   1,  -1, 146, false },
+};
+
+
+static int
+dnp3_kunit_check(struct xt_dnp3_rule *rule) {
+    struct xt_mtchk_param par = {
+        .net        = &init_net,
+        .table      = "filter",
+        .matchinfo  = rule,
+        .hook_mask  = (1 << NF_INET_LOCAL_IN),
+        .family     = NFPROTO_IPV4,
+    };
+
+    return dnp3_mt_check_rule(&par);
+}
+
+
+/*
+    The CRCs of the frames of each case are calculated bit by bit, independently 
+    of the CRC engines of the module.
+*/
+
+static u16
+dnp3_kunit_crc(const u8 *data, u32 len) {
+    u32 bit;
+    u16 crc;
+
+    for (crc = 0; len-- > 0; ++data) {
+        crc ^= *data;
+        for (bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xa6bc) : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+
+static void
+dnp3_kunit_destroy(struct xt_dnp3_rule *rule) {
+    struct xt_mtdtor_param par = {
+        .net        = &init_net,
+        .matchinfo  = rule,
+        .family     = NFPROTO_IPV4,
+    };
+
+    dnp3_mt_destroy_rule(&par);
+}
+
+
+/*
+    This function evaluates the packet of each case against the rule of the test, 
+    outside of an x_tables traversal such that each evaluation is parsed. Where 
+    paged, the payload is held in page fragments of DNP3_KUNIT_FRAG octets, such 
+    that the link headers and data blocks of frames straddle fragments and are 
+    read through the bounce buffer of dnp3_mt_frame_read().
+*/
+
+static void
+dnp3_kunit_evaluate(struct kunit *test, bool paged) {
+    const struct dnp3_kunit_case *entry;
+    struct sk_buff *skb;
+    unsigned int index;
+    u64 parsed;
+    u8 *payload;
+    bool hotdrop, ret;
+    u32 len;
+
+    payload = kunit_kzalloc(test, DNP3_KUNIT_PAYLOAD, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, payload);
+
+    for (index = 0; index < ARRAY_SIZE(_cases); ++index) {
+        entry = &_cases[index];
+        len = dnp3_kunit_payload(payload, entry);
+        skb = dnp3_kunit_skb(payload, len, paged);
+        KUNIT_ASSERT_NOT_NULL(test, skb);
+        KUNIT_EXPECT_EQ_MSG(test, skb_headlen(skb),
+                paged ? (u32) (sizeof(struct iphdr) + sizeof(struct udphdr)) : skb->len,
+                "%s", entry->name);
+
+        local_bh_disable();
+        parsed = dnp3_kunit_parsed();
+        ret = dnp3_kunit_match(skb, test->priv, &hotdrop);
+        parsed = dnp3_kunit_parsed() - parsed;
+        local_bh_enable();
+
+        KUNIT_EXPECT_EQ_MSG(test, ret, entry->match, "%s", entry->name);
+        KUNIT_EXPECT_FALSE_MSG(test, hotdrop, "%s", entry->name);
+        KUNIT_EXPECT_EQ_MSG(test, parsed, 1ULL, "%s", entry->name);
+        kfree_skb(skb);
+    }
+}
+
+
+static void
+dnp3_kunit_exit(struct kunit *test) {
+    if (test->priv) {
+        dnp3_kunit_destroy(test->priv);
+    }
+}
+
+
+/*
+    This function writes a frame of unconfirmed user data from the primary station 
+    with bytes octets of user data, commencing with the transport header tspt and 
+    the application control and function code func, returning the length of the 
+    frame.
+*/
+
+static u32
+dnp3_kunit_frame(u8 *frame, u8 tspt, u8 func, u32 bytes) {
+    u32 index, offset, segment;
+    u8 data[DNP3_LINK_FRAME_MAX];
+    u16 crc;
+
+    for (index = 0; index < bytes; ++index) {
+        data[index] = (u8) index;
+    }
+    data[0] = tspt;
+    data[1] = 0xc0 | (tspt & DNP3_TSPT_HDR_SEQUENCE_MASK & 0x0f);
+    data[2] = func;
+
+    frame[0] = 0x05;
+    frame[1] = 0x64;
+    frame[2] = (u8) (bytes + 5);
+    frame[3] = 0xc4;
+    frame[4] = (u8) (DNP3_KUNIT_DADDR & 0xff);
+    frame[5] = (u8) (DNP3_KUNIT_DADDR >> 8);
+    frame[6] = (u8) (DNP3_KUNIT_SADDR & 0xff);
+    frame[7] = (u8) (DNP3_KUNIT_SADDR >> 8);
+    crc = dnp3_kunit_crc(frame, 8);
+    frame[8] = (u8) (crc & 0xff);
+    frame[9] = (u8) (crc >> 8);
+
+    for (offset = DNP3_LINK_HDR_LENGTH, index = 0; index < bytes; index += segment) {
+        segment = min_t(u32, bytes - index, DNP3_LINK_BLOCK_LENGTH);
+        memcpy(&frame[offset], &data[index], segment);
+        crc = dnp3_kunit_crc(&frame[offset], segment);
+        frame[offset + segment] = (u8) (crc & 0xff);
+        frame[offset + segment + 1] = (u8) (crc >> 8);
+        offset += (segment + DNP3_LINK_CRC_LENGTH);
+    }
+    return offset;
+}
+
+
+/*
+    A rule admitting read requests with full CRC validation is loaded for each 
+    case, such that the depth of validation and the tracking of sessions are those 
+    of a loaded rule.
+*/
+
+static int
+dnp3_kunit_init(struct kunit *test) {
+    struct xt_dnp3_rule *rule;
+    int ret;
+
+    if (!(rule = kunit_kzalloc(test, sizeof(*rule), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+    dnp3_kunit_rule(rule, 1);
+    if ((ret = dnp3_kunit_check(rule)) != 0) {
+        return ret;
+    }
+    test->priv = rule;
+    return 0;
+}
+
+
+static bool
+dnp3_kunit_match(const struct sk_buff *skb,
+        const struct xt_dnp3_rule *rule,
+        bool *hotdrop) {
+    struct nf_hook_state state = {
+        .hook       = NF_INET_LOCAL_IN,
+        .pf         = NFPROTO_IPV4,
+        .net        = &init_net,
+    };
+    struct xt_action_param par = {
+        .matchinfo  = rule,
+        .state      = &state,
+        .thoff      = sizeof(struct iphdr),
+    };
+    bool ret;
+
+    ret = dnp3_mt_match_rule(skb, &par);
+    if (hotdrop) {
+        *hotdrop = par.hotdrop;
+    }
+    return ret;
+}
+
+
+static u64
+dnp3_kunit_parsed(void) {
+    return this_cpu_ptr(dnp3_net(&init_net)->stats)->count[XT_DNP3_STAT_PACKETS];
+}
+
+
+static u32
+dnp3_kunit_payload(u8 *payload, const struct dnp3_kunit_case *entry) {
+    u32 index, len;
+
+    for (len = 0, index = 0; index < entry->frames; ++index) {
+        len += dnp3_kunit_frame(&payload[len], (u8) (0xc0 | index), entry->func, entry->bytes);
+    }
+    if (entry->corrupt >= 0) {
+        payload[entry->corrupt] ^= 0xff;
+    }
+    return len - entry->truncate;
+}
+
+
+static void
+dnp3_kunit_rule(struct xt_dnp3_rule *rule, u8 func) {
+    memset(rule, 0, sizeof(*rule));
+    rule->set = XT_DNP3_FLAG_FC | XT_DNP3_FLAG_CHECKSUM;
+    rule->crc = XT_DNP3_CRC_FULL;
+    rule->fc[func / 8] |= (1 << (func % 8));
+}
+
+
+static struct sk_buff *
+dnp3_kunit_skb(const u8 *payload, u32 len, bool paged) {
+    struct sk_buff *skb;
+    struct udphdr *udph;
+    struct iphdr *iph;
+    struct page *page;
+    u32 index, offset, size;
+
+    if (!(skb = alloc_skb(LL_MAX_HEADER + sizeof(*iph) + sizeof(*udph) + (paged ? 0 : len), GFP_KERNEL))) {
+        return NULL;
+    }
+    skb_reserve(skb, LL_MAX_HEADER);
+    skb_reset_network_header(skb);
+    iph = skb_put_zero(skb, sizeof(*iph));
+    iph->version = 4;
+    iph->ihl = 5;
+    iph->ttl = 64;
+    iph->protocol = IPPROTO_UDP;
+    iph->tot_len = htons(sizeof(*iph) + sizeof(*udph) + len);
+    iph->saddr = htonl(0x0a000001);
+    iph->daddr = htonl(0x0a000002);
+    skb_set_transport_header(skb, sizeof(*iph));
+    udph = skb_put_zero(skb, sizeof(*udph));
+    udph->source = htons(DNP3_PORT);
+    udph->dest = htons(DNP3_PORT);
+    udph->len = htons(sizeof(*udph) + len);
+
+    if (!paged) {
+        skb_put_data(skb, payload, len);
+        return skb;
+    }
+    for (index = 0, offset = 0; offset < len; ++index, offset += size) {
+        size = min_t(u32, len - offset, DNP3_KUNIT_FRAG);
+        if (!(page = alloc_page(GFP_KERNEL))) {
+            kfree_skb(skb);
+            return NULL;
+        }
+        memcpy(page_address(page), &payload[offset], size);
+        skb_add_rx_frag(skb, index, page, 0, size, PAGE_SIZE);
+    }
+    return skb;
+}
+
+
+/*
+    Evaluations of the same socket buffer within a traversal are served from the 
+    parse cache, such that a change to the payload is not seen, while a change to 
+    the length of the packet, another socket buffer, a later traversal or an 
+    evaluation outside of a traversal results in the packet being parsed. The 
+    outcomes are checked once bottom halves are enabled again.
+*/
+
+static void
+dnp3_kunit_test_cache(struct kunit *test) {
+    struct sk_buff *other, *skb;
+    unsigned int addend;
+    u64 parsed[6], start;
+    bool match[8];
+    u8 payload[2 * DNP3_LINK_FRAME_MAX];
+    u32 len;
+
+    len = dnp3_kunit_frame(payload, 0xc0, 1, 9);
+    len += dnp3_kunit_frame(&payload[len], 0xc1, 1, 9);
+    skb = dnp3_kunit_skb(payload, len, false);
+    other = dnp3_kunit_skb(payload, len, true);
+    if ((!skb) ||
+            (!other)) {
+        kfree_skb(other);
+        kfree_skb(skb);
+    }
+    KUNIT_ASSERT_NOT_NULL(test, skb);
+    KUNIT_ASSERT_NOT_NULL(test, other);
+
+    local_bh_disable();
+    start = dnp3_kunit_parsed();
+    addend = xt_write_recseq_begin();
+    match[0] = dnp3_kunit_match(skb, test->priv, NULL);
+    match[1] = dnp3_kunit_match(skb, test->priv, NULL);
+    parsed[0] = dnp3_kunit_parsed() - start;
+
+    dnp3_kunit_frame(skb_transport_header(skb) + sizeof(struct udphdr), 0xc0, 2, 9);
+    match[2] = dnp3_kunit_match(skb, test->priv, NULL);
+    parsed[1] = dnp3_kunit_parsed() - start;
+
+    skb_trim(skb, skb->len - 1);
+    match[3] = dnp3_kunit_match(skb, test->priv, NULL);
+    parsed[2] = dnp3_kunit_parsed() - start;
+
+    match[4] = dnp3_kunit_match(other, test->priv, NULL);
+    parsed[3] = dnp3_kunit_parsed() - start;
+    xt_write_recseq_end(addend);
+
+    addend = xt_write_recseq_begin();
+    match[5] = dnp3_kunit_match(other, test->priv, NULL);
+    parsed[4] = dnp3_kunit_parsed() - start;
+    xt_write_recseq_end(addend);
+
+    match[6] = dnp3_kunit_match(other, test->priv, NULL);
+    match[7] = dnp3_kunit_match(other, test->priv, NULL);
+    parsed[5] = dnp3_kunit_parsed() - start;
+    local_bh_enable();
+
+    KUNIT_EXPECT_TRUE(test, match[0]);
+    KUNIT_EXPECT_TRUE(test, match[1]);
+    KUNIT_EXPECT_EQ(test, parsed[0], 1ULL);
+    KUNIT_EXPECT_TRUE(test, match[2]);
+    KUNIT_EXPECT_EQ(test, parsed[1], 1ULL);
+    KUNIT_EXPECT_FALSE(test, match[3]);
+    KUNIT_EXPECT_EQ(test, parsed[2], 2ULL);
+    KUNIT_EXPECT_TRUE(test, match[4]);
+    KUNIT_EXPECT_EQ(test, parsed[3], 3ULL);
+    KUNIT_EXPECT_TRUE(test, match[5]);
+    KUNIT_EXPECT_EQ(test, parsed[4], 4ULL);
+    KUNIT_EXPECT_TRUE(test, match[6]);
+    KUNIT_EXPECT_TRUE(test, match[7]);
+    KUNIT_EXPECT_EQ(test, parsed[5], 6ULL);
+
+    kfree_skb(other);
+    kfree_skb(skb);
+}
+
+
+/*
+    Invalid rules are rejected by checkentry without change to the depth of 
+    validation, while valid rules are reflected in the depth, sample interval, 
+    session tracking and CRC counter modes until destroyed. The rule of the test, 
+    with full CRC validation, remains loaded throughout.
+*/
+
+static void
+dnp3_kunit_test_check(struct kunit *test) {
+    struct xt_dnp3_rule *rule;
+    u32 depth;
+
+    rule = kunit_kzalloc(test, sizeof(*rule), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, rule);
+    depth = dnp3_mt_depth();
+    KUNIT_EXPECT_EQ(test, depth & 0xff, (u32) XT_DNP3_CRC_FULL);
+    KUNIT_EXPECT_NE(test, depth & (1 << 17), 0U);
+    KUNIT_EXPECT_NE(test, depth & (1 << (24 + XT_DNP3_CRC_FULL)), 0U);
+
+    dnp3_kunit_rule(rule, 1);
+    rule->crc = XT_DNP3_CRC_MAX;
+    KUNIT_EXPECT_EQ(test, dnp3_kunit_check(rule), -EINVAL);
+    dnp3_kunit_rule(rule, 1);
+    rule->invert = XT_DNP3_FLAG_CTMARK;
+    KUNIT_EXPECT_EQ(test, dnp3_kunit_check(rule), -EINVAL);
+    dnp3_kunit_rule(rule, 1);
+    rule->set |= XT_DNP3_FLAG_RATE;
+    KUNIT_EXPECT_EQ(test, dnp3_kunit_check(rule), -EINVAL);
+    KUNIT_EXPECT_EQ(test, dnp3_mt_depth(), depth);
+
+    dnp3_kunit_rule(rule, 1);
+    rule->set |= XT_DNP3_FLAG_RATE;
+    rule->interval = 1000;
+    rule->burst = 5;
+    rule->per = XT_DNP3_RATE_PAIR;
+    KUNIT_ASSERT_EQ(test, dnp3_kunit_check(rule), 0);
+    KUNIT_EXPECT_NOT_NULL(test, rule->rate);
+    if (rule->rate) {
+        KUNIT_EXPECT_EQ(test, rule->rate->interval, 1000ULL * NSEC_PER_USEC);
+        KUNIT_EXPECT_EQ(test, rule->rate->tolerance, 4000ULL * NSEC_PER_USEC);
+    }
+    dnp3_kunit_destroy(rule);
+    KUNIT_EXPECT_EQ(test, dnp3_mt_depth(), depth);
+
+    dnp3_kunit_rule(rule, 1);
+    rule->crc = XT_DNP3_CRC_SAMPLE;
+    rule->sample = 3;
+    KUNIT_ASSERT_EQ(test, dnp3_kunit_check(rule), 0);
+    KUNIT_EXPECT_EQ(test, dnp3_mt_depth() & 0xff, (u32) XT_DNP3_CRC_FULL);
+    KUNIT_EXPECT_NE(test, dnp3_mt_depth() & (1 << (24 + XT_DNP3_CRC_SAMPLE)), 0U);
+    dnp3_kunit_destroy(rule);
+    KUNIT_EXPECT_EQ(test, dnp3_mt_depth(), depth);
+}
+
+
+static void
+dnp3_kunit_test_linear(struct kunit *test) {
+    dnp3_kunit_evaluate(test, false);
+}
+
+
+static void
+dnp3_kunit_test_paged(struct kunit *test) {
+    dnp3_kunit_evaluate(test, true);
+}
+
+
+/*
+    The time per packet of each case, with linear and paged payloads, is measured 
+    across DNP3_KUNIT_ITERATIONS evaluations, each within its own traversal such 
+    that every evaluation is parsed.
+*/
+
+static void
+dnp3_kunit_test_time(struct kunit *test) {
+    const struct dnp3_kunit_case *entry;
+    struct sk_buff *skb;
+    unsigned int addend, count, index, paged;
+    u8 *payload;
+    u64 start;
+    u32 len;
+
+    payload = kunit_kzalloc(test, DNP3_KUNIT_PAYLOAD, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, payload);
+
+    for (paged = 0; paged < 2; ++paged) {
+        for (index = 0; index < ARRAY_SIZE(_cases); ++index) {
+            entry = &_cases[index];
+            len = dnp3_kunit_payload(payload, entry);
+            skb = dnp3_kunit_skb(payload, len, paged);
+            KUNIT_ASSERT_NOT_NULL(test, skb);
+
+            start = ktime_get_ns();
+            for (count = 0; count < DNP3_KUNIT_ITERATIONS; ++count) {
+                local_bh_disable();
+                addend = xt_write_recseq_begin();
+                dnp3_kunit_match(skb, test->priv, NULL);
+                xt_write_recseq_end(addend);
+                local_bh_enable();
+            }
+            kunit_info(test, "%-18s %-6s %8llu ns/packet\n",
+                    entry->name,
+                    paged ? "paged" : "linear",
+                    div_u64(ktime_get_ns() - start, DNP3_KUNIT_ITERATIONS));
+            kfree_skb(skb);
+        }
+    }
+}
+
+
+static struct kunit_case dnp3_kunit_cases[] = {
+    KUNIT_CASE(dnp3_kunit_test_cache),
+    KUNIT_CASE(dnp3_kunit_test_check),
+    KUNIT_CASE(dnp3_kunit_test_linear),
+    KUNIT_CASE(dnp3_kunit_test_paged),
+    KUNIT_CASE_SLOW(dnp3_kunit_test_time),
+    {}
+};
+
+static struct kunit_suite dnp3_kunit_suite = {
+    .name       = "xt_dnp3",
+    .init       = dnp3_kunit_init,
+    .exit       = dnp3_kunit_exit,
+    .test_cases = dnp3_kunit_cases,
+};
+
+kunit_test_suite(dnp3_kunit_suite);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+MODULE_IMPORT_NS("EXPORTED_FOR_KUNIT_TESTING");
+#else
+MODULE_IMPORT_NS(EXPORTED_FOR_KUNIT_TESTING);
+#endif
+
+MODULE_DESCRIPTION("KUnit tests for the dnp3 match");
+MODULE_LICENSE("GPL");
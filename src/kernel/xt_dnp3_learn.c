@@ -0,0 +1,381 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <net/ip.h>
+#include <net/net_namespace.h>
+
+#include "xt_dnp3.h"
+
+
+#define XT_DNP3_LEARN_CHAIN             "DNP3_LEARN"
+#define XT_DNP3_LEARN_PROBES            (8)
+
+
+struct xt_dnp3_learn_dump {
+    unsigned long count;                /* Entries */
+    struct xt_dnp3_learn entry[];
+};
+
+
+static int dnp3_learn_compare(const void *a, const void *b);
+static void dnp3_learn_flush(struct work_struct *work);
+static inline bool dnp3_learn_key(const struct xt_dnp3_learn *a, const struct xt_dnp3_learn *b);
+static void * dnp3_learn_next(struct seq_file *seq, void *v, loff_t *pos);
+static int dnp3_learn_open(struct inode *inode, struct file *file);
+static int dnp3_learn_release(struct inode *inode, struct file *file);
+static int dnp3_learn_show(struct seq_file *seq, void *v);
+static void * dnp3_learn_start(struct seq_file *seq, loff_t *pos);
+static void dnp3_learn_stop(struct seq_file *seq, void *v);
+static ssize_t dnp3_learn_write(struct file *file, const char __user *buffer, size_t count, loff_t *ppos);
+
+
+static unsigned int learn __read_mostly = 0;
+module_param(learn, uint, 0400);
+MODULE_PARM_DESC(learn, "Number of tuples in the learning table of each CPU (0 disables)");
+
+
+/*
+    The learning tables of all CPUs are held in a single allocation for each 
+    network namespace, such that the tuples of one namespace are never written 
+    as rules for another. Each tuple is located by a bounded linear probe from its 
+    hash, such that the cost of recording a tuple already held - the steady state 
+    once the traffic of a plant has been observed - is that of a single lookup. 
+    The tables are merged, sorted and grouped by IP and DNP3 address pair as 
+    /proc/net/xt_dnp3_learn of the namespace is opened, and are cleared by a write 
+    to this file.
+*/
+
+static struct xt_dnp3_learn *_flush;
+
+static DEFINE_MUTEX(_flush_lock);
+
+static u32 _mask __read_mostly;
+
+static u32 _seed __read_mostly;
+
+static const struct seq_operations _learn_seq_ops = {
+    .start  = dnp3_learn_start,
+    .next   = dnp3_learn_next,
+    .stop   = dnp3_learn_stop,
+    .show   = dnp3_learn_show,
+};
+
+static const struct proc_ops _learn_ops = {
+    .proc_open      = dnp3_learn_open,
+    .proc_read      = seq_read,
+    .proc_write     = dnp3_learn_write,
+    .proc_lseek     = seq_lseek,
+    .proc_release   = dnp3_learn_release,
+};
+
+
+static int
+dnp3_learn_compare(const void *a, const void *b) {
+    const struct xt_dnp3_learn *x = a, *y = b;
+
+    if (x->src != y->src) {
+        return (ntohl(x->src) < ntohl(y->src)) ? -1 : 1;
+    }
+    if (x->dest != y->dest) {
+        return (ntohl(x->dest) < ntohl(y->dest)) ? -1 : 1;
+    }
+    if (x->protocol != y->protocol) {
+        return (x->protocol < y->protocol) ? -1 : 1;
+    }
+    if (x->saddr != y->saddr) {
+        return (x->saddr < y->saddr) ? -1 : 1;
+    }
+    if (x->daddr != y->daddr) {
+        return (x->daddr < y->daddr) ? -1 : 1;
+    }
+    if (x->func != y->func) {
+        return (x->func < y->func) ? -1 : 1;
+    }
+    return 0;
+}
+
+
+bool
+dnp3_learn_enabled(void) {
+    return (learn != 0);
+}
+
+
+/*
+    This function clears the learning table of the current CPU in the namespace 
+    being flushed, and is run on each CPU in turn with bottom halves disabled, 
+    such that no tuple is being recorded into the table as it is cleared.
+*/
+
+static void
+dnp3_learn_flush(struct work_struct *work) {
+    local_bh_disable();
+    memset(_flush + ((unsigned long) (_mask + 1) * smp_processor_id()),
+            0,
+            (unsigned long) (_mask + 1) * sizeof(struct xt_dnp3_learn));
+    local_bh_enable();
+}
+
+
+void __init
+dnp3_learn_init(void) {
+    if (learn == 0) {
+        return;
+    }
+    _mask = roundup_pow_of_two(min_t(u32, learn, 1U << 20)) - 1;
+    _seed = get_random_u32();
+}
+
+
+static inline bool
+dnp3_learn_key(const struct xt_dnp3_learn *a, const struct xt_dnp3_learn *b) {
+    return ((a->src == b->src) &&
+            (a->dest == b->dest) &&
+            (a->protocol == b->protocol) &&
+            (a->saddr == b->saddr) &&
+            (a->daddr == b->daddr));
+}
+
+
+void
+dnp3_learn_net_exit(struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+
+    if (!dnet->learn) {
+        return;
+    }
+    remove_proc_entry("xt_dnp3_learn", net->proc_net);
+    vfree(dnet->learn);
+}
+
+
+int
+dnp3_learn_net_init(struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+
+    dnet->learn = NULL;
+    if (learn == 0) {
+        return 0;
+    }
+    if (!(dnet->learn = vzalloc(array_size((unsigned long) (_mask + 1) * nr_cpu_ids, sizeof(struct xt_dnp3_learn))))) {
+        return -ENOMEM;
+    }
+    if (!proc_create_data("xt_dnp3_learn", 0600, net->proc_net, &_learn_ops, dnet)) {
+        vfree(dnet->learn);
+        dnet->learn = NULL;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+
+static void *
+dnp3_learn_next(struct seq_file *seq, void *v, loff_t *pos) {
+    ++*pos;
+    return dnp3_learn_start(seq, pos);
+}
+
+
+/*
+    The learning tables of all CPUs are merged into a snapshot as the file is
+    opened, such that the rules written are consistent across reads of the file
+    regardless of the tuples recorded meanwhile.
+*/
+
+static int
+dnp3_learn_open(struct inode *inode, struct file *file) {
+    const struct xt_dnp3_net *dnet = pde_data(inode);
+    struct xt_dnp3_learn_dump *dump;
+    const struct xt_dnp3_learn *entry;
+    unsigned long index, total;
+    int ret;
+
+    total = (unsigned long) (_mask + 1) * nr_cpu_ids;
+    if (!(dump = kvmalloc(struct_size(dump, entry, total), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+    dump->count = 0;
+    for (index = 0; index < total; ++index) {
+        entry = &dnet->learn[index];
+        if (smp_load_acquire(&entry->used)) {
+            dump->entry[dump->count++] = *entry;
+        }
+    }
+    sort(dump->entry, dump->count, sizeof(struct xt_dnp3_learn), dnp3_learn_compare, NULL);
+
+    if ((ret = seq_open(file, &_learn_seq_ops)) != 0) {
+        kvfree(dump);
+        return ret;
+    }
+    ((struct seq_file *) file->private_data)->private = dump;
+    return 0;
+}
+
+
+/*
+    This function records the tuple of each frame of a parsed packet which carries
+    a function code and has not failed CRC validation into the learning table of 
+    the namespace passed, and must be called with bottom halves disabled. Partial 
+    frames are recorded upon completion.
+*/
+
+void
+dnp3_learn_record(struct xt_dnp3_net *dnet, 
+        const struct sk_buff *skb, 
+        const struct xt_dnp3_packet *packet) {
+    const struct xt_dnp3_frame *frame;
+    struct xt_dnp3_learn *entry, *table;
+    const struct iphdr *iph;
+    u32 hash, index, probe;
+
+    if ((!dnet->learn) ||
+            (!packet->valid)) {
+        return;
+    }
+    table = dnet->learn + ((unsigned long) (_mask + 1) * smp_processor_id());
+    iph = ip_hdr(skb);
+
+    for (index = 0; index < packet->count; ++index) {
+        frame = &packet->frame[index];
+        if (((frame->flags & (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_PARTIAL)) != XT_DNP3_FRAME_FC) ||
+                (frame->crc & (XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD))) {
+            continue;
+        }
+        hash = jhash_3words((__force u32) iph->saddr,
+                (__force u32) iph->daddr,
+                ((u32) frame->saddr << 16) | frame->daddr,
+                _seed ^ (((u32) iph->protocol << 8) | frame->func));
+        for (probe = 0; probe < XT_DNP3_LEARN_PROBES; ++probe) {
+            entry = &table[(hash + probe) & _mask];
+            if (!entry->used) {
+                entry->src = iph->saddr;
+                entry->dest = iph->daddr;
+                entry->saddr = frame->saddr;
+                entry->daddr = frame->daddr;
+                entry->protocol = iph->protocol;
+                entry->func = frame->func;
+                smp_store_release(&entry->used, 1);
+                dnp3_stats_inc(XT_DNP3_STAT_LEARNED);
+                break;
+            }
+            if ((entry->src == iph->saddr) &&
+                    (entry->dest == iph->daddr) &&
+                    (entry->saddr == frame->saddr) &&
+                    (entry->daddr == frame->daddr) &&
+                    (entry->protocol == iph->protocol) &&
+                    (entry->func == frame->func)) {
+                break;
+            }
+        }
+        if (probe == XT_DNP3_LEARN_PROBES) {
+            dnp3_stats_inc(XT_DNP3_STAT_UNLEARNED);
+        }
+    }
+}
+
+
+static int
+dnp3_learn_release(struct inode *inode, struct file *file) {
+    kvfree(((struct seq_file *) file->private_data)->private);
+    return seq_release(inode, file);
+}
+
+
+/*
+    The snapshot is written as rules for iptables-restore, with a rule admitting
+    the function codes observed between each pair of IP and DNP3 addresses to the
+    DNP3_LEARN chain, which ends with a rule dropping all other packets. Position
+    zero of the file is the header of the rules, positions one to count the
+    entries of the snapshot and the position following these the trailer.
+*/
+
+static int
+dnp3_learn_show(struct seq_file *seq, void *v) {
+    const struct xt_dnp3_learn_dump *dump = seq->private;
+    const struct xt_dnp3_learn *end, *entry, *next;
+    unsigned long pos;
+
+    pos = (unsigned long) v - 1;
+    if (pos == 0) {
+        seq_printf(seq, "*filter\n:%s - [0:0]\n", XT_DNP3_LEARN_CHAIN);
+        return 0;
+    }
+    if (pos > dump->count) {
+        seq_printf(seq, "-A %s -j DROP\nCOMMIT\n", XT_DNP3_LEARN_CHAIN);
+        return 0;
+    }
+
+    /*
+        The entries of the snapshot are sorted such that the function codes of
+        each pair of IP and DNP3 addresses are adjacent, and may be duplicated
+        where observed on more than one CPU. A rule is written for the first entry
+        of each pair only.
+    */
+
+    entry = &dump->entry[pos - 1];
+    end = &dump->entry[dump->count];
+    if ((pos > 1) &&
+            (dnp3_learn_key(entry - 1, entry))) {
+        return 0;
+    }
+    seq_printf(seq, "-A %s -s %pI4/32 -d %pI4/32 -p %s -m dnp3 --saddr %u --daddr %u --fc %u",
+            XT_DNP3_LEARN_CHAIN,
+            &entry->src,
+            &entry->dest,
+            (entry->protocol == IPPROTO_TCP) ? "tcp" : "udp",
+            entry->saddr,
+            entry->daddr,
+            entry->func);
+    for (next = entry + 1; (next < end) && (dnp3_learn_key(entry, next)); ++next) {
+        if (next->func != next[-1].func) {
+            seq_printf(seq, ",%u", next->func);
+        }
+    }
+    seq_puts(seq, " -j ACCEPT\n");
+    return 0;
+}
+
+
+static void *
+dnp3_learn_start(struct seq_file *seq, loff_t *pos) {
+    const struct xt_dnp3_learn_dump *dump = seq->private;
+
+    if (*pos > (loff_t) dump->count + 1) {
+        return NULL;
+    }
+    return (void *) (unsigned long) (*pos + 1);
+}
+
+
+static void
+dnp3_learn_stop(struct seq_file *seq, void *v) {
+}
+
+
+static ssize_t
+dnp3_learn_write(struct file *file,
+        const char __user *buffer,
+        size_t count,
+        loff_t *ppos) {
+    struct xt_dnp3_net *dnet = pde_data(file_inode(file));
+    int ret;
+
+    mutex_lock(&_flush_lock);
+    _flush = dnet->learn;
+    ret = schedule_on_each_cpu(dnp3_learn_flush);
+    mutex_unlock(&_flush_lock);
+    if (ret != 0) {
+        return ret;
+    }
+    return count;
+}
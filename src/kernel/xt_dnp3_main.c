@@ -0,0 +1,898 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
+#include <kunit/visibility.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+#include <net/tcp.h>
+#include <net/udp.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_ecache.h>
+#include <linux/netfilter/x_tables.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_crc.h"
+#include "xt_dnp3_packet.h"
+
+
+static int dnp3_mt_check_learn(const struct xt_dnp3_rule *rule);
+static int dnp3_mt_check_mark(const struct xt_dnp3_rule *rule);
+static int dnp3_mt_check_object(const struct xt_dnp3_rule *rule);
+static int dnp3_mt_check_policy(const struct xt_dnp3_rule *rule);
+static int dnp3_mt_check_rate(const struct xt_dnp3_rule *rule);
+VISIBLE_IF_KUNIT int dnp3_mt_check_rule(const struct xt_mtchk_param *par);
+static void dnp3_mt_crc_depth(const struct xt_dnp3_rule *rule, int count);
+VISIBLE_IF_KUNIT void dnp3_mt_destroy_rule(const struct xt_mtdtor_param *par);
+static u32 dnp3_mt_frame_copy(struct skb_seq_state *state, u32 offset, u8 *buffer, u32 copied, u32 len);
+static u8 * dnp3_mt_frame_read(struct skb_seq_state *state, u32 offset, u32 len, u8 *buffer, u32 *avail);
+static void dnp3_mt_mark(const struct sk_buff *skb, u32 mark, u32 mask);
+VISIBLE_IF_KUNIT bool dnp3_mt_match_rule(const struct sk_buff *skb, struct xt_action_param *par);
+static void dnp3_mt_parse_payload(const struct sk_buff *skb, u32 offset, u32 len, u32 seq, struct xt_dnp3_stream *stream, struct xt_dnp3_packet *packet);
+static int dnp3_mt_parse_stream(u32 src, u32 dest, struct xt_dnp3_stream *stream, struct skb_seq_state *state, u32 seq, u32 len, u8 *buffer, struct xt_dnp3_packet *packet);
+static bool dnp3_mt_trusted(const struct sk_buff *skb, u32 trust);
+
+
+static char *crc __read_mostly = "slice16";
+module_param(crc, charp, 0400);
+MODULE_PARM_DESC(crc, "CRC engine (table, slice16)");
+
+static int _engine __read_mostly = DNP3_CRC_SLICE16;
+
+static unsigned char ct_safe[32] = { 0x01, 0x81, 0x82 };
+static unsigned int ct_safe_count = 3;
+module_param_array(ct_safe, byte, &ct_safe_count, 0400);
+MODULE_PARM_DESC(ct_safe, "Function codes of messages whose first frame is not validated on trusted flows");
+
+static DEFINE_PER_CPU(struct xt_dnp3_packet, _packet);
+
+
+/*
+    As a packet is parsed once for evaluation against all dnp3 rules, the CRCs of 
+    frames are validated to the greatest depth required by any rule, as tracked 
+    by the count of rules for each validation mode and sample interval. The depth, 
+    together with the shortest sample interval where sampled, is updated as rules 
+    are added and removed - a rule is added before, and removed after, it may be 
+    evaluated against packets - and read without locking in the packet path. The 
+    object headers of frames are likewise only decoded while rules with object 
+    header constraints are loaded, and the sessions of multi-frame messages only 
+    tracked while rules with function code, policy table or object header 
+    constraints, or which learn function codes, are loaded. The CRC validation 
+    counters of each validation mode for which rules are loaded are updated once 
+    as each packet is parsed, rather than for each rule evaluated.
+*/
+
+static DEFINE_MUTEX(_depth_lock);
+
+static unsigned int _depth_rules[XT_DNP3_CRC_MAX];
+
+static unsigned int _depth_samples[XT_DNP3_CRC_SAMPLE_MAX + 1];
+
+static unsigned int _depth_objects;
+
+static unsigned int _depth_sessions;
+
+static u32 _depth __read_mostly = XT_DNP3_CRC_NONE;
+
+
+/*
+    Where the dnp3_ct_trust sysctl of the network namespace of a packet, set 
+    initially from the ct_trust module parameter, is non-zero, flows whose 
+    connection mark carries all of these bits - as set by rules with the --ct-mark 
+    option upon the match of a fully validated packet - are trusted. Within the 
+    packets of a trusted flow, each frame which is the first frame of a message 
+    with one of the function codes of the ct_safe module parameter, such as the 
+    read requests and responses which make up the bulk of polling traffic, is 
+    parsed without the validation of its CRCs. Every other frame, such as that of 
+    a control or restart command carried in the same segment as a read request, 
+    remains validated, and a flow on which a frame fails validation is no longer 
+    trusted. The function codes of the ct_safe parameter are held as a bitmap.
+*/
+
+static u8 _safe[32];
+
+
+/*
+    A rule with the --learn option records the tuples of the frames of each packet 
+    evaluated against it and matches every such packet, and as such, may only be 
+    combined with the --crc option, which selects the validation of the frames 
+    recorded.
+*/
+
+static int
+dnp3_mt_check_learn(const struct xt_dnp3_rule *rule) {
+    if (!(rule->set & XT_DNP3_FLAG_LEARN)) {
+        return 0;
+    }
+    if (rule->set & ~(XT_DNP3_FLAG_LEARN | XT_DNP3_FLAG_CHECKSUM)) {
+        return -EINVAL;
+    }
+    if (!dnp3_learn_enabled()) {
+        return -EOPNOTSUPP;
+    }
+    return 0;
+}
+
+
+static int
+dnp3_mt_check_mark(const struct xt_dnp3_rule *rule) {
+    if (!(rule->set & XT_DNP3_FLAG_CTMARK)) {
+        return 0;
+    }
+    if (!IS_ENABLED(CONFIG_NF_CONNTRACK_MARK)) {
+        return -EOPNOTSUPP;
+    }
+    if (rule->ctmark & ~rule->ctmask) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+
+static int
+dnp3_mt_check_object(const struct xt_dnp3_rule *rule) {
+    const struct xt_dnp3_object *object;
+    unsigned int index;
+
+    if ((rule->objects > XT_DNP3_OBJECTS) ||
+            ((rule->objects > 0) != !! (rule->set & XT_DNP3_FLAG_OBJECT))) {
+        return -EINVAL;
+    }
+    for (index = 0; index < rule->objects; ++index) {
+        object = &rule->object[index];
+        if ((object->flags & ~XT_DNP3_OBJECT_MASK) ||
+                (object->index[0] > object->index[1])) {
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+
+static int
+dnp3_mt_check_policy(const struct xt_dnp3_rule *rule) {
+    if (!(rule->set & XT_DNP3_FLAG_POLICY)) {
+        return 0;
+    }
+    if ((rule->policy[0] == '\0') ||
+            (strnlen(rule->policy, XT_DNP3_POLICY_NAME) == XT_DNP3_POLICY_NAME)) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+
+static int
+dnp3_mt_check_rate(const struct xt_dnp3_rule *rule) {
+    if (!(rule->set & XT_DNP3_FLAG_RATE)) {
+        return 0;
+    }
+    if ((rule->interval == 0) ||
+            (rule->burst == 0) ||
+            (rule->burst > XT_DNP3_RATE_BURST_MAX) ||
+            (rule->per >= XT_DNP3_RATE_MAX)) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+
+VISIBLE_IF_KUNIT int
+dnp3_mt_check_rule(const struct xt_mtchk_param *par) {
+    struct xt_dnp3_rule *rule = par->matchinfo;
+    int ret;
+    
+    if ((rule->set & ~XT_DNP3_FLAG_MASK) ||
+            (rule->invert & ~XT_DNP3_FLAG_MASK) ||
+            (rule->invert & (XT_DNP3_FLAG_CHECKSUM | XT_DNP3_FLAG_EVENT | XT_DNP3_FLAG_CTMARK | XT_DNP3_FLAG_LEARN)) ||
+            (rule->crc >= XT_DNP3_CRC_MAX) ||
+            (rule->sample > XT_DNP3_CRC_SAMPLE_MAX) ||
+            (dnp3_mt_check_object(rule) != 0) ||
+            (dnp3_mt_check_policy(rule) != 0) ||
+            (dnp3_mt_check_rate(rule) != 0)) {
+        return -EINVAL;
+    }
+    if (((ret = dnp3_mt_check_learn(rule)) != 0) ||
+            ((ret = dnp3_mt_check_mark(rule)) != 0)) {
+        return ret;
+    }
+
+    /*
+        The object header constraints of a rule are compiled, and the matcher of 
+        the rule selected, once as the rule is loaded, such that the structure of 
+        the rule is not interpreted for each packet against which the rule is 
+        matched.
+    */
+
+    rule->program = NULL;
+    rule->table = NULL;
+    rule->rate = NULL;
+    dnp3_packet_select(rule);
+    if (rule->set & XT_DNP3_FLAG_OBJECT) {
+        if (!(rule->program = kmalloc(sizeof(*rule->program), GFP_KERNEL))) {
+            return -ENOMEM;
+        }
+        dnp3_object_compile(rule, rule->program);
+    }
+
+    /*
+        A rule holds a reference to the policy table which it names within the 
+        network namespace of the rule, such that the table is resolved once as the 
+        rule is loaded rather than for each packet.
+    */
+
+    if (rule->set & XT_DNP3_FLAG_POLICY) {
+        if (!(rule->table = dnp3_genl_table_get(par->net, rule->policy))) {
+            ret = -ENOMEM;
+            goto error;
+        }
+    }
+
+    /*
+        The token buckets of a rate limited rule are held for the lifetime of the 
+        rule, and are therefore reset where the rule is replaced.
+    */
+
+    if (rule->set & XT_DNP3_FLAG_RATE) {
+        if (!(rule->rate = kzalloc(sizeof(*rule->rate), GFP_KERNEL))) {
+            ret = -ENOMEM;
+            goto error;
+        }
+        rule->rate->interval = (u64) rule->interval * NSEC_PER_USEC;
+        rule->rate->tolerance = (u64) (rule->burst - 1) * rule->rate->interval;
+    }
+
+    /*
+        A rule which sets the connection mark holds a reference to connection 
+        tracking within the network namespace of the rule, such that connection 
+        tracking entries are created for the packets against which it is matched.
+    */
+
+    if (rule->set & XT_DNP3_FLAG_CTMARK) {
+        if ((ret = nf_ct_netns_get(par->net, par->family)) < 0) {
+            goto error;
+        }
+    }
+    dnp3_mt_crc_depth(rule, 1);
+    return 0;
+
+error:
+    kfree(rule->rate);
+    if (rule->table) {
+        dnp3_genl_table_put(rule->table);
+    }
+    kfree(rule->program);
+    return ret;
+}
+EXPORT_SYMBOL_IF_KUNIT(dnp3_mt_check_rule);
+
+
+static void
+dnp3_mt_crc_depth(const struct xt_dnp3_rule *rule, int count) {
+    u8 depth, mode, modes, sample;
+
+    mode = dnp3_packet_crc(rule);
+    sample = 0;
+
+    mutex_lock(&_depth_lock);
+    _depth_rules[mode] += count;
+    if (mode == XT_DNP3_CRC_SAMPLE) {
+        _depth_samples[rule->sample] += count;
+    }
+    if (rule->set & XT_DNP3_FLAG_OBJECT) {
+        _depth_objects += count;
+    }
+    if (rule->set & (XT_DNP3_FLAG_FC | XT_DNP3_FLAG_POLICY | XT_DNP3_FLAG_OBJECT | XT_DNP3_FLAG_LEARN)) {
+        _depth_sessions += count;
+    }
+
+    if (_depth_rules[XT_DNP3_CRC_FULL] > 0) {
+        depth = XT_DNP3_CRC_FULL;
+    }
+    else if (_depth_rules[XT_DNP3_CRC_SAMPLE] > 0) {
+        depth = XT_DNP3_CRC_SAMPLE;
+        while (_depth_samples[sample] == 0) {
+            ++sample;
+        }
+    }
+    else if (_depth_rules[XT_DNP3_CRC_HEADER] > 0) {
+        depth = XT_DNP3_CRC_HEADER;
+    }
+    else {
+        depth = XT_DNP3_CRC_NONE;
+    }
+    modes = 0;
+    for (mode = 0; mode < XT_DNP3_CRC_MAX; ++mode) {
+        if (_depth_rules[mode] > 0) {
+            modes |= (1 << mode);
+        }
+    }
+    WRITE_ONCE(_depth, depth | 
+            (sample << 8) | 
+            ((_depth_objects > 0) << 16) | 
+            ((_depth_sessions > 0) << 17) | 
+            ((u32) modes << 24));
+    mutex_unlock(&_depth_lock);
+}
+
+
+#if IS_ENABLED(CONFIG_KUNIT)
+u32
+dnp3_mt_depth(void) {
+    return READ_ONCE(_depth);
+}
+EXPORT_SYMBOL_IF_KUNIT(dnp3_mt_depth);
+#endif
+
+
+VISIBLE_IF_KUNIT void
+dnp3_mt_destroy_rule(const struct xt_mtdtor_param *par) {
+    struct xt_dnp3_rule *rule = par->matchinfo;
+
+    dnp3_mt_crc_depth(rule, -1);
+    if (rule->set & XT_DNP3_FLAG_CTMARK) {
+        nf_ct_netns_put(par->net, par->family);
+    }
+    kfree(rule->program);
+    kfree(rule->rate);
+    if (rule->table) {
+        dnp3_genl_table_put(rule->table);
+    }
+}
+EXPORT_SYMBOL_IF_KUNIT(dnp3_mt_destroy_rule);
+
+
+static u32
+dnp3_mt_frame_copy(struct skb_seq_state *state, 
+        u32 offset, 
+        u8 *buffer, 
+        u32 copied, 
+        u32 len) {
+    const u8 *data;
+    u32 bytes;
+
+    while (copied < len) {
+        if ((bytes = skb_seq_read(offset + copied, &data, state)) == 0) {
+            break;
+        }
+        bytes = min(bytes, len - copied);
+        memcpy(&buffer[copied], data, bytes);
+        copied += bytes;
+    }
+    return copied;
+}
+
+
+/*
+    This function returns a pointer to a contiguous view of the DNP3 frame located 
+    at offset bytes into the packet payload, where len is the number of payload bytes 
+    remaining from this offset. The number of bytes available in this view, which is 
+    no greater than the frame length, is returned in avail. 
+
+    Where the frame is held entirely within a single linear or paged fragment of the 
+    socket buffer, a pointer into this fragment is returned without copying. Only 
+    where the frame straddles fragments - as may be the case for packets coalesced 
+    by GRO/LRO - is the frame copied into the bounce buffer supplied by the caller.
+*/
+
+static u8 *
+dnp3_mt_frame_read(struct skb_seq_state *state, 
+        u32 offset, 
+        u32 len, 
+        u8 *buffer, 
+        u32 *avail) {
+    const u8 *data;
+    u32 bytes, copied, length;
+
+    if ((bytes = skb_seq_read(offset, &data, state)) == 0) {
+        return NULL;
+    }
+    bytes = min(bytes, len);
+
+    if (bytes >= DNP3_LINK_HDR_LENGTH) {
+        length = min(dnp3_packet_length(data[2]), len);
+        if (bytes >= length) {
+            *avail = length;
+            return (u8 *) data;
+        }
+        copied = 0;
+    }
+    else {
+        memcpy(buffer, data, bytes);
+        copied = dnp3_mt_frame_copy(state, offset, buffer, bytes, min_t(u32, DNP3_LINK_HDR_LENGTH, len));
+        if (copied < DNP3_LINK_HDR_LENGTH) {
+            *avail = copied;
+            return buffer;
+        }
+        length = min(dnp3_packet_length(buffer[2]), len);
+    }
+
+    *avail = dnp3_mt_frame_copy(state, offset, buffer, copied, length);
+    return buffer;
+}
+
+
+/*
+    This function updates the connection mark of the connection of a packet with 
+    the bits of mark under mask, in the manner of the CONNMARK target, and may be 
+    called both from the match of a rule and to withdraw the trust of a flow.
+*/
+
+static void
+dnp3_mt_mark(const struct sk_buff *skb, u32 mark, u32 mask) {
+#if IS_ENABLED(CONFIG_NF_CONNTRACK_MARK)
+    enum ip_conntrack_info ctinfo;
+    struct nf_conn *ct;
+    u32 value;
+
+    if (!(ct = nf_ct_get(skb, &ctinfo))) {
+        return;
+    }
+    value = (READ_ONCE(ct->mark) & ~mask) | mark;
+    if (READ_ONCE(ct->mark) != value) {
+        WRITE_ONCE(ct->mark, value);
+        nf_conntrack_event_cache(IPCT_MARK, ct);
+    }
+#endif
+}
+
+
+VISIBLE_IF_KUNIT bool
+dnp3_mt_match_rule(const struct sk_buff *skb, struct xt_action_param *par) {
+    const struct xt_dnp3_rule *rule = par->matchinfo;
+    struct xt_dnp3_packet *packet;
+    struct xt_dnp3_net *dnet;
+    unsigned int recseq;
+    u32 depth, mode;
+    bool ret;
+
+    if (par->fragoff != 0) {
+        return false;
+    }
+
+    /*
+        A packet is parsed once for each traversal of an x_tables table, with the 
+        result held in a per-CPU cache such that subsequent dnp3 rules evaluated 
+        against the same packet need only compare fields. The cache is keyed on 
+        the socket buffer and the per-CPU x_tables recursion sequence, which is 
+        odd for the duration of a table traversal and incremented on each, such 
+        that a socket buffer address reused for another packet within a later 
+        traversal does not return a stale result. Where this match is evaluated 
+        outside of an x_tables traversal, such as through nft_compat, the sequence 
+        is even and the packet is parsed for each evaluation. Bottom halves are 
+        disabled for the use of the per-CPU cache, as they are already within an 
+        x_tables traversal but not necessarily through nft_compat.
+    */
+
+    local_bh_disable();
+    dnet = dnp3_net_enter(xt_net(par));
+    packet = this_cpu_ptr(&_packet);
+    recseq = __this_cpu_read(xt_recseq.sequence);
+    if ((!(recseq & 1)) ||
+            (packet->skb != skb) ||
+            (packet->recseq != recseq) ||
+            (packet->len != skb->len)) {
+        depth = READ_ONCE(_depth);
+        packet->depth = depth & 0xff;
+        packet->sample = (depth >> 8) & 0xff;
+        packet->inspect = (depth >> 16) & 1;
+        packet->sessions = (depth >> 17) & 1;
+        dnp3_mt_parse_packet(skb, par->thoff, packet);
+        packet->skb = skb;
+        packet->recseq = recseq;
+        packet->len = skb->len;
+
+        for (mode = 0; mode < XT_DNP3_CRC_MAX; ++mode) {
+            if (depth & (1 << (mode + 24))) {
+                dnp3_packet_count(packet, 
+                        mode, 
+                        packet->sample, 
+                        &this_cpu_ptr(dnet->stats)->crc[mode]);
+            }
+        }
+    }
+    if (rule->set & XT_DNP3_FLAG_LEARN) {
+        dnp3_learn_record(dnet, skb, packet);
+        ret = true;
+    }
+    else {
+        ret = dnp3_packet_match(rule, packet, &par->hotdrop);
+    }
+    if ((ret) &&
+            (rule->set & XT_DNP3_FLAG_CTMARK)) {
+        dnp3_mt_mark(skb, rule->ctmark, rule->ctmask);
+    }
+    if ((rule->set & XT_DNP3_FLAG_EVENT) &&
+            ((ret) || (par->hotdrop))) {
+        dnp3_event_write(dnet, 
+                skb, 
+                par->thoff, 
+                packet, 
+                rule->event, 
+                ret ? XT_DNP3_EVENT_MATCH : XT_DNP3_EVENT_HOTDROP);
+    }
+    local_bh_enable();
+
+    return ret;
+}
+EXPORT_SYMBOL_IF_KUNIT(dnp3_mt_match_rule);
+
+
+void
+dnp3_mt_parse_packet(const struct sk_buff *skb, 
+        u32 thoff, 
+        struct xt_dnp3_packet *packet) {
+    const struct iphdr *iph = ip_hdr(skb);
+    struct xt_dnp3_stream *stream;
+    const struct tcphdr *tcph;
+    struct tcphdr _tcph;
+    u32 index, offset, seq, trust;
+    u64 start;
+
+    dnp3_packet_reset(packet);
+    dnp3_stats_inc(XT_DNP3_STAT_PACKETS);
+    stream = NULL;
+    seq = 0;
+
+    switch (iph->protocol) {
+        case IPPROTO_TCP:
+            if (!(tcph = skb_header_pointer(skb, thoff, sizeof(_tcph), &_tcph))) {
+                dnp3_stats_inc(XT_DNP3_STAT_TRUNCATED);
+                packet->hotdrop = true;
+                return;
+            }
+            offset = thoff + (tcph->doff * 4);
+            seq = ntohl(tcph->seq);
+            stream = dnp3_flow_stream(skb);
+            packet->session = stream;
+            break;
+        case IPPROTO_UDP:
+            offset = thoff + sizeof(struct udphdr);
+            break;
+        default:
+            return;
+    }
+
+    if (offset > skb->len) {
+        return;
+    }
+    trust = READ_ONCE(__this_cpu_read(dnp3_net_current)->ct_trust);
+    if (dnp3_mt_trusted(skb, trust)) {
+        packet->safe = _safe;
+        dnp3_stats_inc(XT_DNP3_STAT_TRUSTED);
+    }
+    if (static_branch_unlikely(&dnp3_histogram)) {
+        start = ktime_get_ns();
+        dnp3_mt_parse_payload(skb, offset, skb->len - offset, seq, stream, packet);
+        dnp3_stats_latency(ktime_get_ns() - start, packet);
+    }
+    else {
+        dnp3_mt_parse_payload(skb, offset, skb->len - offset, seq, stream, packet);
+    }
+
+    if (!trust) {
+        return;
+    }
+    for (index = 0; index < packet->count; ++index) {
+        if (packet->frame[index].crc & (XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD)) {
+            dnp3_mt_mark(skb, 0, trust);
+            break;
+        }
+    }
+}
+
+
+static void
+dnp3_mt_parse_payload(const struct sk_buff *skb, 
+        u32 offset, 
+        u32 len, 
+        u32 seq, 
+        struct xt_dnp3_stream *stream, 
+        struct xt_dnp3_packet *packet) {
+    const struct iphdr *iph = ip_hdr(skb);
+    struct skb_seq_state state;
+    struct xt_dnp3_frame frame;
+    u8 buffer[DNP3_LINK_FRAME_MAX];
+    u8 *payload;
+    u32 avail, consumed, dest, src;
+    int length, ret;
+
+    src = ntohl(iph->saddr);
+    dest = ntohl(iph->daddr);
+
+    /*
+        Where no reassembly state is held for the connection and the payload is 
+        contained within the linear data of the socket buffer, the payload is 
+        parsed directly.
+    */
+
+    if ((!stream) &&
+            ((offset + len) <= skb_headlen(skb))) {
+        dnp3_packet_parse(packet, src, dest, skb->data + offset, len, _engine);
+        return;
+    }
+
+    /*
+        The packet payload is walked in place across the linear, paged and frag_list 
+        data of the socket buffer, such that each frame of a packet coalesced by 
+        GRO/LRO, or of a GSO packet awaiting segmentation, is validated.
+    */
+
+    skb_prepare_seq_read((struct sk_buff *) skb, offset, offset + len, &state);
+    consumed = 0;
+    packet->valid = true;
+
+    if ((stream) &&
+            (len > 0)) {
+        spin_lock_bh(&stream->lock);
+        if ((length = dnp3_mt_parse_stream(src, dest, stream, &state, seq, len, buffer, packet)) < 0) {
+            packet->valid = false;
+        }
+        else {
+            consumed = length;
+        }
+    }
+
+    for (; (packet->valid) && (consumed < len); consumed += length) {
+        if ((!(payload = dnp3_mt_frame_read(&state, consumed, len - consumed, buffer, &avail))) ||
+                ((length = dnp3_packet_frame(packet, src, dest, payload, avail, _engine, &frame)) < 0)) {
+            packet->valid = false;
+            break;
+        }
+        if (dnp3_packet_add(packet, &frame) != 0) {
+            packet->valid = false;
+            packet->hotdrop = true;
+            break;
+        }
+
+        /*
+            A frame which extends beyond the end of the payload is held for 
+            reassembly with the following segment of the TCP stream, where the dnp3 
+            connection tracking helper has been assigned to this connection.
+        */
+
+        if (avail < length) {
+            if ((!stream) ||
+                    (avail != (len - consumed))) {
+                dnp3_stats_inc(XT_DNP3_STAT_TRUNCATED);
+                packet->valid = false;
+            }
+            else if ((ret = dnp3_flow_hold(stream, seq + consumed, payload, avail)) != 0) {
+                dnp3_stats_inc((ret == -ENOMEM) ? XT_DNP3_STAT_NOMEM : XT_DNP3_STAT_TRUNCATED);
+                packet->valid = false;
+            }
+            else {
+                dnp3_stats_inc(XT_DNP3_STAT_HELD);
+            }
+            break;
+        }
+    }
+
+    if ((stream) &&
+            (len > 0)) {
+        spin_unlock_bh(&stream->lock);
+    }
+    skb_abort_seq_read(&state);
+}
+
+
+/*
+    This function parses the leading bytes of a TCP segment which continue a 
+    partial frame held from the preceding segment of the stream, returning the 
+    number of bytes of the segment consumed in completing this frame or -1 where 
+    the frame is invalid. 
+
+    As a segment may be evaluated within more than one table, or retransmitted, a 
+    summary of the frame continued by a segment is retained in order that 
+    subsequent evaluations of the same segment can be parsed without the partial 
+    frame, which is released once completed.
+*/
+
+static int
+dnp3_mt_parse_stream(u32 src, 
+        u32 dest, 
+        struct xt_dnp3_stream *stream, 
+        struct skb_seq_state *state, 
+        u32 seq, 
+        u32 len, 
+        u8 *buffer, 
+        struct xt_dnp3_packet *packet) {
+    u32 copied, held, length, total;
+    int ret;
+
+    dnp3_flow_expire(stream);
+
+    if ((!stream->buffer) ||
+            (seq != (stream->seq + stream->len))) {
+        if ((stream->consumed == 0) ||
+                (seq != stream->next)) {
+            return 0;
+        }
+        if (dnp3_packet_add(packet, &stream->frame) != 0) {
+            packet->hotdrop = true;
+            return -1;
+        }
+        return min_t(u32, stream->consumed, len);
+    }
+
+    held = stream->len;
+    memcpy(buffer, stream->buffer, held);
+    copied = 0;
+    if (held < DNP3_LINK_HDR_LENGTH) {
+        copied = dnp3_mt_frame_copy(state, 0, buffer + held, 0, 
+                min_t(u32, DNP3_LINK_HDR_LENGTH - held, len));
+    }
+    if ((held + copied) >= DNP3_LINK_HDR_LENGTH) {
+        length = dnp3_packet_length(buffer[2]);
+        copied = dnp3_mt_frame_copy(state, 0, buffer + held, copied, 
+                min_t(u32, length - held, len));
+    }
+    total = held + copied;
+
+    if ((ret = dnp3_packet_frame(packet, src, dest, buffer, total, _engine, &stream->frame)) < 0) {
+        stream->consumed = 0;
+        return -1;
+    }
+    length = ret;
+    stream->next = seq;
+    stream->consumed = copied;
+    if (dnp3_packet_add(packet, &stream->frame) != 0) {
+        packet->hotdrop = true;
+        return -1;
+    }
+
+    /*
+        The object headers of the completed frame are decoded into the packet 
+        being parsed and are not retained with the summary of the frame, such that 
+        subsequent evaluations of the same segment do not match rules with object 
+        header constraints.
+    */
+
+    stream->frame.flags &= ~XT_DNP3_FRAME_OBJECTS;
+
+    if (total < length) {
+        memcpy(&stream->buffer[held], &buffer[held], copied);
+        stream->len = total;
+        dnp3_stats_inc(XT_DNP3_STAT_HELD);
+    }
+    else {
+        dnp3_flow_release(stream);
+    }
+    return copied;
+}
+
+
+/*
+    This function returns true where the packet is of a flow trusted by the bits 
+    of trust.
+*/
+
+static bool
+dnp3_mt_trusted(const struct sk_buff *skb, u32 trust) {
+#if IS_ENABLED(CONFIG_NF_CONNTRACK_MARK)
+    enum ip_conntrack_info ctinfo;
+    const struct nf_conn *ct;
+
+    return ((trust) &&
+            ((ct = nf_ct_get(skb, &ctinfo)) != NULL) &&
+            ((READ_ONCE(ct->mark) & trust) == trust));
+#else
+    return false;
+#endif
+}
+
+
+static struct xt_match dnp3_mt_reg[] __read_mostly = {
+    {
+        .name       = "dnp3",
+        .family     = NFPROTO_IPV4,
+        .checkentry = dnp3_mt_check_rule,
+        .destroy    = dnp3_mt_destroy_rule,
+        .match      = dnp3_mt_match_rule,
+        .matchsize  = sizeof(struct xt_dnp3_rule),
+        .usersize   = offsetof(struct xt_dnp3_rule, program),
+        .me         = THIS_MODULE,
+    },
+};
+
+
+static int __init
+dnp3_mt_init(void) {
+    struct xt_dnp3_packet *packet;
+    unsigned int index;
+    int ret;
+
+    if (sysfs_streq(crc, "table")) {
+        _engine = DNP3_CRC_TABLE;
+    }
+    else if (sysfs_streq(crc, "slice16")) {
+        _engine = DNP3_CRC_SLICE16;
+    }
+    else {
+        pr_err("xt_dnp3: unknown CRC engine '%s'\n", crc);
+        return -EINVAL;
+    }
+    dnp3_crc_init();
+
+    for (index = 0; index < ct_safe_count; ++index) {
+        _safe[ct_safe[index] / 8] |= (1 << (ct_safe[index] % 8));
+    }
+
+    for_each_possible_cpu(index) {
+        packet = per_cpu_ptr(&_packet, index);
+        packet->frame = packet->frames;
+        packet->size = XT_DNP3_FRAMES;
+    }
+
+    dnp3_event_init();
+    dnp3_learn_init();
+
+    if ((ret = dnp3_stats_init()) != 0) {
+        return ret;
+    }
+    if ((ret = dnp3_session_init()) != 0) {
+        goto error_session;
+    }
+    if ((ret = dnp3_net_init()) != 0) {
+        goto error_net;
+    }
+    if ((ret = dnp3_flow_init()) != 0) {
+        goto error_flow;
+    }
+    if ((ret = dnp3_genl_init()) != 0) {
+        goto error_genl;
+    }
+    if ((ret = xt_register_matches(dnp3_mt_reg, ARRAY_SIZE(dnp3_mt_reg))) != 0) {
+        goto error_register;
+    }
+    if ((ret = dnp3_nft_init()) != 0) {
+        goto error_nft;
+    }
+    return 0;
+
+error_nft:
+    xt_unregister_matches(dnp3_mt_reg, ARRAY_SIZE(dnp3_mt_reg));
+error_register:
+    dnp3_genl_exit();
+error_genl:
+    dnp3_flow_exit();
+error_flow:
+    dnp3_net_exit();
+error_net:
+    dnp3_session_exit();
+error_session:
+    dnp3_stats_exit();
+    return ret;
+}
+
+
+static void __exit
+dnp3_mt_exit(void) {
+    struct xt_dnp3_packet *packet;
+    unsigned int index;
+
+    dnp3_nft_exit();
+    xt_unregister_matches(dnp3_mt_reg, ARRAY_SIZE(dnp3_mt_reg));
+    dnp3_genl_exit();
+    dnp3_flow_exit();
+    dnp3_net_exit();
+    dnp3_session_exit();
+    dnp3_stats_exit();
+
+    for_each_possible_cpu(index) {
+        packet = per_cpu_ptr(&_packet, index);
+        if (packet->frame != packet->frames) {
+            kfree(packet->frame);
+        }
+    }
+}
+
+
+module_init(dnp3_mt_init);
+module_exit(dnp3_mt_exit);
+
+MODULE_AUTHOR("Rob Casey <rcasey@gmail.com>");
+MODULE_LICENSE("GPL");
+
@@ -0,0 +1,214 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/sysctl.h>
+#include <kunit/visibility.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
+
+#include "xt_dnp3.h"
+
+
+static int dnp3_net_create(struct net *net);
+static void dnp3_net_destroy(struct net *net);
+static void dnp3_net_sysctl_exit(struct xt_dnp3_net *dnet);
+static int dnp3_net_sysctl_init(struct net *net, struct xt_dnp3_net *dnet);
+
+
+static unsigned int sessions __read_mostly = XT_DNP3_SESSIONS;
+module_param(sessions, uint, 0400);
+MODULE_PARM_DESC(sessions, "Maximum number of concurrent multi-frame sessions of each network namespace");
+
+static unsigned int session_timeout __read_mostly = XT_DNP3_SESSION_TIMEOUT;
+module_param(session_timeout, uint, 0400);
+MODULE_PARM_DESC(session_timeout, "Initial timeout for multi-frame sessions after the most recent frame (ms)");
+
+static unsigned int ct_trust __read_mostly = 0;
+module_param(ct_trust, uint, 0400);
+MODULE_PARM_DESC(ct_trust, "Initial connection mark bits of flows validated by --ct-mark rules (0 disables)");
+
+
+/*
+    The state of each network namespace is allocated with the namespace, with the
+    module parameters above the initial values of the tunables of the namespace,
+    which may then be changed within the namespace through the dnp3_sessions,
+    dnp3_session_timeout, dnp3_ct_trust and dnp3_streams sysctls of net.netfilter.
+    The number of buckets of the session table and of application fragment
+    buffers of each namespace are fixed by the sessions and apdus module
+    parameters, while the dnp3_sessions and dnp3_streams sysctls bound the
+    sessions and partial frames held.
+*/
+
+unsigned int dnp3_net_id __read_mostly;
+EXPORT_SYMBOL_IF_KUNIT(dnp3_net_id);
+
+DEFINE_PER_CPU(struct xt_dnp3_net *, dnp3_net_current);
+
+static struct pernet_operations _net_ops = {
+    .init   = dnp3_net_create,
+    .exit   = dnp3_net_destroy,
+    .id     = &dnp3_net_id,
+    .size   = sizeof(struct xt_dnp3_net),
+};
+
+#ifdef CONFIG_SYSCTL
+static const struct ctl_table _sysctl[] = {
+    {
+        .procname       = "dnp3_sessions",
+        .maxlen         = sizeof(unsigned int),
+        .mode           = 0644,
+        .proc_handler   = proc_douintvec_minmax,
+        .extra1         = SYSCTL_ONE,
+    },
+    {
+        .procname       = "dnp3_session_timeout",
+        .maxlen         = sizeof(unsigned int),
+        .mode           = 0644,
+        .proc_handler   = proc_douintvec,
+    },
+    {
+        .procname       = "dnp3_ct_trust",
+        .maxlen         = sizeof(unsigned int),
+        .mode           = 0644,
+        .proc_handler   = proc_douintvec,
+    },
+    {
+        .procname       = "dnp3_streams",
+        .maxlen         = sizeof(unsigned int),
+        .mode           = 0644,
+        .proc_handler   = proc_douintvec,
+    },
+};
+#endif
+
+
+static int
+dnp3_net_create(struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+    int ret;
+
+    dnet->sessions = sessions;
+    dnet->session_timeout = session_timeout;
+    dnet->ct_trust = ct_trust;
+    if (!(dnet->stats = alloc_percpu(struct xt_dnp3_stats))) {
+        return -ENOMEM;
+    }
+    if ((ret = dnp3_session_net_init(dnet)) != 0) {
+        goto error_session;
+    }
+    if ((ret = dnp3_apdu_net_init(dnet)) != 0) {
+        goto error_apdu;
+    }
+    if ((ret = dnp3_flow_net_init(dnet)) != 0) {
+        goto error_flow;
+    }
+    if ((ret = dnp3_stats_net_init(net)) != 0) {
+        goto error_stats;
+    }
+    if ((ret = dnp3_event_net_init(net)) != 0) {
+        goto error_event;
+    }
+    if ((ret = dnp3_learn_net_init(net)) != 0) {
+        goto error_learn;
+    }
+    if ((ret = dnp3_net_sysctl_init(net, dnet)) != 0) {
+        goto error_sysctl;
+    }
+    return 0;
+
+error_sysctl:
+    dnp3_learn_net_exit(net);
+error_learn:
+    dnp3_event_net_exit(net);
+error_event:
+    dnp3_stats_net_exit(net);
+error_stats:
+    dnp3_flow_net_exit(net);
+error_flow:
+    dnp3_apdu_net_exit(dnet);
+error_apdu:
+    dnp3_session_net_exit(dnet);
+error_session:
+    free_percpu(dnet->stats);
+    return ret;
+}
+
+
+/*
+    No packet of a namespace is evaluated as it is destroyed, but the connection
+    tracking entries of the namespace are released only after this function, as
+    the pernet operations of nf_conntrack were registered before those of this
+    module. The partial frames and sessions held with the reassembly state of these
+    connections are therefore released here, before the buffers of the namespace,
+    such that the destroy callback of the dnp3 helper no longer refers to the state
+    of the namespace.
+*/
+
+static void
+dnp3_net_destroy(struct net *net) {
+    struct xt_dnp3_net *dnet = dnp3_net(net);
+
+    dnp3_net_sysctl_exit(dnet);
+    dnp3_genl_net_exit(net);
+    dnp3_learn_net_exit(net);
+    dnp3_event_net_exit(net);
+    dnp3_stats_net_exit(net);
+    dnp3_flow_net_exit(net);
+
+    local_bh_disable();
+    dnp3_net_enter(net);
+    dnp3_session_net_exit(dnet);
+    local_bh_enable();
+
+    dnp3_apdu_net_exit(dnet);
+    free_percpu(dnet->stats);
+}
+
+
+void
+dnp3_net_exit(void) {
+    unregister_pernet_subsys(&_net_ops);
+}
+
+
+int __init
+dnp3_net_init(void) {
+    if (sessions == 0) {
+        return -EINVAL;
+    }
+    return register_pernet_subsys(&_net_ops);
+}
+
+
+static void
+dnp3_net_sysctl_exit(struct xt_dnp3_net *dnet) {
+#ifdef CONFIG_SYSCTL
+    const struct ctl_table *table;
+
+    table = dnet->sysctl->ctl_table_arg;
+    unregister_net_sysctl_table(dnet->sysctl);
+    kfree(table);
+#endif
+}
+
+
+static int
+dnp3_net_sysctl_init(struct net *net, struct xt_dnp3_net *dnet) {
+#ifdef CONFIG_SYSCTL
+    struct ctl_table *table;
+
+    if (!(table = kmemdup(_sysctl, sizeof(_sysctl), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+    table[0].data = &dnet->sessions;
+    table[1].data = &dnet->session_timeout;
+    table[2].data = &dnet->ct_trust;
+    table[3].data = &dnet->streams;
+    if (!(dnet->sysctl = register_net_sysctl_sz(net, "net/netfilter", table, ARRAY_SIZE(_sysctl)))) {
+        kfree(table);
+        return -ENOMEM;
+    }
+#endif
+    return 0;
+}
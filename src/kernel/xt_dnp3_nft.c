@@ -0,0 +1,271 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <net/ip.h>
+#include <net/tcp.h>
+#include <net/udp.h>
+#include <net/netfilter/nf_tables.h>
+
+#include "xt_dnp3.h"
+
+
+struct nft_dnp3 {
+    u8 key;                             /* Field */
+    u8 dreg;                            /* Destination register */
+};
+
+
+static int nft_dnp3_dump(struct sk_buff *skb, const struct nft_expr *expr, bool reset);
+static void nft_dnp3_eval(const struct nft_expr *expr, struct nft_regs *regs, const struct nft_pktinfo *pkt);
+static int nft_dnp3_init(const struct nft_ctx *ctx, const struct nft_expr *expr, const struct nlattr * const tb[]);
+static int nft_dnp3_load(u8 key, const struct xt_dnp3_packet *packet, u32 *dest);
+
+
+/*
+    Unlike x_tables, nf_tables provides no per-traversal sequence with which the 
+    parsed form of a packet may be cached for evaluation by subsequent dnp3 
+    expressions - such as within concatenations of dnp3 fields. The per-CPU cache 
+    for these expressions is instead keyed on the socket buffer together with its 
+    length, the IP identification and header checksum and the TCP sequence number 
+    or UDP checksum, such that a socket buffer address reused for a different 
+    packet is parsed afresh. As the IP header checksum changes with the TTL, a 
+    forwarded packet is parsed once at each hook at which it is evaluated. All 
+    CRCs of each frame are validated for these expressions.
+*/
+
+static DEFINE_PER_CPU(struct xt_dnp3_packet, _packet);
+
+static const struct nla_policy nft_dnp3_policy[NFTA_DNP3_MAX + 1] = {
+    [NFTA_DNP3_DREG]    = { .type = NLA_U32 },
+    [NFTA_DNP3_KEY]     = NLA_POLICY_MAX(NLA_BE32, __NFT_DNP3_MAX - 1),
+};
+
+static struct nft_expr_type nft_dnp3_type;
+
+static const struct nft_expr_ops nft_dnp3_ops = {
+    .type       = &nft_dnp3_type,
+    .size       = NFT_EXPR_SIZE(sizeof(struct nft_dnp3)),
+    .eval       = nft_dnp3_eval,
+    .init       = nft_dnp3_init,
+    .dump       = nft_dnp3_dump,
+};
+
+static struct nft_expr_type nft_dnp3_type __read_mostly = {
+    .name       = "dnp3",
+    .ops        = &nft_dnp3_ops,
+    .policy     = nft_dnp3_policy,
+    .maxattr    = NFTA_DNP3_MAX,
+    .owner      = THIS_MODULE,
+};
+
+
+void
+dnp3_nft_exit(void) {
+    struct xt_dnp3_packet *packet;
+    unsigned int cpu;
+
+    nft_unregister_expr(&nft_dnp3_type);
+
+    for_each_possible_cpu(cpu) {
+        packet = per_cpu_ptr(&_packet, cpu);
+        if (packet->frame != packet->frames) {
+            kfree(packet->frame);
+        }
+    }
+}
+
+
+int __init
+dnp3_nft_init(void) {
+    struct xt_dnp3_packet *packet;
+    unsigned int cpu;
+
+    for_each_possible_cpu(cpu) {
+        packet = per_cpu_ptr(&_packet, cpu);
+        packet->frame = packet->frames;
+        packet->size = XT_DNP3_FRAMES;
+    }
+    return nft_register_expr(&nft_dnp3_type);
+}
+
+
+static int
+nft_dnp3_dump(struct sk_buff *skb, const struct nft_expr *expr, bool reset) {
+    const struct nft_dnp3 *priv = nft_expr_priv(expr);
+
+    if ((nft_dump_register(skb, NFTA_DNP3_DREG, priv->dreg)) ||
+            (nla_put_be32(skb, NFTA_DNP3_KEY, htonl(priv->key)))) {
+        return -1;
+    }
+    return 0;
+}
+
+
+static void
+nft_dnp3_eval(const struct nft_expr *expr, 
+        struct nft_regs *regs, 
+        const struct nft_pktinfo *pkt) {
+    const struct nft_dnp3 *priv = nft_expr_priv(expr);
+    const struct iphdr *iph;
+    struct xt_dnp3_packet *packet;
+    struct sk_buff *skb = pkt->skb;
+    __be32 _seq, *seq;
+    u32 id, offset;
+    int ret;
+
+    if ((nft_pf(pkt) != NFPROTO_IPV4) ||
+            (!(pkt->flags & NFT_PKTINFO_L4PROTO)) ||
+            (pkt->fragoff != 0) ||
+            ((pkt->tprot != IPPROTO_TCP) && (pkt->tprot != IPPROTO_UDP))) {
+        regs->verdict.code = NFT_BREAK;
+        return;
+    }
+
+    iph = ip_hdr(skb);
+    id = ((u32) ntohs(iph->id) << 16) | (__force u16) iph->check;
+    offset = nft_thoff(pkt) + ((pkt->tprot == IPPROTO_TCP) ? 
+            offsetof(struct tcphdr, seq) : 
+            offsetof(struct udphdr, check));
+    if (!(seq = skb_header_pointer(skb, offset, sizeof(_seq), &_seq))) {
+        regs->verdict.code = NFT_BREAK;
+        return;
+    }
+
+    local_bh_disable();
+    dnp3_net_enter(nft_net(pkt));
+    packet = this_cpu_ptr(&_packet);
+    if ((packet->skb != skb) ||
+            (packet->len != skb->len) ||
+            (packet->recseq != id) ||
+            (packet->seq != (__force u32) *seq)) {
+        packet->depth = XT_DNP3_CRC_FULL;
+        packet->sample = 0;
+        packet->inspect = false;
+        packet->sessions = true;
+        dnp3_mt_parse_packet(skb, nft_thoff(pkt), packet);
+        packet->skb = skb;
+        packet->len = skb->len;
+        packet->recseq = id;
+        packet->seq = (__force u32) *seq;
+    }
+    ret = nft_dnp3_load(priv->key, packet, &regs->data[priv->dreg]);
+    local_bh_enable();
+
+    if (ret != 0) {
+        regs->verdict.code = NFT_BREAK;
+    }
+}
+
+
+static int
+nft_dnp3_init(const struct nft_ctx *ctx, 
+        const struct nft_expr *expr, 
+        const struct nlattr * const tb[]) {
+    struct nft_dnp3 *priv = nft_expr_priv(expr);
+    unsigned int len;
+
+    if ((!tb[NFTA_DNP3_DREG]) ||
+            (!tb[NFTA_DNP3_KEY])) {
+        return -EINVAL;
+    }
+    priv->key = ntohl(nla_get_be32(tb[NFTA_DNP3_KEY]));
+    switch (priv->key) {
+        case NFT_DNP3_DADDR:
+        case NFT_DNP3_SADDR:
+            len = sizeof(u16);
+            break;
+        case NFT_DNP3_FC:
+        case NFT_DNP3_TSPT:
+            len = sizeof(u8);
+            break;
+        default:
+            return -EOPNOTSUPP;
+    }
+    return nft_parse_register_store(ctx, tb[NFTA_DNP3_DREG], &priv->dreg, 
+            NULL, NFT_DATA_VALUE, len);
+}
+
+
+/*
+    This function loads the requested field of the frames of a packet, returning 
+    zero where every frame of the packet which carries this field carries the same 
+    value. Where the frames of a packet differ in this field, or no frame carries 
+    this field, the expression does not match - such that a set or verdict map 
+    lookup is performed against a value common to every frame of the packet. A 
+    function code cannot be loaded from the subsequent frame of a multi-frame 
+    message for which no session exists, and such a packet, like a packet which 
+    the match would hotdrop, likewise does not match - as this expression only 
+    loads a field, the drop of such packets is left to the rule set.
+*/
+
+static int
+nft_dnp3_load(u8 key, const struct xt_dnp3_packet *packet, u32 *dest) {
+    const struct xt_dnp3_frame *frame;
+    u32 index, value;
+    bool loaded;
+
+    if ((packet->hotdrop) ||
+            (!packet->valid)) {
+        return -EINVAL;
+    }
+
+    loaded = false;
+    for (index = 0; index < packet->count; ++index) {
+        frame = &packet->frame[index];
+        if (frame->crc & (XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD)) {
+            return -EINVAL;
+        }
+        switch (key) {
+            case NFT_DNP3_DADDR:
+                value = frame->daddr;
+                break;
+            case NFT_DNP3_SADDR:
+                value = frame->saddr;
+                break;
+            case NFT_DNP3_FC:
+                if (frame->flags & (XT_DNP3_FRAME_NOSESSION | XT_DNP3_FRAME_NODATA)) {
+                    return -EINVAL;
+                }
+                if (!(frame->flags & XT_DNP3_FRAME_FC)) {
+                    continue;
+                }
+                value = frame->func;
+                break;
+            case NFT_DNP3_TSPT:
+                if (frame->flags & XT_DNP3_FRAME_NODATA) {
+                    return -EINVAL;
+                }
+                if (!(frame->flags & XT_DNP3_FRAME_TSPT)) {
+                    continue;
+                }
+                value = frame->flags & (XT_DNP3_FRAME_FIRST | XT_DNP3_FRAME_FINAL);
+                break;
+            default:
+                return -EINVAL;
+        }
+        if ((loaded) &&
+                (value != *dest)) {
+            return -EINVAL;
+        }
+        *dest = value;
+        loaded = true;
+    }
+    if (!loaded) {
+        return -EINVAL;
+    }
+
+    switch (key) {
+        case NFT_DNP3_DADDR:
+        case NFT_DNP3_SADDR:
+            nft_reg_store16(dest, (u16) *dest);
+            break;
+        default:
+            nft_reg_store8(dest, (u8) *dest);
+            break;
+    }
+    return 0;
+}
+
+
+MODULE_ALIAS_NFT_EXPR("dnp3");
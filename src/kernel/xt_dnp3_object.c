@@ -0,0 +1,384 @@
+#include "xt_dnp3.h"
+#include "xt_dnp3_packet.h"
+
+
+static inline bool dnp3_object_admit(const struct xt_dnp3_program *program, const struct xt_dnp3_objhdr *objhdr);
+
+static int dnp3_object_bits(u8 func, u8 group, u8 variation);
+
+static __always_inline u8 dnp3_object_byte(const u8 *payload, u32 offset, bool framed);
+
+static __always_inline void dnp3_object_decode(struct xt_dnp3_packet *packet, const u8 *payload, u32 offset, u32 bytes, bool framed, struct xt_dnp3_frame *frame);
+
+static __always_inline u32 dnp3_object_read(const u8 *payload, u32 offset, u32 width, bool framed);
+
+
+/*
+    The size of each object carried within an application fragment is determined 
+    by the group and variation of its object header, and must be known in order to 
+    locate the object header which follows. The sizes below, in bits, are those of 
+    the static, event, output and time objects of the DNP3 object library with a 
+    fixed size - object headers of any other group or variation which carry object 
+    data cannot be walked, and the object headers of such a fragment are not 
+    decoded. Objects of less than eight bits are packed without padding.
+*/
+
+static const struct {
+    u8 group;
+    u8 variation;
+    u8 bits;
+} _sizes[] = {
+    {  1, 1,   1 }, {  1, 2,   8 },
+    {  2, 1,   8 }, {  2, 2,  56 }, {  2, 3,  24 },
+    {  3, 1,   2 }, {  3, 2,   8 },
+    {  4, 1,   8 }, {  4, 2,  56 }, {  4, 3,  24 },
+    { 10, 1,   1 }, { 10, 2,   8 },
+    { 11, 1,   8 }, { 11, 2,  56 },
+    { 12, 1,  88 }, { 12, 2,  88 }, { 12, 3,   1 },
+    { 13, 1,   8 }, { 13, 2,  56 },
+    { 20, 1,  40 }, { 20, 2,  24 }, { 20, 5,  32 }, { 20, 6,  16 },
+    { 21, 1,  40 }, { 21, 2,  24 }, { 21, 5,  88 }, { 21, 6,  72 }, { 21, 9,  32 }, { 21, 10, 16 },
+    { 22, 1,  40 }, { 22, 2,  24 }, { 22, 5,  88 }, { 22, 6,  72 },
+    { 23, 1,  40 }, { 23, 2,  24 }, { 23, 5,  88 }, { 23, 6,  72 },
+    { 30, 1,  40 }, { 30, 2,  24 }, { 30, 3,  32 }, { 30, 4,  16 }, { 30, 5,  40 }, { 30, 6,  72 },
+    { 32, 1,  40 }, { 32, 2,  24 }, { 32, 3,  88 }, { 32, 4,  72 }, { 32, 5,  40 }, { 32, 6,  72 },
+    { 32, 7,  88 }, { 32, 8, 120 },
+    { 34, 1,  16 }, { 34, 2,  32 }, { 34, 3,  32 },
+    { 40, 1,  40 }, { 40, 2,  24 }, { 40, 3,  40 }, { 40, 4,  72 },
+    { 41, 1,  40 }, { 41, 2,  24 }, { 41, 3,  40 }, { 41, 4,  72 },
+    { 50, 1,  48 }, { 50, 2,  80 }, { 50, 3,  48 }, { 50, 4,  88 },
+    { 51, 1,  48 }, { 51, 2,  48 },
+    { 52, 1,  16 }, { 52, 2,  16 },
+    { 80, 1,   1 },
+};
+
+
+static inline bool
+dnp3_object_admit(const struct xt_dnp3_program *program, 
+        const struct xt_dnp3_objhdr *objhdr) {
+    const struct xt_dnp3_clause *clause;
+    unsigned int index;
+    u8 mask;
+
+    mask = program->group[objhdr->group];
+    for (index = 0; mask != 0; ++index, mask >>= 1) {
+        if (!(mask & 1)) {
+            continue;
+        }
+        clause = &program->clause[index];
+        if ((clause->variation[objhdr->variation / 8] & (1 << (objhdr->variation % 8))) &&
+                (clause->qualifier[objhdr->qualifier / 8] & (1 << (objhdr->qualifier % 8))) &&
+                (objhdr->min >= clause->min) &&
+                (objhdr->max <= clause->max) &&
+                (objhdr->count <= clause->count)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+    This function returns the size in bits of each object of the group and 
+    variation specified within a fragment with the function code specified, or -1 
+    where this size is not known. The object headers of requests to read, freeze, 
+    assign class to or enable or disable unsolicited responses for objects, and 
+    those of class data objects, carry no object data.
+*/
+
+static int
+dnp3_object_bits(u8 func, u8 group, u8 variation) {
+    unsigned int index;
+
+    switch (func) {
+        case 1:     /* READ */
+        case 7:     /* IMMED_FREEZE */
+        case 8:     /* IMMED_FREEZE_NR */
+        case 9:     /* FREEZE_CLEAR */
+        case 10:    /* FREEZE_CLEAR_NR */
+        case 20:    /* ENABLE_UNSOLICITED */
+        case 21:    /* DISABLE_UNSOLICITED */
+        case 22:    /* ASSIGN_CLASS */
+            return 0;
+        default:
+            break;
+    }
+    if (group == 60) {
+        return 0;
+    }
+    for (index = 0; index < ARRAY_SIZE(_sizes); ++index) {
+        if ((_sizes[index].group == group) &&
+                (_sizes[index].variation == variation)) {
+            return _sizes[index].bits;
+        }
+    }
+    return -1;
+}
+
+
+/*
+    The application data of a frame is interleaved with a CRC following each data 
+    block of 16 bytes. Where framed, the offsets below are those of the user data 
+    of the frame, commencing with the transport header, from which the position of 
+    each byte within the frame is calculated, and otherwise those of a contiguous 
+    reassembled application fragment.
+*/
+
+static __always_inline u8
+dnp3_object_byte(const u8 *payload, u32 offset, bool framed) {
+    if (!framed) {
+        return payload[offset];
+    }
+    return payload[DNP3_LINK_HDR_LENGTH + offset +
+            ((offset / DNP3_LINK_BLOCK_LENGTH) * DNP3_LINK_CRC_LENGTH)];
+}
+
+
+void
+dnp3_object_compile(const struct xt_dnp3_rule *rule, struct xt_dnp3_program *program) {
+    const struct xt_dnp3_object *object;
+    struct xt_dnp3_clause *clause;
+    unsigned int index;
+
+    memset(program, 0, sizeof(*program));
+    for (index = 0; index < rule->objects; ++index) {
+        object = &rule->object[index];
+        clause = &program->clause[index];
+
+        program->group[object->group] |= (1 << index);
+        if (object->flags & XT_DNP3_OBJECT_VARIATION) {
+            clause->variation[object->variation / 8] |= (1 << (object->variation % 8));
+        }
+        else {
+            memset(clause->variation, 0xff, sizeof(clause->variation));
+        }
+        if (object->flags & XT_DNP3_OBJECT_QUALIFIER) {
+            clause->qualifier[object->qualifier / 8] |= (1 << (object->qualifier % 8));
+        }
+        else {
+            memset(clause->qualifier, 0xff, sizeof(clause->qualifier));
+        }
+        clause->min = (object->flags & XT_DNP3_OBJECT_INDEX) ? object->index[0] : 0;
+        clause->max = (object->flags & XT_DNP3_OBJECT_INDEX) ? object->index[1] : U32_MAX;
+        clause->count = (object->flags & XT_DNP3_OBJECT_COUNT) ? object->count : U32_MAX;
+    }
+}
+
+
+/*
+    This function decodes the object headers of an application fragment of bytes 
+    in length, commencing at the offset following the function code, into the 
+    object headers of the packet. Where every object header of the fragment is 
+    decoded, XT_DNP3_FRAME_OBJECTS is set in the frame summary, with the decoded 
+    object headers identified by the object and objects fields of this summary. 
+    The headers of a fragment are otherwise not decoded - for example, where the 
+    fragment is malformed, an object of unknown size is carried, or the object 
+    headers of the packet are exhausted - and such a frame does not match any rule 
+    with object header constraints. 
+
+    Each object header is summarised by the number of objects and the lowest and 
+    highest point index addressed, decoded from the range field or the index prefix 
+    of each object as specified by the qualifier code. An object header which 
+    addresses all points is summarised with an unbounded index range and count. 
+    As each object header occupies at least three bytes of the fragment, the walk 
+    of object headers is bounded by the length of the fragment.
+*/
+
+static __always_inline void
+dnp3_object_decode(struct xt_dnp3_packet *packet, 
+        const u8 *payload, 
+        u32 offset, 
+        u32 bytes, 
+        bool framed, 
+        struct xt_dnp3_frame *frame) {
+    struct xt_dnp3_objhdr *objhdr;
+    u32 count, index, prefix, stride, value, width;
+    u64 size;
+    u8 range;
+    int bits;
+
+    if (frame->func >= DNP3_APPL_FC_RESPONSE) {
+        offset += DNP3_APPL_IIN_LENGTH;
+    }
+    if (offset > bytes) {
+        return;
+    }
+
+    for (count = 0; offset < bytes; ++count) {
+        if (((packet->objects + count) >= XT_DNP3_OBJHDRS) ||
+                ((bytes - offset) < DNP3_APPL_OBJHDR_LENGTH)) {
+            return;
+        }
+        objhdr = &packet->objhdr[packet->objects + count];
+        objhdr->group = dnp3_object_byte(payload, offset, framed);
+        objhdr->variation = dnp3_object_byte(payload, offset + 1, framed);
+        objhdr->qualifier = dnp3_object_byte(payload, offset + 2, framed);
+        offset += DNP3_APPL_OBJHDR_LENGTH;
+
+        /*
+            The qualifier code comprises the object prefix code in bits 4-6 and the 
+            range specifier code in bits 0-3. Index prefixes of one, two and four 
+            bytes are decoded, while object size prefixes, as used with free-format 
+            objects, and virtual address ranges are not.
+        */
+
+        switch ((prefix = (objhdr->qualifier >> 4) & 0x07)) {
+            case 0:
+            case 1:
+            case 2:
+                break;
+            case 3:
+                prefix = 4;
+                break;
+            default:
+                return;
+        }
+
+        range = objhdr->qualifier & 0x0f;
+        switch (range) {
+            case 0x00:
+            case 0x01:
+            case 0x02:
+                width = (range == 0x02) ? 4 : (range + 1);
+                if ((prefix != 0) ||
+                        ((bytes - offset) < (2 * width))) {
+                    return;
+                }
+                objhdr->min = dnp3_object_read(payload, offset, width, framed);
+                objhdr->max = dnp3_object_read(payload, offset + width, width, framed);
+                if (objhdr->max < objhdr->min) {
+                    return;
+                }
+                objhdr->count = objhdr->max - objhdr->min + 1;
+                offset += (2 * width);
+                break;
+            case 0x06:
+                if ((prefix != 0) ||
+                        (dnp3_object_bits(frame->func, objhdr->group, objhdr->variation) != 0)) {
+                    return;
+                }
+                objhdr->count = U32_MAX;
+                objhdr->min = 0;
+                objhdr->max = U32_MAX;
+                continue;
+            case 0x07:
+            case 0x08:
+            case 0x09:
+                width = (range == 0x09) ? 4 : (range - 0x06);
+                if ((bytes - offset) < width) {
+                    return;
+                }
+                objhdr->count = dnp3_object_read(payload, offset, width, framed);
+                objhdr->min = U32_MAX;
+                objhdr->max = 0;
+                if ((prefix == 0) &&
+                        (objhdr->count > 0)) {
+                    objhdr->min = 0;
+                    objhdr->max = objhdr->count - 1;
+                }
+                offset += width;
+                break;
+            default:
+                return;
+        }
+
+        if ((bits = dnp3_object_bits(frame->func, objhdr->group, objhdr->variation)) < 0) {
+            return;
+        }
+        stride = prefix + DIV_ROUND_UP(bits, 8);
+        size = (prefix == 0) ? 
+                DIV_ROUND_UP((u64) objhdr->count * bits, 8) :
+                ((u64) objhdr->count * stride);
+        if (size > (bytes - offset)) {
+            return;
+        }
+        if (prefix != 0) {
+            for (index = 0; index < objhdr->count; ++index) {
+                value = dnp3_object_read(payload, offset + (index * stride), prefix, framed);
+                if (value < objhdr->min) {
+                    objhdr->min = value;
+                }
+                if (value > objhdr->max) {
+                    objhdr->max = value;
+                }
+            }
+        }
+        offset += size;
+    }
+
+    frame->object = packet->objects;
+    frame->objects = count;
+    frame->flags |= XT_DNP3_FRAME_OBJECTS;
+    packet->objects += count;
+}
+
+
+/*
+    This function decodes the object headers of an application fragment reassembled 
+    from the frames of a multi-frame message, summarised with the final frame of 
+    this message.
+*/
+
+void
+dnp3_object_fragment(struct xt_dnp3_packet *packet, 
+        const struct xt_dnp3_fragment *fragment, 
+        struct xt_dnp3_frame *frame) {
+    dnp3_object_decode(packet, 
+            fragment->data, 
+            DNP3_APPL_FC_OFFSET + 1, 
+            fragment->len, 
+            false, 
+            frame);
+}
+
+
+/*
+    This function returns true where each of the object headers specified is 
+    admitted by one of the object header constraints of the compiled program, or 
+    where invert is set, where none of these object headers is admitted.
+*/
+
+bool
+dnp3_object_match(const struct xt_dnp3_program *program, 
+        const struct xt_dnp3_objhdr *objhdr, 
+        u32 count, 
+        bool invert) {
+    u32 index;
+
+    for (index = 0; index < count; ++index) {
+        if (dnp3_object_admit(program, &objhdr[index]) == invert) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+    This function decodes the object headers of the application fragment carried 
+    by a complete frame, which is both the first and final frame of a message and 
+    has a function code.
+*/
+
+void
+dnp3_object_parse(struct xt_dnp3_packet *packet, 
+        const u8 *payload, 
+        struct xt_dnp3_frame *frame) {
+    dnp3_object_decode(packet, 
+            payload, 
+            DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET + 1, 
+            payload[2] - 5, 
+            true, 
+            frame);
+}
+
+
+static __always_inline u32
+dnp3_object_read(const u8 *payload, u32 offset, u32 width, bool framed) {
+    u32 index, value;
+
+    for (index = 0, value = 0; index < width; ++index) {
+        value |= ((u32) dnp3_object_byte(payload, offset + index, framed) << (8 * index));
+    }
+    return value;
+}
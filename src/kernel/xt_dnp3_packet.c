@@ -0,0 +1,817 @@
+#include "xt_dnp3.h"
+#include "xt_dnp3_crc.h"
+#include "xt_dnp3_packet.h"
+
+
+static int dnp3_packet_checksum(const u8 *buff, u32 len, int engine);
+
+static int dnp3_packet_decode(struct xt_dnp3_packet *packet, u32 src, u32 dest, const u8 *payload, u32 len, int engine, struct xt_dnp3_frame *frame);
+
+static __always_inline bool dnp3_packet_frames(const struct xt_dnp3_rule *rule, const struct xt_dnp3_packet *packet, bool *hotdrop, u32 set);
+
+static inline u8 dnp3_packet_mask(u8 mode, u8 sample, const struct xt_dnp3_frame *frame);
+
+static bool dnp3_packet_rate(const struct xt_dnp3_rule *rule, const struct xt_dnp3_packet *packet);
+
+static inline int dnp3_packet_reason(const struct xt_dnp3_frame *frame, int length);
+
+static void dnp3_packet_validate(const struct xt_dnp3_packet *packet, u32 src, u32 dest, const u8 *payload, u32 len, int engine, struct xt_dnp3_frame *frame);
+
+static inline bool dnp3_packet_value(u16 value, u16 min, u16 max, bool invert);
+
+static inline bool dnp3_packet_verify(const struct xt_dnp3_rule *rule, const struct xt_dnp3_frame *frame);
+
+
+int
+dnp3_packet_add(struct xt_dnp3_packet *packet, const struct xt_dnp3_frame *frame) {
+    struct xt_dnp3_frame *last, *summary;
+    u32 size;
+
+    if (frame->count == 0) {
+        return 0;
+    }
+    if (packet->count > 0) {
+        last = &packet->frame[packet->count - 1];
+        if ((last->daddr == frame->daddr) &&
+                (last->saddr == frame->saddr) &&
+                (last->func == frame->func) &&
+                (last->flags == frame->flags) &&
+                (last->crc == frame->crc) &&
+                (!(frame->flags & XT_DNP3_FRAME_OBJECTS)) &&
+                (last->count < U16_MAX)) {
+            ++last->count;
+            return 0;
+        }
+    }
+
+    /*
+        Where the frames of a packet cannot be summarised within the in-line 
+        storage of the packet, additional storage is allocated and retained for 
+        subsequent packets. The number of summaries is bounded by the number of 
+        frames which may be carried within a single packet.
+    */
+
+    if (packet->count == packet->size) {
+        size = packet->size * 2;
+        if (packet->frame == packet->frames) {
+            if ((summary = kmalloc_array(size, sizeof(*summary), GFP_ATOMIC)) != NULL) {
+                memcpy(summary, packet->frames, sizeof(packet->frames));
+            }
+        }
+        else {
+            summary = krealloc_array(packet->frame, size, sizeof(*summary), GFP_ATOMIC);
+        }
+        if (!summary) {
+            dnp3_stats_inc(XT_DNP3_STAT_NOMEM);
+            return -ENOMEM;
+        }
+        packet->frame = summary;
+        packet->size = size;
+    }
+    packet->frame[packet->count++] = *frame;
+    return 0;
+}
+
+
+/*
+    This function appends the user data of the complete frame pointed to by 
+    payload, excluding the transport header and the CRC of each data block, to an 
+    application fragment under reassembly, returning -ENOSPC where the fragment 
+    would exceed XT_DNP3_APDU_MAX bytes.
+*/
+
+int
+dnp3_packet_append(struct xt_dnp3_fragment *fragment, const u8 *payload) {
+    const u8 *data;
+    u32 block, bytes, offset, skip;
+
+    bytes = payload[2] - 5;
+    if (bytes <= DNP3_TSPT_HDR_LENGTH) {
+        return 0;
+    }
+    if ((fragment->len + bytes - DNP3_TSPT_HDR_LENGTH) > XT_DNP3_APDU_MAX) {
+        return -ENOSPC;
+    }
+
+    data = payload + DNP3_LINK_HDR_LENGTH;
+    skip = DNP3_TSPT_HDR_LENGTH;
+    for (offset = 0; offset < bytes; offset += block) {
+        block = bytes - offset;
+        if (block > DNP3_LINK_BLOCK_LENGTH) {
+            block = DNP3_LINK_BLOCK_LENGTH;
+        }
+        memcpy(&fragment->data[fragment->len], data + skip, block - skip);
+        fragment->len += (block - skip);
+        data += block + DNP3_LINK_CRC_LENGTH;
+        skip = 0;
+    }
+    return 0;
+}
+
+
+static int
+dnp3_packet_checksum(const u8 *buff, u32 len, int engine) {
+    u16 crc1, crc2;
+
+    if (len == 0) {
+        return 0;
+    }
+    else if (len < 3) {
+        return -EINVAL;
+    }
+    else {};
+
+    crc1 = (engine == DNP3_CRC_TABLE) ? 
+            dnp3_crc_table(buff, len - 2) : 
+            dnp3_crc_slice16(buff, len - 2);
+    buff += (len - 2);
+    crc2 = buff[0] | (buff[1] << 8);
+
+    return (crc1 == crc2) ? 0 : -EINVAL;
+}
+
+
+/*
+    This function updates the CRC validation counters of a validation mode, with 
+    the sample interval of sample where sampled, for each frame of a parsed 
+    packet. It is called once for each parse of a packet and each validation mode 
+    of the rules loaded, such that each frame is counted once for each mode 
+    irrespective of the number of rules against which the packet is matched.
+*/
+
+void
+dnp3_packet_count(const struct xt_dnp3_packet *packet, 
+        u8 mode, 
+        u8 sample, 
+        struct xt_dnp3_crc_stats *stats) {
+    const struct xt_dnp3_frame *frame;
+    u32 index;
+    u8 mask;
+
+    for (index = 0; index < packet->count; ++index) {
+        frame = &packet->frame[index];
+        mask = dnp3_packet_mask(mode, sample, frame);
+
+        stats->frames += frame->count;
+        if ((mask & XT_DNP3_FRAME_HEADER_BAD) &&
+                (frame->crc & XT_DNP3_FRAME_HEADER_CRC)) {
+            stats->headers += frame->count;
+        }
+        if ((mask & XT_DNP3_FRAME_BLOCK_BAD) &&
+                (frame->crc & XT_DNP3_FRAME_BLOCK_CRC)) {
+            stats->blocks += frame->count;
+        }
+        else if (!(frame->flags & XT_DNP3_FRAME_PARTIAL)) {
+            stats->skipped += frame->count;
+        }
+        if (frame->crc & mask) {
+            stats->failed += frame->count;
+        }
+    }
+}
+
+
+/*
+    This function parses the DNP3 frame pointed to by payload, where len is the 
+    number of bytes of this frame available, into the frame summary pointed to by 
+    frame. The source and destination IP addresses, in host byte order, identify 
+    the transport sessions of multi-frame messages. The length of the frame is 
+    returned where the frame is valid, or -1 otherwise. 
+
+    Where fewer bytes are available than the length of the frame - as may be the 
+    case for a frame split across TCP segments - the fields of the frame which are 
+    available are summarised and the returned frame length will exceed len. 
+    Transport sessions are only updated upon complete frames. A summary count of 
+    zero indicates that too few bytes are available to summarise the frame.
+
+    The CRCs of the frame are validated to the depth required by the rules to be 
+    matched against the packet, with the outcome recorded in the frame summary 
+    rather than invalidating the packet, such that each rule may disregard the 
+    outcome of validation beyond the depth selected for that rule. Where the safe 
+    function codes of the packet are set, for a packet of a trusted flow, a frame 
+    which is the first frame of a message with one of these function codes is not 
+    validated, while every other frame of the packet is.
+*/
+
+static int
+dnp3_packet_decode(struct xt_dnp3_packet *packet, 
+        u32 src, 
+        u32 dest, 
+        const u8 *payload, 
+        u32 len, 
+        int engine, 
+        struct xt_dnp3_frame *frame) {
+    const struct pkt_dnp3_header *pkth;
+    struct xt_dnp3_fragment *fragment;
+    u32 bytes, length;
+    u8 depth, seq, tspt;
+    int ret;
+
+    memset(frame, 0, sizeof(*frame));
+    if (len < sizeof(struct pkt_dnp3_header)) {
+        return DNP3_LINK_FRAME_MAX;
+    }
+    if (dnp3_packet_header(payload, DNP3_LINK_HDR_LENGTH) != 0) {
+        dnp3_stats_inc(XT_DNP3_STAT_SYNC);
+        return -1;
+    }
+    pkth = (const struct pkt_dnp3_header *) payload;
+    frame->daddr = le16_to_cpu(pkth->daddr);
+    frame->saddr = le16_to_cpu(pkth->saddr);
+    frame->control = pkth->control;
+    frame->count = 1;
+
+    depth = packet->depth;
+    if ((packet->safe) &&
+            (len >= DNP3_FRAME_SUMMARY) &&
+            (pkth->length >= (5 + DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET + 1)) &&
+            (payload[DNP3_LINK_HDR_LENGTH] & DNP3_TSPT_HDR_FIRST_MASK) &&
+            (packet->safe[payload[DNP3_FRAME_SUMMARY - 1] / 8] & (1 << (payload[DNP3_FRAME_SUMMARY - 1] % 8)))) {
+        depth = XT_DNP3_CRC_NONE;
+    }
+    if (depth != XT_DNP3_CRC_NONE) {
+        frame->crc |= XT_DNP3_FRAME_HEADER_CRC;
+        if (dnp3_packet_checksum(payload, DNP3_LINK_HDR_LENGTH, engine) != 0) {
+            frame->crc |= XT_DNP3_FRAME_HEADER_BAD;
+            dnp3_stats_inc(XT_DNP3_STAT_HEADER_CRC);
+        }
+    }
+
+    length = dnp3_packet_length(pkth->length);
+    if (len < length) {
+        frame->flags |= XT_DNP3_FRAME_PARTIAL;
+    }
+    else {
+        dnp3_stats_inc(XT_DNP3_STAT_FRAMES);
+        if (depth != XT_DNP3_CRC_NONE) {
+            dnp3_packet_validate(packet, src, dest, payload, length, engine, frame);
+        }
+    }
+
+    /*
+        The splitting of longer DNP3 messages across multiple frames adds a further 
+        layer of complexity to message parsing and firewall rules application.
+
+        For single frame DNP3 messages and the first frame of multi-frame DNP3 
+        messages, the application function code is parsed from the frame. For 
+        multi-frame DNP3 messages, a session entry is established to validate the 
+        transport sequence of subsequent frames of the DNP3 message, which are 
+        summarised with the function code of the first frame. Where no rule to be 
+        matched against the packet requires function codes, sessions are not 
+        tracked and subsequent frames are summarised without a function code.
+    */
+
+    bytes = (pkth->length - 5);
+    if (bytes < DNP3_TSPT_HDR_LENGTH) {
+        frame->flags |= XT_DNP3_FRAME_NODATA;
+        return length;
+    }
+    if (len <= DNP3_LINK_HDR_LENGTH) {
+        return length;
+    }
+    tspt = payload[DNP3_LINK_HDR_LENGTH];
+    seq = tspt & DNP3_TSPT_HDR_SEQUENCE_MASK;
+    frame->tspt = tspt;
+    frame->flags |= XT_DNP3_FRAME_TSPT | 
+            (tspt & (XT_DNP3_FRAME_FIRST | XT_DNP3_FRAME_FINAL));
+
+    if (tspt & DNP3_TSPT_HDR_FIRST_MASK) {
+        if (bytes < (DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET + 1)) {
+            frame->flags |= XT_DNP3_FRAME_NODATA;
+            return length;
+        }
+        if (len < DNP3_FRAME_SUMMARY) {
+            return length;
+        }
+        frame->func = payload[DNP3_LINK_HDR_LENGTH + DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET];
+        frame->flags |= XT_DNP3_FRAME_FC;
+
+        /*
+            The object headers of a single frame message are decoded where required 
+            by the rules to be matched against the packet, and where the frame has 
+            not failed CRC validation. The object headers of multi-frame messages 
+            may span frames and are only decoded from the application fragment 
+            reassembled from these frames.
+        */
+
+        if ((packet->inspect) &&
+                (tspt & DNP3_TSPT_HDR_FINAL_MASK) &&
+                (len >= length) &&
+                (!(frame->crc & (XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD)))) {
+            dnp3_object_parse(packet, payload, frame);
+        }
+
+        if ((!packet->sessions) ||
+                (tspt & DNP3_TSPT_HDR_FINAL_MASK) ||
+                (len < length) ||
+                (frame->crc & (XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD))) {
+            return length;
+        }
+
+        /*
+            Where object headers are decoded, the user data of the first frame of 
+            a multi-frame message commences the reassembly of the application 
+            fragment of the message, with the matching of object headers against 
+            each frame of the message deferred until the final frame.
+        */
+
+        if ((ret = dnp3_session_open(packet->session, src, dest, 
+                frame->saddr, frame->daddr, seq, 
+                dnp3_session_digest(payload, length), frame->func, 
+                (packet->inspect) ? payload : NULL)) < 0) {
+            frame->flags |= XT_DNP3_FRAME_NOSESSION;
+            dnp3_stats_inc((ret == -ENOSPC) ? XT_DNP3_STAT_EXHAUSTED : XT_DNP3_STAT_NOMEM);
+        }
+        else if (ret > 0) {
+            frame->flags |= XT_DNP3_FRAME_DEFERRED;
+        }
+    }
+    else {
+        if ((!packet->sessions) ||
+                (len < length)) {
+            return length;
+        }
+
+        /*
+            A frame which is known to have been corrupted or forged does not update 
+            transport session state, and as such, subsequent frames of a multi-frame 
+            message cannot be attributed to a message by such a frame.
+        */
+
+        if (frame->crc & (XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD)) {
+            frame->flags |= XT_DNP3_FRAME_NOSESSION;
+            return length;
+        }
+        fragment = NULL;
+        if ((ret = dnp3_session_advance(packet->session, src, dest, 
+                frame->saddr, frame->daddr, seq, 
+                dnp3_session_digest(payload, length), 
+                !! (tspt & DNP3_TSPT_HDR_FINAL_MASK), 
+                (packet->inspect) ? payload : NULL, 
+                &frame->func, 
+                &fragment)) < 0) {
+            frame->flags |= XT_DNP3_FRAME_NOSESSION;
+            dnp3_stats_inc((ret == -EINVAL) ? XT_DNP3_STAT_SEQUENCE : XT_DNP3_STAT_NOSESSION);
+        }
+        else {
+            frame->flags |= XT_DNP3_FRAME_FC;
+
+            /*
+                The object headers of a reassembled application fragment are 
+                decoded upon the final frame of the message, and summarised with 
+                this frame, before the buffer of the fragment is released.
+            */
+
+            if (fragment) {
+                dnp3_object_fragment(packet, fragment, frame);
+                dnp3_apdu_free(fragment);
+                dnp3_stats_inc(XT_DNP3_STAT_ASSEMBLED);
+            }
+            else if (ret > 0) {
+                frame->flags |= XT_DNP3_FRAME_DEFERRED;
+            }
+        }
+    }
+
+    return length;
+}
+
+
+/*
+    This function parses a DNP3 frame as described for dnp3_packet_decode(), and 
+    reports the outcome through the dnp3_frame tracepoint where enabled.
+*/
+
+int
+dnp3_packet_frame(struct xt_dnp3_packet *packet, 
+        u32 src, 
+        u32 dest, 
+        const u8 *payload, 
+        u32 len, 
+        int engine, 
+        struct xt_dnp3_frame *frame) {
+    int length;
+
+    length = dnp3_packet_decode(packet, src, dest, payload, len, engine, frame);
+    if (trace_dnp3_frame_enabled()) {
+        trace_dnp3_frame(src, dest, frame, length, dnp3_packet_reason(frame, length));
+    }
+    return length;
+}
+
+
+/*
+    This function matches the frame summaries of a valid packet against a rule for 
+    the criteria of set, which are constant within each specialised matcher such 
+    that the tests of criteria not held by the rule are compiled out, and are the 
+    criteria of the rule itself within the generic matcher.
+*/
+
+static __always_inline bool
+dnp3_packet_frames(const struct xt_dnp3_rule *rule, 
+        const struct xt_dnp3_packet *packet, 
+        bool *hotdrop, 
+        u32 set) {
+    const struct xt_dnp3_policy *policy;
+    const struct xt_dnp3_frame *frame;
+    const u8 *fc;
+    u32 index;
+    u8 invert, match;
+
+    policy = (set & XT_DNP3_FLAG_POLICY) ? dnp3_policy_get(rule->table) : NULL;
+
+    for (index = 0; index < packet->count; ++index) {
+        frame = &packet->frame[index];
+
+        if (!dnp3_packet_verify(rule, frame)) {
+            return false;
+        }
+        if (set & XT_DNP3_FLAG_DADDR) {
+            if (!dnp3_packet_value(frame->daddr,
+                    rule->daddr[0],
+                    rule->daddr[1],
+                    !! (rule->invert & XT_DNP3_FLAG_DADDR))) {
+                return false;
+            }
+        }
+        if (set & XT_DNP3_FLAG_SADDR) {
+            if (!dnp3_packet_value(frame->saddr,
+                    rule->saddr[0],
+                    rule->saddr[1],
+                    !! (rule->invert & XT_DNP3_FLAG_SADDR))) {
+                return false;
+            }
+        }
+
+        /*
+            Frames which carry no transport or application data cannot match a 
+            function code rule. Subsequent frames of a multi-frame message are 
+            matched against the function code of the first frame of the message, 
+            with the packet dropped where no session for the message exists, while 
+            the function code of a partial frame may not yet be available and is 
+            matched upon completion of the frame.
+        */
+
+        if (set & XT_DNP3_FLAG_FC) {
+            if (frame->flags & XT_DNP3_FRAME_NODATA) {
+                return false;
+            }
+            if (frame->flags & XT_DNP3_FRAME_FC) {
+                match = ((rule->fc[frame->func / 8] & (1 << (frame->func % 8))) != 0);
+                invert = !! (rule->invert & XT_DNP3_FLAG_FC);
+                if (!(match ^ invert)) {
+                    return false;
+                }
+            }
+            if (frame->flags & XT_DNP3_FRAME_NOSESSION) {
+                *hotdrop = true;
+                return false;
+            }
+        }
+
+        /*
+            The function code of a frame is likewise matched against the function 
+            codes permitted between the addresses of the frame by the policy table 
+            of the rule, with no function code permitted between addresses for 
+            which the table holds no entry.
+        */
+
+        if (set & XT_DNP3_FLAG_POLICY) {
+            if (frame->flags & XT_DNP3_FRAME_NODATA) {
+                return false;
+            }
+            if (frame->flags & XT_DNP3_FRAME_FC) {
+                fc = dnp3_policy_lookup(policy, frame->saddr, frame->daddr);
+                match = ((fc) && (fc[frame->func / 8] & (1 << (frame->func % 8))));
+                invert = !! (rule->invert & XT_DNP3_FLAG_POLICY);
+                if (!(match ^ invert)) {
+                    return false;
+                }
+            }
+            if (frame->flags & XT_DNP3_FRAME_NOSESSION) {
+                *hotdrop = true;
+                return false;
+            }
+        }
+
+        /*
+            The object headers of a frame are matched against the compiled object 
+            header constraints of the rule, with frames for which object headers 
+            have not been decoded matching neither the rule nor its inversion. As 
+            with function codes, a partial frame is matched upon completion, and 
+            the frames of a multi-frame message whose application fragment is 
+            being reassembled are matched upon the final frame of the message.
+        */
+
+        if ((set & XT_DNP3_FLAG_OBJECT) &&
+                (!(frame->flags & (XT_DNP3_FRAME_PARTIAL | XT_DNP3_FRAME_DEFERRED)))) {
+            if ((!(frame->flags & XT_DNP3_FRAME_OBJECTS)) ||
+                    (!dnp3_object_match(rule->program, 
+                            &packet->objhdr[frame->object], 
+                            frame->objects, 
+                            !! (rule->invert & XT_DNP3_FLAG_OBJECT)))) {
+                return false;
+            }
+        }
+    }
+
+    /*
+        The rate limit of a rule is applied only once every frame of the packet has 
+        matched the other criteria of the rule, such that tokens are not taken for 
+        a packet which the rule would not otherwise match. The rule matches only 
+        where a token is available for every message started within the packet, 
+        or where inverted, where a token is unavailable for any such message.
+    */
+
+    if (set & XT_DNP3_FLAG_RATE) {
+        match = dnp3_packet_rate(rule, packet);
+        invert = !! (rule->invert & XT_DNP3_FLAG_RATE);
+        return (match ^ invert);
+    }
+    return true;
+}
+
+
+int 
+dnp3_packet_header(const u8 *buff, u32 len) {
+    const struct pkt_dnp3_header *pkth;
+
+    if (len < sizeof(struct pkt_dnp3_header)) {
+        return -1;
+    }
+    pkth = (const struct pkt_dnp3_header *) buff;
+    if ((pkth->sync1 != 0x05) ||
+            (pkth->sync2 != 0x64) ||
+            (pkth->length < 5)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+    This function returns the CRC validation outcomes of a frame which are 
+    required to be valid by a validation mode. For the sample mode, the data block 
+    CRCs of a frame are required to be valid only where the frame was selected for 
+    validation for the sample interval, the frames of which are a subset of those 
+    selected for any shorter interval.
+*/
+
+static inline u8
+dnp3_packet_mask(u8 mode, 
+        u8 sample, 
+        const struct xt_dnp3_frame *frame) {
+    switch (mode) {
+        case XT_DNP3_CRC_NONE:
+            return 0;
+        case XT_DNP3_CRC_HEADER:
+            return XT_DNP3_FRAME_HEADER_BAD;
+        case XT_DNP3_CRC_SAMPLE:
+            if ((frame->crc & XT_DNP3_FRAME_BLOCK_CRC) &&
+                    ((frame->crc >> XT_DNP3_FRAME_RANK_SHIFT) >= sample)) {
+                return XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD;
+            }
+            return XT_DNP3_FRAME_HEADER_BAD;
+        case XT_DNP3_CRC_FULL:
+        default:
+            return XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD;
+    }
+}
+
+
+/*
+    This function matches the frame summaries of a parsed packet against a rule, 
+    returning true where every frame of the packet matches. The hotdrop argument 
+    is set where the packet should be dropped irrespective of the remaining rules.
+*/
+
+#define DNP3_PACKET_MATCHER(set) \
+        case XT_DNP3_MATCHER(set): \
+            return dnp3_packet_frames(rule, packet, hotdrop, (set))
+
+bool
+dnp3_packet_match(const struct xt_dnp3_rule *rule, 
+        const struct xt_dnp3_packet *packet, 
+        bool *hotdrop) {
+    if (packet->hotdrop) {
+        *hotdrop = true;
+        return false;
+    }
+    if (!packet->valid) {
+        return false;
+    }
+
+    switch (rule->matcher) {
+        DNP3_PACKET_MATCHER(0);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_DADDR);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_SADDR);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_DADDR | XT_DNP3_FLAG_SADDR);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_FC);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_DADDR | XT_DNP3_FLAG_FC);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_SADDR | XT_DNP3_FLAG_FC);
+        DNP3_PACKET_MATCHER(XT_DNP3_FLAG_DADDR | XT_DNP3_FLAG_SADDR | XT_DNP3_FLAG_FC);
+        case XT_DNP3_MATCHER_GENERIC:
+        default:
+            return dnp3_packet_frames(rule, packet, hotdrop, rule->set);
+    }
+}
+
+#undef DNP3_PACKET_MATCHER
+
+
+/*
+    This function parses the frames of a contiguous packet payload into the frame 
+    summaries of the packet. A frame which extends beyond the end of the payload 
+    invalidates the packet, with the reassembly of frames split across TCP 
+    segments performed by the caller where required.
+*/
+
+void
+dnp3_packet_parse(struct xt_dnp3_packet *packet, 
+        u32 src, 
+        u32 dest, 
+        const u8 *payload, 
+        u32 len, 
+        int engine) {
+    struct xt_dnp3_frame frame;
+    u32 consumed;
+    int length;
+
+    packet->valid = true;
+    for (consumed = 0; consumed < len; consumed += length) {
+        if ((length = dnp3_packet_frame(packet, 
+                src, 
+                dest, 
+                payload + consumed, 
+                len - consumed, 
+                engine, 
+                &frame)) < 0) {
+            packet->valid = false;
+            break;
+        }
+        if (dnp3_packet_add(packet, &frame) != 0) {
+            packet->valid = false;
+            packet->hotdrop = true;
+            break;
+        }
+        if ((len - consumed) < (u32) length) {
+            dnp3_stats_inc(XT_DNP3_STAT_TRUNCATED);
+            packet->valid = false;
+            break;
+        }
+    }
+}
+
+
+/*
+    This function takes a token from the bucket of a rate limited rule for each 
+    message started within a packet, including each of the identical messages of 
+    a frame summary, returning true where every such message is admitted. The 
+    availability of a token for every message is checked before any token is 
+    taken, and where a message is nonetheless not admitted - as where the bucket 
+    is drained concurrently, or shared by messages of the packet - the tokens 
+    taken for the earlier messages of the packet are returned, such that a packet 
+    which is not admitted takes no tokens. Tokens are taken for each rule 
+    evaluated against the packet, from the buckets of that rule.
+*/
+
+static bool
+dnp3_packet_rate(const struct xt_dnp3_rule *rule, 
+        const struct xt_dnp3_packet *packet) {
+    const struct xt_dnp3_frame *frame;
+    u32 index;
+
+    for (index = 0; index < packet->count; ++index) {
+        frame = &packet->frame[index];
+        if (((frame->flags & (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_FIRST)) == 
+                (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_FIRST)) &&
+                (!dnp3_rate_check(rule, frame->saddr, frame->daddr, frame->func, frame->count))) {
+            return false;
+        }
+    }
+    for (index = 0; index < packet->count; ++index) {
+        frame = &packet->frame[index];
+        if (((frame->flags & (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_FIRST)) == 
+                (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_FIRST)) &&
+                (!dnp3_rate_take(rule, frame->saddr, frame->daddr, frame->func, frame->count))) {
+            break;
+        }
+    }
+    if (index == packet->count) {
+        return true;
+    }
+    while (index-- > 0) {
+        frame = &packet->frame[index];
+        if ((frame->flags & (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_FIRST)) == 
+                (XT_DNP3_FRAME_FC | XT_DNP3_FRAME_FIRST)) {
+            dnp3_rate_give(rule, frame->saddr, frame->daddr, frame->func, frame->count);
+        }
+    }
+    return false;
+}
+
+
+static inline int
+dnp3_packet_reason(const struct xt_dnp3_frame *frame, int length) {
+    if (length < 0) {
+        return XT_DNP3_STAT_SYNC;
+    }
+    if (frame->crc & XT_DNP3_FRAME_HEADER_BAD) {
+        return XT_DNP3_STAT_HEADER_CRC;
+    }
+    if (frame->crc & XT_DNP3_FRAME_BLOCK_BAD) {
+        return XT_DNP3_STAT_BLOCK_CRC;
+    }
+    if ((frame->count == 0) ||
+            (frame->flags & XT_DNP3_FRAME_PARTIAL)) {
+        return XT_DNP3_STAT_TRUNCATED;
+    }
+    if (frame->flags & XT_DNP3_FRAME_NOSESSION) {
+        return XT_DNP3_STAT_NOSESSION;
+    }
+    return XT_DNP3_STAT_FRAMES;
+}
+
+
+/*
+    This function selects the matcher of a rule, and must be called once the rule 
+    has been validated and before it is matched against packets.
+*/
+
+void
+dnp3_packet_select(struct xt_dnp3_rule *rule) {
+    if (rule->set & (XT_DNP3_FLAG_OBJECT | XT_DNP3_FLAG_POLICY | XT_DNP3_FLAG_RATE)) {
+        rule->matcher = XT_DNP3_MATCHER_GENERIC;
+    }
+    else {
+        rule->matcher = XT_DNP3_MATCHER(rule->set);
+    }
+}
+
+
+/*
+    This function validates the data block CRCs of a complete frame where required 
+    by the validation depth of the packet. For sampled validation, a frame is 
+    selected where the count of frames between the source and destination IP 
+    addresses is a multiple of the sample interval, with the number of trailing 
+    zero bits of this count - the longest interval for which the frame is selected 
+    - recorded in the frame summary.
+*/
+
+static void
+dnp3_packet_validate(const struct xt_dnp3_packet *packet, 
+        u32 src, 
+        u32 dest, 
+        const u8 *payload, 
+        u32 len, 
+        int engine, 
+        struct xt_dnp3_frame *frame) {
+    u32 count;
+    u8 rank;
+
+    switch (packet->depth) {
+        case XT_DNP3_CRC_FULL:
+            rank = XT_DNP3_CRC_SAMPLE_MAX;
+            break;
+        case XT_DNP3_CRC_SAMPLE:
+            count = dnp3_session_sample(src, dest);
+            if (count & ((1U << packet->sample) - 1)) {
+                return;
+            }
+            for (rank = packet->sample; 
+                    (rank < XT_DNP3_CRC_SAMPLE_MAX) && (!(count & (1U << rank))); 
+                    ++rank) {
+                ;
+            }
+            break;
+        default:
+            return;
+    }
+
+    frame->crc |= XT_DNP3_FRAME_BLOCK_CRC | (rank << XT_DNP3_FRAME_RANK_SHIFT);
+    if (dnp3_crc_check_frame(payload, len, engine) != 0) {
+        frame->crc |= XT_DNP3_FRAME_BLOCK_BAD;
+        dnp3_stats_inc(XT_DNP3_STAT_BLOCK_CRC);
+    }
+}
+
+
+static inline bool 
+dnp3_packet_value(u16 value, 
+        u16 min, 
+        u16 max, 
+        bool invert) {
+    return (((value >= min) && (value <= max)) ^ invert);
+}
+
+
+/*
+    This function returns false where a frame has failed the CRC validation 
+    required by the validation mode of a rule.
+*/
+
+static inline bool
+dnp3_packet_verify(const struct xt_dnp3_rule *rule, 
+        const struct xt_dnp3_frame *frame) {
+    return ((frame->crc & dnp3_packet_mask(dnp3_packet_crc(rule), rule->sample, frame)) == 0);
+}
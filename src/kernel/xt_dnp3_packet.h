@@ -0,0 +1,166 @@
+#ifndef _XT_DNP3_PACKET_H
+#define _XT_DNP3_PACKET_H
+
+
+#include "xt_dnp3_compat.h"
+#include "xt_dnp3.h"
+
+
+/*
+    The parsing of DNP3 frames into frame summaries, and the matching of these 
+    summaries against rules, is independent of the kernel environment and is shared 
+    by the xt_dnp3 kernel module and the userspace tools under src/tools. The 
+    transport session functions declared below are provided by the environment 
+    into which this source is compiled - within the kernel module these maintain 
+    sessions within the connection tracking entry of a connection, passed as the 
+    session context of the packet, or within the global session table, while 
+    within the userspace tools each thread maintains its own table. The environment 
+    similarly provides the frame counts between pairs of IP addresses by which 
+    frames are selected for sampled CRC validation, the current policy of each 
+    policy table referenced by rules, the token buckets by which the message 
+    rates of rules are limited and the buffers into which the application 
+    fragments of multi-frame messages are reassembled.
+*/
+
+/*
+    The frames of a packet are matched against a rule by a matcher specialised for 
+    the criteria of the rule, selected with dnp3_packet_select() as the rule is 
+    loaded. Each combination of the destination address, source address and 
+    function code criteria - which make up the bulk of rules - has a matcher 
+    compiled without the tests of the criteria which it does not hold, while rules 
+    with any other criteria are matched by the generic matcher.
+*/
+
+#define XT_DNP3_MATCHER_GENERIC         (0)
+#define XT_DNP3_MATCHER_CRITERIA        (XT_DNP3_FLAG_DADDR | XT_DNP3_FLAG_SADDR | XT_DNP3_FLAG_FC)
+#define XT_DNP3_MATCHER(set)            (1 + (((set) & XT_DNP3_MATCHER_CRITERIA) >> 1))
+
+
+static inline u32
+dnp3_packet_length(u8 length) {
+    u32 bytes;
+
+    /*
+        The length field of the DNP3 link layer header specifies the number of bytes 
+        in the remainder of the frame excluding CRC bytes, with a CRC inserted after 
+        every 16 bytes of data. Where this field is less than the minimum length of 
+        5 bytes, the frame is sized as a header alone and rejected in validation.
+    */
+
+    if (length < 5) {
+        return DNP3_LINK_HDR_LENGTH;
+    }
+    bytes = (length - 5);
+    return DNP3_LINK_HDR_LENGTH + bytes + 
+            (DIV_ROUND_UP(bytes, DNP3_LINK_BLOCK_LENGTH) * DNP3_LINK_CRC_LENGTH);
+}
+
+
+static inline u8
+dnp3_packet_crc(const struct xt_dnp3_rule *rule) {
+    return (rule->set & XT_DNP3_FLAG_CHECKSUM) ? rule->crc : XT_DNP3_CRC_FULL;
+}
+
+
+/*
+    This function returns the size, as a power of two, of the hash table of a 
+    policy table holding the number of entries specified, such that the table is 
+    never more than half full.
+*/
+
+static inline u32
+dnp3_policy_bits(u32 count) {
+    u32 bits;
+
+    for (bits = 4; (1U << bits) < (2 * count); ++bits) {
+        ;
+    }
+    return bits;
+}
+
+
+/*
+    This function returns the index of the token bucket of a rate limited rule for 
+    the function code and the addresses of a frame selected by the --per option.
+*/
+
+static inline u32
+dnp3_rate_hash(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func) {
+    u32 key;
+
+    switch (rule->per) {
+        case XT_DNP3_RATE_SADDR:
+            key = saddr;
+            break;
+        case XT_DNP3_RATE_PAIR:
+            key = ((u32) saddr << 16) | daddr;
+            break;
+        case XT_DNP3_RATE_DADDR:
+        default:
+            key = daddr;
+            break;
+    }
+    key = (key * 0x9e3779b1U) ^ (func * 0x85ebca77U);
+    return (key ^ (key >> 16)) & (XT_DNP3_RATE_BUCKETS - 1);
+}
+
+
+static inline void
+dnp3_packet_reset(struct xt_dnp3_packet *packet) {
+    packet->count = 0;
+    packet->valid = false;
+    packet->hotdrop = false;
+    packet->safe = NULL;
+    packet->session = NULL;
+    packet->objects = 0;
+}
+
+
+void dnp3_apdu_free(struct xt_dnp3_fragment *fragment);
+
+void dnp3_object_compile(const struct xt_dnp3_rule *rule, struct xt_dnp3_program *program);
+
+bool dnp3_object_match(const struct xt_dnp3_program *program, const struct xt_dnp3_objhdr *objhdr, u32 count, bool invert);
+
+void dnp3_object_fragment(struct xt_dnp3_packet *packet, const struct xt_dnp3_fragment *fragment, struct xt_dnp3_frame *frame);
+
+void dnp3_object_parse(struct xt_dnp3_packet *packet, const u8 *payload, struct xt_dnp3_frame *frame);
+
+int dnp3_packet_add(struct xt_dnp3_packet *packet, const struct xt_dnp3_frame *frame);
+
+int dnp3_packet_append(struct xt_dnp3_fragment *fragment, const u8 *payload);
+
+void dnp3_packet_count(const struct xt_dnp3_packet *packet, u8 mode, u8 sample, struct xt_dnp3_crc_stats *stats);
+
+int dnp3_packet_frame(struct xt_dnp3_packet *packet, u32 src, u32 dest, const u8 *payload, u32 len, int engine, struct xt_dnp3_frame *frame);
+
+int dnp3_packet_header(const u8 *buff, u32 len);
+
+bool dnp3_packet_match(const struct xt_dnp3_rule *rule, const struct xt_dnp3_packet *packet, bool *hotdrop);
+
+void dnp3_packet_parse(struct xt_dnp3_packet *packet, u32 src, u32 dest, const u8 *payload, u32 len, int engine);
+
+void dnp3_packet_select(struct xt_dnp3_rule *rule);
+
+const struct xt_dnp3_policy * dnp3_policy_get(const struct xt_dnp3_table *table);
+
+int dnp3_policy_insert(struct xt_dnp3_policy *policy, const struct xt_dnp3_entry *entry);
+
+const u8 * dnp3_policy_lookup(const struct xt_dnp3_policy *policy, u16 saddr, u16 daddr);
+
+bool dnp3_rate_check(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func, u32 count);
+
+void dnp3_rate_give(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func, u32 count);
+
+bool dnp3_rate_take(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func, u32 count);
+
+int dnp3_session_advance(void *context, u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u32 digest, bool final, const u8 *payload, u8 *func, struct xt_dnp3_fragment **fragment);
+
+u32 dnp3_session_digest(const u8 *buff, u32 len);
+
+int dnp3_session_open(void *context, u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u32 digest, u8 func, const u8 *payload);
+
+u32 dnp3_session_sample(u32 src, u32 dest);
+
+
+#endif
@@ -0,0 +1,117 @@
+#include "xt_dnp3.h"
+#include "xt_dnp3_packet.h"
+
+
+static inline u32 dnp3_policy_hash(const struct xt_dnp3_policy *policy, u16 saddr, u16 daddr, u8 flags);
+
+static inline const struct xt_dnp3_entry * dnp3_policy_probe(const struct xt_dnp3_policy *policy, u16 saddr, u16 daddr, u8 flags);
+
+
+static inline u32
+dnp3_policy_hash(const struct xt_dnp3_policy *policy, 
+        u16 saddr, 
+        u16 daddr, 
+        u8 flags) {
+    u32 key;
+
+    key = ((u32) saddr << 16) | daddr;
+    key ^= (flags * 0x85ebca77U);
+    return (key * 0x9e3779b1U) >> (32 - policy->bits);
+}
+
+
+/*
+    This function inserts an entry into a zeroed policy table, sized with 
+    dnp3_policy_bits(), returning zero on success or -ENOSPC where the table is 
+    full. Where an entry for the same addresses is already present, the function 
+    codes of the entry inserted are added to those of this entry.
+*/
+
+int
+dnp3_policy_insert(struct xt_dnp3_policy *policy, const struct xt_dnp3_entry *entry) {
+    struct xt_dnp3_entry *slot;
+    u32 byte, index, mask, probe;
+    u16 daddr, saddr;
+    u8 flags;
+
+    flags = (entry->flags & (XT_DNP3_POLICY_ANY_SADDR | XT_DNP3_POLICY_ANY_DADDR)) |
+            XT_DNP3_POLICY_USED;
+    saddr = (flags & XT_DNP3_POLICY_ANY_SADDR) ? 0 : entry->saddr;
+    daddr = (flags & XT_DNP3_POLICY_ANY_DADDR) ? 0 : entry->daddr;
+    mask = (1U << policy->bits) - 1;
+    index = dnp3_policy_hash(policy, saddr, daddr, flags);
+    for (probe = 0; probe <= mask; ++probe, index = (index + 1) & mask) {
+        slot = &policy->entry[index];
+        if (!(slot->flags & XT_DNP3_POLICY_USED)) {
+            memcpy(slot->fc, entry->fc, sizeof(slot->fc));
+            slot->saddr = saddr;
+            slot->daddr = daddr;
+            slot->flags = flags;
+            ++policy->count;
+            return 0;
+        }
+        if ((slot->saddr == saddr) &&
+                (slot->daddr == daddr) &&
+                (slot->flags == flags)) {
+            for (byte = 0; byte < sizeof(slot->fc); ++byte) {
+                slot->fc[byte] |= entry->fc[byte];
+            }
+            return 0;
+        }
+    }
+    return -ENOSPC;
+}
+
+
+/*
+    This function returns the function codes permitted between the source and 
+    destination addresses specified by a policy table, or NULL where the table 
+    holds no entry for these addresses. An entry for the pair of addresses takes 
+    precedence over an entry for any source address, then over an entry for any 
+    destination address and finally over an entry for any pair of addresses, such 
+    that a lookup performs at most four probe sequences irrespective of the size 
+    of the table.
+*/
+
+const u8 *
+dnp3_policy_lookup(const struct xt_dnp3_policy *policy, u16 saddr, u16 daddr) {
+    const struct xt_dnp3_entry *entry;
+
+    if (!policy) {
+        return NULL;
+    }
+    if (((entry = dnp3_policy_probe(policy, saddr, daddr, 0)) != NULL) ||
+            ((entry = dnp3_policy_probe(policy, 0, daddr, XT_DNP3_POLICY_ANY_SADDR)) != NULL) ||
+            ((entry = dnp3_policy_probe(policy, saddr, 0, XT_DNP3_POLICY_ANY_DADDR)) != NULL) ||
+            ((entry = dnp3_policy_probe(policy, 0, 0, 
+                    XT_DNP3_POLICY_ANY_SADDR | XT_DNP3_POLICY_ANY_DADDR)) != NULL)) {
+        return entry->fc;
+    }
+    return NULL;
+}
+
+
+static inline const struct xt_dnp3_entry *
+dnp3_policy_probe(const struct xt_dnp3_policy *policy, 
+        u16 saddr, 
+        u16 daddr, 
+        u8 flags) {
+    const struct xt_dnp3_entry *entry;
+    u32 index, mask, probe;
+
+    flags |= XT_DNP3_POLICY_USED;
+    mask = (1U << policy->bits) - 1;
+    index = dnp3_policy_hash(policy, saddr, daddr, flags);
+    for (probe = 0; probe <= mask; ++probe, index = (index + 1) & mask) {
+        entry = &policy->entry[index];
+        if (!(entry->flags & XT_DNP3_POLICY_USED)) {
+            break;
+        }
+        if ((entry->saddr == saddr) &&
+                (entry->daddr == daddr) &&
+                (entry->flags == flags)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
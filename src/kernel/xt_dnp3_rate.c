@@ -0,0 +1,69 @@
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/minmax.h>
+#include <linux/timekeeping.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_packet.h"
+
+
+/*
+    This function returns true where count tokens are available from the bucket 
+    of a rate limited rule for the function code and addresses of a message, 
+    without taking these tokens.
+*/
+
+bool
+dnp3_rate_check(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func, u32 count) {
+    struct xt_dnp3_rate *rate;
+    s64 now, tat;
+
+    rate = rule->rate;
+    now = (s64) ktime_get_mono_fast_ns();
+    tat = atomic64_read(&rate->tat[dnp3_rate_hash(rule, saddr, daddr, func)]);
+    return ((u64) (max(tat, now) - now) + (count - 1) * rate->interval <= rate->tolerance);
+}
+
+
+/*
+    This function returns count tokens taken from the bucket of a rate limited 
+    rule for the function code and addresses of a message, where a later message 
+    of the same packet is not admitted.
+*/
+
+void
+dnp3_rate_give(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func, u32 count) {
+    atomic64_sub(count * rule->rate->interval, &rule->rate->tat[dnp3_rate_hash(rule, saddr, daddr, func)]);
+}
+
+
+/*
+    This function takes count tokens from the bucket of a rate limited rule for 
+    the function code and addresses of a message, one for each of count identical 
+    messages, returning false where these are not available. Each bucket is held 
+    as the theoretical arrival time of the next message, which is advanced by the 
+    interval of the rule for each message admitted with a compare-and-exchange 
+    operation, such that the buckets of a rule are shared between CPUs without 
+    locks. A message is admitted where this time is no later than the current 
+    time plus the burst tolerance of the rule.
+*/
+
+bool
+dnp3_rate_take(const struct xt_dnp3_rule *rule, u16 saddr, u16 daddr, u8 func, u32 count) {
+    struct xt_dnp3_rate *rate;
+    atomic64_t *tat;
+    s64 next, now, prev;
+
+    rate = rule->rate;
+    tat = &rate->tat[dnp3_rate_hash(rule, saddr, daddr, func)];
+    now = (s64) ktime_get_mono_fast_ns();
+    prev = atomic64_read(tat);
+    do {
+        next = max(prev, now);
+        if ((u64) (next - now) + (count - 1) * rate->interval > rate->tolerance) {
+            return false;
+        }
+        next += count * rate->interval;
+    } while (!atomic64_try_cmpxchg(tat, &prev, next));
+    return true;
+}
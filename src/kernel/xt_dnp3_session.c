@@ -0,0 +1,688 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/jhash.h>
+#include <linux/jiffies.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_packet.h"
+
+
+static inline bool dnp3_session_duplicate(const u32 *digests, u8 frames, u8 last, u8 seq, u32 digest);
+static bool dnp3_session_evict(struct xt_dnp3_net *dnet);
+static void dnp3_session_expire(struct xt_dnp3_net *dnet, struct xt_dnp3_bucket *bucket);
+static void dnp3_session_free(struct rcu_head *head);
+static inline struct xt_dnp3_bucket * dnp3_session_hash(struct xt_dnp3_net *dnet, u32 src, u32 dest, u16 saddr, u16 daddr);
+static struct xt_dnp3_link * dnp3_session_link(struct xt_dnp3_net *dnet, struct xt_dnp3_stream *stream, u32 src, u32 dest, u16 saddr, u16 daddr, struct xt_dnp3_link **slot);
+static struct xt_dnp3_session * dnp3_session_lookup(struct xt_dnp3_bucket *bucket, u32 src, u32 dest, u16 saddr, u16 daddr);
+static inline void dnp3_session_record(u32 *digests, u8 *frames, u8 seq, u32 digest);
+static bool dnp3_session_unlink(struct xt_dnp3_net *dnet, struct xt_dnp3_session *session, int stat);
+
+
+/*
+    Multi-frame DNP3 message sessions are held in a hash table keyed on the source 
+    and destination IP addresses and DNP3 link layer addresses. Lookups are 
+    performed under RCU without locking, while insertion and removal of sessions 
+    is serialised by a per-bucket lock and transport sequence updates by a per-
+    session lock, such that concurrent messages on different CPUs do not contend.
+
+    Each session expires once no frame of its message has been received within the 
+    session timeout, such that the sessions of messages abandoned mid-message - 
+    where a master disconnects or the final frame is lost - do not remain held. 
+    Expired sessions are disregarded by lookups and released as new sessions are 
+    inserted into the same bucket. Where the table is full, a clock hand sweeps the 
+    buckets for an expired session to release or, failing that, a session to which 
+    no frame has been added since the hand last passed, such that the table 
+    recovers under sustained load without periodic work.
+
+    A session table is held by each network namespace, sized as the namespace is 
+    created, with the sessions of all namespaces allocated from a single cache. 
+    The session functions called from the frame parsing source operate upon the 
+    table of the namespace of the packet under evaluation.
+*/
+
+static struct kmem_cache *_cache __read_mostly;
+
+static u32 _seed __read_mostly;
+
+
+/*
+    Where the dnp3 connection tracking helper is assigned to a connection, the 
+    sessions of multi-frame messages on this connection are instead held with the 
+    reassembly state of each direction of the connection, passed as the session 
+    context, and are released with the connection tracking entry. These sessions 
+    are accessed under the stream lock held for the parsing of each segment, and 
+    only where the sessions of a connection are exhausted is the session table of 
+    the namespace employed. The links count of the namespace records the number 
+    of such sessions held.
+*/
+
+
+/*
+    This function advances the transport sequence of the session of a multi-frame 
+    message, returning the function code of the first frame of the message in func. 
+    Where the application fragment of the message is being reassembled, the user 
+    data of the frame pointed to by payload is added to the fragment, with one 
+    returned where reassembly continues and upon the final frame, the completed 
+    fragment returned in fragment.
+
+    A frame with the sequence and digest of one of the most recent frames of the 
+    message - such as a frame of a retransmitted TCP segment - is a duplicate, and 
+    is returned with the function code of the message without advancing the 
+    session. Where the dnp3 connection tracking helper is assigned, the digests of 
+    a message are retained after its final frame until the entry is reused, such 
+    that a retransmission of the final frames of a message is also recognised.
+*/
+
+int
+dnp3_session_advance(void *context, 
+        u32 src, 
+        u32 dest, 
+        u16 saddr, 
+        u16 daddr, 
+        u8 seq, 
+        u32 digest, 
+        bool final, 
+        const u8 *payload, 
+        u8 *func, 
+        struct xt_dnp3_fragment **fragment) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    struct xt_dnp3_bucket *bucket;
+    struct xt_dnp3_session *session;
+    struct xt_dnp3_link *link;
+    unsigned int index;
+    u8 expected;
+    int ret;
+
+    if (context) {
+        if ((link = dnp3_session_link(dnet, context, src, dest, saddr, daddr, NULL)) != NULL) {
+            if (seq != ((link->seq + 1) & DNP3_TSPT_HDR_SEQUENCE_MASK)) {
+                if (!dnp3_session_duplicate(link->digest, link->frames, link->seq, seq, digest)) {
+                    return -EINVAL;
+                }
+                *func = link->func;
+                dnp3_stats_inc(XT_DNP3_STAT_DUPLICATE);
+                return (link->apdu != NULL);
+            }
+            link->seq = seq;
+            link->expires = jiffies + msecs_to_jiffies(READ_ONCE(dnet->session_timeout));
+            dnp3_session_record(link->digest, &link->frames, seq, digest);
+            *func = link->func;
+            ret = dnp3_apdu_add(&link->apdu, link, payload, final, fragment);
+            trace_dnp3_session_advance(src, dest, saddr, daddr, seq, link->func, XT_DNP3_STAT_FRAMES);
+            if (final) {
+                link->active = false;
+                atomic_dec(&dnet->links);
+                dnp3_stats_inc(XT_DNP3_STAT_CLOSED);
+                trace_dnp3_session_close(src, dest, saddr, daddr, seq, link->func, XT_DNP3_STAT_CLOSED);
+            }
+            return ret;
+        }
+
+        for (index = 0; index < XT_DNP3_LINKS; ++index) {
+            link = &((struct xt_dnp3_stream *) context)->link[index];
+            if ((!link->active) &&
+                    (link->saddr == saddr) &&
+                    (link->daddr == daddr) &&
+                    (dnp3_session_duplicate(link->digest, link->frames, link->seq, seq, digest))) {
+                *func = link->func;
+                dnp3_stats_inc(XT_DNP3_STAT_DUPLICATE);
+                return 0;
+            }
+        }
+    }
+
+    bucket = dnp3_session_hash(dnet, src, dest, saddr, daddr);
+    if (!(session = dnp3_session_lookup(bucket, src, dest, saddr, daddr))) {
+        return -ENOENT;
+    }
+
+    spin_lock_bh(&session->lock);
+    if (!session->active) {
+        spin_unlock_bh(&session->lock);
+        return -ENOENT;
+    }
+    expected = ((session->seq + 1) & DNP3_TSPT_HDR_SEQUENCE_MASK);
+    if (seq != expected) {
+        if (!dnp3_session_duplicate(session->digest, session->frames, session->seq, seq, digest)) {
+            spin_unlock_bh(&session->lock);
+            return -EINVAL;
+        }
+        *func = session->func;
+        ret = (session->apdu != NULL);
+        spin_unlock_bh(&session->lock);
+        dnp3_stats_inc(XT_DNP3_STAT_DUPLICATE);
+        return ret;
+    }
+    session->seq = seq;
+    WRITE_ONCE(session->expires, jiffies + msecs_to_jiffies(READ_ONCE(dnet->session_timeout)));
+    WRITE_ONCE(session->referenced, true);
+    dnp3_session_record(session->digest, &session->frames, seq, digest);
+    *func = session->func;
+    ret = dnp3_apdu_add(&session->apdu, session, payload, final, fragment);
+    if (final) {
+        session->active = false;
+    }
+    spin_unlock_bh(&session->lock);
+    trace_dnp3_session_advance(src, dest, saddr, daddr, seq, *func, XT_DNP3_STAT_FRAMES);
+
+    /*
+        The final frame of a multi-frame message releases the session. Lookups 
+        running concurrently on other CPUs may still hold a reference to this 
+        session, so its release is deferred until after an RCU grace period.
+    */
+
+    if (final) {
+        dnp3_stats_inc(XT_DNP3_STAT_CLOSED);
+        trace_dnp3_session_close(src, dest, saddr, daddr, seq, *func, XT_DNP3_STAT_CLOSED);
+        spin_lock_bh(&bucket->lock);
+        hlist_del_rcu(&session->node);
+        spin_unlock_bh(&bucket->lock);
+        atomic_dec(&dnet->count);
+        call_rcu(&session->rcu, dnp3_session_free);
+    }
+    return ret;
+}
+
+
+unsigned int
+dnp3_session_count(struct xt_dnp3_net *dnet) {
+    return atomic_read(&dnet->count) + atomic_read(&dnet->links);
+}
+
+
+/*
+    This function returns the digest of a complete frame by which retransmissions 
+    of the frame are recognised. The digest is seeded with the same random value 
+    as the session table, such that a frame with the transport sequence of a 
+    message but different content cannot readily be constructed to be passed as 
+    a duplicate.
+*/
+
+u32
+dnp3_session_digest(const u8 *buff, u32 len) {
+    return jhash(buff, len, _seed);
+}
+
+
+static inline bool
+dnp3_session_duplicate(const u32 *digests, 
+        u8 frames, 
+        u8 last, 
+        u8 seq, 
+        u32 digest) {
+    u8 distance;
+
+    distance = (last - seq) & DNP3_TSPT_HDR_SEQUENCE_MASK;
+    return ((distance < frames) &&
+            (digests[seq & (XT_DNP3_DIGESTS - 1)] == digest));
+}
+
+
+/*
+    This function releases a single session where the session table is full, 
+    sweeping the buckets of the table from the clock hand for an expired session, 
+    or a session to which no frame has been added since the hand last passed, and 
+    clearing the referenced flag of the sessions passed over. Where no session is 
+    found within XT_DNP3_SESSION_SCAN buckets, false is returned and the sweep 
+    resumes from this point upon the next call.
+*/
+
+static bool
+dnp3_session_evict(struct xt_dnp3_net *dnet) {
+    struct xt_dnp3_bucket *bucket;
+    struct xt_dnp3_session *session;
+    unsigned int scan;
+    bool evicted;
+
+    evicted = false;
+    for (scan = 0; (scan < XT_DNP3_SESSION_SCAN) && (!evicted); ++scan) {
+        bucket = &dnet->bucket[(unsigned int) atomic_inc_return(&dnet->hand) & (dnet->buckets - 1)];
+        if (hlist_empty(&bucket->head)) {
+            continue;
+        }
+        spin_lock_bh(&bucket->lock);
+        hlist_for_each_entry(session, &bucket->head, node) {
+            if (time_after(jiffies, READ_ONCE(session->expires))) {
+                evicted = dnp3_session_unlink(dnet, session, XT_DNP3_STAT_EXPIRED);
+            }
+            else if (!READ_ONCE(session->referenced)) {
+                evicted = dnp3_session_unlink(dnet, session, XT_DNP3_STAT_EVICTED);
+            }
+            else {
+                WRITE_ONCE(session->referenced, false);
+            }
+            if (evicted) {
+                break;
+            }
+        }
+        spin_unlock_bh(&bucket->lock);
+    }
+    return evicted;
+}
+
+
+void
+dnp3_session_exit(void) {
+    rcu_barrier();
+    kmem_cache_destroy(_cache);
+}
+
+
+/*
+    This function releases the expired sessions of a bucket, and must be called 
+    with the lock of the bucket held.
+*/
+
+static void
+dnp3_session_expire(struct xt_dnp3_net *dnet, struct xt_dnp3_bucket *bucket) {
+    struct xt_dnp3_session *session;
+    struct hlist_node *next;
+
+    hlist_for_each_entry_safe(session, next, &bucket->head, node) {
+        if (time_after(jiffies, READ_ONCE(session->expires))) {
+            dnp3_session_unlink(dnet, session, XT_DNP3_STAT_EXPIRED);
+        }
+    }
+}
+
+
+static void
+dnp3_session_free(struct rcu_head *head) {
+    struct xt_dnp3_session *session;
+
+    session = container_of(head, struct xt_dnp3_session, rcu);
+    kmem_cache_free(_cache, session);
+}
+
+
+static inline struct xt_dnp3_bucket *
+dnp3_session_hash(struct xt_dnp3_net *dnet, 
+        u32 src, 
+        u32 dest, 
+        u16 saddr, 
+        u16 daddr) {
+    u32 hash;
+
+    hash = jhash_3words(src, dest, ((u32) saddr << 16) | daddr, _seed);
+    return &dnet->bucket[hash & (dnet->buckets - 1)];
+}
+
+
+int __init
+dnp3_session_init(void) {
+    _seed = get_random_u32();
+
+    _cache = kmem_cache_create("xt_dnp3_session", 
+            sizeof(struct xt_dnp3_session), 
+            0, 
+            SLAB_HWCACHE_ALIGN, 
+            NULL);
+    if (!_cache) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+
+/*
+    This function returns the active session between the DNP3 link layer addresses 
+    passed held with the reassembly state of a connection, or NULL where no such 
+    session is held, releasing any sessions of the connection which have expired. 
+    Where slot is not NULL, an inactive entry which may be used for a new session 
+    is returned in slot.
+*/
+
+static struct xt_dnp3_link *
+dnp3_session_link(struct xt_dnp3_net *dnet, 
+        struct xt_dnp3_stream *stream, 
+        u32 src, 
+        u32 dest, 
+        u16 saddr, 
+        u16 daddr, 
+        struct xt_dnp3_link **slot) {
+    struct xt_dnp3_link *link;
+    unsigned int index;
+
+    for (index = 0; index < XT_DNP3_LINKS; ++index) {
+        link = &stream->link[index];
+        if ((link->active) &&
+                (time_after(jiffies, link->expires))) {
+            dnp3_apdu_put(link->apdu, link);
+            link->apdu = NULL;
+            link->active = false;
+            link->frames = 0;
+            atomic_dec(&dnet->links);
+            dnp3_stats_inc(XT_DNP3_STAT_EXPIRED);
+            trace_dnp3_session_close(src, dest, link->saddr, link->daddr, link->seq, link->func, XT_DNP3_STAT_EXPIRED);
+        }
+        if (!link->active) {
+            if ((slot) &&
+                    (!*slot)) {
+                *slot = link;
+            }
+            continue;
+        }
+        if ((link->saddr == saddr) &&
+                (link->daddr == daddr)) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+
+static struct xt_dnp3_session *
+dnp3_session_lookup(struct xt_dnp3_bucket *bucket, 
+        u32 src, 
+        u32 dest, 
+        u16 saddr, 
+        u16 daddr) {
+    struct xt_dnp3_session *session;
+
+    hlist_for_each_entry_rcu(session, &bucket->head, node) {
+        if ((session->dest == dest) &&
+                (session->src == src) &&
+                (session->daddr == daddr) &&
+                (session->saddr == saddr) &&
+                (READ_ONCE(session->active)) &&
+                (!time_after(jiffies, READ_ONCE(session->expires)))) {
+            return session;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+    This function releases the sessions of the session table of a namespace as 
+    the namespace is destroyed, and must be called with bottom halves disabled and 
+    the namespace entered, such that the buffers of application fragments under 
+    reassembly are returned and counted against this namespace.
+*/
+
+void
+dnp3_session_net_exit(struct xt_dnp3_net *dnet) {
+    struct xt_dnp3_session *session;
+    struct hlist_node *next;
+    unsigned int index;
+
+    for (index = 0; index < dnet->buckets; ++index) {
+        hlist_for_each_entry_safe(session, next, &dnet->bucket[index].head, node) {
+            hlist_del(&session->node);
+            dnp3_apdu_put(session->apdu, session);
+            kmem_cache_free(_cache, session);
+        }
+    }
+    kvfree(dnet->bucket);
+}
+
+
+int
+dnp3_session_net_init(struct xt_dnp3_net *dnet) {
+    unsigned int index;
+
+    dnet->buckets = roundup_pow_of_two(dnet->sessions);
+    if (!(dnet->bucket = kvcalloc(dnet->buckets, sizeof(*dnet->bucket), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+    for (index = 0; index < dnet->buckets; ++index) {
+        INIT_HLIST_HEAD(&dnet->bucket[index].head);
+        spin_lock_init(&dnet->bucket[index].lock);
+    }
+    atomic_set(&dnet->count, 0);
+    atomic_set(&dnet->hand, 0);
+    atomic_set(&dnet->links, 0);
+    return 0;
+}
+
+
+/*
+    This function opens a session for a multi-frame message upon its first frame. 
+    Where payload is not NULL, the reassembly of the application fragment of the 
+    message is commenced with the user data of this frame, with one returned where 
+    a buffer is available for this fragment. A retransmission of the first frame 
+    of the message in progress is passed as a duplicate, without restarting the 
+    session.
+*/
+
+int
+dnp3_session_open(void *context, 
+        u32 src, 
+        u32 dest, 
+        u16 saddr, 
+        u16 daddr, 
+        u8 seq, 
+        u32 digest, 
+        u8 func, 
+        const u8 *payload) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    struct xt_dnp3_bucket *bucket;
+    struct xt_dnp3_session *entry, *session;
+    struct xt_dnp3_link *link, *slot;
+    unsigned long expires;
+    int ret;
+
+    expires = jiffies + msecs_to_jiffies(READ_ONCE(dnet->session_timeout));
+    if (context) {
+        slot = NULL;
+        if ((link = dnp3_session_link(dnet, context, src, dest, saddr, daddr, &slot)) != NULL) {
+            if (dnp3_session_duplicate(link->digest, link->frames, link->seq, seq, digest)) {
+                dnp3_stats_inc(XT_DNP3_STAT_DUPLICATE);
+                return (link->apdu != NULL);
+            }
+            link->seq = seq;
+            link->func = func;
+            link->expires = expires;
+            link->frames = 0;
+            dnp3_session_record(link->digest, &link->frames, seq, digest);
+            dnp3_apdu_put(link->apdu, link);
+            link->apdu = dnp3_apdu_get(link, payload);
+            dnp3_stats_inc(XT_DNP3_STAT_EVICTED);
+            trace_dnp3_session_open(src, dest, saddr, daddr, seq, func, XT_DNP3_STAT_EVICTED);
+            return (link->apdu != NULL);
+        }
+        if (slot) {
+            slot->saddr = saddr;
+            slot->daddr = daddr;
+            slot->seq = seq;
+            slot->func = func;
+            slot->expires = expires;
+            slot->frames = 0;
+            dnp3_session_record(slot->digest, &slot->frames, seq, digest);
+            slot->apdu = dnp3_apdu_get(slot, payload);
+            slot->active = true;
+            atomic_inc(&dnet->links);
+            dnp3_stats_inc(XT_DNP3_STAT_OPENED);
+            trace_dnp3_session_open(src, dest, saddr, daddr, seq, func, XT_DNP3_STAT_OPENED);
+            return (slot->apdu != NULL);
+        }
+    }
+
+    /*
+        Where a session already exists for this combination of IP and DNP3 link 
+        layer addresses, the first frame of a new multi-frame message restarts the 
+        transport sequence of the existing session.
+    */
+
+    bucket = dnp3_session_hash(dnet, src, dest, saddr, daddr);
+    if ((session = dnp3_session_lookup(bucket, src, dest, saddr, daddr)) != NULL) {
+        spin_lock_bh(&session->lock);
+        if ((session->active) &&
+                (dnp3_session_duplicate(session->digest, session->frames, session->seq, seq, digest))) {
+            ret = (session->apdu != NULL);
+            spin_unlock_bh(&session->lock);
+            dnp3_stats_inc(XT_DNP3_STAT_DUPLICATE);
+            return ret;
+        }
+        if (session->active) {
+            session->seq = seq;
+            session->func = func;
+            WRITE_ONCE(session->expires, expires);
+            WRITE_ONCE(session->referenced, true);
+            session->frames = 0;
+            dnp3_session_record(session->digest, &session->frames, seq, digest);
+            dnp3_apdu_put(session->apdu, session);
+            session->apdu = dnp3_apdu_get(session, payload);
+            ret = (session->apdu != NULL);
+            spin_unlock_bh(&session->lock);
+            dnp3_stats_inc(XT_DNP3_STAT_EVICTED);
+            trace_dnp3_session_open(src, dest, saddr, daddr, seq, func, XT_DNP3_STAT_EVICTED);
+            return ret;
+        }
+        spin_unlock_bh(&session->lock);
+    }
+
+    /*
+        Where the session table is full, a session is evicted to make room for the 
+        session of this message. The count of sessions is decremented as a session 
+        is removed from the table, rather than upon its release after an RCU grace 
+        period, such that the evicted session is immediately replaced.
+    */
+
+    if ((atomic_inc_return(&dnet->count) > READ_ONCE(dnet->sessions)) &&
+            (!dnp3_session_evict(dnet))) {
+        atomic_dec(&dnet->count);
+        return -ENOSPC;
+    }
+    if (!(session = kmem_cache_alloc(_cache, GFP_ATOMIC))) {
+        atomic_dec(&dnet->count);
+        return -ENOMEM;
+    }
+    spin_lock_init(&session->lock);
+    session->dest = dest;
+    session->src = src;
+    session->daddr = daddr;
+    session->saddr = saddr;
+    session->seq = seq;
+    session->func = func;
+    session->expires = expires;
+    session->referenced = true;
+    session->frames = 0;
+    dnp3_session_record(session->digest, &session->frames, seq, digest);
+    session->active = true;
+
+    spin_lock_bh(&bucket->lock);
+    dnp3_session_expire(dnet, bucket);
+    if ((entry = dnp3_session_lookup(bucket, src, dest, saddr, daddr)) != NULL) {
+        spin_lock(&entry->lock);
+        entry->seq = seq;
+        entry->func = func;
+        WRITE_ONCE(entry->expires, expires);
+        WRITE_ONCE(entry->referenced, true);
+        entry->frames = 0;
+        dnp3_session_record(entry->digest, &entry->frames, seq, digest);
+        dnp3_apdu_put(entry->apdu, entry);
+        entry->apdu = dnp3_apdu_get(entry, payload);
+        ret = (entry->apdu != NULL);
+        spin_unlock(&entry->lock);
+        spin_unlock_bh(&bucket->lock);
+
+        kmem_cache_free(_cache, session);
+        atomic_dec(&dnet->count);
+        dnp3_stats_inc(XT_DNP3_STAT_EVICTED);
+        trace_dnp3_session_open(src, dest, saddr, daddr, seq, func, XT_DNP3_STAT_EVICTED);
+        return ret;
+    }
+
+    /*
+        The session is not yet visible to other CPUs and as such, the buffer for 
+        the reassembly of its application fragment is acquired without the session 
+        lock.
+    */
+
+    session->apdu = dnp3_apdu_get(session, payload);
+    hlist_add_head_rcu(&session->node, &bucket->head);
+    spin_unlock_bh(&bucket->lock);
+    dnp3_stats_inc(XT_DNP3_STAT_OPENED);
+    trace_dnp3_session_open(src, dest, saddr, daddr, seq, func, XT_DNP3_STAT_OPENED);
+
+    return (session->apdu != NULL);
+}
+
+
+static inline void
+dnp3_session_record(u32 *digests, 
+        u8 *frames, 
+        u8 seq, 
+        u32 digest) {
+    digests[seq & (XT_DNP3_DIGESTS - 1)] = digest;
+    if (*frames < XT_DNP3_DIGESTS) {
+        ++*frames;
+    }
+}
+
+
+/*
+    This function releases the sessions held with the reassembly state of a 
+    connection, and must be called with bottom halves disabled and the namespace 
+    of the connection entered.
+*/
+
+void
+dnp3_session_release(struct xt_dnp3_stream *stream) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    unsigned int index;
+
+    for (index = 0; index < XT_DNP3_LINKS; ++index) {
+        if (stream->link[index].active) {
+            dnp3_apdu_put(stream->link[index].apdu, &stream->link[index]);
+            stream->link[index].apdu = NULL;
+            stream->link[index].active = false;
+            atomic_dec(&dnet->links);
+        }
+    }
+}
+
+
+/*
+    The frame counts by which frames are selected for sampled CRC validation are 
+    held in a fixed table of each namespace indexed by a hash of the source and 
+    destination IP addresses. These counts are updated without locking - a lost 
+    update on concurrent evaluation of frames between the same addresses, or the 
+    sharing of a count by colliding address pairs, only perturbs which frames are 
+    sampled and not the proportion of frames validated.
+*/
+
+u32
+dnp3_session_sample(u32 src, u32 dest) {
+    struct xt_dnp3_net *dnet = __this_cpu_read(dnp3_net_current);
+    u32 count, *entry;
+
+    entry = &dnet->sample[jhash_2words(src, dest, _seed) & (XT_DNP3_SAMPLES - 1)];
+    count = READ_ONCE(*entry);
+    WRITE_ONCE(*entry, count + 1);
+    return count;
+}
+
+
+/*
+    This function removes an active session from the session table, releasing the 
+    buffer of any application fragment under reassembly, and must be called with 
+    the lock of the bucket of the session held. False is returned where the 
+    session is no longer active, as where its final frame is being processed 
+    concurrently, in which case the session is removed by that frame.
+*/
+
+static bool
+dnp3_session_unlink(struct xt_dnp3_net *dnet, struct xt_dnp3_session *session, int stat) {
+    spin_lock(&session->lock);
+    if (!session->active) {
+        spin_unlock(&session->lock);
+        return false;
+    }
+    session->active = false;
+    dnp3_apdu_put(session->apdu, session);
+    session->apdu = NULL;
+    spin_unlock(&session->lock);
+
+    hlist_del_rcu(&session->node);
+    atomic_dec(&dnet->count);
+    trace_dnp3_session_close(session->src, session->dest, session->saddr, session->daddr, session->seq, session->func, stat);
+    call_rcu(&session->rcu, dnp3_session_free);
+    dnp3_stats_inc(stat);
+    return true;
+}
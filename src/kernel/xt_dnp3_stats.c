@@ -0,0 +1,284 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/jump_label.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <net/net_namespace.h>
+
+#include "xt_dnp3.h"
+
+#define CREATE_TRACE_POINTS
+#include "xt_dnp3_trace.h"
+
+
+#define XT_DNP3_LATENCY_BUCKETS         (32)
+
+
+static inline unsigned int dnp3_stats_bucket(u64 ns);
+static int dnp3_stats_count(struct seq_file *seq, void *v);
+static int dnp3_stats_crc(struct seq_file *seq, void *v);
+static int dnp3_stats_histogram(const char *val, const struct kernel_param *kp);
+static int dnp3_stats_latency_show(struct seq_file *seq, void *v);
+
+
+/*
+    Counters are maintained per-CPU for each network namespace and updated without
+    atomic operations from within the packet path, and are summed across CPUs only
+    when read. The frame parsing and session counters, together with the number of
+    sessions currently held, are read from /proc/net/xt_dnp3_stats and the CRC
+    validation counters for each validation mode from /proc/net/xt_dnp3_crc, both
+    of which are created within each namespace.
+*/
+
+static const char * const _count[XT_DNP3_STAT_MAX] = {
+    [XT_DNP3_STAT_PACKETS]      = "packets",
+    [XT_DNP3_STAT_TRUSTED]      = "trusted",
+    [XT_DNP3_STAT_FRAMES]       = "frames",
+    [XT_DNP3_STAT_SYNC]         = "sync",
+    [XT_DNP3_STAT_HEADER_CRC]   = "header_crc",
+    [XT_DNP3_STAT_BLOCK_CRC]    = "block_crc",
+    [XT_DNP3_STAT_TRUNCATED]    = "truncated",
+    [XT_DNP3_STAT_HELD]         = "held",
+    [XT_DNP3_STAT_SEQUENCE]     = "sequence",
+    [XT_DNP3_STAT_DUPLICATE]    = "duplicate",
+    [XT_DNP3_STAT_NOSESSION]    = "nosession",
+    [XT_DNP3_STAT_EXHAUSTED]    = "exhausted",
+    [XT_DNP3_STAT_NOMEM]        = "nomem",
+    [XT_DNP3_STAT_OPENED]       = "opened",
+    [XT_DNP3_STAT_CLOSED]       = "closed",
+    [XT_DNP3_STAT_EVICTED]      = "evicted",
+    [XT_DNP3_STAT_EXPIRED]      = "expired",
+    [XT_DNP3_STAT_ASSEMBLED]    = "assembled",
+    [XT_DNP3_STAT_ABANDONED]    = "abandoned",
+    [XT_DNP3_STAT_LEARNED]      = "learned",
+    [XT_DNP3_STAT_UNLEARNED]    = "unlearned",
+};
+
+static const char * const _crc[XT_DNP3_CRC_MAX] = {
+    [XT_DNP3_CRC_FULL]      = "full",
+    [XT_DNP3_CRC_HEADER]    = "header",
+    [XT_DNP3_CRC_NONE]      = "none",
+    [XT_DNP3_CRC_SAMPLE]    = "sample",
+};
+
+
+/*
+    Where the histogram module parameter is set, the time taken to parse the 
+    payload of each packet, and this time divided by the number of frames of the 
+    packet, are counted per-CPU in buckets of powers of two nanoseconds and read 
+    from the packet_ns and frame_ns files of /sys/kernel/debug/xt_dnp3. The timing 
+    of packets is patched into the packet path by a static key only while the 
+    parameter is set, and the histograms are cleared each time it is set.
+*/
+
+struct xt_dnp3_latency {
+    u64 packet[XT_DNP3_LATENCY_BUCKETS];
+    u64 frame[XT_DNP3_LATENCY_BUCKETS];
+};
+
+DEFINE_STATIC_KEY_FALSE(dnp3_histogram);
+
+static DEFINE_PER_CPU(struct xt_dnp3_latency, _latency);
+
+static DEFINE_MUTEX(_histogram_lock);
+
+static struct dentry *_debugfs;
+
+static bool histogram;
+
+static const struct kernel_param_ops _histogram_ops = {
+    .set = dnp3_stats_histogram,
+    .get = param_get_bool,
+};
+
+module_param_cb(histogram, &_histogram_ops, &histogram, 0600);
+MODULE_PARM_DESC(histogram, "Record histograms of packet and frame parsing latency in debugfs");
+
+DEFINE_SHOW_ATTRIBUTE(dnp3_stats_latency);
+
+
+static inline unsigned int
+dnp3_stats_bucket(u64 ns) {
+    return (ns == 0) ? 0 : min_t(unsigned int, ilog2(ns) + 1, XT_DNP3_LATENCY_BUCKETS - 1);
+}
+
+
+static int
+dnp3_stats_count(struct seq_file *seq, void *v) {
+    struct xt_dnp3_net *dnet = dnp3_net(seq_file_single_net(seq));
+    unsigned int cpu, index;
+    u64 total;
+
+    for (index = 0; index < XT_DNP3_STAT_MAX; ++index) {
+        total = 0;
+        for_each_possible_cpu(cpu) {
+            total += READ_ONCE(per_cpu_ptr(dnet->stats, cpu)->count[index]);
+        }
+        seq_printf(seq, "%-12s %16llu\n", _count[index], total);
+    }
+    seq_printf(seq, "%-12s %16u\n", "sessions", dnp3_session_count(dnet));
+    return 0;
+}
+
+
+static int
+dnp3_stats_crc(struct seq_file *seq, void *v) {
+    struct xt_dnp3_net *dnet = dnp3_net(seq_file_single_net(seq));
+    const struct xt_dnp3_crc_stats *stats;
+    struct xt_dnp3_crc_stats total;
+    unsigned int cpu, mode;
+
+    seq_printf(seq, "%-8s %16s %16s %16s %16s %16s\n",
+            "mode", "frames", "headers", "blocks", "skipped", "failed");
+    for (mode = 0; mode < XT_DNP3_CRC_MAX; ++mode) {
+        memset(&total, 0, sizeof(total));
+        for_each_possible_cpu(cpu) {
+            stats = &per_cpu_ptr(dnet->stats, cpu)->crc[mode];
+            total.frames += READ_ONCE(stats->frames);
+            total.headers += READ_ONCE(stats->headers);
+            total.blocks += READ_ONCE(stats->blocks);
+            total.skipped += READ_ONCE(stats->skipped);
+            total.failed += READ_ONCE(stats->failed);
+        }
+        seq_printf(seq, "%-8s %16llu %16llu %16llu %16llu %16llu\n",
+                _crc[mode],
+                total.frames,
+                total.headers,
+                total.blocks,
+                total.skipped,
+                total.failed);
+    }
+    return 0;
+}
+
+
+void
+dnp3_stats_exit(void) {
+    debugfs_remove(_debugfs);
+}
+
+
+static int
+dnp3_stats_histogram(const char *val, const struct kernel_param *kp) {
+    unsigned int cpu;
+    bool enable;
+    int ret;
+
+    if ((ret = kstrtobool(val, &enable)) != 0) {
+        return ret;
+    }
+    mutex_lock(&_histogram_lock);
+    if ((enable) &&
+            (!histogram)) {
+        for_each_possible_cpu(cpu) {
+            memset(per_cpu_ptr(&_latency, cpu), 0, sizeof(struct xt_dnp3_latency));
+        }
+        static_branch_enable(&dnp3_histogram);
+    }
+    else if ((!enable) &&
+            (histogram)) {
+        static_branch_disable(&dnp3_histogram);
+    }
+    histogram = enable;
+    mutex_unlock(&_histogram_lock);
+    return 0;
+}
+
+
+/*
+    The histograms are a debugging aid, and as such, the failure to create their 
+    files does not prevent the loading of the module.
+*/
+
+int __init
+dnp3_stats_init(void) {
+    _debugfs = debugfs_create_dir("xt_dnp3", NULL);
+    debugfs_create_file("packet_ns", 0444, _debugfs, 
+            (void *) offsetof(struct xt_dnp3_latency, packet), 
+            &dnp3_stats_latency_fops);
+    debugfs_create_file("frame_ns", 0444, _debugfs, 
+            (void *) offsetof(struct xt_dnp3_latency, frame), 
+            &dnp3_stats_latency_fops);
+    return 0;
+}
+
+
+/*
+    This function counts the time taken to parse the payload of a packet, and 
+    must be called with bottom halves disabled.
+*/
+
+void
+dnp3_stats_latency(u64 ns, const struct xt_dnp3_packet *packet) {
+    struct xt_dnp3_latency *latency;
+    unsigned int index;
+    u32 frames;
+
+    latency = this_cpu_ptr(&_latency);
+    ++latency->packet[dnp3_stats_bucket(ns)];
+    for (frames = 0, index = 0; index < packet->count; ++index) {
+        frames += packet->frame[index].count;
+    }
+    if (frames > 0) {
+        ++latency->frame[dnp3_stats_bucket(div_u64(ns, frames))];
+    }
+}
+
+
+static int
+dnp3_stats_latency_show(struct seq_file *seq, void *v) {
+    u64 count[XT_DNP3_LATENCY_BUCKETS];
+    unsigned int cpu, index, last;
+    size_t offset;
+
+    offset = (size_t) seq->private;
+    memset(count, 0, sizeof(count));
+    for_each_possible_cpu(cpu) {
+        for (index = 0; index < XT_DNP3_LATENCY_BUCKETS; ++index) {
+            count[index] += READ_ONCE(((const u64 *) ((const u8 *) per_cpu_ptr(&_latency, cpu) + offset))[index]);
+        }
+    }
+    for (last = XT_DNP3_LATENCY_BUCKETS; (last > 0) && (count[last - 1] == 0); --last) {
+        ;
+    }
+
+    seq_printf(seq, "%12s %12s %16s\n", "from", "to", "count");
+    for (index = 0; index < last; ++index) {
+        if (index == (XT_DNP3_LATENCY_BUCKETS - 1)) {
+            seq_printf(seq, "%12llu %12s %16llu\n", 1ULL << (index - 1), "-", count[index]);
+        }
+        else {
+            seq_printf(seq, "%12llu %12llu %16llu\n", 
+                    (index == 0) ? 0ULL : (1ULL << (index - 1)), 
+                    1ULL << index, 
+                    count[index]);
+        }
+    }
+    return 0;
+}
+
+
+void
+dnp3_stats_net_exit(struct net *net) {
+    remove_proc_entry("xt_dnp3_crc", net->proc_net);
+    remove_proc_entry("xt_dnp3_stats", net->proc_net);
+}
+
+
+int
+dnp3_stats_net_init(struct net *net) {
+    if (!proc_create_net_single("xt_dnp3_stats", 0444, net->proc_net, dnp3_stats_count, NULL)) {
+        return -ENOMEM;
+    }
+    if (!proc_create_net_single("xt_dnp3_crc", 0444, net->proc_net, dnp3_stats_crc, NULL)) {
+        remove_proc_entry("xt_dnp3_stats", net->proc_net);
+        return -ENOMEM;
+    }
+    return 0;
+}
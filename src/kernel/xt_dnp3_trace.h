@@ -0,0 +1,160 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM xt_dnp3
+
+#if !defined(_XT_DNP3_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _XT_DNP3_TRACE_H
+
+
+#include <linux/tracepoint.h>
+
+#include "xt_dnp3.h"
+
+
+/*
+    The outcome of the parsing of each frame, and the opening, advancing and
+    closing of the transport sessions of multi-frame messages, are reported through
+    the tracepoints below. Each tracepoint is patched into the packet path only
+    while enabled, such as with:
+
+        echo 1 > /sys/kernel/tracing/events/xt_dnp3/enable
+
+    The reason of each event is the statistics counter incremented for the frame
+    or session, with complete frames which are neither invalid nor without a
+    session reported as accepted.
+*/
+
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_FRAMES);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_SYNC);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_HEADER_CRC);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_BLOCK_CRC);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_TRUNCATED);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_NOSESSION);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_OPENED);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_CLOSED);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_EVICTED);
+TRACE_DEFINE_ENUM(XT_DNP3_STAT_EXPIRED);
+
+#define dnp3_trace_reason(reason) \
+        __print_symbolic(reason, \
+                { XT_DNP3_STAT_FRAMES,      "accepted" }, \
+                { XT_DNP3_STAT_SYNC,        "sync" }, \
+                { XT_DNP3_STAT_HEADER_CRC,  "header_crc" }, \
+                { XT_DNP3_STAT_BLOCK_CRC,   "block_crc" }, \
+                { XT_DNP3_STAT_TRUNCATED,   "truncated" }, \
+                { XT_DNP3_STAT_NOSESSION,   "nosession" }, \
+                { XT_DNP3_STAT_OPENED,      "opened" }, \
+                { XT_DNP3_STAT_CLOSED,      "closed" }, \
+                { XT_DNP3_STAT_EVICTED,     "evicted" }, \
+                { XT_DNP3_STAT_EXPIRED,     "expired" })
+
+
+TRACE_EVENT(dnp3_frame,
+
+    TP_PROTO(u32 src, u32 dest, const struct xt_dnp3_frame *frame, int length, int reason),
+
+    TP_ARGS(src, dest, frame, length, reason),
+
+    TP_STRUCT__entry(
+        __field(u32, src)
+        __field(u32, dest)
+        __field(u16, saddr)
+        __field(u16, daddr)
+        __field(u16, flags)
+        __field(u8, control)
+        __field(u8, tspt)
+        __field(u8, func)
+        __field(u8, crc)
+        __field(int, length)
+        __field(int, reason)
+    ),
+
+    TP_fast_assign(
+        __entry->src = src;
+        __entry->dest = dest;
+        __entry->saddr = frame->saddr;
+        __entry->daddr = frame->daddr;
+        __entry->flags = frame->flags;
+        __entry->control = frame->control;
+        __entry->tspt = frame->tspt;
+        __entry->func = frame->func;
+        __entry->crc = frame->crc;
+        __entry->length = length;
+        __entry->reason = reason;
+    ),
+
+    TP_printk("%pI4h > %pI4h %u > %u control 0x%02x tspt 0x%02x fc %u flags 0x%04x crc 0x%02x length %d %s",
+            &__entry->src,
+            &__entry->dest,
+            __entry->saddr,
+            __entry->daddr,
+            __entry->control,
+            __entry->tspt,
+            __entry->func,
+            __entry->flags,
+            __entry->crc,
+            __entry->length,
+            dnp3_trace_reason(__entry->reason))
+);
+
+
+DECLARE_EVENT_CLASS(dnp3_session,
+
+    TP_PROTO(u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u8 func, int reason),
+
+    TP_ARGS(src, dest, saddr, daddr, seq, func, reason),
+
+    TP_STRUCT__entry(
+        __field(u32, src)
+        __field(u32, dest)
+        __field(u16, saddr)
+        __field(u16, daddr)
+        __field(u8, seq)
+        __field(u8, func)
+        __field(int, reason)
+    ),
+
+    TP_fast_assign(
+        __entry->src = src;
+        __entry->dest = dest;
+        __entry->saddr = saddr;
+        __entry->daddr = daddr;
+        __entry->seq = seq;
+        __entry->func = func;
+        __entry->reason = reason;
+    ),
+
+    TP_printk("%pI4h > %pI4h %u > %u seq %u fc %u %s",
+            &__entry->src,
+            &__entry->dest,
+            __entry->saddr,
+            __entry->daddr,
+            __entry->seq,
+            __entry->func,
+            dnp3_trace_reason(__entry->reason))
+);
+
+DEFINE_EVENT(dnp3_session, dnp3_session_open,
+    TP_PROTO(u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u8 func, int reason),
+    TP_ARGS(src, dest, saddr, daddr, seq, func, reason)
+);
+
+DEFINE_EVENT(dnp3_session, dnp3_session_advance,
+    TP_PROTO(u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u8 func, int reason),
+    TP_ARGS(src, dest, saddr, daddr, seq, func, reason)
+);
+
+DEFINE_EVENT(dnp3_session, dnp3_session_close,
+    TP_PROTO(u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u8 func, int reason),
+    TP_ARGS(src, dest, saddr, daddr, seq, func, reason)
+);
+
+
+#endif
+
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE xt_dnp3_trace
+
+#include <trace/define_trace.h>
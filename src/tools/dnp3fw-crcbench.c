@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_crc.h"
+
+
+/*
+    This program compares the performance of the CRC engines of the xt_dnp3 kernel 
+    module, compiled from the same source, against a corpus of randomly generated 
+    DNP3 frames of varying length. Prior to measurement, the output of each engine 
+    is verified against the byte-at-a-time table engine and known DNP3 frames.
+*/
+
+#define FRAME_MAX                       (292)
+
+
+struct bench_engine {
+    const char *name;
+    int engine;
+};
+
+static const struct bench_engine _engines[] = {
+        { .name = "table", .engine = DNP3_CRC_TABLE },
+        { .name = "slice16", .engine = DNP3_CRC_SLICE16 },
+};
+
+
+static void bench_build_frame( uint8_t *frame, uint32_t *length, uint8_t bytes );
+
+static uint64_t bench_now( void );
+
+static int bench_verify( void );
+
+
+static void
+bench_build_frame( uint8_t *frame, uint32_t *length, uint8_t bytes )
+{
+    uint32_t index, offset, segment;
+    uint16_t crc;
+
+    frame[0] = 0x05;
+    frame[1] = 0x64;
+    frame[2] = ( uint8_t ) ( bytes + 5 );
+    for( index = 3; index < 8; ++index ) {
+        frame[ index ] = ( uint8_t ) rand();
+    }
+    crc = dnp3_crc_table( frame, 8 );
+    frame[8] = ( uint8_t ) ( crc & 0xff );
+    frame[9] = ( uint8_t ) ( crc >> 8 );
+
+    for( offset = DNP3_LINK_HDR_LENGTH; bytes > 0; bytes -= segment ) {
+        segment = ( bytes > DNP3_LINK_BLOCK_LENGTH ) ? DNP3_LINK_BLOCK_LENGTH : bytes;
+        for( index = 0; index < segment; ++index ) {
+            frame[ offset + index ] = ( uint8_t ) rand();
+        }
+        crc = dnp3_crc_table( &frame[ offset ], segment );
+        frame[ offset + segment ] = ( uint8_t ) ( crc & 0xff );
+        frame[ offset + segment + 1 ] = ( uint8_t ) ( crc >> 8 );
+        offset += ( segment + DNP3_LINK_CRC_LENGTH );
+    }
+    *length = offset;
+}
+
+
+static uint64_t
+bench_now( void )
+{
+    struct timespec ts;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( ( uint64_t ) ts.tv_sec * 1000000000ULL ) + ts.tv_nsec;
+}
+
+
+static int
+bench_verify( void )
+{
+    /* Link status request from the DNP3 specification examples */
+    static const uint8_t header[] = { 0x05, 0x64, 0x05, 0xc0, 0x01, 0x00, 0x00, 0x04, 0xe9, 0x21 };
+    uint8_t buffer[ DNP3_LINK_BLOCK_LENGTH ];
+    uint32_t index, iteration, len;
+    uint16_t crc;
+
+    for( index = 0; index < ( sizeof( _engines ) / sizeof( _engines[0] ) ); ++index ) {
+        if( _engines[ index ].engine == DNP3_CRC_TABLE ) {
+            crc = dnp3_crc_table( header, 8 );
+        }
+        else {
+            crc = dnp3_crc_slice16( header, 8 );
+        }
+        if( crc != ( header[8] | ( header[9] << 8 ) ) ) {
+            fprintf( stderr, "%s: header CRC mismatch (0x%04x)\n", _engines[ index ].name, crc );
+            return -1;
+        }
+    }
+
+    for( iteration = 0; iteration < 100000; ++iteration ) {
+        len = ( uint32_t ) rand() % ( sizeof( buffer ) + 1 );
+        for( index = 0; index < len; ++index ) {
+            buffer[ index ] = ( uint8_t ) rand();
+        }
+        if( dnp3_crc_table( buffer, len ) != dnp3_crc_slice16( buffer, len ) ) {
+            fprintf( stderr, "slice16: CRC mismatch (length %u)\n", len );
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int
+main( int argc, char **argv )
+{
+    uint8_t *frames;
+    uint32_t *lengths;
+    uint64_t elapsed, start, total;
+    uint32_t bytes, count, index, iterations, iteration;
+    int c, engine, errors;
+
+    count = 1024;
+    iterations = 2000;
+    bytes = 0;
+
+    while( ( c = getopt( argc, argv, "n:i:l:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'n':
+                count = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'i':
+                iterations = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'l':
+                bytes = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                if( bytes > 250 ) {
+                    fprintf( stderr, "Data length must be no greater than 250 bytes\n" );
+                    return 1;
+                }
+                break;
+            case 'h':
+            default:
+                fprintf( stderr, "Usage: %s [-n frames] [-i iterations] [-l data-length]\n", argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( count == 0 ) {
+        count = 1;
+    }
+
+    dnp3_crc_init();
+    srand( 1 );
+    if( bench_verify() != 0 ) {
+        return 1;
+    }
+
+    frames = malloc( ( size_t ) count * FRAME_MAX );
+    lengths = malloc( ( size_t ) count * sizeof( *lengths ) );
+    if( ( frames == NULL ) ||
+            ( lengths == NULL ) ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return 1;
+    }
+
+    /*
+        Where a data length is not specified, the corpus comprises frames with data 
+        lengths uniformly distributed between 1 and 250 bytes.
+    */
+
+    for( index = 0, total = 0; index < count; ++index ) {
+        bench_build_frame( &frames[ index * FRAME_MAX ], 
+                &lengths[ index ], 
+                ( uint8_t ) ( bytes ? bytes : ( 1 + ( rand() % 250 ) ) ) );
+        total += lengths[ index ];
+    }
+
+    printf( "%-10s %12s %12s %12s\n", "engine", "ns/frame", "Mframes/s", "MB/s" );
+    for( engine = 0; engine < ( int ) ( sizeof( _engines ) / sizeof( _engines[0] ) ); ++engine ) {
+        errors = 0;
+        start = bench_now();
+        for( iteration = 0; iteration < iterations; ++iteration ) {
+            for( index = 0; index < count; ++index ) {
+                errors += ( dnp3_crc_check_frame( &frames[ index * FRAME_MAX ],
+                        lengths[ index ],
+                        _engines[ engine ].engine ) != 0 );
+            }
+        }
+        elapsed = bench_now() - start;
+        if( errors != 0 ) {
+            fprintf( stderr, "%s: %d frame validation failures\n", _engines[ engine ].name, errors );
+            return 1;
+        }
+        printf( "%-10s %12.2f %12.2f %12.1f\n", 
+                _engines[ engine ].name,
+                ( double ) elapsed / ( ( double ) count * iterations ),
+                ( ( double ) count * iterations * 1000.0 ) / elapsed,
+                ( ( double ) total * iterations * 1000.0 ) / elapsed );
+    }
+
+    free( lengths );
+    free( frames );
+    return 0;
+}
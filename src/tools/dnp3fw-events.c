@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This program reads the event records written by the xt_dnp3 kernel module for
+    frames of packets matched or dropped by rules with the --event option, where
+    the module is loaded with a non-zero events parameter. The per-CPU rings of
+    the module are mapped from /proc/net/xt_dnp3_events of the network namespace
+    in which this program is run, with the records available in each ring read in
+    place and the ring released to the module by a single update of its tail per
+    batch. Records are either printed as text, or
+    written unmodified to a file with the -w option for later processing.
+
+    Each ring has a single producer, the CPU which owns it, and supports a single
+    consumer, such that only one instance of this program may read the rings of
+    a namespace at a time. Records which could not be written as a ring was full
+    are counted by the module and reported as lost upon exit.
+*/
+
+#define EVENTS_FILE                     "/proc/net/xt_dnp3_events"
+
+#define EVENTS_INTERVAL                 (100)
+
+
+static uint32_t events_drain( struct xt_dnp3_ring *ring, FILE *out, int binary, uint64_t limit );
+
+static void events_print( FILE *out, const struct xt_dnp3_event *event );
+
+static void events_signal( int signum );
+
+
+static volatile sig_atomic_t _stop;
+
+
+/*
+    This function reads the records available in a ring, up to limit records
+    where limit is non-zero, and returns the number of records read. The records
+    are released to the producer once written, by a single store of the tail of
+    the ring which orders the reads of these records before their reuse.
+*/
+
+static uint32_t
+events_drain( struct xt_dnp3_ring *ring, FILE *out, int binary, uint64_t limit )
+{
+    const struct xt_dnp3_event *record;
+    uint64_t head, tail;
+    uint32_t count, mask;
+
+    record = ( const struct xt_dnp3_event * ) ( ( const uint8_t * ) ring + ring->offset );
+    mask = ring->size - 1;
+    head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE );
+    tail = ring->tail;
+    if( ( limit != 0 ) &&
+            ( ( head - tail ) > limit ) ) {
+        head = tail + limit;
+    }
+
+    for( count = 0; tail != head; ++tail, ++count ) {
+        if( binary ) {
+            ( void ) fwrite( &record[ tail & mask ], sizeof( *record ), 1, out );
+        }
+        else {
+            events_print( out, &record[ tail & mask ] );
+        }
+    }
+    __atomic_store_n( &ring->tail, tail, __ATOMIC_RELEASE );
+    return count;
+}
+
+
+static void
+events_print( FILE *out, const struct xt_dnp3_event *event )
+{
+    static const char *reasons[] = { "MATCH", "HOTDROP" };
+    char src[ INET_ADDRSTRLEN ], dest[ INET_ADDRSTRLEN ], func[ 8 ];
+
+    ( void ) inet_ntop( AF_INET, &event->src, src, sizeof( src ) );
+    ( void ) inet_ntop( AF_INET, &event->dest, dest, sizeof( dest ) );
+    if( ( event->flags & XT_DNP3_FRAME_FC ) != 0 ) {
+        ( void ) snprintf( func, sizeof( func ), "%u", event->func );
+    }
+    else {
+        ( void ) strcpy( func, "-" );
+    }
+    fprintf( out, "%llu.%09llu %s:%u > %s:%u %u > %u control 0x%02x tspt 0x%02x fc %s frames %u %s tag %u\n",
+            ( unsigned long long ) ( event->time / 1000000000ULL ),
+            ( unsigned long long ) ( event->time % 1000000000ULL ),
+            src,
+            ntohs( event->sport ),
+            dest,
+            ntohs( event->dport ),
+            event->saddr,
+            event->daddr,
+            event->control,
+            event->tspt,
+            func,
+            event->count,
+            ( event->reason < XT_DNP3_EVENT_MAX ) ? reasons[ event->reason ] : "UNKNOWN",
+            event->tag );
+}
+
+
+static void
+events_signal( int signum )
+{
+    ( void ) signum;
+    _stop = 1;
+}
+
+
+int
+main( int argc, char **argv )
+{
+    struct xt_dnp3_ring *ring;
+    struct timespec interval;
+    struct sigaction sa;
+    const char *file, *path;
+    uint8_t *map;
+    uint64_t count, limit, lost;
+    uint32_t index, batch, rings, stride;
+    size_t size;
+    FILE *out;
+    int c, fd;
+
+    file = EVENTS_FILE;
+    path = NULL;
+    limit = 0;
+    interval.tv_sec = EVENTS_INTERVAL / 1000;
+    interval.tv_nsec = ( EVENTS_INTERVAL % 1000 ) * 1000000L;
+
+    while( ( c = getopt( argc, argv, "c:f:i:w:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'c':
+                limit = strtoull( optarg, NULL, 10 );
+                break;
+            case 'f':
+                file = optarg;
+                break;
+            case 'i':
+                count = strtoull( optarg, NULL, 10 );
+                interval.tv_sec = ( time_t ) ( count / 1000 );
+                interval.tv_nsec = ( long ) ( count % 1000 ) * 1000000L;
+                break;
+            case 'w':
+                path = optarg;
+                break;
+            case 'h':
+            default:
+                fprintf( stderr, "Usage: %s [-c count] [-f file] [-i interval] [-w output]\n", argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( optind != argc ) {
+        fprintf( stderr, "Usage: %s [-c count] [-f file] [-i interval] [-w output]\n", argv[0] );
+        return 1;
+    }
+
+    if( ( fd = open( file, O_RDWR ) ) < 0 ) {
+        fprintf( stderr, "Unable to open `%s': %s\n", file, strerror( errno ) );
+        return 1;
+    }
+
+    /*
+        The header page of the first ring is mapped alone to read the number and
+        stride of the rings, which are then mapped in whole.
+    */
+
+    size = ( size_t ) sysconf( _SC_PAGESIZE );
+    if( ( map = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 ) ) == MAP_FAILED ) {
+        fprintf( stderr, "Unable to map `%s': %s\n", file, strerror( errno ) );
+        ( void ) close( fd );
+        return 1;
+    }
+    ring = ( struct xt_dnp3_ring * ) map;
+    rings = ring->rings;
+    stride = ring->stride;
+    size = ( size_t ) stride * rings;
+    ( void ) munmap( map, ( size_t ) sysconf( _SC_PAGESIZE ) );
+    if( ( map = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ) == MAP_FAILED ) {
+        fprintf( stderr, "Unable to map `%s': %s\n", file, strerror( errno ) );
+        ( void ) close( fd );
+        return 1;
+    }
+    ( void ) close( fd );
+
+    out = stdout;
+    if( ( path != NULL ) &&
+            ( ( out = fopen( path, "wb" ) ) == NULL ) ) {
+        fprintf( stderr, "Unable to open `%s': %s\n", path, strerror( errno ) );
+        ( void ) munmap( map, size );
+        return 1;
+    }
+
+    ( void ) memset( &sa, 0, sizeof( sa ) );
+    sa.sa_handler = events_signal;
+    ( void ) sigaction( SIGINT, &sa, NULL );
+    ( void ) sigaction( SIGTERM, &sa, NULL );
+
+    count = 0;
+    while( ( ! _stop ) &&
+            ( ( limit == 0 ) || ( count < limit ) ) ) {
+        batch = 0;
+        for( index = 0; index < rings; ++index ) {
+            ring = ( struct xt_dnp3_ring * ) ( map + ( ( size_t ) stride * index ) );
+            batch += events_drain( ring, out, ( path != NULL ), ( limit != 0 ) ? limit - count - batch : 0 );
+            if( ( limit != 0 ) &&
+                    ( ( count + batch ) >= limit ) ) {
+                break;
+            }
+        }
+        count += batch;
+        if( batch == 0 ) {
+            ( void ) fflush( out );
+            ( void ) nanosleep( &interval, NULL );
+        }
+    }
+
+    lost = 0;
+    for( index = 0; index < rings; ++index ) {
+        ring = ( struct xt_dnp3_ring * ) ( map + ( ( size_t ) stride * index ) );
+        lost += __atomic_load_n( &ring->lost, __ATOMIC_RELAXED );
+    }
+    fprintf( stderr, "%llu records read, %llu lost\n", ( unsigned long long ) count, ( unsigned long long ) lost );
+
+    if( out != stdout ) {
+        ( void ) fclose( out );
+    }
+    ( void ) munmap( map, size );
+    return 0;
+}
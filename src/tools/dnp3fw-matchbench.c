@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This program measures the frame parsing and rule matching path of the xt_dnp3
+    kernel module, compiled from the same source, against synthetic packets -
+    single and multi-frame packets, packets with invalid CRCs at varying offsets,
+    truncated frames, the frames of multi-frame messages and the first frames of
+    messages opened against a full session table. Each packet is parsed and
+    matched against a --fc rule as by the dnp3 match of the kernel module, with
+    the outcome of each evaluation verified against that expected for the packet,
+    such that a change to this path which alters its outcome results in a non-zero
+    exit status, and the time per packet and per frame reported for each case.
+
+    The connection tracking, per-CPU packet cache and socket buffer access of the
+    kernel module are not measured, being outside of the source shared with these
+    tools.
+*/
+
+#define BENCH_PACKET                    (2048)
+
+#define BENCH_SADDR                     (1)
+
+#define BENCH_DADDR                     (10)
+
+
+struct bench_case {
+    const char *name;                   /* Case name */
+    uint8_t *data;                      /* Packet payloads */
+    uint32_t *length;                   /* Packet payload lengths */
+    uint32_t count;                     /* Number of packets */
+    uint32_t frames;                    /* Frames per packet */
+    uint8_t match;                      /* Expected rule match */
+    uint8_t hotdrop;                    /* Expected hotdrop */
+    uint8_t warm;                       /* Evaluate once before measurement */
+    uint8_t exhausted;                  /* Session table may be exhausted */
+};
+
+
+static int bench_alloc( struct bench_case *bench, const char *name, uint32_t count );
+
+static uint32_t bench_frame( uint8_t *frame, uint16_t daddr, uint16_t saddr, uint8_t tspt, uint8_t func, uint32_t bytes );
+
+static uint64_t bench_now( void );
+
+static int bench_run( const struct bench_case *bench, const struct xt_dnp3_rule *rule, struct xt_dnp3_packet *parsed, uint32_t packets, uint32_t sessions );
+
+
+static int _engine = DNP3_CRC_SLICE16;
+
+
+static int
+bench_alloc( struct bench_case *bench, const char *name, uint32_t count )
+{
+    ( void ) memset( bench, 0, sizeof( *bench ) );
+    bench->name = name;
+    bench->count = count;
+    bench->data = calloc( count, BENCH_PACKET );
+    bench->length = calloc( count, sizeof( *bench->length ) );
+    if( ( bench->data == NULL ) ||
+            ( bench->length == NULL ) ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+    This function writes a frame of unconfirmed user data from the primary station
+    with bytes octets of user data, commencing with the transport header tspt and,
+    for the first frame of a message, the application control and function code
+    func. The length of the frame is returned.
+*/
+
+static uint32_t
+bench_frame( uint8_t *frame, uint16_t daddr, uint16_t saddr, uint8_t tspt, uint8_t func, uint32_t bytes )
+{
+    uint8_t data[ 250 ];
+    uint32_t index, offset, segment;
+    uint16_t crc;
+
+    for( index = 0; index < bytes; ++index ) {
+        data[ index ] = ( uint8_t ) index;
+    }
+    data[0] = tspt;
+    if( tspt & DNP3_TSPT_HDR_FIRST_MASK ) {
+        data[1] = 0xc0 | ( tspt & DNP3_TSPT_HDR_SEQUENCE_MASK & 0x0f );
+        data[2] = func;
+    }
+
+    frame[0] = 0x05;
+    frame[1] = 0x64;
+    frame[2] = ( uint8_t ) ( bytes + 5 );
+    frame[3] = 0xc4;
+    frame[4] = ( uint8_t ) ( daddr & 0xff );
+    frame[5] = ( uint8_t ) ( daddr >> 8 );
+    frame[6] = ( uint8_t ) ( saddr & 0xff );
+    frame[7] = ( uint8_t ) ( saddr >> 8 );
+    crc = dnp3_crc_table( frame, 8 );
+    frame[8] = ( uint8_t ) ( crc & 0xff );
+    frame[9] = ( uint8_t ) ( crc >> 8 );
+
+    for( offset = DNP3_LINK_HDR_LENGTH, index = 0; index < bytes; index += segment ) {
+        segment = ( ( bytes - index ) > DNP3_LINK_BLOCK_LENGTH ) ? DNP3_LINK_BLOCK_LENGTH : ( bytes - index );
+        ( void ) memcpy( &frame[ offset ], &data[ index ], segment );
+        crc = dnp3_crc_table( &frame[ offset ], segment );
+        frame[ offset + segment ] = ( uint8_t ) ( crc & 0xff );
+        frame[ offset + segment + 1 ] = ( uint8_t ) ( crc >> 8 );
+        offset += ( segment + DNP3_LINK_CRC_LENGTH );
+    }
+    return offset;
+}
+
+
+static uint64_t
+bench_now( void )
+{
+    struct timespec ts;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( ( uint64_t ) ts.tv_sec * 1000000000ULL ) + ts.tv_nsec;
+}
+
+
+/*
+    This function parses and matches the packets of a case in turn, until at least
+    the number of packets specified have been evaluated, against a session table
+    of the number of sessions specified, and returns non-zero where the outcome of
+    any evaluation differs from that expected. Cases which depend upon the state
+    of the session table from prior packets are evaluated once before measurement,
+    and where the session table may be exhausted, the drop of a packet for which
+    no session could be opened is accepted as an outcome.
+*/
+
+static int
+bench_run( const struct bench_case *bench,
+        const struct xt_dnp3_rule *rule,
+        struct xt_dnp3_packet *parsed,
+        uint32_t packets,
+        uint32_t sessions )
+{
+    uint64_t elapsed, errors, start;
+    uint32_t frames, index, iteration, iterations;
+    bool hotdrop, match;
+
+    if( dnp3fw_session_init( sessions, 0 ) != 0 ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return -1;
+    }
+
+    iterations = ( packets + bench->count - 1 ) / bench->count;
+    errors = 0;
+    start = 0;
+    for( iteration = ( bench->warm ? 0 : 1 ); iteration <= iterations; ++iteration ) {
+        if( iteration == 1 ) {
+            start = bench_now();
+        }
+        for( index = 0; index < bench->count; ++index ) {
+            dnp3_packet_reset( parsed );
+            parsed->depth = XT_DNP3_CRC_FULL;
+            parsed->sessions = 1;
+            dnp3_packet_parse( parsed,
+                    0x0a000001,
+                    0x0a000002,
+                    &bench->data[ ( size_t ) index * BENCH_PACKET ],
+                    bench->length[ index ],
+                    _engine );
+            hotdrop = false;
+            match = dnp3_packet_match( rule, parsed, &hotdrop );
+            if( ( bench->exhausted ) &&
+                    ( hotdrop ) &&
+                    ( parsed->frame[0].flags & XT_DNP3_FRAME_NOSESSION ) ) {
+                continue;
+            }
+            if( ( match != bench->match ) ||
+                    ( hotdrop != bench->hotdrop ) ) {
+                ++errors;
+            }
+        }
+    }
+    elapsed = bench_now() - start;
+
+    for( frames = 0, index = 0; index < parsed->count; ++index ) {
+        frames += parsed->frame[ index ].count;
+    }
+    if( ( bench->frames != 0 ) &&
+            ( frames != bench->frames ) ) {
+        ++errors;
+    }
+    dnp3fw_session_exit();
+
+    printf( "%-18s %8u %12.2f %12.2f %8s\n",
+            bench->name,
+            frames,
+            ( double ) elapsed / ( ( double ) bench->count * iterations ),
+            frames ? ( double ) elapsed / ( ( double ) bench->count * iterations * frames ) : 0.0,
+            errors ? "FAIL" : "ok" );
+    if( errors != 0 ) {
+        fprintf( stderr, "%s: %llu evaluations with unexpected outcome\n", bench->name, ( unsigned long long ) errors );
+        return -1;
+    }
+    return 0;
+}
+
+
+int
+main( int argc, char **argv )
+{
+    struct xt_dnp3_packet *parsed;
+    struct bench_case bench[ 10 ];
+    struct xt_dnp3_rule rule;
+    uint32_t cases, index, offset, packets, sessions;
+    uint8_t *data;
+    int c, ret;
+
+    packets = 1000000;
+    sessions = 4096;
+
+    while( ( c = getopt( argc, argv, "c:n:s:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'c':
+                if( strcmp( optarg, "table" ) == 0 ) {
+                    _engine = DNP3_CRC_TABLE;
+                }
+                else if( strcmp( optarg, "slice16" ) == 0 ) {
+                    _engine = DNP3_CRC_SLICE16;
+                }
+                else {
+                    fprintf( stderr, "Unknown CRC engine `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'n':
+                packets = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+            case 's':
+                sessions = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'h':
+            default:
+                fprintf( stderr, "Usage: %s [-c table|slice16] [-n packets] [-s sessions]\n", argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( ( packets == 0 ) ||
+            ( sessions == 0 ) ) {
+        fprintf( stderr, "Packets and sessions must be non-zero\n" );
+        return 1;
+    }
+
+    dnp3_crc_init();
+    if( ( parsed = calloc( 1, sizeof( *parsed ) ) ) == NULL ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return 1;
+    }
+    parsed->frame = parsed->frames;
+    parsed->size = XT_DNP3_FRAMES;
+
+    /*
+        Packets are matched against a rule admitting read requests and responses
+        with full CRC validation.
+    */
+
+    ( void ) memset( &rule, 0, sizeof( rule ) );
+    rule.set = XT_DNP3_FLAG_FC | XT_DNP3_FLAG_CHECKSUM;
+    rule.crc = XT_DNP3_CRC_FULL;
+    rule.fc[ 1 / 8 ] |= ( 1 << ( 1 % 8 ) );
+    rule.fc[ 129 / 8 ] |= ( 1 << ( 129 % 8 ) );
+    dnp3_packet_select( &rule );
+
+    cases = 0;
+    ret = 0;
+
+    if( bench_alloc( &bench[ cases ], "read", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_DADDR, BENCH_SADDR, 0xc0, 1, 9 );
+    bench[ cases ].frames = 1;
+    bench[ cases ].match = 1;
+    ++cases;
+
+    if( bench_alloc( &bench[ cases ], "read x10", 1 ) != 0 ) {
+        return 1;
+    }
+    for( offset = 0, index = 0; index < 10; ++index ) {
+        offset += bench_frame( &bench[ cases ].data[ offset ], BENCH_DADDR, BENCH_SADDR, ( uint8_t ) ( 0xc0 | index ), 1, 9 );
+    }
+    bench[ cases ].length[0] = offset;
+    bench[ cases ].frames = 10;
+    bench[ cases ].match = 1;
+    ++cases;
+
+    if( bench_alloc( &bench[ cases ], "response 250", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_SADDR, BENCH_DADDR, 0xc0, 129, 250 );
+    bench[ cases ].frames = 1;
+    bench[ cases ].match = 1;
+    ++cases;
+
+    /*
+        Invalid CRCs are introduced to the link header and to the first, middle and
+        last data blocks of a frame of 250 octets of user data.
+    */
+
+    if( bench_alloc( &bench[ cases ], "header_crc", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_SADDR, BENCH_DADDR, 0xc0, 129, 250 );
+    bench[ cases ].data[8] ^= 0xff;
+    bench[ cases ].frames = 1;
+    ++cases;
+
+    if( bench_alloc( &bench[ cases ], "block_crc first", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_SADDR, BENCH_DADDR, 0xc0, 129, 250 );
+    bench[ cases ].data[ DNP3_LINK_HDR_LENGTH + DNP3_LINK_BLOCK_LENGTH ] ^= 0xff;
+    bench[ cases ].frames = 1;
+    ++cases;
+
+    if( bench_alloc( &bench[ cases ], "block_crc middle", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_SADDR, BENCH_DADDR, 0xc0, 129, 250 );
+    bench[ cases ].data[ DNP3_LINK_HDR_LENGTH + ( 8 * ( DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH ) ) - 1 ] ^= 0xff;
+    bench[ cases ].frames = 1;
+    ++cases;
+
+    if( bench_alloc( &bench[ cases ], "block_crc last", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_SADDR, BENCH_DADDR, 0xc0, 129, 250 );
+    bench[ cases ].data[ bench[ cases ].length[0] - 1 ] ^= 0xff;
+    bench[ cases ].frames = 1;
+    ++cases;
+
+    if( bench_alloc( &bench[ cases ], "truncated", 1 ) != 0 ) {
+        return 1;
+    }
+    bench[ cases ].length[0] = bench_frame( bench[ cases ].data, BENCH_SADDR, BENCH_DADDR, 0xc0, 129, 250 ) / 2;
+    bench[ cases ].frames = 1;
+    ++cases;
+
+    /*
+        The frames of a multi-frame response are evaluated as separate packets, with
+        the subsequent frames matched against the function code of the first frame
+        held within the session table.
+    */
+
+    if( bench_alloc( &bench[ cases ], "multi-frame x3", 3 ) != 0 ) {
+        return 1;
+    }
+    data = bench[ cases ].data;
+    bench[ cases ].length[0] = bench_frame( &data[0], BENCH_SADDR, BENCH_DADDR, 0x40, 129, 250 );
+    bench[ cases ].length[1] = bench_frame( &data[ BENCH_PACKET ], BENCH_SADDR, BENCH_DADDR, 0x01, 0, 250 );
+    bench[ cases ].length[2] = bench_frame( &data[ 2 * BENCH_PACKET ], BENCH_SADDR, BENCH_DADDR, 0x82, 0, 250 );
+    bench[ cases ].frames = 1;
+    bench[ cases ].match = 1;
+    bench[ cases ].warm = 1;
+    ++cases;
+
+    /*
+        The first frames of multi-frame messages between four times as many address
+        pairs as there are sessions, such that once the session table is filled,
+        each message opened evicts the session of another. Where the clock sweep
+        finds no session to evict within its scan, the packet is dropped.
+    */
+
+    if( bench_alloc( &bench[ cases ], "session evict", 4 * sessions ) != 0 ) {
+        return 1;
+    }
+    for( index = 0; index < bench[ cases ].count; ++index ) {
+        bench[ cases ].length[ index ] = bench_frame( &bench[ cases ].data[ ( size_t ) index * BENCH_PACKET ],
+                ( uint16_t ) index,
+                ( uint16_t ) ( index >> 16 ),
+                0x40,
+                129,
+                250 );
+    }
+    bench[ cases ].frames = 1;
+    bench[ cases ].match = 1;
+    bench[ cases ].warm = 1;
+    bench[ cases ].exhausted = 1;
+    ++cases;
+
+    printf( "%-18s %8s %12s %12s %8s\n", "case", "frames", "ns/packet", "ns/frame", "result" );
+    for( index = 0; index < cases; ++index ) {
+        if( bench_run( &bench[ index ], &rule, parsed, packets, sessions ) != 0 ) {
+            ret = 1;
+        }
+        free( bench[ index ].length );
+        free( bench[ index ].data );
+    }
+
+    free( parsed );
+    return ret;
+}
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This program loads a policy table into the xt_dnp3 kernel module through the 
+    xt_dnp3 generic netlink family, replacing any policy previously loaded into a 
+    table of the same name in the network namespace within which this program is 
+    run, or deletes the policy of a table. The entries of the 
+    policy are read from a policy file, as for the -T option of dnp3fw-replay, and 
+    are sent within a single message such that the policy of the table is replaced 
+    atomically. Each entry is sent as a separate attribute, with the source or 
+    destination address omitted where an entry applies to any address.
+*/
+
+#define POLICY_RECV                     (32768)
+
+#ifndef SOL_NETLINK
+#define SOL_NETLINK                     (270)
+#endif
+
+
+static void * policy_attr( uint8_t *buffer, uint32_t *offset, uint16_t type, const void *data, uint16_t len );
+
+static int policy_family( int fd, uint16_t *family );
+
+static int policy_recv( int fd, uint32_t seq, uint16_t *family );
+
+static int policy_send( int fd, uint8_t *buffer, uint32_t len, uint16_t type, uint16_t flags, uint32_t seq );
+
+
+static void *
+policy_attr( uint8_t *buffer, uint32_t *offset, uint16_t type, const void *data, uint16_t len )
+{
+    struct nlattr *attr;
+
+    attr = ( struct nlattr * ) ( buffer + *offset );
+    attr->nla_type = type;
+    attr->nla_len = ( uint16_t ) ( NLA_HDRLEN + len );
+    if( data != NULL ) {
+        ( void ) memcpy( buffer + *offset + NLA_HDRLEN, data, len );
+    }
+    *offset += NLA_ALIGN( attr->nla_len );
+    return attr;
+}
+
+
+static int
+policy_family( int fd, uint16_t *family )
+{
+    uint8_t buffer[ NLMSG_HDRLEN + GENL_HDRLEN + NLA_HDRLEN + NLA_ALIGN( sizeof( XT_DNP3_GENL_NAME ) ) ];
+    uint32_t offset;
+
+    ( void ) memset( buffer, 0, sizeof( buffer ) );
+    offset = NLMSG_HDRLEN + GENL_HDRLEN;
+    ( void ) policy_attr( buffer, &offset, CTRL_ATTR_FAMILY_NAME, XT_DNP3_GENL_NAME, sizeof( XT_DNP3_GENL_NAME ) );
+    ( ( struct genlmsghdr * ) ( buffer + NLMSG_HDRLEN ) )->cmd = CTRL_CMD_GETFAMILY;
+    ( ( struct genlmsghdr * ) ( buffer + NLMSG_HDRLEN ) )->version = 1;
+    if( policy_send( fd, buffer, offset, GENL_ID_CTRL, 0, 1 ) != 0 ) {
+        return -1;
+    }
+    return policy_recv( fd, 1, family );
+}
+
+
+/*
+    This function receives the response to the request of the sequence number 
+    specified, either the family identifier of a CTRL_CMD_GETFAMILY request where 
+    family is non-NULL, or the acknowledgement of a request otherwise, reporting 
+    any error and extended acknowledgement message returned.
+*/
+
+static int
+policy_recv( int fd, uint32_t seq, uint16_t *family )
+{
+    const struct nlmsgerr *error;
+    const struct nlmsghdr *nlh;
+    const struct nlattr *attr;
+    uint32_t len, offset, size;
+    ssize_t ret;
+    uint8_t *buffer;
+
+    if( ( buffer = malloc( POLICY_RECV ) ) == NULL ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return -1;
+    }
+    for( ;; ) {
+        if( ( ret = recv( fd, buffer, POLICY_RECV, 0 ) ) < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            perror( "recv" );
+            break;
+        }
+        for( nlh = ( const struct nlmsghdr * ) buffer, len = ( uint32_t ) ret;
+                NLMSG_OK( nlh, len );
+                nlh = NLMSG_NEXT( nlh, len ) ) {
+
+            if( nlh->nlmsg_seq != seq ) {
+                continue;
+            }
+            if( nlh->nlmsg_type == NLMSG_ERROR ) {
+                error = NLMSG_DATA( nlh );
+                if( error->error == 0 ) {
+                    free( buffer );
+                    return 0;
+                }
+                if( ( family != NULL ) &&
+                        ( error->error == -ENOENT ) ) {
+                    fprintf( stderr, "Generic netlink family `%s' not found - is the xt_dnp3 module loaded?\n", XT_DNP3_GENL_NAME );
+                    break;
+                }
+                fprintf( stderr, "%s", strerror( -error->error ) );
+                if( nlh->nlmsg_flags & NLM_F_ACK_TLVS ) {
+                    size = nlh->nlmsg_len - NLMSG_HDRLEN;
+                    for( offset = NLMSG_ALIGN( sizeof( *error ) );
+                            ( offset + NLA_HDRLEN ) <= size;
+                            offset += NLA_ALIGN( attr->nla_len ) ) {
+                        attr = ( const struct nlattr * ) ( ( const uint8_t * ) error + offset );
+                        if( ( attr->nla_len < NLA_HDRLEN ) ||
+                                ( ( offset + attr->nla_len ) > size ) ) {
+                            break;
+                        }
+                        if( attr->nla_type == NLMSGERR_ATTR_MSG ) {
+                            fprintf( stderr, ": %.*s", ( int ) ( attr->nla_len - NLA_HDRLEN ), ( const char * ) attr + NLA_HDRLEN );
+                        }
+                    }
+                }
+                fprintf( stderr, "\n" );
+                break;
+            }
+            if( family != NULL ) {
+                size = nlh->nlmsg_len - NLMSG_HDRLEN;
+                for( offset = GENL_HDRLEN;
+                        ( offset + NLA_HDRLEN ) <= size;
+                        offset += NLA_ALIGN( attr->nla_len ) ) {
+                    attr = ( const struct nlattr * ) ( ( const uint8_t * ) NLMSG_DATA( nlh ) + offset );
+                    if( ( attr->nla_len < NLA_HDRLEN ) ||
+                            ( ( offset + attr->nla_len ) > size ) ) {
+                        break;
+                    }
+                    if( attr->nla_type == CTRL_ATTR_FAMILY_ID ) {
+                        ( void ) memcpy( family, ( const uint8_t * ) attr + NLA_HDRLEN, sizeof( *family ) );
+                        free( buffer );
+                        return 0;
+                    }
+                }
+                fprintf( stderr, "Malformed generic netlink family response\n" );
+                break;
+            }
+        }
+        if( NLMSG_OK( nlh, len ) ) {
+            break;
+        }
+    }
+    free( buffer );
+    return -1;
+}
+
+
+static int
+policy_send( int fd, uint8_t *buffer, uint32_t len, uint16_t type, uint16_t flags, uint32_t seq )
+{
+    struct sockaddr_nl addr;
+    struct nlmsghdr *nlh;
+
+    nlh = ( struct nlmsghdr * ) buffer;
+    nlh->nlmsg_len = len;
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = ( uint16_t ) ( NLM_F_REQUEST | flags );
+    nlh->nlmsg_seq = seq;
+    nlh->nlmsg_pid = 0;
+
+    ( void ) memset( &addr, 0, sizeof( addr ) );
+    addr.nl_family = AF_NETLINK;
+    if( sendto( fd, buffer, len, 0, ( struct sockaddr * ) &addr, sizeof( addr ) ) < 0 ) {
+        perror( "sendto" );
+        return -1;
+    }
+    return 0;
+}
+
+
+int
+main( int argc, char **argv )
+{
+    struct xt_dnp3_entry *entry;
+    struct genlmsghdr *genl;
+    struct nlattr *nest;
+    const char *name;
+    unsigned int count, index;
+    uint32_t len, offset;
+    uint16_t family;
+    uint8_t *buffer;
+    int c, del, fd, one, ret;
+
+    name = NULL;
+    del = 0;
+    while( ( c = getopt( argc, argv, "dn:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'd':
+                del = 1;
+                break;
+            case 'n':
+                name = optarg;
+                break;
+            case 'h':
+            default:
+                fprintf( stderr, "Usage: %s [-d] -n name [policy]\n", argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( ( name == NULL ) ||
+            ( optind != ( argc - ( del ? 0 : 1 ) ) ) ) {
+        fprintf( stderr, "Usage: %s [-d] -n name [policy]\n", argv[0] );
+        return 1;
+    }
+    if( ( name[0] == '\0' ) ||
+            ( strlen( name ) >= XT_DNP3_POLICY_NAME ) ) {
+        fprintf( stderr, "Invalid policy table name `%s'\n", name );
+        return 1;
+    }
+
+    entry = NULL;
+    count = 0;
+    if( ( del == 0 ) &&
+            ( dnp3fw_policy_read( argv[ optind ], &entry, &count ) != 0 ) ) {
+        return 1;
+    }
+
+    len = NLMSG_HDRLEN + GENL_HDRLEN + NLA_HDRLEN + NLA_ALIGN( XT_DNP3_POLICY_NAME ) +
+            count * ( NLA_HDRLEN + 2 * NLA_ALIGN( NLA_HDRLEN + sizeof( uint16_t ) ) +
+            NLA_HDRLEN + sizeof( entry->fc ) );
+    if( ( buffer = calloc( 1, len ) ) == NULL ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        free( entry );
+        return 1;
+    }
+
+    offset = NLMSG_HDRLEN + GENL_HDRLEN;
+    genl = ( struct genlmsghdr * ) ( buffer + NLMSG_HDRLEN );
+    genl->cmd = del ? XT_DNP3_CMD_POLICY_DEL : XT_DNP3_CMD_POLICY_SET;
+    genl->version = XT_DNP3_GENL_VERSION;
+    ( void ) policy_attr( buffer, &offset, XT_DNP3_ATTR_NAME, name, ( uint16_t ) ( strlen( name ) + 1 ) );
+    for( index = 0; index < count; ++index ) {
+        nest = policy_attr( buffer, &offset, NLA_F_NESTED | XT_DNP3_ATTR_ENTRY, NULL, 0 );
+        if( ( entry[ index ].flags & XT_DNP3_POLICY_ANY_SADDR ) == 0 ) {
+            ( void ) policy_attr( buffer, &offset, XT_DNP3_ENTRY_SADDR, &entry[ index ].saddr, sizeof( uint16_t ) );
+        }
+        if( ( entry[ index ].flags & XT_DNP3_POLICY_ANY_DADDR ) == 0 ) {
+            ( void ) policy_attr( buffer, &offset, XT_DNP3_ENTRY_DADDR, &entry[ index ].daddr, sizeof( uint16_t ) );
+        }
+        ( void ) policy_attr( buffer, &offset, XT_DNP3_ENTRY_FC, entry[ index ].fc, sizeof( entry[ index ].fc ) );
+        nest->nla_len = ( uint16_t ) ( ( buffer + offset ) - ( uint8_t * ) nest );
+    }
+    free( entry );
+
+    /*
+        The send buffer of the socket is enlarged to accommodate the policy within 
+        a single message, and the acknowledgement requested without the original 
+        message, but with any extended acknowledgement message.
+    */
+
+    if( ( fd = socket( AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC ) ) < 0 ) {
+        perror( "socket" );
+        free( buffer );
+        return 1;
+    }
+    one = 1;
+    ( void ) setsockopt( fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof( one ) );
+    ( void ) setsockopt( fd, SOL_NETLINK, NETLINK_EXT_ACK, &one, sizeof( one ) );
+    c = ( int ) ( offset + 4096 );
+    if( setsockopt( fd, SOL_SOCKET, SO_SNDBUFFORCE, &c, sizeof( c ) ) != 0 ) {
+        ( void ) setsockopt( fd, SOL_SOCKET, SO_SNDBUF, &c, sizeof( c ) );
+    }
+
+    ret = 1;
+    if( ( policy_family( fd, &family ) == 0 ) &&
+            ( policy_send( fd, buffer, offset, family, NLM_F_ACK, 2 ) == 0 ) &&
+            ( policy_recv( fd, 2, NULL ) == 0 ) ) {
+        ret = 0;
+    }
+    ( void ) close( fd );
+    free( buffer );
+    return ret;
+}
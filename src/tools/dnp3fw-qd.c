@@ -0,0 +1,641 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_queue.h>
+#include <linux/netlink.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This program evaluates a rule set against the packets of one or more NFQUEUE
+    queues with the DNP3 frame parsing and rule matching source of the xt_dnp3
+    kernel module, such that inspection which is too costly or stateful for the
+    packet path of the kernel module may be performed in userspace - for example:
+
+        iptables -A FORWARD -p tcp --dport 20000 -j NFQUEUE --queue-balance 0:3 --queue-cpu-fanout --queue-bypass
+
+    A worker thread is bound to each queue of the range specified with the -q
+    option and pinned to the CPU of the same index, such that with the
+    --queue-cpu-fanout option of the NFQUEUE target, each packet is evaluated on
+    the CPU on which it was received and the transport sessions of a flow are
+    tracked by a single thread. Each worker receives a batch of queued packets with
+    a single call to recvmmsg(), evaluates each packet in place within the receive
+    buffer, and returns the verdicts of the batch with a single send of
+    NFQNL_MSG_VERDICT_BATCH messages, one for each run of packets with the same
+    verdict. Verdicts carry no payload, such that packets are never copied back to
+    the kernel, and segmentation offload packets are queued unsegmented with the
+    NFQA_CFG_F_GSO flag.
+
+    Packets received between the binding of a queue and the completion of its
+    configuration are given the verdict of the default policy. Where the -F option
+    is specified, packets are accepted by the kernel rather than dropped where a
+    queue is full.
+*/
+
+#define QD_BATCH                        (64)
+
+#define QD_BUFFER                       (65536 + 4096)
+
+#define QD_RCVBUF                       (8 * 1024 * 1024)
+
+#define QD_SEND                         (8192)
+
+#define QD_VERDICT_LENGTH               ( NLMSG_HDRLEN + NLMSG_ALIGN( sizeof( struct nfgenmsg ) ) + NLA_HDRLEN + NLA_ALIGN( sizeof( struct nfqnl_msg_verdict_hdr ) ) )
+
+
+struct qd_worker {
+    pthread_t thread;                   /* Worker thread */
+    uint16_t queue;                     /* Queue number */
+    int fd;                             /* Netlink socket */
+    uint64_t packets;                   /* Packets evaluated */
+    uint64_t accepted;                  /* Packets accepted */
+    uint64_t batches;                   /* Batches received */
+    uint64_t overruns;                  /* Receive buffer overruns */
+    int error;                          /* Worker error */
+};
+
+
+static int qd_ack( int fd, uint16_t queue, uint32_t seq );
+
+static void * qd_attr( uint8_t *buffer, uint32_t *offset, uint16_t type, const void *data, uint16_t len );
+
+static int qd_config( int fd, uint16_t queue );
+
+static uint32_t qd_header( uint8_t *buffer, uint16_t type, uint16_t flags, uint32_t seq, uint16_t queue );
+
+static int qd_packet( const struct nlmsghdr *nlh, uint32_t *id, const uint8_t **payload, uint32_t *len );
+
+static int qd_send( int fd, const uint8_t *buffer, uint32_t len );
+
+static void qd_signal( int signum );
+
+static uint32_t qd_verdict( uint8_t *buffer, uint32_t offset, uint16_t queue, uint32_t id, uint32_t verdict );
+
+static void * qd_worker( void *arg );
+
+
+static struct dnp3fw_rules _rules;
+
+static int _engine = DNP3_CRC_SLICE16;
+
+static unsigned int _sessions = 4096;
+
+static unsigned int _apdus = 0;
+
+static uint32_t _flags = NFQA_CFG_F_GSO;
+
+static uint32_t _maxlen = 0;
+
+static long _cpus;
+
+static volatile sig_atomic_t _stop;
+
+
+/*
+    This function awaits the acknowledgement of a configuration message, returning
+    the error reported by the kernel. Packets received from the queue before the
+    acknowledgement are given the verdict of the default policy.
+*/
+
+static int
+qd_ack( int fd, uint16_t queue, uint32_t seq )
+{
+    const struct nlmsghdr *nlh;
+    const uint8_t *payload;
+    uint8_t *buffer, verdict[ QD_VERDICT_LENGTH ];
+    uint32_t id, len, size;
+    ssize_t ret;
+
+    if( ( buffer = malloc( QD_BUFFER ) ) == NULL ) {
+        return -ENOMEM;
+    }
+    for( ;; ) {
+        if( ( ret = recv( fd, buffer, QD_BUFFER, 0 ) ) < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            ret = -errno;
+            break;
+        }
+        for( nlh = ( const struct nlmsghdr * ) buffer, len = ( uint32_t ) ret;
+                NLMSG_OK( nlh, len );
+                nlh = NLMSG_NEXT( nlh, len ) ) {
+            if( qd_packet( nlh, &id, &payload, &size ) == 0 ) {
+                ( void ) qd_send( fd, verdict, qd_verdict( verdict, 0, queue, id,
+                        ( _rules.policy == DNP3FW_VERDICT_DROP ) ? NF_DROP : NF_ACCEPT ) );
+                continue;
+            }
+            if( ( nlh->nlmsg_type == NLMSG_ERROR ) &&
+                    ( nlh->nlmsg_seq == seq ) ) {
+                ret = ( ( const struct nlmsgerr * ) NLMSG_DATA( nlh ) )->error;
+                free( buffer );
+                return ( int ) ret;
+            }
+        }
+    }
+    free( buffer );
+    return ( int ) ret;
+}
+
+
+static void *
+qd_attr( uint8_t *buffer, uint32_t *offset, uint16_t type, const void *data, uint16_t len )
+{
+    struct nlattr *attr;
+
+    attr = ( struct nlattr * ) ( buffer + *offset );
+    attr->nla_type = type;
+    attr->nla_len = ( uint16_t ) ( NLA_HDRLEN + len );
+    if( data != NULL ) {
+        ( void ) memcpy( buffer + *offset + NLA_HDRLEN, data, len );
+    }
+    *offset += NLA_ALIGN( attr->nla_len );
+    return attr;
+}
+
+
+/*
+    This function binds the socket to a queue, and configures the queue to copy
+    whole packets, including unsegmented segmentation offload packets, to
+    userspace.
+*/
+
+static int
+qd_config( int fd, uint16_t queue )
+{
+    struct nfqnl_msg_config_params params;
+    struct nfqnl_msg_config_cmd cmd;
+    uint8_t buffer[ 256 ];
+    uint32_t mask, offset, value;
+    int ret;
+
+    ( void ) memset( &cmd, 0, sizeof( cmd ) );
+    cmd.command = NFQNL_CFG_CMD_BIND;
+    offset = qd_header( buffer, NFQNL_MSG_CONFIG, NLM_F_ACK, 1, queue );
+    ( void ) qd_attr( buffer, &offset, NFQA_CFG_CMD, &cmd, sizeof( cmd ) );
+    ( ( struct nlmsghdr * ) buffer )->nlmsg_len = offset;
+    if( qd_send( fd, buffer, offset ) != 0 ) {
+        return -1;
+    }
+    if( ( ret = qd_ack( fd, queue, 1 ) ) != 0 ) {
+        fprintf( stderr, "Unable to bind queue %u: %s\n", queue, strerror( -ret ) );
+        return -1;
+    }
+
+    ( void ) memset( &params, 0, sizeof( params ) );
+    params.copy_range = htonl( 0xffff );
+    params.copy_mode = NFQNL_COPY_PACKET;
+    offset = qd_header( buffer, NFQNL_MSG_CONFIG, NLM_F_ACK, 2, queue );
+    ( void ) qd_attr( buffer, &offset, NFQA_CFG_PARAMS, &params, sizeof( params ) );
+    mask = htonl( NFQA_CFG_F_GSO | NFQA_CFG_F_FAIL_OPEN );
+    value = htonl( _flags );
+    ( void ) qd_attr( buffer, &offset, NFQA_CFG_FLAGS, &value, sizeof( value ) );
+    ( void ) qd_attr( buffer, &offset, NFQA_CFG_MASK, &mask, sizeof( mask ) );
+    if( _maxlen != 0 ) {
+        value = htonl( _maxlen );
+        ( void ) qd_attr( buffer, &offset, NFQA_CFG_QUEUE_MAXLEN, &value, sizeof( value ) );
+    }
+    ( ( struct nlmsghdr * ) buffer )->nlmsg_len = offset;
+    if( qd_send( fd, buffer, offset ) != 0 ) {
+        return -1;
+    }
+    if( ( ret = qd_ack( fd, queue, 2 ) ) != 0 ) {
+        fprintf( stderr, "Unable to configure queue %u: %s\n", queue, strerror( -ret ) );
+        return -1;
+    }
+    return 0;
+}
+
+
+static uint32_t
+qd_header( uint8_t *buffer, uint16_t type, uint16_t flags, uint32_t seq, uint16_t queue )
+{
+    struct nfgenmsg *nfg;
+    struct nlmsghdr *nlh;
+
+    nlh = ( struct nlmsghdr * ) buffer;
+    nlh->nlmsg_len = NLMSG_HDRLEN + NLMSG_ALIGN( sizeof( *nfg ) );
+    nlh->nlmsg_type = ( uint16_t ) ( ( NFNL_SUBSYS_QUEUE << 8 ) | type );
+    nlh->nlmsg_flags = ( uint16_t ) ( NLM_F_REQUEST | flags );
+    nlh->nlmsg_seq = seq;
+    nlh->nlmsg_pid = 0;
+    nfg = ( struct nfgenmsg * ) ( buffer + NLMSG_HDRLEN );
+    nfg->nfgen_family = AF_UNSPEC;
+    nfg->version = NFNETLINK_V0;
+    nfg->res_id = htons( queue );
+    return nlh->nlmsg_len;
+}
+
+
+/*
+    This function returns the packet identifier and payload of a queued packet
+    message, returning -1 where the message is not a queued packet. The payload
+    is returned in place within the receive buffer.
+*/
+
+static int
+qd_packet( const struct nlmsghdr *nlh, uint32_t *id, const uint8_t **payload, uint32_t *len )
+{
+    const struct nfqnl_msg_packet_hdr *hdr;
+    const struct nlattr *attr;
+    uint32_t offset;
+
+    if( nlh->nlmsg_type != ( ( NFNL_SUBSYS_QUEUE << 8 ) | NFQNL_MSG_PACKET ) ) {
+        return -1;
+    }
+    hdr = NULL;
+    *payload = NULL;
+    *len = 0;
+    for( offset = NLMSG_HDRLEN + NLMSG_ALIGN( sizeof( struct nfgenmsg ) );
+            ( offset + NLA_HDRLEN ) <= nlh->nlmsg_len;
+            offset += NLA_ALIGN( attr->nla_len ) ) {
+        attr = ( const struct nlattr * ) ( ( const uint8_t * ) nlh + offset );
+        if( ( attr->nla_len < NLA_HDRLEN ) ||
+                ( ( offset + attr->nla_len ) > nlh->nlmsg_len ) ) {
+            break;
+        }
+        switch( attr->nla_type & NLA_TYPE_MASK ) {
+            case NFQA_PACKET_HDR:
+                if( ( attr->nla_len - NLA_HDRLEN ) >= sizeof( *hdr ) ) {
+                    hdr = ( const struct nfqnl_msg_packet_hdr * ) ( ( const uint8_t * ) attr + NLA_HDRLEN );
+                }
+                break;
+            case NFQA_PAYLOAD:
+                *payload = ( const uint8_t * ) attr + NLA_HDRLEN;
+                *len = attr->nla_len - NLA_HDRLEN;
+                break;
+            default:
+                break;
+        }
+    }
+    if( hdr == NULL ) {
+        return -1;
+    }
+    *id = ntohl( hdr->packet_id );
+    return 0;
+}
+
+
+static int
+qd_send( int fd, const uint8_t *buffer, uint32_t len )
+{
+    struct sockaddr_nl addr;
+
+    ( void ) memset( &addr, 0, sizeof( addr ) );
+    addr.nl_family = AF_NETLINK;
+    if( sendto( fd, buffer, len, 0, ( struct sockaddr * ) &addr, sizeof( addr ) ) < 0 ) {
+        perror( "sendto" );
+        return -1;
+    }
+    return 0;
+}
+
+
+static void
+qd_signal( int signum )
+{
+    ( void ) signum;
+    _stop = 1;
+}
+
+
+/*
+    This function appends a batch verdict message to the buffer at offset, which
+    applies the verdict to the packet identified and all earlier packets of the
+    queue without a verdict, and returns the offset following the message.
+*/
+
+static uint32_t
+qd_verdict( uint8_t *buffer, uint32_t offset, uint16_t queue, uint32_t id, uint32_t verdict )
+{
+    struct nfqnl_msg_verdict_hdr hdr;
+    uint32_t len;
+
+    len = qd_header( buffer + offset, NFQNL_MSG_VERDICT_BATCH, 0, 0, queue );
+    hdr.verdict = htonl( verdict );
+    hdr.id = htonl( id );
+    ( void ) qd_attr( buffer + offset, &len, NFQA_VERDICT_HDR, &hdr, sizeof( hdr ) );
+    ( ( struct nlmsghdr * ) ( buffer + offset ) )->nlmsg_len = len;
+    return offset + len;
+}
+
+
+static void *
+qd_worker( void *arg )
+{
+    struct qd_worker *worker = arg;
+    struct mmsghdr msgs[ QD_BATCH ];
+    struct iovec iov[ QD_BATCH ];
+    struct xt_dnp3_packet *parsed;
+    struct dnp3fw_packet packet;
+    const struct nlmsghdr *nlh;
+    const uint8_t *payload;
+    struct timespec ts;
+    uint8_t *buffer, send[ QD_SEND ];
+    uint32_t id, last, len, offset, run, size, verdict;
+    unsigned int index, rule;
+    int count;
+
+    buffer = malloc( ( size_t ) QD_BATCH * QD_BUFFER );
+    parsed = calloc( 1, sizeof( *parsed ) );
+    if( ( buffer == NULL ) ||
+            ( parsed == NULL ) ||
+            ( dnp3fw_session_init( _sessions, _apdus ) != 0 ) ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        free( parsed );
+        free( buffer );
+        worker->error = -1;
+        return NULL;
+    }
+    parsed->frame = parsed->frames;
+    parsed->size = XT_DNP3_FRAMES;
+    for( index = 0; index < QD_BATCH; ++index ) {
+        iov[ index ].iov_base = buffer + ( ( size_t ) index * QD_BUFFER );
+        iov[ index ].iov_len = QD_BUFFER;
+        ( void ) memset( &msgs[ index ], 0, sizeof( msgs[ index ] ) );
+        msgs[ index ].msg_hdr.msg_iov = &iov[ index ];
+        msgs[ index ].msg_hdr.msg_iovlen = 1;
+    }
+
+    while( ! _stop ) {
+        if( ( count = recvmmsg( worker->fd, msgs, QD_BATCH, MSG_WAITFORONE, NULL ) ) < 0 ) {
+            if( errno == ENOBUFS ) {
+                ++worker->overruns;
+            }
+            else if( ( errno != EINTR ) &&
+                    ( errno != EAGAIN ) ) {
+                perror( "recvmmsg" );
+                worker->error = -1;
+                break;
+            }
+            continue;
+        }
+        ++worker->batches;
+        ( void ) clock_gettime( CLOCK_MONOTONIC, &ts );
+
+        /*
+            Packet identifiers are assigned in order by the kernel, such that a
+            batch verdict is sent only where the verdict differs from that of the
+            preceding packet, and for the last packet of the batch.
+        */
+
+        offset = 0;
+        run = UINT32_MAX;
+        last = 0;
+        for( index = 0; index < ( unsigned int ) count; ++index ) {
+            for( nlh = ( const struct nlmsghdr * ) iov[ index ].iov_base, len = msgs[ index ].msg_len;
+                    NLMSG_OK( nlh, len );
+                    nlh = NLMSG_NEXT( nlh, len ) ) {
+                if( qd_packet( nlh, &id, &payload, &size ) != 0 ) {
+                    continue;
+                }
+                ( void ) memset( &packet, 0, sizeof( packet ) );
+                packet.time = ( ( uint64_t ) ts.tv_sec * 1000000000ULL ) + ts.tv_nsec;
+                if( payload != NULL ) {
+                    dnp3fw_pcap_ipv4( payload, size, &packet );
+                }
+                parsed->count = 0;
+                verdict = ( dnp3fw_rules_evaluate( &_rules, &packet, parsed, _engine, &rule ) == DNP3FW_VERDICT_DROP ) ?
+                        NF_DROP : NF_ACCEPT;
+                ++worker->packets;
+                worker->accepted += ( verdict == NF_ACCEPT );
+
+                if( ( run != UINT32_MAX ) &&
+                        ( run != verdict ) ) {
+                    offset = qd_verdict( send, offset, worker->queue, last, run );
+                    if( ( offset + QD_VERDICT_LENGTH ) > sizeof( send ) ) {
+                        ( void ) qd_send( worker->fd, send, offset );
+                        offset = 0;
+                    }
+                }
+                run = verdict;
+                last = id;
+            }
+        }
+        if( run != UINT32_MAX ) {
+            offset = qd_verdict( send, offset, worker->queue, last, run );
+        }
+        if( offset > 0 ) {
+            ( void ) qd_send( worker->fd, send, offset );
+        }
+    }
+
+    dnp3fw_session_exit();
+    if( parsed->frame != parsed->frames ) {
+        free( parsed->frame );
+    }
+    free( parsed );
+    free( buffer );
+    return NULL;
+}
+
+
+int
+main( int argc, char **argv )
+{
+    struct qd_worker *workers;
+    struct sockaddr_nl addr;
+    struct sigaction sa;
+    struct timeval tv;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    const char *rules;
+    char *ptr;
+    unsigned long first, last;
+    unsigned int index, queues, started;
+    int c, ret, size;
+
+    rules = NULL;
+    first = last = 0;
+    _rules.policy = DNP3FW_VERDICT_ACCEPT;
+    _cpus = sysconf( _SC_NPROCESSORS_ONLN );
+
+    while( ( c = getopt( argc, argv, "a:c:Fl:P:q:r:s:T:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'a':
+                _apdus = ( unsigned int ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'c':
+                if( strcmp( optarg, "table" ) == 0 ) {
+                    _engine = DNP3_CRC_TABLE;
+                }
+                else if( strcmp( optarg, "slice16" ) == 0 ) {
+                    _engine = DNP3_CRC_SLICE16;
+                }
+                else {
+                    fprintf( stderr, "Unknown CRC engine `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'F':
+                _flags |= NFQA_CFG_F_FAIL_OPEN;
+                break;
+            case 'l':
+                _maxlen = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'P':
+                if( strcmp( optarg, "ACCEPT" ) == 0 ) {
+                    _rules.policy = DNP3FW_VERDICT_ACCEPT;
+                }
+                else if( strcmp( optarg, "DROP" ) == 0 ) {
+                    _rules.policy = DNP3FW_VERDICT_DROP;
+                }
+                else {
+                    fprintf( stderr, "Unknown policy `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'q':
+                first = last = strtoul( optarg, &ptr, 10 );
+                if( *ptr == ':' ) {
+                    last = strtoul( ptr + 1, &ptr, 10 );
+                }
+                if( ( *ptr != '\0' ) ||
+                        ( last < first ) ||
+                        ( last > 65535 ) ) {
+                    fprintf( stderr, "Invalid queue range `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'r':
+                rules = optarg;
+                break;
+            case 's':
+                _sessions = ( unsigned int ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'T':
+                if( ( ptr = strchr( optarg, '=' ) ) == NULL ) {
+                    fprintf( stderr, "Policy table must be specified as name=policy\n" );
+                    return 1;
+                }
+                *ptr++ = '\0';
+                if( dnp3fw_policy_load( optarg, ptr ) != 0 ) {
+                    return 1;
+                }
+                break;
+            case 'h':
+            default:
+                fprintf( stderr, "Usage: %s [-a apdus] [-c table|slice16] [-F] [-l maxlen] [-P ACCEPT|DROP] [-q queue[:queue]] [-s sessions] [-T name=policy] -r rules\n", argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( ( rules == NULL ) ||
+            ( optind != argc ) ) {
+        fprintf( stderr, "Usage: %s [-a apdus] [-c table|slice16] [-F] [-l maxlen] [-P ACCEPT|DROP] [-q queue[:queue]] [-s sessions] [-T name=policy] -r rules\n", argv[0] );
+        return 1;
+    }
+    if( _sessions == 0 ) {
+        fprintf( stderr, "Session count must be non-zero\n" );
+        return 1;
+    }
+
+    dnp3_crc_init();
+    if( dnp3fw_rules_load( &_rules, rules ) != 0 ) {
+        return 1;
+    }
+
+    queues = ( unsigned int ) ( last - first + 1 );
+    if( ( workers = calloc( queues, sizeof( *workers ) ) ) == NULL ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return 1;
+    }
+
+    /*
+        The sockets of all queues are bound and configured before any worker is
+        started, with a receive timeout such that workers observe the termination
+        of the program while their queues are idle.
+    */
+
+    ret = 0;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;
+    size = QD_RCVBUF;
+    for( index = 0; index < queues; ++index ) {
+        workers[ index ].queue = ( uint16_t ) ( first + index );
+        if( ( workers[ index ].fd = socket( AF_NETLINK, SOCK_RAW, NETLINK_NETFILTER ) ) < 0 ) {
+            perror( "socket" );
+            ret = 1;
+            break;
+        }
+        ( void ) memset( &addr, 0, sizeof( addr ) );
+        addr.nl_family = AF_NETLINK;
+        if( bind( workers[ index ].fd, ( struct sockaddr * ) &addr, sizeof( addr ) ) != 0 ) {
+            perror( "bind" );
+            ret = 1;
+            break;
+        }
+        if( setsockopt( workers[ index ].fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof( size ) ) != 0 ) {
+            ( void ) setsockopt( workers[ index ].fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ) );
+        }
+        if( qd_config( workers[ index ].fd, workers[ index ].queue ) != 0 ) {
+            ret = 1;
+            break;
+        }
+        ( void ) setsockopt( workers[ index ].fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+    }
+
+    ( void ) memset( &sa, 0, sizeof( sa ) );
+    sa.sa_handler = qd_signal;
+    ( void ) sigaction( SIGINT, &sa, NULL );
+    ( void ) sigaction( SIGTERM, &sa, NULL );
+
+    for( started = 0; ( ret == 0 ) && ( started < queues ); ++started ) {
+        ( void ) pthread_attr_init( &attr );
+        if( _cpus > 0 ) {
+            CPU_ZERO( &cpus );
+            CPU_SET( started % ( unsigned int ) _cpus, &cpus );
+            ( void ) pthread_attr_setaffinity_np( &attr, sizeof( cpus ), &cpus );
+        }
+        if( pthread_create( &workers[ started ].thread, &attr, qd_worker, &workers[ started ] ) != 0 ) {
+            fprintf( stderr, "Unable to create worker thread\n" );
+            _stop = 1;
+            ret = 1;
+        }
+        ( void ) pthread_attr_destroy( &attr );
+        if( ret != 0 ) {
+            break;
+        }
+    }
+    for( index = 0; index < started; ++index ) {
+        ( void ) pthread_join( workers[ index ].thread, NULL );
+        ret |= ( workers[ index ].error != 0 );
+    }
+
+    if( ret == 0 ) {
+        fprintf( stderr, "queue        packets     accepted      dropped  packets/batch   overruns\n" );
+        for( index = 0; index < queues; ++index ) {
+            fprintf( stderr, "%-5u %12llu %12llu %12llu %14.2f %10llu\n",
+                    workers[ index ].queue,
+                    ( unsigned long long ) workers[ index ].packets,
+                    ( unsigned long long ) workers[ index ].accepted,
+                    ( unsigned long long ) ( workers[ index ].packets - workers[ index ].accepted ),
+                    workers[ index ].batches ? ( double ) workers[ index ].packets / workers[ index ].batches : 0.0,
+                    ( unsigned long long ) workers[ index ].overruns );
+        }
+    }
+
+    for( index = 0; index < queues; ++index ) {
+        if( workers[ index ].fd > 0 ) {
+            ( void ) close( workers[ index ].fd );
+        }
+    }
+    free( workers );
+    dnp3fw_rules_free( &_rules );
+    dnp3fw_policy_free();
+    return ret;
+}
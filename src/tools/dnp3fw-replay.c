@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This program evaluates a rule set against the packets of a capture file with 
+    the DNP3 frame parsing and rule matching source of the xt_dnp3 kernel module, 
+    reporting the verdict for each packet. The flows of the capture are partitioned 
+    between worker threads by IP address pair, such that transport sessions are 
+    tracked by a single thread, and the throughput of frame parsing and matching is 
+    reported upon completion.
+
+    Policy tables referenced by the --policy option of rules are loaded from policy 
+    files with the -T option.
+
+    Frames split across TCP segments are not reassembled, consistent with the 
+    kernel module where the dnp3 connection tracking helper is not assigned. The 
+    application fragments of multi-frame messages are reassembled for the 
+    matching of object header constraints where a number of concurrent 
+    reassemblies is specified with the -a option.
+*/
+
+struct replay_worker {
+    pthread_t thread;                   /* Worker thread */
+    uint32_t *index;                    /* Packets of this worker */
+    uint32_t count;                     /* Number of packets */
+    uint32_t size;                      /* Packet index capacity */
+    uint64_t frames;                    /* Frames parsed */
+    uint64_t elapsed;                   /* Thread CPU time (ns) */
+    uint64_t *hits;                     /* Packets by rule */
+    uint64_t stats[ XT_DNP3_STAT_MAX ]; /* Parsing and session counters */
+    int error;                          /* Worker error */
+};
+
+
+static int replay_add( struct replay_worker *worker, uint32_t index );
+
+static uint64_t replay_clock( clockid_t clock );
+
+static void replay_report( struct replay_worker *workers, unsigned int threads, uint64_t elapsed );
+
+static void * replay_worker( void *arg );
+
+
+static struct dnp3fw_packet *_packets;
+
+static uint32_t _count;
+
+static uint8_t *_verdict;
+
+static uint32_t *_rule;
+
+static struct dnp3fw_rules _rules;
+
+static int _engine = DNP3_CRC_SLICE16;
+
+static unsigned int _sessions = XT_DNP3_SESSIONS;
+
+static unsigned int _apdus;
+
+static const char *_stats[ XT_DNP3_STAT_MAX ] = {
+    [ XT_DNP3_STAT_PACKETS ]    = "packets",
+    [ XT_DNP3_STAT_TRUSTED ]    = "trusted",
+    [ XT_DNP3_STAT_FRAMES ]     = "frames",
+    [ XT_DNP3_STAT_SYNC ]       = "sync",
+    [ XT_DNP3_STAT_HEADER_CRC ] = "header_crc",
+    [ XT_DNP3_STAT_BLOCK_CRC ]  = "block_crc",
+    [ XT_DNP3_STAT_TRUNCATED ]  = "truncated",
+    [ XT_DNP3_STAT_HELD ]       = "held",
+    [ XT_DNP3_STAT_SEQUENCE ]   = "sequence",
+    [ XT_DNP3_STAT_DUPLICATE ]  = "duplicate",
+    [ XT_DNP3_STAT_NOSESSION ]  = "nosession",
+    [ XT_DNP3_STAT_EXHAUSTED ]  = "exhausted",
+    [ XT_DNP3_STAT_NOMEM ]      = "nomem",
+    [ XT_DNP3_STAT_OPENED ]     = "opened",
+    [ XT_DNP3_STAT_CLOSED ]     = "closed",
+    [ XT_DNP3_STAT_EVICTED ]    = "evicted",
+    [ XT_DNP3_STAT_EXPIRED ]    = "expired",
+    [ XT_DNP3_STAT_ASSEMBLED ]  = "assembled",
+    [ XT_DNP3_STAT_ABANDONED ]  = "abandoned",
+    [ XT_DNP3_STAT_LEARNED ]    = "learned",
+    [ XT_DNP3_STAT_UNLEARNED ]  = "unlearned",
+};
+
+
+static int
+replay_add( struct replay_worker *worker, uint32_t index )
+{
+    uint32_t *ptr;
+
+    if( worker->count == worker->size ) {
+        worker->size = worker->size ? ( worker->size * 2 ) : 1024;
+        if( ( ptr = realloc( worker->index, worker->size * sizeof( *ptr ) ) ) == NULL ) {
+            return -1;
+        }
+        worker->index = ptr;
+    }
+    worker->index[ worker->count++ ] = index;
+    return 0;
+}
+
+
+static uint64_t
+replay_clock( clockid_t clock )
+{
+    struct timespec ts;
+
+    ( void ) clock_gettime( clock, &ts );
+    return ( ( uint64_t ) ts.tv_sec * 1000000000ULL ) + ts.tv_nsec;
+}
+
+
+static void
+replay_report( struct replay_worker *workers, unsigned int threads, uint64_t elapsed )
+{
+    uint64_t cpu, evaluated, frames, hits;
+    unsigned int index, rule;
+
+    cpu = evaluated = frames = 0;
+    for( index = 0; index < threads; ++index ) {
+        cpu += workers[ index ].elapsed;
+        evaluated += workers[ index ].count;
+        frames += workers[ index ].frames;
+    }
+
+    fprintf( stderr, "%u packets, %llu evaluated, %llu frames, %u threads\n",
+            _count,
+            ( unsigned long long ) evaluated,
+            ( unsigned long long ) frames,
+            threads );
+    fprintf( stderr, "%.3f ms, %.0f frames/s, %.2f ns/frame\n",
+            ( double ) elapsed / 1000000.0,
+            elapsed ? ( ( double ) frames * 1000000000.0 ) / elapsed : 0.0,
+            frames ? ( double ) cpu / frames : 0.0 );
+
+    fprintf( stderr, "\n%-8s %8s %-8s %12s\n", "rule", "line", "verdict", "packets" );
+    for( rule = 0; rule <= _rules.count; ++rule ) {
+        for( index = 0, hits = 0; index < threads; ++index ) {
+            hits += workers[ index ].hits[ rule ];
+        }
+        if( rule < _rules.count ) {
+            fprintf( stderr, "%-8u %8u %-8s %12llu\n",
+                    rule + 1,
+                    _rules.rule[ rule ].line,
+                    ( _rules.rule[ rule ].verdict == DNP3FW_VERDICT_ACCEPT ) ? "ACCEPT" : "DROP",
+                    ( unsigned long long ) hits );
+        }
+        else {
+            fprintf( stderr, "%-8s %8s %-8s %12llu\n",
+                    "policy",
+                    "-",
+                    ( _rules.policy == DNP3FW_VERDICT_ACCEPT ) ? "ACCEPT" : "DROP",
+                    ( unsigned long long ) hits );
+        }
+    }
+
+    fprintf( stderr, "\n%-12s %12s\n", "counter", "count" );
+    for( rule = 0; rule < XT_DNP3_STAT_MAX; ++rule ) {
+        for( index = 0, hits = 0; index < threads; ++index ) {
+            hits += workers[ index ].stats[ rule ];
+        }
+        fprintf( stderr, "%-12s %12llu\n", _stats[ rule ], ( unsigned long long ) hits );
+    }
+}
+
+
+static void *
+replay_worker( void *arg )
+{
+    struct replay_worker *worker = arg;
+    struct xt_dnp3_packet *parsed;
+    uint64_t start;
+    uint32_t count, index, summary;
+
+    if( ( parsed = calloc( 1, sizeof( *parsed ) ) ) == NULL ) {
+        worker->error = -1;
+        return NULL;
+    }
+    parsed->frame = parsed->frames;
+    parsed->size = XT_DNP3_FRAMES;
+    if( dnp3fw_session_init( _sessions, _apdus ) != 0 ) {
+        free( parsed );
+        worker->error = -1;
+        return NULL;
+    }
+
+    start = replay_clock( CLOCK_THREAD_CPUTIME_ID );
+    for( count = 0; count < worker->count; ++count ) {
+        index = worker->index[ count ];
+        parsed->count = 0;
+        _verdict[ index ] = ( uint8_t ) dnp3fw_rules_evaluate( &_rules, 
+                &_packets[ index ], 
+                parsed, 
+                _engine, 
+                &_rule[ index ] );
+        ++worker->hits[ _rule[ index ] ];
+        for( summary = 0; summary < parsed->count; ++summary ) {
+            worker->frames += parsed->frame[ summary ].count;
+        }
+    }
+    worker->elapsed = replay_clock( CLOCK_THREAD_CPUTIME_ID ) - start;
+    for( index = 0; index < XT_DNP3_STAT_MAX; ++index ) {
+        worker->stats[ index ] = dnp3_stats[ index ];
+    }
+
+    dnp3fw_session_exit();
+    if( parsed->frame != parsed->frames ) {
+        free( parsed->frame );
+    }
+    free( parsed );
+    return NULL;
+}
+
+
+int
+main( int argc, char **argv )
+{
+    static const char *verdicts[] = { "SKIP", "ACCEPT", "DROP" };
+    struct replay_worker *workers;
+    struct dnp3fw_packet *packet;
+    struct dnp3fw_pcap pcap;
+    const char *rules;
+    char *ptr;
+    uint64_t elapsed, start;
+    uint32_t index, size, hash, high, low;
+    unsigned int thread, threads;
+    long cpus;
+    int c, quiet, ret;
+
+    rules = NULL;
+    quiet = 0;
+    cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    threads = ( cpus > 0 ) ? ( unsigned int ) cpus : 1;
+    _rules.policy = DNP3FW_VERDICT_ACCEPT;
+
+    while( ( c = getopt( argc, argv, "a:c:P:qr:s:t:T:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'a':
+                _apdus = ( unsigned int ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'c':
+                if( strcmp( optarg, "table" ) == 0 ) {
+                    _engine = DNP3_CRC_TABLE;
+                }
+                else if( strcmp( optarg, "slice16" ) == 0 ) {
+                    _engine = DNP3_CRC_SLICE16;
+                }
+                else {
+                    fprintf( stderr, "Unknown CRC engine `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'P':
+                if( strcmp( optarg, "ACCEPT" ) == 0 ) {
+                    _rules.policy = DNP3FW_VERDICT_ACCEPT;
+                }
+                else if( strcmp( optarg, "DROP" ) == 0 ) {
+                    _rules.policy = DNP3FW_VERDICT_DROP;
+                }
+                else {
+                    fprintf( stderr, "Unknown policy `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 'r':
+                rules = optarg;
+                break;
+            case 's':
+                _sessions = ( unsigned int ) strtoul( optarg, NULL, 10 );
+                break;
+            case 't':
+                threads = ( unsigned int ) strtoul( optarg, NULL, 10 );
+                break;
+            case 'T':
+                if( ( ptr = strchr( optarg, '=' ) ) == NULL ) {
+                    fprintf( stderr, "Policy table must be specified as name=policy\n" );
+                    return 1;
+                }
+                *ptr++ = '\0';
+                if( dnp3fw_policy_load( optarg, ptr ) != 0 ) {
+                    return 1;
+                }
+                break;
+            case 'h':
+            default:
+                fprintf( stderr, "Usage: %s [-a apdus] [-c table|slice16] [-P ACCEPT|DROP] [-q] [-s sessions] [-t threads] [-T name=policy] -r rules capture.pcap\n", argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( ( rules == NULL ) ||
+            ( optind != ( argc - 1 ) ) ) {
+        fprintf( stderr, "Usage: %s [-a apdus] [-c table|slice16] [-P ACCEPT|DROP] [-q] [-s sessions] [-t threads] [-T name=policy] -r rules capture.pcap\n", argv[0] );
+        return 1;
+    }
+    if( ( threads == 0 ) ||
+            ( _sessions == 0 ) ) {
+        fprintf( stderr, "Thread and session counts must be non-zero\n" );
+        return 1;
+    }
+
+    dnp3_crc_init();
+    if( dnp3fw_rules_load( &_rules, rules ) != 0 ) {
+        return 1;
+    }
+    if( dnp3fw_pcap_open( &pcap, argv[ optind ] ) != 0 ) {
+        return 1;
+    }
+
+    workers = calloc( threads, sizeof( *workers ) );
+    for( thread = 0; ( workers != NULL ) && ( thread < threads ); ++thread ) {
+        if( ( workers[ thread ].hits = calloc( _rules.count + 1, sizeof( uint64_t ) ) ) == NULL ) {
+            fprintf( stderr, "Memory allocation failure\n" );
+            return 1;
+        }
+    }
+    if( workers == NULL ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return 1;
+    }
+
+    /*
+        The packets of the capture are decoded and partitioned between worker 
+        threads on the unordered pair of IP addresses, prior to the evaluation of 
+        the rule set, such that only parsing and matching is measured.
+    */
+
+    for( size = 0;; ++_count ) {
+        if( _count == size ) {
+            size = size ? ( size * 2 ) : 65536;
+            if( ( packet = realloc( _packets, size * sizeof( *packet ) ) ) == NULL ) {
+                fprintf( stderr, "Memory allocation failure\n" );
+                return 1;
+            }
+            _packets = packet;
+        }
+        packet = &_packets[ _count ];
+        if( ( ret = dnp3fw_pcap_next( &pcap, packet ) ) <= 0 ) {
+            if( ret < 0 ) {
+                fprintf( stderr, "%s: Truncated capture file\n", argv[ optind ] );
+            }
+            break;
+        }
+        if( packet->protocol == 0 ) {
+            continue;
+        }
+        low = ( packet->src < packet->dest ) ? packet->src : packet->dest;
+        high = ( packet->src < packet->dest ) ? packet->dest : packet->src;
+        hash = ( low * 0x9e3779b1U ) ^ ( high * 0x85ebca77U );
+        hash ^= ( hash >> 16 );
+        if( replay_add( &workers[ hash % threads ], _count ) != 0 ) {
+            fprintf( stderr, "Memory allocation failure\n" );
+            return 1;
+        }
+    }
+    _verdict = calloc( _count + 1, sizeof( *_verdict ) );
+    _rule = calloc( _count + 1, sizeof( *_rule ) );
+    if( ( _verdict == NULL ) ||
+            ( _rule == NULL ) ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return 1;
+    }
+
+    start = replay_clock( CLOCK_MONOTONIC );
+    for( thread = 0; thread < threads; ++thread ) {
+        if( pthread_create( &workers[ thread ].thread, NULL, replay_worker, &workers[ thread ] ) != 0 ) {
+            fprintf( stderr, "Unable to create worker thread\n" );
+            return 1;
+        }
+    }
+    for( thread = 0, ret = 0; thread < threads; ++thread ) {
+        ( void ) pthread_join( workers[ thread ].thread, NULL );
+        ret |= workers[ thread ].error;
+    }
+    elapsed = replay_clock( CLOCK_MONOTONIC ) - start;
+    if( ret != 0 ) {
+        fprintf( stderr, "Worker thread initialisation failure\n" );
+        return 1;
+    }
+
+    if( ! quiet ) {
+        for( index = 0; index < _count; ++index ) {
+            if( _verdict[ index ] == DNP3FW_VERDICT_NONE ) {
+                printf( "%u %s -\n", index + 1, verdicts[ _verdict[ index ] ] );
+            }
+            else if( _rule[ index ] < _rules.count ) {
+                printf( "%u %s %u\n", index + 1, verdicts[ _verdict[ index ] ], _rules.rule[ _rule[ index ] ].line );
+            }
+            else {
+                printf( "%u %s policy\n", index + 1, verdicts[ _verdict[ index ] ] );
+            }
+        }
+    }
+    replay_report( workers, threads, elapsed );
+
+    for( thread = 0; thread < threads; ++thread ) {
+        free( workers[ thread ].index );
+        free( workers[ thread ].hits );
+    }
+    free( workers );
+    free( _rule );
+    free( _verdict );
+    free( _packets );
+    dnp3fw_pcap_close( &pcap );
+    dnp3fw_rules_free( &_rules );
+    dnp3fw_policy_free();
+    return 0;
+}
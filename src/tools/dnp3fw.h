@@ -0,0 +1,114 @@
+#ifndef _DNP3FW_H
+#define _DNP3FW_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "xt_dnp3.h"
+#include "xt_dnp3_crc.h"
+#include "xt_dnp3_packet.h"
+
+
+/*
+    The libdnp3fw library comprises the DNP3 frame parsing and rule matching source 
+    of the xt_dnp3 kernel module, compiled for userspace, together with the capture 
+    file, rule set, policy table and transport session support required to 
+    evaluate rule sets against captured traffic outside of the kernel.
+*/
+
+enum {
+    DNP3FW_VERDICT_NONE = 0,
+    DNP3FW_VERDICT_ACCEPT,
+    DNP3FW_VERDICT_DROP,
+};
+
+
+struct dnp3fw_packet {
+    uint64_t time;                      /* Capture time (ns) */
+    const uint8_t *ip;                  /* IPv4 header */
+    uint32_t iplen;                     /* IPv4 datagram length */
+    const uint8_t *payload;             /* Transport payload */
+    uint32_t len;                       /* Transport payload length */
+    uint32_t src;                       /* Source IP (host order) */
+    uint32_t dest;                      /* Destination IP (host order) */
+    uint16_t sport;                     /* Source port */
+    uint16_t dport;                     /* Destination port */
+    uint8_t protocol;                   /* IP protocol, zero where not IPv4 */
+    uint8_t fragment;                   /* Non-initial IP fragment */
+};
+
+struct dnp3fw_pcap {
+    uint8_t *map;                       /* Capture file mapping */
+    size_t size;                        /* Capture file size */
+    size_t offset;                      /* Offset of next record */
+    uint32_t linktype;                  /* Link layer header type */
+    int swapped;                        /* Byte-swapped capture file */
+    int nsec;                           /* Nanosecond timestamps */
+};
+
+struct xt_dnp3_rate {
+    uint64_t interval;                  /* Interval between messages (ns) */
+    uint64_t tolerance;                 /* Burst tolerance (ns) */
+    uint64_t tat[ XT_DNP3_RATE_BUCKETS ];
+};
+
+struct xt_dnp3_table {
+    struct xt_dnp3_table *next;         /* Policy tables */
+    struct xt_dnp3_policy *policy;      /* Policy */
+    char name[ XT_DNP3_POLICY_NAME ];   /* Table name */
+};
+
+struct dnp3fw_rule {
+    struct xt_dnp3_rule match;          /* dnp3 match */
+    unsigned int line;                  /* Rule set line number */
+    uint32_t src[2];                    /* Source IP and mask (host order) */
+    uint32_t dest[2];                   /* Destination IP and mask (host order) */
+    uint16_t sport[2];                  /* Source port range */
+    uint16_t dport[2];                  /* Destination port range */
+    uint8_t protocol;                   /* IP protocol, zero for any */
+    uint8_t dnp3;                       /* dnp3 match specified */
+    uint8_t verdict;                    /* Verdict */
+};
+
+struct dnp3fw_rules {
+    struct dnp3fw_rule *rule;           /* Rules */
+    unsigned int count;                 /* Number of rules */
+    uint8_t policy;                     /* Default verdict */
+    uint8_t depth;                      /* CRC validation depth */
+    uint8_t sample;                     /* CRC sample interval (log2) */
+    uint8_t inspect;                    /* Decode object headers */
+    uint8_t sessions;                   /* Track multi-frame messages */
+};
+
+
+void dnp3fw_pcap_close( struct dnp3fw_pcap *pcap );
+
+void dnp3fw_pcap_ipv4( const uint8_t *data, uint32_t len, struct dnp3fw_packet *packet );
+
+int dnp3fw_pcap_next( struct dnp3fw_pcap *pcap, struct dnp3fw_packet *packet );
+
+int dnp3fw_pcap_open( struct dnp3fw_pcap *pcap, const char *path );
+
+void dnp3fw_policy_free( void );
+
+int dnp3fw_policy_load( const char *name, const char *path );
+
+int dnp3fw_policy_read( const char *path, struct xt_dnp3_entry **entry, unsigned int *count );
+
+struct xt_dnp3_table * dnp3fw_policy_table( const char *name );
+
+int dnp3fw_rules_evaluate( const struct dnp3fw_rules *rules, const struct dnp3fw_packet *packet, struct xt_dnp3_packet *parsed, int engine, unsigned int *index );
+
+void dnp3fw_rules_free( struct dnp3fw_rules *rules );
+
+int dnp3fw_rules_load( struct dnp3fw_rules *rules, const char *path );
+
+void dnp3fw_session_exit( void );
+
+int dnp3fw_session_init( unsigned int sessions, unsigned int apdus );
+
+void dnp3fw_session_time( uint64_t time );
+
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This source provides a minimal reader for capture files in the classic pcap 
+    format, with microsecond or nanosecond timestamp resolution and in either byte 
+    order, which decodes the IPv4 and transport headers of each packet. Captures 
+    in the pcapng format should be converted with editcap prior to replay.
+*/
+
+#define PCAP_MAGIC                      (0xa1b2c3d4)
+#define PCAP_MAGIC_NSEC                 (0xa1b23c4d)
+
+#define PCAP_HDR_LENGTH                 (24)
+#define PCAP_RECORD_LENGTH              (16)
+
+#define LINKTYPE_NULL                   (0)
+#define LINKTYPE_ETHERNET               (1)
+#define LINKTYPE_RAW                    (101)
+#define LINKTYPE_LINUX_SLL              (113)
+#define LINKTYPE_IPV4                   (228)
+#define LINKTYPE_LINUX_SLL2             (276)
+
+
+static void pcap_decode( struct dnp3fw_pcap *pcap, const uint8_t *data, uint32_t len, struct dnp3fw_packet *packet );
+
+static uint32_t pcap_read32( const struct dnp3fw_pcap *pcap, const uint8_t *data );
+
+
+static void
+pcap_decode( struct dnp3fw_pcap *pcap, const uint8_t *data, uint32_t len, struct dnp3fw_packet *packet )
+{
+    uint32_t family, offset;
+    uint16_t type;
+
+    switch( pcap->linktype ) {
+        case LINKTYPE_NULL:
+            if( len < 4 ) {
+                return;
+            }
+            family = pcap_read32( pcap, data );
+            if( family != 2 ) {
+                return;
+            }
+            offset = 4;
+            break;
+        case LINKTYPE_ETHERNET:
+            for( offset = 12;; offset += 4 ) {
+                if( len < ( offset + 2 ) ) {
+                    return;
+                }
+                type = ( data[ offset ] << 8 ) | data[ offset + 1 ];
+                if( ( type != 0x8100 ) &&
+                        ( type != 0x88a8 ) ) {
+                    break;
+                }
+            }
+            if( type != 0x0800 ) {
+                return;
+            }
+            offset += 2;
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if( ( len < 16 ) ||
+                    ( ( ( data[14] << 8 ) | data[15] ) != 0x0800 ) ) {
+                return;
+            }
+            offset = 16;
+            break;
+        case LINKTYPE_LINUX_SLL2:
+            if( ( len < 20 ) ||
+                    ( ( ( data[0] << 8 ) | data[1] ) != 0x0800 ) ) {
+                return;
+            }
+            offset = 20;
+            break;
+        case LINKTYPE_RAW:
+        case LINKTYPE_IPV4:
+            offset = 0;
+            break;
+        default:
+            return;
+    }
+    dnp3fw_pcap_ipv4( data + offset, len - offset, packet );
+}
+
+
+static uint32_t
+pcap_read32( const struct dnp3fw_pcap *pcap, const uint8_t *data )
+{
+    uint32_t value;
+
+    memcpy( &value, data, sizeof( value ) );
+    return pcap->swapped ? bswap_32( value ) : value;
+}
+
+
+void
+dnp3fw_pcap_close( struct dnp3fw_pcap *pcap )
+{
+    if( pcap->map != NULL ) {
+        ( void ) munmap( pcap->map, pcap->size );
+    }
+    pcap->map = NULL;
+}
+
+
+/*
+    This function decodes the IPv4 and transport headers of a datagram into the 
+    structure pointed to by packet, which is expected to have been cleared, and is 
+    also used to decode the packets of other sources, such as NFQUEUE.
+*/
+
+void
+dnp3fw_pcap_ipv4( const uint8_t *data, uint32_t len, struct dnp3fw_packet *packet )
+{
+    uint32_t hlen, offset, total;
+
+    if( ( len < 20 ) ||
+            ( ( data[0] >> 4 ) != 4 ) ||
+            ( ( hlen = ( data[0] & 0x0f ) * 4 ) < 20 ) ) {
+        return;
+    }
+
+    /*
+        The IPv4 total length bounds the datagram, excluding any link layer padding, 
+        while the datagram is further bounded by the captured length of the packet.
+    */
+
+    total = ( data[2] << 8 ) | data[3];
+    if( ( total < hlen ) ||
+            ( len < hlen ) ) {
+        return;
+    }
+    if( total < len ) {
+        len = total;
+    }
+
+    packet->ip = data;
+    packet->iplen = len;
+    packet->protocol = data[9];
+    packet->fragment = ( ( ( ( data[6] << 8 ) | data[7] ) & 0x1fff ) != 0 );
+    packet->src = ( ( uint32_t ) data[12] << 24 ) | ( data[13] << 16 ) | ( data[14] << 8 ) | data[15];
+    packet->dest = ( ( uint32_t ) data[16] << 24 ) | ( data[17] << 16 ) | ( data[18] << 8 ) | data[19];
+    if( packet->fragment ) {
+        return;
+    }
+
+    data += hlen;
+    len -= hlen;
+    switch( packet->protocol ) {
+        case 6:
+            if( ( len < 20 ) ||
+                    ( ( offset = ( data[12] >> 4 ) * 4 ) > len ) ) {
+                return;
+            }
+            break;
+        case 17:
+            if( len < 8 ) {
+                return;
+            }
+            offset = 8;
+            break;
+        default:
+            return;
+    }
+    packet->sport = ( data[0] << 8 ) | data[1];
+    packet->dport = ( data[2] << 8 ) | data[3];
+    packet->payload = data + offset;
+    packet->len = len - offset;
+}
+
+
+/*
+    This function returns the next packet of the capture file, decoded into the 
+    structure pointed to by packet, returning 1 where a packet is returned, 0 at 
+    the end of the capture file and -1 where the capture file is truncated. The 
+    protocol of packets which are not IPv4 is returned as zero.
+*/
+
+int
+dnp3fw_pcap_next( struct dnp3fw_pcap *pcap, struct dnp3fw_packet *packet )
+{
+    const uint8_t *record;
+    uint32_t len;
+
+    ( void ) memset( packet, 0, sizeof( *packet ) );
+    if( pcap->offset == pcap->size ) {
+        return 0;
+    }
+    if( ( pcap->size - pcap->offset ) < PCAP_RECORD_LENGTH ) {
+        return -1;
+    }
+    record = pcap->map + pcap->offset;
+    len = pcap_read32( pcap, record + 8 );
+    if( ( pcap->size - pcap->offset - PCAP_RECORD_LENGTH ) < len ) {
+        return -1;
+    }
+    pcap->offset += PCAP_RECORD_LENGTH + len;
+
+    packet->time = ( uint64_t ) pcap_read32( pcap, record ) * 1000000000ULL +
+            ( uint64_t ) pcap_read32( pcap, record + 4 ) * ( pcap->nsec ? 1 : 1000 );
+    pcap_decode( pcap, record + PCAP_RECORD_LENGTH, len, packet );
+    return 1;
+}
+
+
+int
+dnp3fw_pcap_open( struct dnp3fw_pcap *pcap, const char *path )
+{
+    struct stat st;
+    uint32_t magic;
+    int fd;
+
+    ( void ) memset( pcap, 0, sizeof( *pcap ) );
+    if( ( fd = open( path, O_RDONLY ) ) < 0 ) {
+        perror( path );
+        return -1;
+    }
+    if( fstat( fd, &st ) != 0 ) {
+        perror( path );
+        ( void ) close( fd );
+        return -1;
+    }
+    if( st.st_size < PCAP_HDR_LENGTH ) {
+        fprintf( stderr, "%s: Not a pcap capture file\n", path );
+        ( void ) close( fd );
+        return -1;
+    }
+    pcap->size = ( size_t ) st.st_size;
+    pcap->map = mmap( NULL, pcap->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ( void ) close( fd );
+    if( pcap->map == MAP_FAILED ) {
+        perror( path );
+        pcap->map = NULL;
+        return -1;
+    }
+    ( void ) madvise( pcap->map, pcap->size, MADV_SEQUENTIAL );
+
+    memcpy( &magic, pcap->map, sizeof( magic ) );
+    if( ( magic == PCAP_MAGIC_NSEC ) ||
+            ( magic == bswap_32( PCAP_MAGIC_NSEC ) ) ) {
+        pcap->nsec = 1;
+    }
+    if( ( magic == bswap_32( PCAP_MAGIC ) ) ||
+            ( magic == bswap_32( PCAP_MAGIC_NSEC ) ) ) {
+        pcap->swapped = 1;
+    }
+    else if( ( magic != PCAP_MAGIC ) &&
+            ( magic != PCAP_MAGIC_NSEC ) ) {
+        fprintf( stderr, "%s: Not a pcap capture file\n", path );
+        dnp3fw_pcap_close( pcap );
+        return -1;
+    }
+    pcap->linktype = pcap_read32( pcap, pcap->map + 20 ) & 0x0fffffff;
+    pcap->offset = PCAP_HDR_LENGTH;
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    Policy tables are read from a text file with one entry per line, specifying 
+    the source and destination link layer addresses, either of which may be given 
+    as `*' for any address, and the function codes permitted between these 
+    addresses - for example:
+
+        1 10 1,2,129,130
+        * 10 129,130
+
+    Blank lines and comments are ignored, and the function codes of entries for 
+    the same addresses are combined. The entries read are either built into a 
+    policy table for evaluation by the userspace tools or loaded into the kernel 
+    module by dnp3fw-policy.
+*/
+
+#define POLICY_TOKENS                   (3)
+
+
+static int policy_parse( struct xt_dnp3_entry *entry, char **token );
+
+static int policy_parse_addr( const char *arg, uint16_t *addr, uint8_t *flags, uint8_t any );
+
+static int policy_parse_number( const char *arg, unsigned long max, unsigned long *value );
+
+
+static struct xt_dnp3_table *_table;
+
+
+static int
+policy_parse( struct xt_dnp3_entry *entry, char **token )
+{
+    unsigned long value;
+    char *ptr, *save;
+
+    ( void ) memset( entry, 0, sizeof( *entry ) );
+    if( ( policy_parse_addr( token[0], &entry->saddr, &entry->flags, XT_DNP3_POLICY_ANY_SADDR ) != 0 ) ||
+            ( policy_parse_addr( token[1], &entry->daddr, &entry->flags, XT_DNP3_POLICY_ANY_DADDR ) != 0 ) ) {
+        return -1;
+    }
+    for( ptr = strtok_r( token[2], ",", &save );
+            ptr;
+            ptr = strtok_r( NULL, ",", &save ) ) {
+
+        if( policy_parse_number( ptr, 255, &value ) != 0 ) {
+            fprintf( stderr, "Only numeric DNP3 function codes accepted\n" );
+            return -1;
+        }
+        entry->fc[ value / 8 ] |= ( 1 << ( value % 8 ) );
+    }
+    return 0;
+}
+
+
+static int
+policy_parse_addr( const char *arg, uint16_t *addr, uint8_t *flags, uint8_t any )
+{
+    unsigned long value;
+
+    if( strcmp( arg, "*" ) == 0 ) {
+        *flags |= any;
+        return 0;
+    }
+    if( policy_parse_number( arg, 0xffff, &value ) != 0 ) {
+        return -1;
+    }
+    *addr = ( uint16_t ) value;
+    return 0;
+}
+
+
+static int
+policy_parse_number( const char *arg, unsigned long max, unsigned long *value )
+{
+    const char *ptr;
+
+    for( ptr = arg; *ptr; ++ptr ) {
+        if( isdigit( ( unsigned char ) *ptr ) == 0 ) {
+            break;
+        }
+    }
+    if( ( ptr == arg ) ||
+            ( *ptr != '\0' ) ||
+            ( ( *value = strtoul( arg, NULL, 10 ) ) > max ) ) {
+        fprintf( stderr, "Invalid value `%s'\n", arg );
+        return -1;
+    }
+    return 0;
+}
+
+
+const struct xt_dnp3_policy *
+dnp3_policy_get( const struct xt_dnp3_table *table )
+{
+    return table->policy;
+}
+
+
+void
+dnp3fw_policy_free( void )
+{
+    struct xt_dnp3_table *table;
+
+    while( ( table = _table ) != NULL ) {
+        _table = table->next;
+        free( table->policy );
+        free( table );
+    }
+}
+
+
+/*
+    This function reads the policy file specified and builds from it the policy 
+    table of the name specified, for reference by the --policy option of rules 
+    subsequently loaded. A policy table may be loaded only once.
+*/
+
+int
+dnp3fw_policy_load( const char *name, const char *path )
+{
+    struct xt_dnp3_entry *entry;
+    struct xt_dnp3_table *table;
+    unsigned int count, index;
+    uint32_t bits;
+
+    if( ( name[0] == '\0' ) ||
+            ( strlen( name ) >= XT_DNP3_POLICY_NAME ) ) {
+        fprintf( stderr, "Invalid policy table name `%s'\n", name );
+        return -1;
+    }
+    if( dnp3fw_policy_table( name ) != NULL ) {
+        fprintf( stderr, "Policy table `%s' already loaded\n", name );
+        return -1;
+    }
+    if( dnp3fw_policy_read( path, &entry, &count ) != 0 ) {
+        return -1;
+    }
+
+    bits = dnp3_policy_bits( count );
+    if( ( ( table = calloc( 1, sizeof( *table ) ) ) == NULL ) ||
+            ( ( table->policy = calloc( 1, sizeof( *table->policy ) +
+                    ( sizeof( struct xt_dnp3_entry ) << bits ) ) ) == NULL ) ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        free( table );
+        free( entry );
+        return -1;
+    }
+    table->policy->bits = bits;
+    for( index = 0; index < count; ++index ) {
+        ( void ) dnp3_policy_insert( table->policy, &entry[ index ] );
+    }
+    free( entry );
+
+    ( void ) strcpy( table->name, name );
+    table->next = _table;
+    _table = table;
+    return 0;
+}
+
+
+int
+dnp3fw_policy_read( const char *path, struct xt_dnp3_entry **entry, unsigned int *count )
+{
+    struct xt_dnp3_entry *next;
+    char *token[ POLICY_TOKENS ];
+    char *line, *ptr, *save;
+    unsigned int number, tokens;
+    size_t size;
+    FILE *fp;
+    int ret;
+
+    if( ( fp = fopen( path, "r" ) ) == NULL ) {
+        perror( path );
+        return -1;
+    }
+
+    *entry = NULL;
+    *count = 0;
+    line = NULL;
+    size = 0;
+    number = 0;
+    ret = 0;
+    while( getline( &line, &size, fp ) >= 0 ) {
+        ++number;
+        if( ( ptr = strchr( line, '#' ) ) != NULL ) {
+            *ptr = '\0';
+        }
+        for( tokens = 0, ptr = strtok_r( line, " \t\r\n", &save );
+                ( ptr != NULL ) && ( tokens < POLICY_TOKENS );
+                ptr = strtok_r( NULL, " \t\r\n", &save ) ) {
+            token[ tokens++ ] = ptr;
+        }
+        if( tokens == 0 ) {
+            continue;
+        }
+        if( ( tokens != POLICY_TOKENS ) ||
+                ( ptr != NULL ) ) {
+            fprintf( stderr, "%s:%u: Expected source address, destination address and function codes\n", path, number );
+            ret = -1;
+            break;
+        }
+        if( *count >= XT_DNP3_POLICY_ENTRIES ) {
+            fprintf( stderr, "%s:%u: Too many policy table entries\n", path, number );
+            ret = -1;
+            break;
+        }
+
+        if( ( next = realloc( *entry, ( *count + 1 ) * sizeof( *next ) ) ) == NULL ) {
+            fprintf( stderr, "Memory allocation failure\n" );
+            ret = -1;
+            break;
+        }
+        *entry = next;
+        if( policy_parse( &next[ *count ], token ) != 0 ) {
+            fprintf( stderr, "%s:%u: Invalid policy table entry\n", path, number );
+            ret = -1;
+            break;
+        }
+        ++*count;
+    }
+
+    free( line );
+    ( void ) fclose( fp );
+    if( ret != 0 ) {
+        free( *entry );
+        *entry = NULL;
+        *count = 0;
+    }
+    return ret;
+}
+
+
+struct xt_dnp3_table *
+dnp3fw_policy_table( const char *name )
+{
+    struct xt_dnp3_table *table;
+
+    for( table = _table; table != NULL; table = table->next ) {
+        if( strcmp( table->name, name ) == 0 ) {
+            return table;
+        }
+    }
+    return NULL;
+}
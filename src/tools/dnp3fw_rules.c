@@ -0,0 +1,993 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <arpa/inet.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    Rule sets are read from a text file with one rule per line, specified with the 
+    options of the iptables command and of the dnp3 match - for example:
+
+        -p tcp --dport 20000 -m dnp3 --saddr 1 --daddr 10 --fc 1,129 -j ACCEPT
+
+    Rules are evaluated in order, with the first matching rule determining the 
+    verdict for a packet. Blank lines, comments and the table, chain and COMMIT 
+    lines of iptables-save output are ignored, as is a leading -A chain option, 
+    such that the output of iptables-save for a single chain may be used directly.
+*/
+
+#define RULES_TOKENS                    (64)
+
+
+static void rules_depth( struct dnp3fw_rules *rules );
+
+static int rules_parse( struct dnp3fw_rule *rule, char **token, unsigned int count );
+
+static int rules_parse_address( const char *arg, uint32_t *addr );
+
+static int rules_parse_crc( const char *arg, struct xt_dnp3_rule *match );
+
+static int rules_parse_function( const char *arg, uint8_t *func );
+
+static int rules_parse_mark( const char *arg, struct xt_dnp3_rule *match );
+
+static int rules_parse_number( const char *arg, unsigned long max, unsigned long *value );
+
+static int rules_parse_object( const char *arg, struct xt_dnp3_object *object );
+
+static int rules_parse_range( const char *arg, uint16_t *range );
+
+static int rules_parse_rate( const char *arg, uint32_t *interval );
+
+static int rules_parse_verdict( const char *arg, uint8_t *verdict );
+
+static inline int rules_value( uint16_t value, const uint16_t *range );
+
+
+static __thread uint64_t _time;
+
+
+/*
+    As within the kernel module, the frames of a packet are validated to the 
+    greatest depth required by any rule of the rule set, with the shortest sample 
+    interval of those rules where sampled. Object headers are decoded only where 
+    a rule with object header constraints is present, and the sessions of 
+    multi-frame messages tracked only where a rule with function code, policy 
+    table or object header constraints, or which learns function codes, is 
+    present.
+*/
+
+static void
+rules_depth( struct dnp3fw_rules *rules )
+{
+    const struct xt_dnp3_rule *match;
+    unsigned int index;
+    int full, header;
+
+    full = header = 0;
+    rules->depth = XT_DNP3_CRC_NONE;
+    rules->sample = XT_DNP3_CRC_SAMPLE_MAX;
+    rules->inspect = 0;
+    rules->sessions = 0;
+    for( index = 0; index < rules->count; ++index ) {
+        if( ! rules->rule[ index ].dnp3 ) {
+            continue;
+        }
+        match = &rules->rule[ index ].match;
+        if( match->set & XT_DNP3_FLAG_OBJECT ) {
+            rules->inspect = 1;
+        }
+        if( match->set & ( XT_DNP3_FLAG_FC | XT_DNP3_FLAG_POLICY | XT_DNP3_FLAG_OBJECT | XT_DNP3_FLAG_LEARN ) ) {
+            rules->sessions = 1;
+        }
+        switch( dnp3_packet_crc( match ) ) {
+            case XT_DNP3_CRC_FULL:
+                full = 1;
+                break;
+            case XT_DNP3_CRC_HEADER:
+                header = 1;
+                break;
+            case XT_DNP3_CRC_SAMPLE:
+                rules->depth = XT_DNP3_CRC_SAMPLE;
+                if( match->sample < rules->sample ) {
+                    rules->sample = match->sample;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if( full ) {
+        rules->depth = XT_DNP3_CRC_FULL;
+    }
+    else if( ( header ) &&
+            ( rules->depth != XT_DNP3_CRC_SAMPLE ) ) {
+        rules->depth = XT_DNP3_CRC_HEADER;
+    }
+    if( rules->depth != XT_DNP3_CRC_SAMPLE ) {
+        rules->sample = 0;
+    }
+}
+
+
+static int
+rules_parse( struct dnp3fw_rule *rule, char **token, unsigned int count )
+{
+    struct xt_dnp3_rule *match;
+    const char *arg, *option;
+    unsigned long value;
+    unsigned int index;
+    uint32_t flag;
+    int invert, per;
+
+    match = &rule->match;
+    match->daddr[1] = match->saddr[1] = 0xffff;
+    per = 0;
+    rule->sport[1] = rule->dport[1] = 0xffff;
+
+    for( index = 0; index < count; ++index ) {
+        option = token[ index ];
+        invert = 0;
+        if( strcmp( option, "!" ) == 0 ) {
+            if( ++index >= count ) {
+                fprintf( stderr, "Missing option following `!'\n" );
+                return -1;
+            }
+            option = token[ index ];
+            invert = 1;
+        }
+        if( strcmp( option, "--chksum" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( invert ) {
+                fprintf( stderr, "Inversion not supported for option `%s'\n", option );
+                return -1;
+            }
+            match->set |= XT_DNP3_FLAG_CHECKSUM;
+            match->crc = XT_DNP3_CRC_FULL;
+            continue;
+        }
+        if( strcmp( option, "--learn" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( invert ) {
+                fprintf( stderr, "Inversion not supported for option `%s'\n", option );
+                return -1;
+            }
+            match->set |= XT_DNP3_FLAG_LEARN;
+            continue;
+        }
+        if( ( index + 1 ) >= count ) {
+            fprintf( stderr, "Missing argument for option `%s'\n", option );
+            return -1;
+        }
+        arg = token[ ++index ];
+
+        if( strcmp( option, "-A" ) == 0 ) {
+            continue;
+        }
+        else if( ( strcmp( option, "-s" ) == 0 ) ||
+                ( strcmp( option, "--source" ) == 0 ) ) {
+            if( rules_parse_address( arg, rule->src ) != 0 ) {
+                return -1;
+            }
+        }
+        else if( ( strcmp( option, "-d" ) == 0 ) ||
+                ( strcmp( option, "--destination" ) == 0 ) ) {
+            if( rules_parse_address( arg, rule->dest ) != 0 ) {
+                return -1;
+            }
+        }
+        else if( ( strcmp( option, "-p" ) == 0 ) ||
+                ( strcmp( option, "--protocol" ) == 0 ) ) {
+            if( strcmp( arg, "tcp" ) == 0 ) {
+                rule->protocol = 6;
+            }
+            else if( strcmp( arg, "udp" ) == 0 ) {
+                rule->protocol = 17;
+            }
+            else {
+                fprintf( stderr, "Unsupported protocol `%s'\n", arg );
+                return -1;
+            }
+        }
+        else if( ( strcmp( option, "--sport" ) == 0 ) ||
+                ( strcmp( option, "--source-port" ) == 0 ) ) {
+            if( rules_parse_range( arg, rule->sport ) != 0 ) {
+                return -1;
+            }
+        }
+        else if( ( strcmp( option, "--dport" ) == 0 ) ||
+                ( strcmp( option, "--destination-port" ) == 0 ) ) {
+            if( rules_parse_range( arg, rule->dport ) != 0 ) {
+                return -1;
+            }
+        }
+        else if( ( strcmp( option, "-m" ) == 0 ) ||
+                ( strcmp( option, "--match" ) == 0 ) ) {
+            if( strcmp( arg, "dnp3" ) == 0 ) {
+                rule->dnp3 = 1;
+            }
+            else if( ( strcmp( arg, "tcp" ) != 0 ) &&
+                    ( strcmp( arg, "udp" ) != 0 ) ) {
+                fprintf( stderr, "Unsupported match `%s'\n", arg );
+                return -1;
+            }
+        }
+        else if( ( strcmp( option, "-j" ) == 0 ) ||
+                ( strcmp( option, "--jump" ) == 0 ) ) {
+            if( rules_parse_verdict( arg, &rule->verdict ) != 0 ) {
+                return -1;
+            }
+        }
+        else if( strcmp( option, "--object" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( match->objects >= XT_DNP3_OBJECTS ) {
+                fprintf( stderr, "Only %u `--object' definitions allowed\n", XT_DNP3_OBJECTS );
+                return -1;
+            }
+            if( ( match->set & XT_DNP3_FLAG_OBJECT ) &&
+                    ( ( ! ( match->invert & XT_DNP3_FLAG_OBJECT ) ) != ( ! invert ) ) ) {
+                fprintf( stderr, "Inversion must be specified for all or no `--object' definitions\n" );
+                return -1;
+            }
+            if( rules_parse_object( arg, &match->object[ match->objects++ ] ) != 0 ) {
+                return -1;
+            }
+            match->set |= XT_DNP3_FLAG_OBJECT;
+            match->invert |= invert ? XT_DNP3_FLAG_OBJECT : 0;
+            continue;
+        }
+        else if( strcmp( option, "--policy" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( match->set & XT_DNP3_FLAG_POLICY ) {
+                fprintf( stderr, "Only single `--policy' definition allowed\n" );
+                return -1;
+            }
+            if( ( match->table = dnp3fw_policy_table( arg ) ) == NULL ) {
+                fprintf( stderr, "Unknown policy table `%s'\n", arg );
+                return -1;
+            }
+            ( void ) strcpy( match->policy, match->table->name );
+            match->set |= XT_DNP3_FLAG_POLICY;
+            match->invert |= invert ? XT_DNP3_FLAG_POLICY : 0;
+            continue;
+        }
+        else if( strcmp( option, "--fc-rate" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( rules_parse_rate( arg, &match->interval ) != 0 ) {
+                return -1;
+            }
+            match->set |= XT_DNP3_FLAG_RATE;
+            match->invert |= invert ? XT_DNP3_FLAG_RATE : 0;
+            continue;
+        }
+        else if( strcmp( option, "--fc-burst" ) == 0 ) {
+            if( rules_parse_number( arg, XT_DNP3_RATE_BURST_MAX, &value ) != 0 ) {
+                return -1;
+            }
+            if( value == 0 ) {
+                fprintf( stderr, "Burst must be non-zero\n" );
+                return -1;
+            }
+            match->burst = ( uint32_t ) value;
+        }
+        else if( strcmp( option, "--per" ) == 0 ) {
+            if( strcmp( arg, "daddr" ) == 0 ) {
+                match->per = XT_DNP3_RATE_DADDR;
+            }
+            else if( strcmp( arg, "saddr" ) == 0 ) {
+                match->per = XT_DNP3_RATE_SADDR;
+            }
+            else if( strcmp( arg, "pair" ) == 0 ) {
+                match->per = XT_DNP3_RATE_PAIR;
+            }
+            else {
+                fprintf( stderr, "Unknown rate limit key `%s'\n", arg );
+                return -1;
+            }
+            per = 1;
+        }
+        else if( strcmp( option, "--event" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( rules_parse_number( arg, 255, &value ) != 0 ) {
+                return -1;
+            }
+            match->event = ( uint8_t ) value;
+            match->set |= XT_DNP3_FLAG_EVENT;
+        }
+        else if( strcmp( option, "--ct-mark" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( rules_parse_mark( arg, match ) != 0 ) {
+                return -1;
+            }
+            match->set |= XT_DNP3_FLAG_CTMARK;
+        }
+        else if( strcmp( option, "--crc" ) == 0 ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( rules_parse_crc( arg, match ) != 0 ) {
+                return -1;
+            }
+            match->set |= XT_DNP3_FLAG_CHECKSUM;
+        }
+        else if( ( strcmp( option, "--daddr" ) == 0 ) ||
+                ( strcmp( option, "--destination-addr" ) == 0 ) ||
+                ( strcmp( option, "--saddr" ) == 0 ) ||
+                ( strcmp( option, "--source-addr" ) == 0 ) ||
+                ( strcmp( option, "--fc" ) == 0 ) ||
+                ( strcmp( option, "--function-code" ) == 0 ) ) {
+            if( rule->dnp3 == 0 ) {
+                fprintf( stderr, "Option `%s' requires `-m dnp3'\n", option );
+                return -1;
+            }
+            if( option[2] == 'd' ) {
+                flag = XT_DNP3_FLAG_DADDR;
+                if( rules_parse_range( arg, match->daddr ) != 0 ) {
+                    return -1;
+                }
+            }
+            else if( option[2] == 's' ) {
+                flag = XT_DNP3_FLAG_SADDR;
+                if( rules_parse_range( arg, match->saddr ) != 0 ) {
+                    return -1;
+                }
+            }
+            else {
+                flag = XT_DNP3_FLAG_FC;
+                if( ( match->set & XT_DNP3_FLAG_FC ) &&
+                        ( ( match->invert & XT_DNP3_FLAG_FC ) || invert ) ) {
+                    fprintf( stderr, "Only single `--function-code' definition allowed with inversion\n" );
+                    return -1;
+                }
+                if( rules_parse_function( arg, match->fc ) != 0 ) {
+                    return -1;
+                }
+            }
+            match->set |= flag;
+            match->invert |= invert ? flag : 0;
+            continue;
+        }
+        else {
+            fprintf( stderr, "Unsupported option `%s'\n", option );
+            return -1;
+        }
+
+        if( invert ) {
+            fprintf( stderr, "Inversion not supported for option `%s'\n", option );
+            return -1;
+        }
+    }
+
+    if( ( rule->protocol == 0 ) &&
+            ( ( rule->sport[0] != 0 ) || ( rule->sport[1] != 0xffff ) ||
+            ( rule->dport[0] != 0 ) || ( rule->dport[1] != 0xffff ) ) ) {
+        fprintf( stderr, "Port matching requires `-p tcp' or `-p udp'\n" );
+        return -1;
+    }
+    if( rule->verdict == DNP3FW_VERDICT_NONE ) {
+        fprintf( stderr, "Missing `-j ACCEPT' or `-j DROP'\n" );
+        return -1;
+    }
+    if( ( ! ( match->set & XT_DNP3_FLAG_RATE ) ) &&
+            ( ( match->burst != 0 ) || per ) ) {
+        fprintf( stderr, "Options `--fc-burst' and `--per' require `--fc-rate'\n" );
+        return -1;
+    }
+    if( ( match->set & XT_DNP3_FLAG_LEARN ) &&
+            ( match->set & ~( XT_DNP3_FLAG_LEARN | XT_DNP3_FLAG_CHECKSUM ) ) ) {
+        fprintf( stderr, "Option `--learn' may only be combined with `--crc'\n" );
+        return -1;
+    }
+    if( match->set & XT_DNP3_FLAG_OBJECT ) {
+        if( ( match->program = malloc( sizeof( *match->program ) ) ) == NULL ) {
+            fprintf( stderr, "Memory allocation failure\n" );
+            return -1;
+        }
+        dnp3_object_compile( match, match->program );
+    }
+    dnp3_packet_select( match );
+    if( match->set & XT_DNP3_FLAG_RATE ) {
+        if( match->burst == 0 ) {
+            match->burst = XT_DNP3_RATE_BURST;
+        }
+        if( ( match->rate = calloc( 1, sizeof( *match->rate ) ) ) == NULL ) {
+            fprintf( stderr, "Memory allocation failure\n" );
+            return -1;
+        }
+        match->rate->interval = ( uint64_t ) match->interval * 1000;
+        match->rate->tolerance = ( uint64_t ) ( match->burst - 1 ) * match->rate->interval;
+    }
+    return 0;
+}
+
+
+/*
+    Addresses are specified as a dotted-quad IPv4 address with an optional prefix 
+    length, as written by iptables-save and /proc/net/xt_dnp3_learn, and held as 
+    the address and mask in host order.
+*/
+
+static int
+rules_parse_address( const char *arg, uint32_t *addr )
+{
+    unsigned long value;
+    struct in_addr in;
+    char *buffer, *ptr;
+    int ret;
+
+    buffer = strdup( arg );
+    value = 32;
+    ret = 0;
+    if( ( ptr = strchr( buffer, '/' ) ) != NULL ) {
+        *ptr++ = '\0';
+        ret = rules_parse_number( ptr, 32, &value );
+    }
+    if( ( ret == 0 ) &&
+            ( inet_pton( AF_INET, buffer, &in ) != 1 ) ) {
+        fprintf( stderr, "Invalid address `%s'\n", arg );
+        ret = -1;
+    }
+    if( ret == 0 ) {
+        addr[1] = ( value == 0 ) ? 0 : ( 0xffffffffU << ( 32 - value ) );
+        addr[0] = ntohl( in.s_addr ) & addr[1];
+    }
+    free( buffer );
+    return ret;
+}
+
+
+static int
+rules_parse_crc( const char *arg, struct xt_dnp3_rule *match )
+{
+    unsigned long value;
+
+    if( strcmp( arg, "full" ) == 0 ) {
+        match->crc = XT_DNP3_CRC_FULL;
+    }
+    else if( strcmp( arg, "header" ) == 0 ) {
+        match->crc = XT_DNP3_CRC_HEADER;
+    }
+    else if( strcmp( arg, "none" ) == 0 ) {
+        match->crc = XT_DNP3_CRC_NONE;
+    }
+    else if( strncmp( arg, "sample:", 7 ) == 0 ) {
+        if( ( rules_parse_number( &arg[7], 1UL << XT_DNP3_CRC_SAMPLE_MAX, &value ) != 0 ) ||
+                ( value == 0 ) ||
+                ( ( value & ( value - 1 ) ) != 0 ) ) {
+            fprintf( stderr, "CRC sample interval must be a power of two between 1 and %lu\n", 1UL << XT_DNP3_CRC_SAMPLE_MAX );
+            return -1;
+        }
+        match->crc = XT_DNP3_CRC_SAMPLE;
+        for( match->sample = 0; ( value >>= 1 ) != 0; ++match->sample ) {
+            ;
+        }
+    }
+    else {
+        fprintf( stderr, "Unknown CRC validation mode `%s'\n", arg );
+        return -1;
+    }
+    return 0;
+}
+
+
+static int
+rules_parse_function( const char *arg, uint8_t *func )
+{
+    unsigned long value;
+    char *buffer, *ptr, *save;
+    int ret;
+
+    buffer = strdup( arg );
+    ret = 0;
+    for( ptr = strtok_r( buffer, ",", &save );
+            ptr;
+            ptr = strtok_r( NULL, ",", &save ) ) {
+
+        if( ( ret = rules_parse_number( ptr, 255, &value ) ) != 0 ) {
+            fprintf( stderr, "Only numeric DNP3 function codes accepted\n" );
+            break;
+        }
+        func[ value / 8 ] |= ( 1 << ( value % 8 ) );
+    }
+    free( buffer );
+    return ret;
+}
+
+
+/*
+    Connection marks are specified as with the --ct-mark option of the dnp3 match, 
+    as a value optionally followed by a mask, and are accepted for compatibility 
+    with rule sets saved from iptables but have no effect on the evaluation of 
+    rules, as there is no connection tracking within these tools.
+*/
+
+static int
+rules_parse_mark( const char *arg, struct xt_dnp3_rule *match )
+{
+    unsigned long mark, mask;
+    const char *ptr;
+    char *end;
+
+    mask = UINT32_MAX;
+    mark = strtoul( arg, &end, 0 );
+    ptr = arg;
+    if( ( end != ptr ) &&
+            ( *end == '/' ) ) {
+        ptr = end + 1;
+        mask = strtoul( ptr, &end, 0 );
+    }
+    if( ( end == ptr ) ||
+            ( *end != '\0' ) ||
+            ( mark > UINT32_MAX ) ||
+            ( mask > UINT32_MAX ) ||
+            ( ( mark & ~mask ) != 0 ) ) {
+        fprintf( stderr, "Invalid connection mark `%s'\n", arg );
+        return -1;
+    }
+    match->ctmark = ( uint32_t ) mark;
+    match->ctmask = ( uint32_t ) mask;
+    return 0;
+}
+
+
+static int
+rules_parse_number( const char *arg, unsigned long max, unsigned long *value )
+{
+    const char *ptr;
+
+    for( ptr = arg; *ptr; ++ptr ) {
+        if( isdigit( ( unsigned char ) *ptr ) == 0 ) {
+            break;
+        }
+    }
+    if( ( ptr == arg ) ||
+            ( *ptr != '\0' ) ||
+            ( ( *value = strtoul( arg, NULL, 10 ) ) > max ) ) {
+        fprintf( stderr, "Invalid value `%s'\n", arg );
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+    Object header constraints are specified as with the --object option of the 
+    dnp3 match - for example, `12:1,qualifier=0x17,index=0:15,count=1'.
+*/
+
+static int
+rules_parse_object( const char *arg, struct xt_dnp3_object *object )
+{
+    unsigned long value;
+    char *buffer, *end, *ptr, *save, *sep;
+    int ret;
+
+    buffer = strdup( arg );
+    ret = -1;
+    if( ( ptr = strtok_r( buffer, ",", &save ) ) == NULL ) {
+        goto error;
+    }
+    if( ( sep = strchr( ptr, ':' ) ) != NULL ) {
+        *sep++ = '\0';
+        if( rules_parse_number( sep, 255, &value ) != 0 ) {
+            goto error;
+        }
+        object->variation = ( uint8_t ) value;
+        object->flags |= XT_DNP3_OBJECT_VARIATION;
+    }
+    if( rules_parse_number( ptr, 255, &value ) != 0 ) {
+        goto error;
+    }
+    object->group = ( uint8_t ) value;
+
+    while( ( ptr = strtok_r( NULL, ",", &save ) ) != NULL ) {
+        if( strncmp( ptr, "qualifier=", 10 ) == 0 ) {
+            value = strtoul( &ptr[10], &end, 0 );
+            if( ( ! isdigit( ( unsigned char ) ptr[10] ) ) ||
+                    ( *end != '\0' ) ||
+                    ( value > 255 ) ) {
+                fprintf( stderr, "Invalid qualifier code `%s'\n", &ptr[10] );
+                goto error;
+            }
+            object->qualifier = ( uint8_t ) value;
+            object->flags |= XT_DNP3_OBJECT_QUALIFIER;
+        }
+        else if( strncmp( ptr, "index=", 6 ) == 0 ) {
+            ptr += 6;
+            object->index[0] = 0;
+            object->index[1] = UINT32_MAX;
+            if( ( sep = strchr( ptr, ':' ) ) != NULL ) {
+                *sep++ = '\0';
+            }
+            if( ptr[0] ) {
+                if( rules_parse_number( ptr, UINT32_MAX, &value ) != 0 ) {
+                    goto error;
+                }
+                object->index[0] = ( uint32_t ) value;
+                if( sep == NULL ) {
+                    object->index[1] = ( uint32_t ) value;
+                }
+            }
+            if( ( sep != NULL ) &&
+                    ( sep[0] ) ) {
+                if( rules_parse_number( sep, UINT32_MAX, &value ) != 0 ) {
+                    goto error;
+                }
+                object->index[1] = ( uint32_t ) value;
+            }
+            if( object->index[0] > object->index[1] ) {
+                fprintf( stderr, "Invalid range `%s' (min > max)\n", arg );
+                goto error;
+            }
+            object->flags |= XT_DNP3_OBJECT_INDEX;
+        }
+        else if( strncmp( ptr, "count=", 6 ) == 0 ) {
+            if( rules_parse_number( &ptr[6], UINT32_MAX, &value ) != 0 ) {
+                goto error;
+            }
+            object->count = ( uint32_t ) value;
+            object->flags |= XT_DNP3_OBJECT_COUNT;
+        }
+        else {
+            fprintf( stderr, "Unknown object header field `%s'\n", ptr );
+            goto error;
+        }
+    }
+    ret = 0;
+
+error:
+    free( buffer );
+    return ret;
+}
+
+
+static int
+rules_parse_range( const char *arg, uint16_t *range )
+{
+    unsigned long value;
+    char *buffer, *ptr;
+    int ret;
+
+    buffer = strdup( arg );
+    if( ( ptr = strchr( buffer, ':' ) ) == NULL ) {
+        if( ( ret = rules_parse_number( buffer, 0xffff, &value ) ) == 0 ) {
+            range[0] = range[1] = ( uint16_t ) value;
+        }
+    }
+    else {
+        *ptr++ = '\0';
+        range[0] = 0;
+        range[1] = 0xffff;
+        ret = 0;
+        if( ( buffer[0] ) &&
+                ( ( ret = rules_parse_number( buffer, 0xffff, &value ) ) == 0 ) ) {
+            range[0] = ( uint16_t ) value;
+        }
+        if( ( ret == 0 ) &&
+                ( ptr[0] ) &&
+                ( ( ret = rules_parse_number( ptr, 0xffff, &value ) ) == 0 ) ) {
+            range[1] = ( uint16_t ) value;
+        }
+        if( ( ret == 0 ) &&
+                ( range[0] > range[1] ) ) {
+            fprintf( stderr, "Invalid range `%s' (min > max)\n", arg );
+            ret = -1;
+        }
+    }
+    free( buffer );
+    return ret;
+}
+
+
+/*
+    Rate limits are specified as the number of messages admitted per second, 
+    minute or hour, with a rate without a unit taken as per second, and held as 
+    the interval between messages in microseconds.
+*/
+
+static int
+rules_parse_rate( const char *arg, uint32_t *interval )
+{
+    static const struct {
+        const char *name;
+        uint32_t period;
+    } units[] = {
+        { "second", 1000000U },
+        { "minute", 60000000U },
+        { "hour", 3600000000U },
+    };
+    unsigned long value;
+    char *buffer, *ptr;
+    unsigned int index;
+    uint32_t period;
+    int ret;
+
+    buffer = strdup( arg );
+    period = units[0].period;
+    if( ( ptr = strchr( buffer, '/' ) ) != NULL ) {
+        *ptr++ = '\0';
+        for( index = 0; index < ARRAY_SIZE( units ); ++index ) {
+            if( ( ptr[0] != '\0' ) &&
+                    ( strncmp( units[ index ].name, ptr, strlen( ptr ) ) == 0 ) ) {
+                break;
+            }
+        }
+        if( index == ARRAY_SIZE( units ) ) {
+            fprintf( stderr, "Unknown rate unit `%s'\n", ptr );
+            free( buffer );
+            return -1;
+        }
+        period = units[ index ].period;
+    }
+    if( ( ret = rules_parse_number( buffer, period, &value ) ) == 0 ) {
+        if( value == 0 ) {
+            fprintf( stderr, "Rate must be non-zero\n" );
+            ret = -1;
+        }
+        else {
+            *interval = period / ( uint32_t ) value;
+        }
+    }
+    free( buffer );
+    return ret;
+}
+
+
+static int
+rules_parse_verdict( const char *arg, uint8_t *verdict )
+{
+    if( strcmp( arg, "ACCEPT" ) == 0 ) {
+        *verdict = DNP3FW_VERDICT_ACCEPT;
+    }
+    else if( strcmp( arg, "DROP" ) == 0 ) {
+        *verdict = DNP3FW_VERDICT_DROP;
+    }
+    else {
+        fprintf( stderr, "Unsupported target `%s'\n", arg );
+        return -1;
+    }
+    return 0;
+}
+
+
+static inline int
+rules_value( uint16_t value, const uint16_t *range )
+{
+    return ( ( value >= range[0] ) && ( value <= range[1] ) );
+}
+
+
+/*
+    These functions check the availability of tokens in, and return tokens to, 
+    the bucket of a rate limited rule, as within the kernel module, with the 
+    capture time of the packet evaluated in place of the current time.
+*/
+
+bool
+dnp3_rate_check( const struct xt_dnp3_rule *rule, uint16_t saddr, uint16_t daddr, uint8_t func, uint32_t count )
+{
+    uint64_t next;
+
+    next = __atomic_load_n( &rule->rate->tat[ dnp3_rate_hash( rule, saddr, daddr, func ) ], __ATOMIC_RELAXED );
+    if( next < _time ) {
+        next = _time;
+    }
+    return ( ( next - _time ) + ( count - 1 ) * rule->rate->interval <= rule->rate->tolerance );
+}
+
+
+void
+dnp3_rate_give( const struct xt_dnp3_rule *rule, uint16_t saddr, uint16_t daddr, uint8_t func, uint32_t count )
+{
+    ( void ) __atomic_fetch_sub( &rule->rate->tat[ dnp3_rate_hash( rule, saddr, daddr, func ) ], count * rule->rate->interval, __ATOMIC_RELAXED );
+}
+
+
+/*
+    This function takes count tokens from the bucket of a rate limited rule, as 
+    within the kernel module, with the capture time of the packet evaluated in 
+    place of the current time. As the buckets of a rule are shared between worker 
+    threads, the theoretical arrival time of each bucket is updated atomically, 
+    and the packets of a bucket evaluated by different threads may be admitted in 
+    an order other than that of the capture.
+*/
+
+bool
+dnp3_rate_take( const struct xt_dnp3_rule *rule, uint16_t saddr, uint16_t daddr, uint8_t func, uint32_t count )
+{
+    uint64_t next, prev, *tat;
+
+    tat = &rule->rate->tat[ dnp3_rate_hash( rule, saddr, daddr, func ) ];
+    prev = __atomic_load_n( tat, __ATOMIC_RELAXED );
+    do {
+        next = ( prev > _time ) ? prev : _time;
+        if( ( next - _time ) + ( count - 1 ) * rule->rate->interval > rule->rate->tolerance ) {
+            return false;
+        }
+        next += count * rule->rate->interval;
+    } while( ! __atomic_compare_exchange_n( tat, &prev, next, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+    return true;
+}
+
+
+/*
+    This function evaluates the rule set against a packet, returning the verdict 
+    and the index of the matching rule, or the number of rules where the verdict 
+    is that of the default policy. As within the kernel module, the payload of a 
+    packet is parsed upon evaluation of the first dnp3 match, with the result held 
+    in the structure pointed to by parsed for subsequent dnp3 matches.
+*/
+
+int
+dnp3fw_rules_evaluate( const struct dnp3fw_rules *rules, 
+        const struct dnp3fw_packet *packet, 
+        struct xt_dnp3_packet *parsed, 
+        int engine, 
+        unsigned int *index )
+{
+    const struct dnp3fw_rule *rule;
+    unsigned int count;
+    int cached;
+    bool hotdrop;
+
+    cached = 0;
+    hotdrop = false;
+    _time = packet->time;
+    dnp3fw_session_time( packet->time );
+    for( count = 0; count < rules->count; ++count ) {
+        rule = &rules->rule[ count ];
+
+        if( rule->protocol != 0 ) {
+            if( ( rule->protocol != packet->protocol ) ||
+                    ( packet->fragment ) ||
+                    ( packet->payload == NULL ) ||
+                    ( ! rules_value( packet->sport, rule->sport ) ) ||
+                    ( ! rules_value( packet->dport, rule->dport ) ) ) {
+                continue;
+            }
+        }
+        if( ( rule->src[1] | rule->dest[1] ) &&
+                ( ( packet->protocol == 0 ) ||
+                ( ( packet->src & rule->src[1] ) != rule->src[0] ) ||
+                ( ( packet->dest & rule->dest[1] ) != rule->dest[0] ) ) ) {
+            continue;
+        }
+        if( rule->dnp3 ) {
+            if( packet->fragment ) {
+                continue;
+            }
+            if( ! cached ) {
+                dnp3_packet_reset( parsed );
+                parsed->depth = rules->depth;
+                parsed->sample = rules->sample;
+                parsed->inspect = rules->inspect;
+                parsed->sessions = rules->sessions;
+                dnp3_stats_inc( XT_DNP3_STAT_PACKETS );
+                if( packet->payload != NULL ) {
+                    dnp3_packet_parse( parsed, packet->src, packet->dest, packet->payload, packet->len, engine );
+                }
+                cached = 1;
+            }
+            if( ( ! ( rule->match.set & XT_DNP3_FLAG_LEARN ) ) &&
+                    ( ! dnp3_packet_match( &rule->match, parsed, &hotdrop ) ) ) {
+                if( hotdrop ) {
+                    *index = count;
+                    return DNP3FW_VERDICT_DROP;
+                }
+                continue;
+            }
+        }
+        *index = count;
+        return rule->verdict;
+    }
+    *index = rules->count;
+    return rules->policy;
+}
+
+
+void
+dnp3fw_rules_free( struct dnp3fw_rules *rules )
+{
+    unsigned int index;
+
+    for( index = 0; index < rules->count; ++index ) {
+        free( rules->rule[ index ].match.program );
+        free( rules->rule[ index ].match.rate );
+    }
+    free( rules->rule );
+    rules->rule = NULL;
+    rules->count = 0;
+}
+
+
+int
+dnp3fw_rules_load( struct dnp3fw_rules *rules, const char *path )
+{
+    struct dnp3fw_rule *rule;
+    char *token[ RULES_TOKENS ];
+    char *line, *ptr, *save;
+    unsigned int count, number;
+    size_t size;
+    FILE *fp;
+    int ret;
+
+    if( ( fp = fopen( path, "r" ) ) == NULL ) {
+        perror( path );
+        return -1;
+    }
+
+    line = NULL;
+    size = 0;
+    number = 0;
+    ret = 0;
+    while( getline( &line, &size, fp ) >= 0 ) {
+        ++number;
+        if( ( ptr = strchr( line, '#' ) ) != NULL ) {
+            *ptr = '\0';
+        }
+        for( count = 0, ptr = strtok_r( line, " \t\r\n", &save );
+                ( ptr != NULL ) && ( count < RULES_TOKENS );
+                ptr = strtok_r( NULL, " \t\r\n", &save ) ) {
+            token[ count++ ] = ptr;
+        }
+        if( ( count == 0 ) ||
+                ( token[0][0] == '*' ) ||
+                ( token[0][0] == ':' ) ||
+                ( strcmp( token[0], "COMMIT" ) == 0 ) ) {
+            continue;
+        }
+        if( ptr != NULL ) {
+            fprintf( stderr, "%s:%u: Too many options\n", path, number );
+            ret = -1;
+            break;
+        }
+
+        if( ( rule = realloc( rules->rule, ( rules->count + 1 ) * sizeof( *rule ) ) ) == NULL ) {
+            fprintf( stderr, "Memory allocation failure\n" );
+            ret = -1;
+            break;
+        }
+        rules->rule = rule;
+        rule = &rules->rule[ rules->count ];
+        ( void ) memset( rule, 0, sizeof( *rule ) );
+        rule->line = number;
+        if( rules_parse( rule, token, count ) != 0 ) {
+            fprintf( stderr, "%s:%u: Invalid rule\n", path, number );
+            ret = -1;
+            break;
+        }
+        ++rules->count;
+    }
+
+    free( line );
+    ( void ) fclose( fp );
+    rules_depth( rules );
+    return ret;
+}
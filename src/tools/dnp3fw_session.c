@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dnp3fw.h"
+
+
+/*
+    This source provides the transport session functions called by the frame 
+    parsing source of the xt_dnp3 kernel module when compiled for userspace. Each 
+    thread maintains its own session table, such that no locking is required where 
+    the flows of a capture are partitioned between threads by IP address. As within 
+    the kernel module, the number of sessions tracked is bounded, the first frame 
+    of a multi-frame message restarts an existing session and retransmitted frames 
+    of the message in progress are recognised by their digest. Sessions expire 
+    after the default session timeout of the kernel module, measured against the 
+    capture time of packets, and where the table is full, a session is evicted by 
+    the same clock sweep. The frame counts for sampled CRC validation are likewise 
+    held per thread.
+
+    The application fragments of multi-frame messages are reassembled where object 
+    headers are decoded, with the number of fragments reassembled concurrently by 
+    each thread bounded as by the apdus parameter of the kernel module. No 
+    reassembly timeout is applied other than the expiry of the session.
+*/
+
+#define SESSION_TIMEOUT                 ( XT_DNP3_SESSION_TIMEOUT * 1000000ULL )
+
+struct session {
+    struct session *next;               /* Hash bucket linkage */
+    uint32_t src;                       /* Source IP */
+    uint32_t dest;                      /* Destination IP */
+    uint16_t saddr;                     /* Source address */
+    uint16_t daddr;                     /* Destination address */
+    uint8_t seq;                        /* Transport sequence */
+    uint8_t func;                       /* Function code of first frame */
+    uint8_t frames;                     /* Frames with digests held */
+    uint8_t referenced;                 /* Frame since eviction scan */
+    uint32_t digest[ XT_DNP3_DIGESTS ]; /* Digests of recent frames */
+    uint64_t expires;                   /* Session expiry (ns) */
+    struct xt_dnp3_fragment *fragment;  /* Fragment under reassembly */
+};
+
+
+static int session_duplicate( const struct session *session, uint8_t seq, uint32_t digest );
+
+static int session_evict( void );
+
+static void session_fragment( struct session *session, const uint8_t *payload );
+
+static struct session ** session_lookup( uint32_t src, uint32_t dest, uint16_t saddr, uint16_t daddr );
+
+static void session_record( struct session *session, uint8_t seq, uint32_t digest );
+
+static void session_release( struct session **entry, int stat );
+
+
+static __thread struct session **_bucket;
+
+static __thread unsigned int _buckets;
+
+static __thread unsigned int _count;
+
+static __thread unsigned int _sessions;
+
+static __thread unsigned int _fragments;
+
+static __thread unsigned int _apdus;
+
+static __thread unsigned int _hand;
+
+static __thread uint64_t _time;
+
+static __thread uint32_t _sample[ XT_DNP3_SAMPLES ];
+
+__thread unsigned long long dnp3_stats[ XT_DNP3_STAT_MAX ];
+
+
+/*
+    This function returns non-zero where a frame with the transport sequence and 
+    digest passed is a retransmission of one of the most recent frames of the 
+    message of a session.
+*/
+
+static int
+session_duplicate( const struct session *session, uint8_t seq, uint32_t digest )
+{
+    uint8_t distance;
+
+    distance = ( uint8_t ) ( session->seq - seq ) & DNP3_TSPT_HDR_SEQUENCE_MASK;
+    return ( ( distance < session->frames ) &&
+            ( session->digest[ seq & ( XT_DNP3_DIGESTS - 1 ) ] == digest ) );
+}
+
+
+/*
+    This function releases a single session where the session table is full, in 
+    the same manner as the clock sweep of the kernel module, returning non-zero 
+    where a session was released.
+*/
+
+static int
+session_evict( void )
+{
+    struct session **entry;
+    unsigned int scan;
+
+    for( scan = 0; scan < XT_DNP3_SESSION_SCAN; ++scan ) {
+        for( entry = &_bucket[ _hand++ & ( _buckets - 1 ) ];
+                *entry != NULL;
+                entry = &( *entry )->next ) {
+            if( _time > ( *entry )->expires ) {
+                session_release( entry, XT_DNP3_STAT_EXPIRED );
+                return 1;
+            }
+            if( ! ( *entry )->referenced ) {
+                session_release( entry, XT_DNP3_STAT_EVICTED );
+                return 1;
+            }
+            ( *entry )->referenced = 0;
+        }
+    }
+    return 0;
+}
+
+
+/*
+    This function commences the reassembly of the application fragment of a session 
+    with the user data of the first frame of a message, abandoning the reassembly 
+    of any previous message of the session.
+*/
+
+static void
+session_fragment( struct session *session, const uint8_t *payload )
+{
+    if( session->fragment != NULL ) {
+        dnp3_apdu_free( session->fragment );
+        session->fragment = NULL;
+        dnp3_stats_inc( XT_DNP3_STAT_ABANDONED );
+    }
+    if( ( payload == NULL ) ||
+            ( _apdus == 0 ) ) {
+        return;
+    }
+    if( ( _fragments >= _apdus ) ||
+            ( ( session->fragment = malloc( sizeof( *session->fragment ) ) ) == NULL ) ) {
+        dnp3_stats_inc( XT_DNP3_STAT_ABANDONED );
+        return;
+    }
+    ++_fragments;
+    session->fragment->len = 0;
+    ( void ) dnp3_packet_append( session->fragment, payload );
+}
+
+
+static struct session **
+session_lookup( uint32_t src, uint32_t dest, uint16_t saddr, uint16_t daddr )
+{
+    struct session **entry;
+    uint32_t hash;
+
+    hash = ( src * 0x9e3779b1U ) ^ ( dest * 0x85ebca77U ) ^ ( ( ( uint32_t ) saddr << 16 ) | daddr );
+    hash ^= ( hash >> 16 );
+    entry = &_bucket[ hash & ( _buckets - 1 ) ];
+    while( *entry != NULL ) {
+        if( _time > ( *entry )->expires ) {
+            session_release( entry, XT_DNP3_STAT_EXPIRED );
+            continue;
+        }
+        if( ( ( *entry )->dest == dest ) &&
+                ( ( *entry )->src == src ) &&
+                ( ( *entry )->daddr == daddr ) &&
+                ( ( *entry )->saddr == saddr ) ) {
+            break;
+        }
+        entry = &( *entry )->next;
+    }
+    return entry;
+}
+
+
+static void
+session_record( struct session *session, uint8_t seq, uint32_t digest )
+{
+    session->seq = seq;
+    session->expires = _time + SESSION_TIMEOUT;
+    session->referenced = 1;
+    session->digest[ seq & ( XT_DNP3_DIGESTS - 1 ) ] = digest;
+    if( session->frames < XT_DNP3_DIGESTS ) {
+        ++session->frames;
+    }
+}
+
+
+static void
+session_release( struct session **entry, int stat )
+{
+    struct session *session;
+
+    session = *entry;
+    *entry = session->next;
+    session_fragment( session, NULL );
+    free( session );
+    --_count;
+    dnp3_stats_inc( stat );
+}
+
+
+void
+dnp3_apdu_free( struct xt_dnp3_fragment *fragment )
+{
+    free( fragment );
+    --_fragments;
+}
+
+
+int
+dnp3_session_advance( void *context, u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u32 digest, bool final, const u8 *payload, u8 *func, struct xt_dnp3_fragment **fragment )
+{
+    struct session **entry, *session;
+    int ret;
+
+    entry = session_lookup( src, dest, saddr, daddr );
+    if( ( session = *entry ) == NULL ) {
+        return -ENOENT;
+    }
+    if( seq != ( ( session->seq + 1 ) & DNP3_TSPT_HDR_SEQUENCE_MASK ) ) {
+        if( ! session_duplicate( session, seq, digest ) ) {
+            return -EINVAL;
+        }
+        *func = session->func;
+        dnp3_stats_inc( XT_DNP3_STAT_DUPLICATE );
+        return ( session->fragment != NULL );
+    }
+    session_record( session, seq, digest );
+    *func = session->func;
+
+    ret = 0;
+    if( session->fragment != NULL ) {
+        if( ( payload == NULL ) ||
+                ( dnp3_packet_append( session->fragment, payload ) != 0 ) ) {
+            session_fragment( session, NULL );
+        }
+        else {
+            ret = 1;
+        }
+    }
+    if( final ) {
+        if( ret > 0 ) {
+            *fragment = session->fragment;
+        }
+        *entry = session->next;
+        free( session );
+        --_count;
+        dnp3_stats_inc( XT_DNP3_STAT_CLOSED );
+    }
+    return ret;
+}
+
+
+u32
+dnp3_session_digest( const u8 *buff, u32 len )
+{
+    uint32_t hash;
+    u32 index;
+
+    hash = 0x811c9dc5U;
+    for( index = 0; index < len; ++index ) {
+        hash = ( hash ^ buff[ index ] ) * 0x01000193U;
+    }
+    return hash;
+}
+
+
+int
+dnp3_session_open( void *context, u32 src, u32 dest, u16 saddr, u16 daddr, u8 seq, u32 digest, u8 func, const u8 *payload )
+{
+    struct session **entry, *session;
+
+    entry = session_lookup( src, dest, saddr, daddr );
+    if( ( session = *entry ) == NULL ) {
+        if( _count >= _sessions ) {
+            if( ! session_evict() ) {
+                return -ENOSPC;
+            }
+            entry = session_lookup( src, dest, saddr, daddr );
+        }
+        if( ( session = calloc( 1, sizeof( *session ) ) ) == NULL ) {
+            return -ENOMEM;
+        }
+        session->src = src;
+        session->dest = dest;
+        session->saddr = saddr;
+        session->daddr = daddr;
+        *entry = session;
+        ++_count;
+        dnp3_stats_inc( XT_DNP3_STAT_OPENED );
+    }
+    else if( session_duplicate( session, seq, digest ) ) {
+        dnp3_stats_inc( XT_DNP3_STAT_DUPLICATE );
+        return ( session->fragment != NULL );
+    }
+    else {
+        dnp3_stats_inc( XT_DNP3_STAT_EVICTED );
+    }
+    session->frames = 0;
+    session_record( session, seq, digest );
+    session->func = func;
+    session_fragment( session, payload );
+    return ( session->fragment != NULL );
+}
+
+
+u32
+dnp3_session_sample( u32 src, u32 dest )
+{
+    uint32_t hash;
+
+    hash = ( src * 0x9e3779b1U ) ^ ( dest * 0x85ebca77U );
+    hash ^= ( hash >> 16 );
+    return _sample[ hash & ( XT_DNP3_SAMPLES - 1 ) ]++;
+}
+
+
+void
+dnp3fw_session_exit( void )
+{
+    struct session *next, *session;
+    unsigned int index;
+
+    for( index = 0; index < _buckets; ++index ) {
+        for( session = _bucket[ index ]; session != NULL; session = next ) {
+            next = session->next;
+            free( session->fragment );
+            free( session );
+        }
+    }
+    free( _bucket );
+    _bucket = NULL;
+    _buckets = _count = _fragments = _hand = 0;
+    _time = 0;
+    ( void ) memset( _sample, 0, sizeof( _sample ) );
+}
+
+
+int
+dnp3fw_session_init( unsigned int sessions, unsigned int apdus )
+{
+    if( sessions == 0 ) {
+        return -EINVAL;
+    }
+    for( _buckets = 1; _buckets < sessions; _buckets <<= 1 ) {
+        ;
+    }
+    if( ( _bucket = calloc( _buckets, sizeof( *_bucket ) ) ) == NULL ) {
+        return -ENOMEM;
+    }
+    _sessions = sessions;
+    _apdus = apdus;
+    _count = _fragments = 0;
+    return 0;
+}
+
+
+void
+dnp3fw_session_time( uint64_t time )
+{
+    _time = time;
+}
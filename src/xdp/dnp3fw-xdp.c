@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <linux/if_link.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "dnp3fw.h"
+#include "xdp_dnp3.h"
+
+
+/*
+    This program loads the xdp_dnp3 program, with the rule set read from a rule
+    file in the same format as dnp3fw-replay, and attaches it to the XDP hook of a
+    network interface. The options of each rule are translated into an entry of
+    the dnp3_rules map, such that the rule set may be replaced by running this
+    program again without detaching the program from the interface.
+
+    With the -t option, the program is instead run with BPF_PROG_TEST_RUN against
+    each IPv4 packet of a capture file, which is also evaluated against the rule
+    set with the frame parsing and rule matching source of the xt_dnp3 kernel
+    module, as by dnp3fw-replay. A packet dropped by the XDP program but not by the
+    rule set is reported as unsafe, and results in a non-zero exit status.
+*/
+
+#ifndef XDP_DNP3_OBJECT
+#define XDP_DNP3_OBJECT                 "xdp_dnp3.o"
+#endif
+
+#define XDP_ETH_HLEN                    (14)
+
+
+static int xdp_config( struct bpf_object *obj, const struct dnp3fw_rules *rules );
+
+static int xdp_map( struct bpf_object *obj, const char *name );
+
+static struct bpf_object * xdp_open( const char *path, const struct dnp3fw_rules *rules, int *prog );
+
+static int xdp_query( int ifindex );
+
+static void xdp_stats( FILE *fp, int fd );
+
+static int xdp_test( int prog, int stats, const struct dnp3fw_rules *rules, const char *path, int quiet );
+
+static void xdp_usage( const char *name );
+
+
+static const char *_stats[ XDP_DNP3_STAT_MAX ] = {
+    [ XDP_DNP3_STAT_PACKETS ]       = "packets",
+    [ XDP_DNP3_STAT_FRAMES ]        = "frames",
+    [ XDP_DNP3_STAT_SYNC ]          = "sync",
+    [ XDP_DNP3_STAT_HEADER_CRC ]    = "header_crc",
+    [ XDP_DNP3_STAT_BLOCK_CRC ]     = "block_crc",
+    [ XDP_DNP3_STAT_TRUNCATED ]     = "truncated",
+    [ XDP_DNP3_STAT_ACCEPTED ]      = "accepted",
+    [ XDP_DNP3_STAT_DROPPED ]       = "dropped",
+    [ XDP_DNP3_STAT_POLICY ]        = "policy",
+    [ XDP_DNP3_STAT_DEFERRED ]      = "deferred",
+};
+
+
+static int
+xdp_config( struct bpf_object *obj, const struct dnp3fw_rules *rules )
+{
+    const struct dnp3fw_rule *rule;
+    struct xdp_dnp3_config config;
+    struct xdp_dnp3_rule entry;
+    uint32_t index;
+    int fd;
+
+    if( rules->count > XDP_DNP3_RULES ) {
+        fprintf( stderr, "Rule set exceeds %u rules\n", XDP_DNP3_RULES );
+        return -1;
+    }
+    if( ( fd = xdp_map( obj, "dnp3_rules" ) ) < 0 ) {
+        return -1;
+    }
+    for( index = 0; index < rules->count; ++index ) {
+        rule = &rules->rule[ index ];
+
+        ( void ) memset( &entry, 0, sizeof( entry ) );
+        memcpy( entry.src, rule->src, sizeof( entry.src ) );
+        memcpy( entry.dest, rule->dest, sizeof( entry.dest ) );
+        memcpy( entry.sport, rule->sport, sizeof( entry.sport ) );
+        memcpy( entry.dport, rule->dport, sizeof( entry.dport ) );
+        memcpy( entry.daddr, rule->match.daddr, sizeof( entry.daddr ) );
+        memcpy( entry.saddr, rule->match.saddr, sizeof( entry.saddr ) );
+        memcpy( entry.fc, rule->match.fc, sizeof( entry.fc ) );
+        entry.set = rule->match.set;
+        entry.invert = rule->match.invert;
+        entry.protocol = rule->protocol;
+        entry.dnp3 = rule->dnp3;
+        entry.crc = ( uint8_t ) dnp3_packet_crc( &rule->match );
+        entry.verdict = ( rule->verdict == DNP3FW_VERDICT_DROP ) ? XDP_DNP3_DROP : XDP_DNP3_ACCEPT;
+        if( bpf_map_update_elem( fd, &index, &entry, BPF_ANY ) != 0 ) {
+            fprintf( stderr, "Unable to update rule %u: %s\n", index + 1, strerror( errno ) );
+            return -1;
+        }
+    }
+
+    if( ( fd = xdp_map( obj, "dnp3_config" ) ) < 0 ) {
+        return -1;
+    }
+    ( void ) memset( &config, 0, sizeof( config ) );
+    config.count = rules->count;
+    config.policy = ( rules->policy == DNP3FW_VERDICT_DROP ) ? XDP_DNP3_DROP : XDP_DNP3_ACCEPT;
+    config.depth = rules->depth;
+    index = 0;
+    if( bpf_map_update_elem( fd, &index, &config, BPF_ANY ) != 0 ) {
+        fprintf( stderr, "Unable to update configuration: %s\n", strerror( errno ) );
+        return -1;
+    }
+    return 0;
+}
+
+
+static int
+xdp_map( struct bpf_object *obj, const char *name )
+{
+    struct bpf_map *map;
+
+    if( ( map = bpf_object__find_map_by_name( obj, name ) ) == NULL ) {
+        fprintf( stderr, "Map `%s' not found\n", name );
+        return -1;
+    }
+    return bpf_map__fd( map );
+}
+
+
+static struct bpf_object *
+xdp_open( const char *path, const struct dnp3fw_rules *rules, int *prog )
+{
+    struct bpf_program *program;
+    struct bpf_object *obj;
+
+    if( ( obj = bpf_object__open_file( path, NULL ) ) == NULL ) {
+        fprintf( stderr, "%s: %s\n", path, strerror( errno ) );
+        return NULL;
+    }
+    if( bpf_object__load( obj ) != 0 ) {
+        fprintf( stderr, "%s: Unable to load program: %s\n", path, strerror( errno ) );
+        bpf_object__close( obj );
+        return NULL;
+    }
+    if( ( ( program = bpf_object__find_program_by_name( obj, "xdp_dnp3" ) ) == NULL ) ||
+            ( xdp_config( obj, rules ) != 0 ) ) {
+        bpf_object__close( obj );
+        return NULL;
+    }
+    *prog = bpf_program__fd( program );
+    return obj;
+}
+
+
+/*
+    This function returns a descriptor for the dnp3_stats map of the xdp_dnp3
+    program attached to the interface ifindex, or -1 where no such program is
+    attached.
+*/
+
+static int
+xdp_query( int ifindex )
+{
+    struct bpf_prog_info prog;
+    struct bpf_map_info map;
+    uint32_t id[ 8 ], index, len;
+    int fd, ret;
+
+    if( ( bpf_xdp_query_id( ifindex, 0, &id[0] ) != 0 ) ||
+            ( id[0] == 0 ) ) {
+        fprintf( stderr, "No XDP program attached\n" );
+        return -1;
+    }
+    if( ( fd = bpf_prog_get_fd_by_id( id[0] ) ) < 0 ) {
+        fprintf( stderr, "Unable to open XDP program: %s\n", strerror( errno ) );
+        return -1;
+    }
+    ( void ) memset( &prog, 0, sizeof( prog ) );
+    prog.nr_map_ids = sizeof( id ) / sizeof( id[0] );
+    prog.map_ids = ( uint64_t ) ( uintptr_t ) id;
+    len = sizeof( prog );
+    ret = bpf_obj_get_info_by_fd( fd, &prog, &len );
+    ( void ) close( fd );
+    if( ret != 0 ) {
+        fprintf( stderr, "Unable to query XDP program: %s\n", strerror( errno ) );
+        return -1;
+    }
+
+    for( index = 0; ( index < prog.nr_map_ids ) && ( index < sizeof( id ) / sizeof( id[0] ) ); ++index ) {
+        if( ( fd = bpf_map_get_fd_by_id( id[ index ] ) ) < 0 ) {
+            continue;
+        }
+        ( void ) memset( &map, 0, sizeof( map ) );
+        len = sizeof( map );
+        if( ( bpf_obj_get_info_by_fd( fd, &map, &len ) == 0 ) &&
+                ( strcmp( map.name, "dnp3_stats" ) == 0 ) ) {
+            return fd;
+        }
+        ( void ) close( fd );
+    }
+    fprintf( stderr, "XDP program attached is not xdp_dnp3\n" );
+    return -1;
+}
+
+
+static void
+xdp_stats( FILE *fp, int fd )
+{
+    uint64_t *value, sum;
+    uint32_t index;
+    int cpu, cpus;
+
+    if( ( ( cpus = libbpf_num_possible_cpus() ) <= 0 ) ||
+            ( ( value = calloc( cpus, sizeof( *value ) ) ) == NULL ) ) {
+        return;
+    }
+    fprintf( fp, "%-12s %12s\n", "counter", "count" );
+    for( index = 0; index < XDP_DNP3_STAT_MAX; ++index ) {
+        sum = 0;
+        if( bpf_map_lookup_elem( fd, &index, value ) == 0 ) {
+            for( cpu = 0; cpu < cpus; ++cpu ) {
+                sum += value[ cpu ];
+            }
+        }
+        fprintf( fp, "%-12s %12llu\n", _stats[ index ], ( unsigned long long ) sum );
+    }
+    free( value );
+}
+
+
+static int
+xdp_test( int prog, int stats, const struct dnp3fw_rules *rules, const char *path, int quiet )
+{
+    static const char *verdicts[] = { "SKIP", "ACCEPT", "DROP" };
+    struct xt_dnp3_packet *parsed;
+    struct dnp3fw_packet packet;
+    struct dnp3fw_pcap pcap;
+    uint64_t dropped, passed, skipped, unsafe;
+    uint32_t count, rule;
+    uint8_t *frame;
+    const char *verdict;
+    int evaluated, ret;
+
+    if( dnp3fw_pcap_open( &pcap, path ) != 0 ) {
+        return -1;
+    }
+    frame = malloc( XDP_ETH_HLEN + 65536 );
+    parsed = calloc( 1, sizeof( *parsed ) );
+    if( ( frame == NULL ) ||
+            ( parsed == NULL ) ||
+            ( dnp3fw_session_init( XT_DNP3_SESSIONS, 0 ) != 0 ) ) {
+        fprintf( stderr, "Memory allocation failure\n" );
+        return -1;
+    }
+    parsed->frame = parsed->frames;
+    parsed->size = XT_DNP3_FRAMES;
+
+    /*
+        Each IPv4 datagram of the capture is run within an Ethernet frame, such
+        that the program is tested against captures of any link layer type.
+    */
+
+    ( void ) memset( frame, 0, XDP_ETH_HLEN );
+    frame[12] = 0x08;
+    dropped = passed = skipped = unsafe = 0;
+    for( count = 1;; ++count ) {
+        if( ( ret = dnp3fw_pcap_next( &pcap, &packet ) ) <= 0 ) {
+            if( ret < 0 ) {
+                fprintf( stderr, "%s: Truncated capture file\n", path );
+            }
+            break;
+        }
+        if( packet.protocol == 0 ) {
+            continue;
+        }
+        parsed->count = 0;
+        evaluated = dnp3fw_rules_evaluate( rules, &packet, parsed, DNP3_CRC_SLICE16, &rule );
+
+        LIBBPF_OPTS( bpf_test_run_opts, opts,
+                .data_in = frame,
+                .data_size_in = XDP_ETH_HLEN + packet.iplen,
+                .repeat = 1 );
+        memcpy( frame + XDP_ETH_HLEN, packet.ip, packet.iplen );
+        if( bpf_prog_test_run_opts( prog, &opts ) != 0 ) {
+            verdict = "SKIP";
+            ++skipped;
+        }
+        else if( opts.retval == XDP_DROP ) {
+            verdict = "DROP";
+            ++dropped;
+            if( evaluated != DNP3FW_VERDICT_DROP ) {
+                verdict = "UNSAFE";
+                ++unsafe;
+            }
+        }
+        else {
+            verdict = "PASS";
+            ++passed;
+        }
+        if( ! quiet ) {
+            printf( "%u %s %s\n", count, verdict, verdicts[ evaluated ] );
+        }
+    }
+
+    fprintf( stderr, "%llu passed, %llu dropped, %llu skipped, %llu unsafe\n\n",
+            ( unsigned long long ) passed,
+            ( unsigned long long ) dropped,
+            ( unsigned long long ) skipped,
+            ( unsigned long long ) unsafe );
+    xdp_stats( stderr, stats );
+
+    dnp3fw_session_exit();
+    if( parsed->frame != parsed->frames ) {
+        free( parsed->frame );
+    }
+    free( parsed );
+    free( frame );
+    dnp3fw_pcap_close( &pcap );
+    return ( unsafe == 0 ) ? 0 : -1;
+}
+
+
+static void
+xdp_usage( const char *name )
+{
+    fprintf( stderr, "Usage: %s [-g] [-o object] [-P ACCEPT|DROP] -r rules -i interface\n", name );
+    fprintf( stderr, "       %s -d [-g] -i interface\n", name );
+    fprintf( stderr, "       %s -s -i interface\n", name );
+    fprintf( stderr, "       %s [-o object] [-P ACCEPT|DROP] [-q] -r rules -t capture.pcap\n", name );
+}
+
+
+int
+main( int argc, char **argv )
+{
+    struct dnp3fw_rules rules;
+    struct bpf_object *obj;
+    const char *capture, *interface, *object, *path;
+    uint32_t flags;
+    int c, detach, fd, ifindex, prog, quiet, ret, stats;
+
+    ( void ) memset( &rules, 0, sizeof( rules ) );
+    rules.policy = DNP3FW_VERDICT_ACCEPT;
+    capture = interface = path = NULL;
+    object = XDP_DNP3_OBJECT;
+    flags = XDP_FLAGS_DRV_MODE;
+    detach = quiet = stats = 0;
+    ifindex = 0;
+
+    while( ( c = getopt( argc, argv, "dgi:o:P:qr:st:h" ) ) != -1 ) {
+        switch( c ) {
+            case 'd':
+                detach = 1;
+                break;
+            case 'g':
+                flags = XDP_FLAGS_SKB_MODE;
+                break;
+            case 'i':
+                interface = optarg;
+                break;
+            case 'o':
+                object = optarg;
+                break;
+            case 'P':
+                if( strcmp( optarg, "ACCEPT" ) == 0 ) {
+                    rules.policy = DNP3FW_VERDICT_ACCEPT;
+                }
+                else if( strcmp( optarg, "DROP" ) == 0 ) {
+                    rules.policy = DNP3FW_VERDICT_DROP;
+                }
+                else {
+                    fprintf( stderr, "Unknown policy `%s'\n", optarg );
+                    return 1;
+                }
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 'r':
+                path = optarg;
+                break;
+            case 's':
+                stats = 1;
+                break;
+            case 't':
+                capture = optarg;
+                break;
+            case 'h':
+            default:
+                xdp_usage( argv[0] );
+                return ( c == 'h' ) ? 0 : 1;
+        }
+    }
+    if( ( optind != argc ) ||
+            ( ( capture == NULL ) == ( interface == NULL ) ) ||
+            ( ( ( detach ) || ( stats ) ) ? ( path != NULL ) : ( path == NULL ) ) ) {
+        xdp_usage( argv[0] );
+        return 1;
+    }
+    if( ( interface != NULL ) &&
+            ( ( ifindex = ( int ) if_nametoindex( interface ) ) == 0 ) ) {
+        fprintf( stderr, "%s: %s\n", interface, strerror( errno ) );
+        return 1;
+    }
+
+    if( detach ) {
+        if( bpf_xdp_detach( ifindex, flags, NULL ) != 0 ) {
+            fprintf( stderr, "%s: Unable to detach program: %s\n", interface, strerror( errno ) );
+            return 1;
+        }
+        return 0;
+    }
+    if( stats ) {
+        if( ( fd = xdp_query( ifindex ) ) < 0 ) {
+            return 1;
+        }
+        xdp_stats( stdout, fd );
+        ( void ) close( fd );
+        return 0;
+    }
+
+    dnp3_crc_init();
+    if( dnp3fw_rules_load( &rules, path ) != 0 ) {
+        return 1;
+    }
+    if( ( obj = xdp_open( object, &rules, &prog ) ) == NULL ) {
+        return 1;
+    }
+
+    ret = 0;
+    if( capture != NULL ) {
+        if( ( fd = xdp_map( obj, "dnp3_stats" ) ) < 0 ) {
+            ret = 1;
+        }
+        else if( xdp_test( prog, fd, &rules, capture, quiet ) != 0 ) {
+            ret = 1;
+        }
+    }
+    else if( bpf_xdp_attach( ifindex, prog, flags, NULL ) != 0 ) {
+        fprintf( stderr, "%s: Unable to attach program: %s\n", interface, strerror( errno ) );
+        ret = 1;
+    }
+
+    bpf_object__close( obj );
+    dnp3fw_rules_free( &rules );
+    return ret;
+}
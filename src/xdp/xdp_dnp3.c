@@ -0,0 +1,569 @@
+#include <stdbool.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "xt_dnp3.h"
+#include "xdp_dnp3.h"
+
+
+/*
+    The outcome of the parsing of the DNP3 frames of a packet is recorded as one of
+    the following states. A packet is deferred where the outcome of parsing may
+    differ within the xt_dnp3 kernel module - for example, where a frame is
+    truncated by the end of a packet and may be held for reassembly by the dnp3
+    connection tracking helper.
+*/
+
+enum {
+    XDP_DNP3_VALID = 0,
+    XDP_DNP3_INVALID,
+    XDP_DNP3_DEFERRED,
+};
+
+enum {
+    XDP_DNP3_NOMATCH = 0,
+    XDP_DNP3_MATCH,
+    XDP_DNP3_UNKNOWN,
+};
+
+#define XDP_DNP3_SCRATCH                (512)
+#define XDP_DNP3_SCRATCH_MASK           (XDP_DNP3_SCRATCH - 1)
+
+
+struct xdp_dnp3_frame {
+    __u16 daddr;                        /* Destination address */
+    __u16 saddr;                        /* Source address */
+    __u8 flags;                         /* Frame flags */
+    __u8 func;                          /* Function code */
+    __u8 crc;                           /* CRC validation outcome */
+};
+
+struct xdp_dnp3_packet {
+    struct xdp_dnp3_frame frame[XDP_DNP3_FRAMES];
+    __u32 count;                        /* Number of frames */
+    __u32 src;                          /* Source IP (host order) */
+    __u32 dest;                         /* Destination IP (host order) */
+    __u16 sport;                        /* Source port */
+    __u16 dport;                        /* Destination port */
+    __u8 protocol;                      /* IP protocol */
+    __u8 state;                         /* Parse outcome */
+};
+
+struct xdp_dnp3_scratch {
+    __u8 data[XDP_DNP3_SCRATCH];        /* Frame */
+};
+
+struct xdp_dnp3_vlan {
+    __be16 tci;                         /* Tag control information */
+    __be16 proto;                       /* Encapsulated protocol */
+};
+
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, XDP_DNP3_RULES);
+    __type(key, __u32);
+    __type(value, struct xdp_dnp3_rule);
+} dnp3_rules SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct xdp_dnp3_config);
+} dnp3_config SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, XDP_DNP3_STAT_MAX);
+    __type(key, __u32);
+    __type(value, __u64);
+} dnp3_stats SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct xdp_dnp3_scratch);
+} dnp3_scratch SEC(".maps");
+
+
+static const __u16 _crc[256] = {
+        0x0000, 0x365e, 0x6cbc, 0x5ae2, 0xd978, 0xef26, 0xb5c4, 0x839a,
+        0xff89, 0xc9d7, 0x9335, 0xa56b, 0x26f1, 0x10af, 0x4a4d, 0x7c13,
+        0xb26b, 0x8435, 0xded7, 0xe889, 0x6b13, 0x5d4d, 0x07af, 0x31f1,
+        0x4de2, 0x7bbc, 0x215e, 0x1700, 0x949a, 0xa2c4, 0xf826, 0xce78,
+        0x29af, 0x1ff1, 0x4513, 0x734d, 0xf0d7, 0xc689, 0x9c6b, 0xaa35,
+        0xd626, 0xe078, 0xba9a, 0x8cc4, 0x0f5e, 0x3900, 0x63e2, 0x55bc,
+        0x9bc4, 0xad9a, 0xf778, 0xc126, 0x42bc, 0x74e2, 0x2e00, 0x185e,
+        0x644d, 0x5213, 0x08f1, 0x3eaf, 0xbd35, 0x8b6b, 0xd189, 0xe7d7,
+        0x535e, 0x6500, 0x3fe2, 0x09bc, 0x8a26, 0xbc78, 0xe69a, 0xd0c4,
+        0xacd7, 0x9a89, 0xc06b, 0xf635, 0x75af, 0x43f1, 0x1913, 0x2f4d,
+        0xe135, 0xd76b, 0x8d89, 0xbbd7, 0x384d, 0x0e13, 0x54f1, 0x62af,
+        0x1ebc, 0x28e2, 0x7200, 0x445e, 0xc7c4, 0xf19a, 0xab78, 0x9d26,
+        0x7af1, 0x4caf, 0x164d, 0x2013, 0xa389, 0x95d7, 0xcf35, 0xf96b,
+        0x8578, 0xb326, 0xe9c4, 0xdf9a, 0x5c00, 0x6a5e, 0x30bc, 0x06e2,
+        0xc89a, 0xfec4, 0xa426, 0x9278, 0x11e2, 0x27bc, 0x7d5e, 0x4b00,
+        0x3713, 0x014d, 0x5baf, 0x6df1, 0xee6b, 0xd835, 0x82d7, 0xb489,
+        0xa6bc, 0x90e2, 0xca00, 0xfc5e, 0x7fc4, 0x499a, 0x1378, 0x2526,
+        0x5935, 0x6f6b, 0x3589, 0x03d7, 0x804d, 0xb613, 0xecf1, 0xdaaf,
+        0x14d7, 0x2289, 0x786b, 0x4e35, 0xcdaf, 0xfbf1, 0xa113, 0x974d,
+        0xeb5e, 0xdd00, 0x87e2, 0xb1bc, 0x3226, 0x0478, 0x5e9a, 0x68c4,
+        0x8f13, 0xb94d, 0xe3af, 0xd5f1, 0x566b, 0x6035, 0x3ad7, 0x0c89,
+        0x709a, 0x46c4, 0x1c26, 0x2a78, 0xa9e2, 0x9fbc, 0xc55e, 0xf300,
+        0x3d78, 0x0b26, 0x51c4, 0x679a, 0xe400, 0xd25e, 0x88bc, 0xbee2,
+        0xc2f1, 0xf4af, 0xae4d, 0x9813, 0x1b89, 0x2dd7, 0x7735, 0x416b,
+        0xf5e2, 0xc3bc, 0x995e, 0xaf00, 0x2c9a, 0x1ac4, 0x4026, 0x7678,
+        0x0a6b, 0x3c35, 0x66d7, 0x5089, 0xd313, 0xe54d, 0xbfaf, 0x89f1,
+        0x4789, 0x71d7, 0x2b35, 0x1d6b, 0x9ef1, 0xa8af, 0xf24d, 0xc413,
+        0xb800, 0x8e5e, 0xd4bc, 0xe2e2, 0x6178, 0x5726, 0x0dc4, 0x3b9a,
+        0xdc4d, 0xea13, 0xb0f1, 0x86af, 0x0535, 0x336b, 0x6989, 0x5fd7,
+        0x23c4, 0x159a, 0x4f78, 0x7926, 0xfabc, 0xcce2, 0x9600, 0xa05e,
+        0x6e26, 0x5878, 0x029a, 0x34c4, 0xb75e, 0x8100, 0xdbe2, 0xedbc,
+        0x91af, 0xa7f1, 0xfd13, 0xcb4d, 0x48d7, 0x7e89, 0x246b, 0x1235
+};
+
+
+static __always_inline __u16
+xdp_dnp3_crc(const __u8 *data,
+        __u32 offset,
+        __u32 len) {
+    __u32 index;
+    __u16 crc;
+
+    crc = 0;
+    for (index = 0; index < DNP3_LINK_BLOCK_LENGTH; ++index) {
+        if (index >= len) {
+            break;
+        }
+        crc = (crc >> 8) ^ _crc[(crc ^ data[(offset + index) & XDP_DNP3_SCRATCH_MASK]) & 0x00ff];
+    }
+    return (~crc & 0xffff);
+}
+
+
+static __always_inline __u16
+xdp_dnp3_read16(const __u8 *data,
+        __u32 offset) {
+    return data[offset & XDP_DNP3_SCRATCH_MASK] |
+            (data[(offset + 1) & XDP_DNP3_SCRATCH_MASK] << 8);
+}
+
+
+/*
+    This function validates the CRC of each data block of the complete DNP3 frame
+    of length len bytes held in data, as dnp3_crc_check_frame() within the kernel
+    module, returning -1 where the CRC of any block is invalid.
+*/
+
+static __always_inline int
+xdp_dnp3_blocks(const __u8 *data,
+        __u32 len) {
+    __u32 block, index, segment;
+
+    for (block = 0; block < DNP3_LINK_FRAME_MAX / DNP3_LINK_BLOCK_LENGTH; ++block) {
+        index = DNP3_LINK_HDR_LENGTH + block * (DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH);
+        if (index >= len) {
+            break;
+        }
+        segment = len - index;
+        if (segment > (DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH)) {
+            segment = (DNP3_LINK_BLOCK_LENGTH + DNP3_LINK_CRC_LENGTH);
+        }
+        if (segment <= DNP3_LINK_CRC_LENGTH) {
+            return -1;
+        }
+        segment -= DNP3_LINK_CRC_LENGTH;
+
+        if (xdp_dnp3_crc(data, index, segment) != xdp_dnp3_read16(data, index + segment)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static __always_inline void
+xdp_dnp3_stats_inc(__u32 stat) {
+    __u64 *count;
+
+    if ((count = bpf_map_lookup_elem(&dnp3_stats, &stat))) {
+        ++*count;
+    }
+}
+
+
+/*
+    This function parses the DNP3 frames of the transport payload of a packet,
+    between offset and end, into the frame summaries of packet, as
+    dnp3_packet_parse() within the kernel module. Each frame is copied into a
+    per-CPU scratch buffer, such that frames are parsed irrespective of the
+    layout of the packet buffer, and its CRCs are validated to the depth required
+    by the rule set.
+
+    The function code of the first frame of a message is summarised, while the
+    subsequent frames of a multi-frame message are summarised without a function
+    code, as the function code of these frames is only known to the transport
+    sessions of the kernel module. The first frame of a TCP segment which fails
+    validation may be the remainder of a frame held for reassembly by the dnp3
+    connection tracking helper and, as such, defers the packet.
+*/
+
+static __always_inline void
+xdp_dnp3_parse(struct xdp_md *ctx,
+        __u32 offset,
+        __u32 end,
+        __u8 depth,
+        struct xdp_dnp3_packet *packet) {
+    struct xdp_dnp3_scratch *scratch;
+    struct xdp_dnp3_frame *frame;
+    __u32 bytes, index, key, len, length;
+    __u8 *data;
+
+    key = 0;
+    if (!(scratch = bpf_map_lookup_elem(&dnp3_scratch, &key))) {
+        packet->state = XDP_DNP3_DEFERRED;
+        return;
+    }
+    data = scratch->data;
+
+    for (index = 0; index < XDP_DNP3_FRAMES; ++index) {
+        if (offset >= end) {
+            return;
+        }
+        len = end - offset;
+        if (len < DNP3_LINK_HDR_LENGTH) {
+            xdp_dnp3_stats_inc(XDP_DNP3_STAT_TRUNCATED);
+            packet->state = XDP_DNP3_DEFERRED;
+            return;
+        }
+        if (bpf_xdp_load_bytes(ctx, offset, data, DNP3_LINK_HDR_LENGTH) != 0) {
+            packet->state = XDP_DNP3_DEFERRED;
+            return;
+        }
+        if ((data[0] != 0x05) ||
+                (data[1] != 0x64) ||
+                (data[2] < 5)) {
+            xdp_dnp3_stats_inc(XDP_DNP3_STAT_SYNC);
+            packet->state = ((index == 0) && (packet->protocol == IPPROTO_TCP)) ?
+                    XDP_DNP3_DEFERRED : XDP_DNP3_INVALID;
+            return;
+        }
+
+        frame = &packet->frame[index];
+        packet->count = index + 1;
+        frame->daddr = xdp_dnp3_read16(data, 4);
+        frame->saddr = xdp_dnp3_read16(data, 6);
+
+        if (depth != XT_DNP3_CRC_NONE) {
+            if (xdp_dnp3_crc(data, 0, DNP3_LINK_HDR_LENGTH - DNP3_LINK_CRC_LENGTH) !=
+                    xdp_dnp3_read16(data, DNP3_LINK_HDR_LENGTH - DNP3_LINK_CRC_LENGTH)) {
+                xdp_dnp3_stats_inc(XDP_DNP3_STAT_HEADER_CRC);
+                if ((index == 0) && (packet->protocol == IPPROTO_TCP)) {
+                    packet->state = XDP_DNP3_DEFERRED;
+                    return;
+                }
+                frame->crc |= XT_DNP3_FRAME_HEADER_BAD;
+            }
+        }
+
+        bytes = data[2] - 5;
+        length = DNP3_LINK_HDR_LENGTH + bytes +
+                (((bytes + DNP3_LINK_BLOCK_LENGTH - 1) / DNP3_LINK_BLOCK_LENGTH) * DNP3_LINK_CRC_LENGTH);
+        if (len < length) {
+            xdp_dnp3_stats_inc(XDP_DNP3_STAT_TRUNCATED);
+            packet->state = XDP_DNP3_DEFERRED;
+            return;
+        }
+        barrier_var(length);
+        if ((length < DNP3_LINK_HDR_LENGTH) ||
+                (length > DNP3_LINK_FRAME_MAX)) {
+            packet->state = XDP_DNP3_DEFERRED;
+            return;
+        }
+        if (bpf_xdp_load_bytes(ctx, offset, data, length) != 0) {
+            packet->state = XDP_DNP3_DEFERRED;
+            return;
+        }
+        xdp_dnp3_stats_inc(XDP_DNP3_STAT_FRAMES);
+
+        if ((depth == XT_DNP3_CRC_FULL) ||
+                (depth == XT_DNP3_CRC_SAMPLE)) {
+            if (xdp_dnp3_blocks(data, length) != 0) {
+                xdp_dnp3_stats_inc(XDP_DNP3_STAT_BLOCK_CRC);
+                frame->crc |= XT_DNP3_FRAME_BLOCK_BAD;
+            }
+        }
+
+        if (bytes < DNP3_TSPT_HDR_LENGTH) {
+            frame->flags |= XT_DNP3_FRAME_NODATA;
+        }
+        else if (data[DNP3_LINK_HDR_LENGTH] & DNP3_TSPT_HDR_FIRST_MASK) {
+            if (bytes < (DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET + 1)) {
+                frame->flags |= XT_DNP3_FRAME_NODATA;
+            }
+            else {
+                frame->func = data[DNP3_LINK_HDR_LENGTH + DNP3_TSPT_HDR_LENGTH + DNP3_APPL_FC_OFFSET];
+                frame->flags |= XT_DNP3_FRAME_FC;
+            }
+        }
+        offset += length;
+    }
+
+    if (offset < end) {
+        packet->state = XDP_DNP3_DEFERRED;
+    }
+}
+
+
+static __always_inline bool
+xdp_dnp3_value(__u16 value,
+        const __u16 *range,
+        bool invert) {
+    return (((value >= range[0]) && (value <= range[1])) ^ invert);
+}
+
+
+/*
+    This function matches the frame summaries of a parsed packet against a rule,
+    as dnp3_packet_match() within the kernel module, returning XDP_DNP3_UNKNOWN
+    where the outcome depends upon state not available to the XDP program. As
+    such, a rule with a policy table, object header constraints or a rate limit
+    is only known not to match a packet, where the other criteria of the rule are
+    not matched, while the sampled validation of data block CRCs is treated as
+    selecting any frame with an invalid data block CRC.
+*/
+
+static __always_inline int
+xdp_dnp3_match(const struct xdp_dnp3_rule *rule,
+        const struct xdp_dnp3_packet *packet) {
+    const struct xdp_dnp3_frame *frame;
+    __u32 index;
+    __u8 mask;
+    int result;
+
+    if (rule->protocol != 0) {
+        if ((rule->protocol != packet->protocol) ||
+                (!xdp_dnp3_value(packet->sport, rule->sport, false)) ||
+                (!xdp_dnp3_value(packet->dport, rule->dport, false))) {
+            return XDP_DNP3_NOMATCH;
+        }
+    }
+    if ((rule->src[1] | rule->dest[1]) &&
+            (((packet->src & rule->src[1]) != rule->src[0]) ||
+            ((packet->dest & rule->dest[1]) != rule->dest[0]))) {
+        return XDP_DNP3_NOMATCH;
+    }
+    if (!rule->dnp3) {
+        return XDP_DNP3_MATCH;
+    }
+    if (packet->state == XDP_DNP3_DEFERRED) {
+        return XDP_DNP3_UNKNOWN;
+    }
+    if (packet->state == XDP_DNP3_INVALID) {
+        return XDP_DNP3_NOMATCH;
+    }
+
+    switch (rule->crc) {
+        case XT_DNP3_CRC_NONE:
+            mask = 0;
+            break;
+        case XT_DNP3_CRC_HEADER:
+        case XT_DNP3_CRC_SAMPLE:
+            mask = XT_DNP3_FRAME_HEADER_BAD;
+            break;
+        case XT_DNP3_CRC_FULL:
+        default:
+            mask = XT_DNP3_FRAME_HEADER_BAD | XT_DNP3_FRAME_BLOCK_BAD;
+            break;
+    }
+
+    result = (rule->set & (XT_DNP3_FLAG_POLICY | XT_DNP3_FLAG_OBJECT | XT_DNP3_FLAG_RATE)) ?
+            XDP_DNP3_UNKNOWN : XDP_DNP3_MATCH;
+    for (index = 0; index < XDP_DNP3_FRAMES; ++index) {
+        if (index >= packet->count) {
+            break;
+        }
+        frame = &packet->frame[index];
+
+        if (frame->crc & mask) {
+            return XDP_DNP3_NOMATCH;
+        }
+        if ((rule->crc == XT_DNP3_CRC_SAMPLE) &&
+                (frame->crc & XT_DNP3_FRAME_BLOCK_BAD)) {
+            result = XDP_DNP3_UNKNOWN;
+        }
+        if ((rule->set & XT_DNP3_FLAG_DADDR) &&
+                (!xdp_dnp3_value(frame->daddr, rule->daddr, !! (rule->invert & XT_DNP3_FLAG_DADDR)))) {
+            return XDP_DNP3_NOMATCH;
+        }
+        if ((rule->set & XT_DNP3_FLAG_SADDR) &&
+                (!xdp_dnp3_value(frame->saddr, rule->saddr, !! (rule->invert & XT_DNP3_FLAG_SADDR)))) {
+            return XDP_DNP3_NOMATCH;
+        }
+        if (rule->set & (XT_DNP3_FLAG_FC | XT_DNP3_FLAG_POLICY)) {
+            if (frame->flags & XT_DNP3_FRAME_NODATA) {
+                return XDP_DNP3_NOMATCH;
+            }
+        }
+        if (rule->set & XT_DNP3_FLAG_FC) {
+            if (frame->flags & XT_DNP3_FRAME_FC) {
+                if (!(((rule->fc[(frame->func / 8) & 0x1f] & (1 << (frame->func % 8))) != 0) ^
+                        (!! (rule->invert & XT_DNP3_FLAG_FC)))) {
+                    return XDP_DNP3_NOMATCH;
+                }
+            }
+            else {
+                result = XDP_DNP3_UNKNOWN;
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+    This program evaluates the rule set held in the dnp3_rules map against each
+    unfragmented IPv4 TCP or UDP packet carrying a transport payload, dropping the
+    packet where dropped by a rule or the default policy. All other packets,
+    including those accepted and those for which the verdict could not be
+    determined, are passed to the network stack.
+*/
+
+SEC("xdp")
+int
+xdp_dnp3(struct xdp_md *ctx) {
+    void *data = (void *)(long) ctx->data;
+    void *data_end = (void *)(long) ctx->data_end;
+    const struct xdp_dnp3_config *config;
+    const struct xdp_dnp3_rule *rule;
+    const struct xdp_dnp3_vlan *vlan;
+    const struct ethhdr *eth;
+    const struct iphdr *iph;
+    const struct tcphdr *tcph;
+    const struct udphdr *udph;
+    struct xdp_dnp3_packet packet;
+    __u32 end, hlen, index, key, offset, stat;
+    __be16 proto;
+    __u8 verdict;
+
+    eth = data;
+    offset = sizeof(*eth);
+    if ((void *) (eth + 1) > data_end) {
+        return XDP_PASS;
+    }
+    proto = eth->h_proto;
+    for (index = 0; index < 2; ++index) {
+        if ((proto != bpf_htons(ETH_P_8021Q)) &&
+                (proto != bpf_htons(ETH_P_8021AD))) {
+            break;
+        }
+        vlan = data + offset;
+        if ((void *) (vlan + 1) > data_end) {
+            return XDP_PASS;
+        }
+        proto = vlan->proto;
+        offset += sizeof(*vlan);
+    }
+    if (proto != bpf_htons(ETH_P_IP)) {
+        return XDP_PASS;
+    }
+
+    iph = data + offset;
+    if (((void *) (iph + 1) > data_end) ||
+            (iph->version != 4) ||
+            (iph->ihl < 5) ||
+            (iph->frag_off & bpf_htons(0x3fff))) {
+        return XDP_PASS;
+    }
+    hlen = iph->ihl * 4;
+    end = offset + bpf_ntohs(iph->tot_len);
+    if ((bpf_ntohs(iph->tot_len) < hlen) ||
+            (end > bpf_xdp_get_buff_len(ctx))) {
+        return XDP_PASS;
+    }
+    offset += hlen;
+
+    __builtin_memset(&packet, 0, sizeof(packet));
+    packet.protocol = iph->protocol;
+    packet.src = bpf_ntohl(iph->saddr);
+    packet.dest = bpf_ntohl(iph->daddr);
+    switch (iph->protocol) {
+        case IPPROTO_TCP:
+            tcph = data + offset;
+            if (((void *) (tcph + 1) > data_end) ||
+                    (tcph->doff < 5)) {
+                return XDP_PASS;
+            }
+            packet.sport = bpf_ntohs(tcph->source);
+            packet.dport = bpf_ntohs(tcph->dest);
+            offset += tcph->doff * 4;
+            break;
+        case IPPROTO_UDP:
+            udph = data + offset;
+            if ((void *) (udph + 1) > data_end) {
+                return XDP_PASS;
+            }
+            packet.sport = bpf_ntohs(udph->source);
+            packet.dport = bpf_ntohs(udph->dest);
+            offset += sizeof(*udph);
+            break;
+        default:
+            return XDP_PASS;
+    }
+    if (offset >= end) {
+        return XDP_PASS;
+    }
+
+    key = 0;
+    if (!(config = bpf_map_lookup_elem(&dnp3_config, &key))) {
+        return XDP_PASS;
+    }
+    xdp_dnp3_stats_inc(XDP_DNP3_STAT_PACKETS);
+    xdp_dnp3_parse(ctx, offset, end, config->depth, &packet);
+
+    /*
+        Rules are evaluated in order, as within the iptables chain from which the
+        rule set is taken, such that a packet is only dropped by a rule, or by the
+        default policy, where no preceding rule may match the packet.
+    */
+
+    for (index = 0; index < XDP_DNP3_RULES; ++index) {
+        if (index >= config->count) {
+            break;
+        }
+        if (!(rule = bpf_map_lookup_elem(&dnp3_rules, &index))) {
+            break;
+        }
+        switch (xdp_dnp3_match(rule, &packet)) {
+            case XDP_DNP3_NOMATCH:
+                continue;
+            case XDP_DNP3_MATCH:
+                verdict = rule->verdict;
+                stat = XDP_DNP3_STAT_DROPPED;
+                goto verdict;
+            default:
+                xdp_dnp3_stats_inc(XDP_DNP3_STAT_DEFERRED);
+                return XDP_PASS;
+        }
+    }
+    verdict = config->policy;
+    stat = XDP_DNP3_STAT_POLICY;
+
+verdict:
+    if (verdict == XDP_DNP3_DROP) {
+        xdp_dnp3_stats_inc(stat);
+        return XDP_DROP;
+    }
+    xdp_dnp3_stats_inc(XDP_DNP3_STAT_ACCEPTED);
+    return XDP_PASS;
+}
+
+
+char _license[] SEC("license") = "GPL";
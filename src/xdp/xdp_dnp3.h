@@ -0,0 +1,88 @@
+#ifndef _XDP_DNP3_H
+#define _XDP_DNP3_H
+
+
+#include <linux/types.h>
+
+
+/*
+    The xdp_dnp3 program applies the rule set of a single chain, as read by the
+    userspace tools under src/tools, at the XDP hook of a network interface such
+    that packets which the xt_dnp3 kernel module would reject are dropped before
+    an skb is allocated. Each rule is held as an entry of the dnp3_rules array map,
+    with the number of rules, the default policy and the CRC validation depth of
+    the rule set held in the single entry of the dnp3_config array map.
+
+    The XDP program is stateless and, as such, only drops a packet where the
+    verdict of the rule set for that packet is certain without connection
+    tracking, transport session or policy table state. Any packet for which the
+    verdict depends upon such state - such as the subsequent frames of a
+    multi-frame message matched against a function code rule - is passed to the
+    network stack, where the rule set remains to be applied in full by the
+    xt_dnp3 kernel module.
+*/
+
+#define XDP_DNP3_RULES                  (64)
+
+/*
+    The XDP_DNP3_FRAMES definition specifies the maximum number of DNP3 frames
+    parsed from a packet by the XDP program, with packets carrying more frames
+    passed to the network stack.
+*/
+
+#define XDP_DNP3_FRAMES                 (8)
+
+/*
+    The verdict of a rule and the default policy take the same values as the
+    DNP3FW_VERDICT_ACCEPT and DNP3FW_VERDICT_DROP verdicts of the userspace tools.
+*/
+
+#define XDP_DNP3_ACCEPT                 (1)
+#define XDP_DNP3_DROP                   (2)
+
+struct xdp_dnp3_rule {
+    __u32 src[2];                       /* Source IP and mask (host order) */
+    __u32 dest[2];                      /* Destination IP and mask (host order) */
+    __u16 sport[2];                     /* Source port range */
+    __u16 dport[2];                     /* Destination port range */
+    __u16 daddr[2];                     /* Destination address */
+    __u16 saddr[2];                     /* Source address */
+    __u8 fc[32];                        /* Function code */
+    __u32 set;                          /* Set flags */
+    __u32 invert;                       /* Invert flags */
+    __u8 protocol;                      /* IP protocol, zero for any */
+    __u8 dnp3;                          /* dnp3 match specified */
+    __u8 crc;                           /* CRC validation */
+    __u8 verdict;                       /* Verdict */
+};
+
+struct xdp_dnp3_config {
+    __u32 count;                        /* Number of rules */
+    __u8 policy;                        /* Default verdict */
+    __u8 depth;                         /* CRC validation depth */
+};
+
+
+/*
+    The following counters, held in the dnp3_stats per-CPU array map, record the
+    outcome of the evaluation of IPv4 TCP and UDP packets carrying a transport
+    payload. Packets counted as deferred are those for which the verdict of the
+    rule set could not be determined by the XDP program.
+*/
+
+enum {
+    XDP_DNP3_STAT_PACKETS = 0,          /* Packets evaluated */
+    XDP_DNP3_STAT_FRAMES,               /* Complete frames parsed */
+    XDP_DNP3_STAT_SYNC,                 /* Invalid start or length field */
+    XDP_DNP3_STAT_HEADER_CRC,           /* Link header CRC failure */
+    XDP_DNP3_STAT_BLOCK_CRC,            /* Data block CRC failure */
+    XDP_DNP3_STAT_TRUNCATED,            /* Frame truncated by end of packet */
+    XDP_DNP3_STAT_ACCEPTED,             /* Packets accepted by rule or policy */
+    XDP_DNP3_STAT_DROPPED,              /* Packets dropped by rule */
+    XDP_DNP3_STAT_POLICY,               /* Packets dropped by policy */
+    XDP_DNP3_STAT_DEFERRED,             /* Packets passed undetermined */
+    XDP_DNP3_STAT_MAX
+};
+
+
+#endif